@@ -3,7 +3,7 @@ QT -= gui
 TEMPLATE = lib
 DEFINES += CPPRESTLIB_LIBRARY
 
-CONFIG += c++11
+CONFIG += c++17
 
 INCLUDEPATH += /usr/local/include
 
@@ -17,24 +17,76 @@ LIBS += -llog4cxx
 
 SOURCES += \
     CppRestLib.cpp \
+	CryptoPool.cpp \
+	EventLoop.cpp \
+	HeaderMap.cpp \
+	HttpDate.cpp \
+	HttpScanner.cpp \
+	RequestArena.cpp \
+	RequestParser.cpp \
 	RestRequest.cpp \
 	RestResponse.cpp \
 	RestServer.cpp \
+	Router.cpp \
 	SecureRestServer.cpp \
 	Socket.cpp \
 	SslSocket.cpp \
-	StringUtils.cpp
+	StaticResponse.cpp \
+	StringUtils.cpp \
+	ThreadPool.cpp \
+	TlsConfig.cpp
 
 HEADERS += \
     CppRestLib_global.h \
     CppRestLib.h \
+    CryptoPool.h \
+    EventLoop.h \
+    HeaderMap.h \
+    HttpDate.h \
+    HttpScanner.h \
+    ObjectPool.h \
+    RequestArena.h \
+    RequestParser.h \
     RestRequest.h \
     RestResponse.h \
     RestServer.h \
+    Router.h \
     SecureRestServer.h \
     Socket.h \
     SslSocket.h \
-    StringUtils.h
+    StaticResponse.h \
+    StringUtils.h \
+    ThreadPool.h \
+    TlsConfig.h
+
+# The IO_URING server mode is built with "qmake CONFIG+=io_uring". It needs
+# the headers of Linux 6.1 or later; servers fall back to event loops on
+# kernels that cannot run it.
+io_uring {
+    DEFINES += CPPRESTLIB_IO_URING
+
+    SOURCES += \
+	IoUring.cpp \
+	IoUringLoop.cpp
+
+    HEADERS += \
+    IoUring.h \
+    IoUringLoop.h
+}
+
+# HTTP/2 is built with "qmake CONFIG+=http2". It needs nghttp2; secure
+# servers that enable it offer it to clients through ALPN.
+http2 {
+    DEFINES += CPPRESTLIB_HTTP2
+
+    LIBS += -lnghttp2
+
+    SOURCES += \
+	Http2Session.cpp
+
+    HEADERS += \
+    Http2Session.h
+}
 
 # Default rules for deployment.
 unix {
@@ -0,0 +1,489 @@
+// The RSA and EC key methods are deprecated in OpenSSL 3, but they are the
+// only way short of a provider to take over a key's private operations
+#define OPENSSL_SUPPRESS_DEPRECATED
+
+#include "CryptoPool.h"
+
+#include <openssl/async.h>
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <vector>
+
+using namespace kaoisoft;
+using namespace std;
+using namespace log4cxx;
+
+/* Kinds of private key operations */
+#define RSA_PRIVATE_ENCRYPT 0
+#define EC_SIGN 1
+
+namespace kaoisoft
+{
+    /**
+     * Private key operation that is shared by the connection that waits for
+     * it and the worker that performs it. Whichever of them finishes with it
+     * last deletes it.
+     */
+    struct AsyncKeyOperation
+    {
+        int kind;                               // RSA_PRIVATE_ENCRYPT or EC_SIGN
+        std::vector<unsigned char> input;       // Data to sign
+        std::vector<unsigned char> output;      // Result of the operation
+        int padding;                            // RSA padding, or the digest type of a signature
+        RSA* rsa;                               // RSA key, or nullptr
+        EC_KEY* ecKey;                          // EC key, or nullptr
+        int result;                             // What the operation returned
+        unsigned int outputLength;              // Length of a signature
+        int fd;                                 // eventfd to signal when the operation is done
+        bool done;                              // Whether the operation has been performed
+        bool cancelled;                         // Whether the connection stopped waiting
+        pthread_mutex_t mutex;                  // Protects done, cancelled and the signal
+        std::atomic<int> references;            // Number of users of the operation
+    };
+}
+
+/* Index of the pool in the ex data of an EC key */
+static int ecKeyPoolIndex = -1;
+
+/* Makes sure that ecKeyPoolIndex is only allocated once */
+static pthread_once_t ecKeyPoolIndexOnce = PTHREAD_ONCE_INIT;
+
+/* Connection whose handshake the calling thread is advancing */
+static thread_local AsyncKeyWait* currentWait = nullptr;
+
+/**
+ * Allocates the index of the pool in the ex data of an EC key.
+ */
+static void allocateEcKeyPoolIndex()
+{
+    ecKeyPoolIndex = EC_KEY_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+}
+
+/**
+ * Performs an operation with OpenSSL's own methods.
+ *
+ * @param op Operation to perform
+ */
+static void runOperation(AsyncKeyOperation* op)
+{
+    const RSA_METHOD* rsaDefault = RSA_PKCS1_OpenSSL();
+    switch (op->kind)
+    {
+    case RSA_PRIVATE_ENCRYPT:
+        op->output.resize(RSA_size(op->rsa));
+        op->result = RSA_meth_get_priv_enc(rsaDefault)((int)op->input.size(), op->input.data(),
+                                                       op->output.data(), op->rsa, op->padding);
+        break;
+
+    default:
+    {
+        int (*sign)(int, const unsigned char*, int, unsigned char*, unsigned int*,
+                    const BIGNUM*, const BIGNUM*, EC_KEY*) = nullptr;
+        EC_KEY_METHOD_get_sign(EC_KEY_OpenSSL(), &sign, nullptr, nullptr);
+        op->output.resize(ECDSA_size(op->ecKey));
+        op->outputLength = 0;
+        op->result = sign(op->padding, op->input.data(), (int)op->input.size(),
+                          op->output.data(), &op->outputLength, nullptr, nullptr, op->ecKey);
+        break;
+    }
+    }
+}
+
+/**
+ * Drops one user of an operation, deleting it after the last one.
+ *
+ * @param op Operation to release
+ */
+static void releaseOperation(AsyncKeyOperation* op)
+{
+    if (1 != op->references.fetch_sub(1, memory_order_acq_rel))
+    {
+        return;
+    }
+
+    if (nullptr != op->rsa)
+    {
+        RSA_free(op->rsa);
+    }
+    if (nullptr != op->ecKey)
+    {
+        EC_KEY_free(op->ecKey);
+    }
+    pthread_mutex_destroy(&op->mutex);
+    delete op;
+}
+
+/**
+ * Creates an operation on a key.
+ *
+ * @param kind Kind of operation
+ * @param input Data to sign
+ * @param length Length of the data
+ * @param padding RSA padding, or the digest type of a signature
+ * @param rsa RSA key, or nullptr
+ * @param ecKey EC key, or nullptr
+ *
+ * @return The operation, which has one user
+ */
+static AsyncKeyOperation* createOperation(int kind, const unsigned char* input, int length,
+                                          int padding, RSA* rsa, EC_KEY* ecKey)
+{
+    AsyncKeyOperation* op = new AsyncKeyOperation;
+    op->kind = kind;
+    op->input.assign(input, input + length);
+    op->padding = padding;
+    op->rsa = rsa;
+    op->ecKey = ecKey;
+    op->result = -1;
+    op->outputLength = 0;
+    op->fd = -1;
+    op->done = false;
+    op->cancelled = false;
+    pthread_mutex_init(&op->mutex, nullptr);
+    op->references = 1;
+
+    // The key must stay valid while a worker uses it
+    if (nullptr != rsa)
+    {
+        RSA_up_ref(rsa);
+    }
+    if (nullptr != ecKey)
+    {
+        EC_KEY_up_ref(ecKey);
+    }
+
+    return op;
+}
+
+/**
+ * RSA private encryption (signing) method of a wrapped key.
+ */
+static int rsaPrivateEncrypt(int flen, const unsigned char* from, unsigned char* to, RSA* rsa,
+                             int padding)
+{
+    CryptoPool* pool = (CryptoPool*)RSA_meth_get0_app_data(RSA_get_method(rsa));
+    AsyncKeyOperation* op = createOperation(RSA_PRIVATE_ENCRYPT, from, flen, padding, rsa, nullptr);
+    int ret = pool->perform(op);
+    if (0 < ret)
+    {
+        memcpy(to, op->output.data(), ret);
+    }
+    releaseOperation(op);
+
+    return ret;
+}
+
+/**
+ * ECDSA signing method of a wrapped key.
+ */
+static int ecSign(int type, const unsigned char* dgst, int dlen, unsigned char* sig,
+                  unsigned int* siglen, const BIGNUM* kinv, const BIGNUM* r, EC_KEY* eckey)
+{
+    // A signature with precomputed values is not worth queuing
+    if (nullptr != kinv || nullptr != r)
+    {
+        int (*sign)(int, const unsigned char*, int, unsigned char*, unsigned int*,
+                    const BIGNUM*, const BIGNUM*, EC_KEY*) = nullptr;
+        EC_KEY_METHOD_get_sign(EC_KEY_OpenSSL(), &sign, nullptr, nullptr);
+        return sign(type, dgst, dlen, sig, siglen, kinv, r, eckey);
+    }
+
+    CryptoPool* pool = (CryptoPool*)EC_KEY_get_ex_data(eckey, ecKeyPoolIndex);
+    AsyncKeyOperation* op = createOperation(EC_SIGN, dgst, dlen, type, nullptr, eckey);
+    int ret = pool->perform(op);
+    if (1 == ret)
+    {
+        memcpy(sig, op->output.data(), op->outputLength);
+        *siglen = op->outputLength;
+    }
+    releaseOperation(op);
+
+    return ret;
+}
+
+CryptoPool::CryptoPool(int size, size_t queueCapacity)
+{
+    this->size = size;
+    this->queueCapacity = queueCapacity;
+    threadPool = nullptr;
+    offloaded = 0;
+    inlined = 0;
+    cancelled = 0;
+
+    // Create the logger
+    logger = Logger::getLogger("com.kaoisoft.CryptoPool");
+
+    // Start from OpenSSL's own methods and only take over the private key
+    // operations
+    rsaMethod = RSA_meth_dup(RSA_PKCS1_OpenSSL());
+    if (nullptr != rsaMethod)
+    {
+        RSA_meth_set1_name(rsaMethod, "CppRestLib crypto pool");
+        RSA_meth_set0_app_data(rsaMethod, this);
+        RSA_meth_set_priv_enc(rsaMethod, rsaPrivateEncrypt);
+    }
+    ecMethod = EC_KEY_METHOD_new(EC_KEY_OpenSSL());
+    if (nullptr != ecMethod)
+    {
+        int (*signSetup)(EC_KEY*, BN_CTX*, BIGNUM**, BIGNUM**) = nullptr;
+        ECDSA_SIG* (*signSig)(const unsigned char*, int, const BIGNUM*, const BIGNUM*,
+                              EC_KEY*) = nullptr;
+        EC_KEY_METHOD_get_sign(ecMethod, nullptr, &signSetup, &signSig);
+        EC_KEY_METHOD_set_sign(ecMethod, ecSign, signSetup, signSig);
+    }
+    pthread_once(&ecKeyPoolIndexOnce, allocateEcKeyPoolIndex);
+}
+
+CryptoPool::~CryptoPool()
+{
+    stop();
+
+    if (nullptr != rsaMethod)
+    {
+        RSA_meth_free(rsaMethod);
+    }
+    if (nullptr != ecMethod)
+    {
+        EC_KEY_METHOD_free(ecMethod);
+    }
+}
+
+void CryptoPool::cancel(AsyncKeyWait* wait)
+{
+    AsyncKeyOperation* op = wait->pending;
+    if (nullptr == op)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&op->mutex);
+    op->cancelled = true;
+    pthread_mutex_unlock(&op->mutex);
+}
+
+void CryptoPool::getStatistics(CryptoPoolStatistics* stats)
+{
+    stats->offloaded = offloaded.load(memory_order_relaxed);
+    stats->inlined = inlined.load(memory_order_relaxed);
+    stats->cancelled = cancelled.load(memory_order_relaxed);
+}
+
+void CryptoPool::getThreadPoolStatistics(ThreadPoolStatistics* stats)
+{
+    if (nullptr == threadPool)
+    {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+
+    threadPool->getStatistics(stats);
+}
+
+void* CryptoPool::operationJob(void* args)
+{
+    AsyncKeyOperation* op = (AsyncKeyOperation*)args;
+
+    // Skip the work if the connection has already gone
+    pthread_mutex_lock(&op->mutex);
+    bool skip = op->cancelled;
+    pthread_mutex_unlock(&op->mutex);
+    if (!skip)
+    {
+        runOperation(op);
+    }
+
+    // The connection may close its eventfd as soon as it has cancelled the
+    // operation, so it is only signaled while the lock is held
+    pthread_mutex_lock(&op->mutex);
+    if (!op->cancelled)
+    {
+        op->done = true;
+        // This cannot fail, since the waiter resets the counter after each
+        // operation
+        uint64_t value = 1;
+        ssize_t written = ::write(op->fd, &value, sizeof(value));
+        (void)written;
+    }
+    pthread_mutex_unlock(&op->mutex);
+
+    releaseOperation(op);
+
+    return nullptr;
+}
+
+int CryptoPool::perform(AsyncKeyOperation* op)
+{
+    AsyncKeyWait* wait = currentWait;
+
+    // The pool is only worth it when the handshake can be paused while the
+    // operation is performed
+    if (nullptr == threadPool || nullptr == wait || nullptr == ASYNC_get_current_job())
+    {
+        inlined.fetch_add(1, memory_order_relaxed);
+        runOperation(op);
+        return op->result;
+    }
+    if (-1 == wait->fd)
+    {
+        wait->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (-1 == wait->fd)
+        {
+            LOG4CXX_ERROR(logger, "Could not create an eventfd: " << strerror(errno));
+            inlined.fetch_add(1, memory_order_relaxed);
+            runOperation(op);
+            return op->result;
+        }
+    }
+
+    // Queue the operation. The worker holds a reference of its own.
+    op->fd = wait->fd;
+    op->references.fetch_add(1, memory_order_relaxed);
+    if (!threadPool->submit(CryptoPool::operationJob, op))
+    {
+        op->references.fetch_sub(1, memory_order_relaxed);
+        inlined.fetch_add(1, memory_order_relaxed);
+        runOperation(op);
+        return op->result;
+    }
+    offloaded.fetch_add(1, memory_order_relaxed);
+
+    // Let the thread serve other connections until the operation is done.
+    // The job may be resumed early, for example when the client closes the
+    // connection, in which case it is paused again.
+    wait->pending = op;
+    bool done = false;
+    bool abandoned = false;
+    for (;;)
+    {
+        pthread_mutex_lock(&op->mutex);
+        done = op->done;
+        abandoned = op->cancelled;
+        pthread_mutex_unlock(&op->mutex);
+        if (done || abandoned)
+        {
+            break;
+        }
+        if (0 == ASYNC_pause_job())
+        {
+            // The job cannot be paused, so wait here
+            struct pollfd pfd;
+            pfd.fd = wait->fd;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            poll(&pfd, 1, -1);
+        }
+    }
+    wait->pending = nullptr;
+
+    // Reset the eventfd for the next operation
+    uint64_t value;
+    if (-1 == ::read(wait->fd, &value, sizeof(value)) && EAGAIN != errno)
+    {
+        LOG4CXX_DEBUG(logger, "Could not reset the eventfd: " << strerror(errno));
+    }
+
+    if (abandoned)
+    {
+        cancelled.fetch_add(1, memory_order_relaxed);
+        return -1;
+    }
+
+    return op->result;
+}
+
+void CryptoPool::setCurrentWait(AsyncKeyWait* wait)
+{
+    currentWait = wait;
+}
+
+bool CryptoPool::start()
+{
+    if (nullptr == rsaMethod || nullptr == ecMethod || -1 == ecKeyPoolIndex)
+    {
+        LOG4CXX_ERROR(logger, "Could not create the key methods");
+        return false;
+    }
+    if (!ASYNC_is_capable())
+    {
+        LOG4CXX_ERROR(logger, "OpenSSL cannot run async jobs on this platform");
+        return false;
+    }
+
+    // Operations that do not fit in the queue are performed by the caller
+    threadPool = new ThreadPool(size, queueCapacity, ThreadPool::REJECT);
+    if (!threadPool->start())
+    {
+        LOG4CXX_ERROR(logger, "Could not start the crypto threads");
+        delete threadPool;
+        threadPool = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+void CryptoPool::stop()
+{
+    if (nullptr != threadPool)
+    {
+        threadPool->stop();
+        delete threadPool;
+        threadPool = nullptr;
+    }
+}
+
+EVP_PKEY* CryptoPool::wrapKey(EVP_PKEY* key)
+{
+    EVP_PKEY* wrapped = nullptr;
+    switch (EVP_PKEY_base_id(key))
+    {
+    case EVP_PKEY_RSA:
+    {
+        RSA* rsa = EVP_PKEY_get1_RSA(key);
+        if (nullptr == rsa)
+        {
+            break;
+        }
+        wrapped = EVP_PKEY_new();
+        if (nullptr == wrapped || 1 != RSA_set_method(rsa, rsaMethod) ||
+            1 != EVP_PKEY_assign_RSA(wrapped, rsa))
+        {
+            RSA_free(rsa);
+            EVP_PKEY_free(wrapped);
+            wrapped = nullptr;
+        }
+        break;
+    }
+
+    case EVP_PKEY_EC:
+    {
+        EC_KEY* ecKey = EVP_PKEY_get1_EC_KEY(key);
+        if (nullptr == ecKey)
+        {
+            break;
+        }
+        wrapped = EVP_PKEY_new();
+        if (nullptr == wrapped || 1 != EC_KEY_set_method(ecKey, ecMethod) ||
+            1 != EC_KEY_set_ex_data(ecKey, ecKeyPoolIndex, this) ||
+            1 != EVP_PKEY_assign_EC_KEY(wrapped, ecKey))
+        {
+            EC_KEY_free(ecKey);
+            EVP_PKEY_free(wrapped);
+            wrapped = nullptr;
+        }
+        break;
+    }
+
+    default:
+        LOG4CXX_ERROR(logger, "Only RSA and EC keys can be used with the crypto pool");
+        break;
+    }
+
+    return wrapped;
+}
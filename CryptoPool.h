@@ -0,0 +1,154 @@
+#ifndef CRYPTOPOOL_H
+#define CRYPTOPOOL_H
+
+#include "ThreadPool.h"
+
+#include <log4cxx/logger.h>
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
+#include <openssl/ec.h>
+
+#include <atomic>
+
+namespace kaoisoft
+{
+    struct AsyncKeyOperation;
+
+    /**
+     * Lets one connection wait for the private key operations that a crypto
+     * pool runs for its handshake.
+     */
+    struct AsyncKeyWait
+    {
+        int fd;                         // eventfd that is signaled when an operation finishes, or -1 until one is needed
+        AsyncKeyOperation* pending;     // Operation that the handshake is paused for, or nullptr
+    };
+
+    /**
+     * Snapshot of the private key operations that a crypto pool has handled.
+     */
+    struct CryptoPoolStatistics
+    {
+        unsigned long long offloaded;   // Operations that were run by the pool
+        unsigned long long inlined;     // Operations that were run on the calling thread
+        unsigned long long cancelled;   // Operations whose connection was closed before they finished
+    };
+
+    /**
+     * Worker threads that perform the server's private key operations (the
+     * RSA or ECDSA signature of a full TLS handshake) so that the threads
+     * which serve connections are not held up by them.
+     *
+     * The pool works with OpenSSL's asynchronous mode (SSL_MODE_ASYNC), in
+     * which each handshake runs in an async job. wrapKey() gives the server's
+     * key methods that, when they are called inside a job, queue the
+     * operation on the pool and pause the job. SSL_accept() then reports
+     * SSL_ERROR_WANT_ASYNC, and the connection's eventfd becomes readable once
+     * the operation is done, at which point SSL_accept() is called again to
+     * resume the job. Operations that are not called inside a job, or that
+     * do not fit in the queue, are performed on the calling thread.
+     *
+     * OpenSSL finds out which connection is waiting through setCurrentWait(),
+     * which SslSocket calls around each step of the handshake.
+     */
+    class CryptoPool
+    {
+    private:
+        int size;                                   // Number of worker threads
+        size_t queueCapacity;                       // Most operations that may wait for a worker
+        ThreadPool* threadPool;                     // Workers that perform the operations
+        RSA_METHOD* rsaMethod;                      // RSA methods that queue private key operations
+        EC_KEY_METHOD* ecMethod;                    // EC methods that queue signatures
+        std::atomic<unsigned long long> offloaded;  // Operations that were run by the pool
+        std::atomic<unsigned long long> inlined;    // Operations that were run on the calling thread
+        std::atomic<unsigned long long> cancelled;  // Operations whose connection was closed first
+        log4cxx::LoggerPtr logger;                  // Logger for instances of this class
+
+    private:
+        /**
+         * Runs in a worker thread and performs a queued operation.
+         *
+         * @param args The operation
+         *
+         * @return nullptr
+         */
+        static void* operationJob(void* args);
+
+    public:
+        /**
+         * @param size Number of worker threads
+         * @param queueCapacity Most operations that may wait for a worker
+         */
+        CryptoPool(int size, size_t queueCapacity);
+        virtual ~CryptoPool();
+
+        /**
+         * Cancels the operation that a connection is waiting for, so that
+         * the connection's handshake can be abandoned. The paused job must
+         * then be resumed once more, and fails. No worker signals the
+         * connection's eventfd once this returns.
+         *
+         * @param wait Connection's wait, whose pending operation is cancelled
+         */
+        static void cancel(AsyncKeyWait* wait);
+
+        /**
+         * Gets the totals of the private key operations.
+         *
+         * @param stats Structure into which the statistics are stored
+         */
+        void getStatistics(CryptoPoolStatistics* stats);
+
+        /**
+         * Gets the sizing and activity of the worker threads.
+         *
+         * @param stats Structure into which the statistics are stored
+         */
+        void getThreadPoolStatistics(ThreadPoolStatistics* stats);
+
+        /**
+         * Performs a private key operation, in the pool if the caller is in
+         * an async job and on the calling thread otherwise. This is called by
+         * the methods of the keys that wrapKey() made.
+         *
+         * @param op Operation to perform, which belongs to the caller
+         *
+         * @return The result of the operation
+         */
+        int perform(AsyncKeyOperation* op);
+
+        /**
+         * Tells the key methods which connection the calling thread is
+         * advancing the handshake of.
+         *
+         * @param wait Connection's wait, or nullptr once the step is over
+         */
+        static void setCurrentWait(AsyncKeyWait* wait);
+
+        /**
+         * Starts the worker threads.
+         *
+         * @return true if successful
+         */
+        bool start();
+
+        /**
+         * Waits for the queued operations and stops the worker threads.
+         */
+        void stop();
+
+        /**
+         * Makes a copy of a private key whose operations are performed by
+         * this pool. Only RSA and EC keys can be wrapped. The pool must
+         * outlive the copy and anything that uses it.
+         *
+         * @param key Key to wrap
+         *
+         * @return The new key, which the caller frees, or nullptr if the key
+         *         cannot be wrapped
+         */
+        EVP_PKEY* wrapKey(EVP_PKEY* key);
+    };
+}
+
+#endif // CRYPTOPOOL_H
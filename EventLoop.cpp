@@ -0,0 +1,846 @@
+#include "EventLoop.h"
+#ifdef CPPRESTLIB_HTTP2
+#include "Http2Session.h"
+#endif
+#include "ObjectPool.h"
+#include "RequestParser.h"
+#include "RestServer.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace kaoisoft;
+using namespace std;
+using namespace log4cxx;
+
+/* Maximum number of events handled per call to epoll_wait() */
+#define MAX_EVENTS 64
+
+/* Longest time between checks for idle connections (milliseconds) */
+#define MAX_IDLE_CHECK_INTERVAL 1000
+
+/* Most buffers gathered into one write */
+#define MAX_WRITE_BUFFERS 16
+
+/**
+ * Adds the part of a buffer that has not been written yet to a list of
+ * buffers to write.
+ *
+ * @param iov List of buffers
+ * @param count Number of buffers in the list, which is updated
+ * @param buffer Buffer to add
+ * @param skip Number of bytes at the start of the remaining buffers that have
+ *             already been written, which is updated
+ */
+static void addBuffer(struct iovec* iov, int* count, string_view buffer, size_t* skip)
+{
+    if (*skip >= buffer.length())
+    {
+        *skip -= buffer.length();
+        return;
+    }
+
+    iov[*count].iov_base = (void*)(buffer.data() + *skip);
+    iov[*count].iov_len = buffer.length() - *skip;
+    (*count)++;
+    *skip = 0;
+}
+
+/**
+ * Keeps a connection whose socket has been closed for reuse by the next one,
+ * along with the memory that its request, arena and output queue have grown.
+ *
+ * @param conn Connection to recycle, whose responses have been released
+ */
+static void recycleConnection(EventLoopConnection* conn)
+{
+    conn->outputQueue.clear();
+    conn->request.reset();
+    conn->arena.reset();
+    ObjectPool<EventLoopConnection>::release(conn);
+}
+
+EventLoop::EventLoop(RestServer* server, const vector<Socket*>& listenSockets)
+{
+    this->server = server;
+    this->listenSockets = listenSockets;
+    epollFd = -1;
+    wakeFd = -1;
+    running = false;
+    lastIdleCheck = now();
+
+    // Create the logger
+    logger = Logger::getLogger("com.kaoisoft.EventLoop");
+}
+
+EventLoop::~EventLoop()
+{
+    // Close the connections that are still open
+    while (!connections.empty())
+    {
+        closeConnection(connections.begin()->second);
+    }
+
+    if (-1 != wakeFd)
+    {
+        close(wakeFd);
+    }
+    if (-1 != epollFd)
+    {
+        close(epollFd);
+    }
+}
+
+void EventLoop::acceptClients(Socket* listener)
+{
+    // Accept connections until there are none left or the batch is full, in
+    // which case epoll reports the listen socket again on the next pass.
+    // Another loop may have already taken the connection that woke this one.
+    for (int accepted = 0; accepted < server->acceptBatchSize && running; accepted++)
+    {
+        Socket* socket = server->acceptClient(listener);
+        if (nullptr == socket)
+        {
+            break;
+        }
+        int sock = socket->getHandle();
+
+        // Start watching the connection
+        EventLoopConnection* conn = ObjectPool<EventLoopConnection>::take();
+        if (nullptr == conn)
+        {
+            conn = new EventLoopConnection;
+        }
+        conn->sock = socket;
+        conn->handshaking = true;
+        conn->asyncFd = -1;
+        conn->http2 = nullptr;
+        conn->outputOffset = 0;
+        conn->queuedBytes = 0;
+        conn->closeAfterWrite = false;
+        conn->inputClosed = false;
+        conn->events = EPOLLIN;
+        conn->continueSent = false;
+        conn->requestCount = 0;
+        conn->lastActivity = now();
+
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = conn->events;
+        event.data.fd = sock;
+        if (-1 == epoll_ctl(epollFd, EPOLL_CTL_ADD, sock, &event))
+        {
+            LOG4CXX_ERROR(logger, "Could not add client connection to epoll: " << strerror(errno));
+            socket->recycle();
+            recycleConnection(conn);
+            continue;
+        }
+        connections[sock] = conn;
+
+        // Start securing the connection. Plain ones are ready straight away.
+        continueHandshake(conn);
+    }
+}
+
+void EventLoop::closeIdleConnections()
+{
+    long long currentTime = now();
+    lastIdleCheck = currentTime;
+
+    map<int, EventLoopConnection*>::iterator iter = connections.begin();
+    while (iter != connections.end())
+    {
+        EventLoopConnection* conn = iter->second;
+        iter++;
+
+        // Requests that are waiting in the input buffer with nothing queued
+        // ahead of them are served rather than counted as idle. Whatever is
+        // left afterwards is part of a request.
+        if (!conn->handshaking && 0 == conn->queuedBytes &&
+            0 < conn->sock->getBufferedLength())
+        {
+            int sock = conn->sock->getHandle();
+            serviceConnection(conn);
+            if (connections.end() == connections.find(sock))
+            {
+                continue;
+            }
+        }
+
+        // A client that is being sent a response must keep accepting it, and
+        // a client that has sent part of a request gets the read timeout
+        int timeout = server->keepAliveTimeout;
+        if (conn->handshaking)
+        {
+            timeout = server->handshakeTimeout;
+        }
+        else if (0 < conn->queuedBytes)
+        {
+            timeout = server->writeTimeout;
+        }
+        else if (0 < conn->sock->getBufferedLength())
+        {
+            timeout = server->readTimeout;
+        }
+        if (currentTime - conn->lastActivity > timeout)
+        {
+            LOG4CXX_DEBUG(logger, "Connection to client at " << conn->sock->getRemoteAddress() <<
+                          " has been idle for too long");
+            closeConnection(conn);
+        }
+    }
+}
+
+void EventLoop::closeConnection(EventLoopConnection* conn)
+{
+    int sock = conn->sock->getHandle();
+
+    unwatchAsync(conn);
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, sock, nullptr);
+    connections.erase(sock);
+
+    LOG4CXX_DEBUG(logger, "Closing connection to client at " <<
+                  conn->sock->getRemoteAddress());
+
+    deque<EventLoopOutput>::iterator iter;
+    for (iter = conn->outputQueue.begin(); iter != conn->outputQueue.end(); iter++)
+    {
+        releaseResponse(iter->response);
+    }
+#ifdef CPPRESTLIB_HTTP2
+    delete conn->http2;
+    conn->http2 = nullptr;
+#endif
+    conn->sock->recycle();
+    recycleConnection(conn);
+}
+
+void* EventLoop::eventLoopThread(void* args)
+{
+    EventLoop* inst = (EventLoop*)args;
+
+    inst->run();
+
+    return nullptr;
+}
+
+void EventLoop::continueHandshake(EventLoopConnection* conn)
+{
+    uint32_t events;
+    Socket::HandshakeStatus status = conn->sock->continueHandshake();
+    if (Socket::HANDSHAKE_WANT_ASYNC != status)
+    {
+        unwatchAsync(conn);
+    }
+    switch (status)
+    {
+    case Socket::HANDSHAKE_DONE:
+        conn->handshaking = false;
+        if (!server->verifyClient(conn->sock))
+        {
+            closeConnection(conn);
+            return;
+        }
+        conn->lastActivity = now();
+
+#ifdef CPPRESTLIB_HTTP2
+        // The client may have chosen HTTP/2 while securing the connection
+        if (HTTP2_ALPN_ID == conn->sock->getApplicationProtocol())
+        {
+            conn->http2 = new Http2Session(server, conn->sock);
+            if (!conn->http2->start())
+            {
+                closeConnection(conn);
+                return;
+            }
+        }
+#endif
+
+        // The client may have sent its first request right behind the end of
+        // the handshake
+        handleRead(conn);
+        return;
+
+    case Socket::HANDSHAKE_WANT_READ:
+        events = EPOLLIN;
+        break;
+
+    case Socket::HANDSHAKE_WANT_WRITE:
+        events = EPOLLOUT;
+        break;
+
+    case Socket::HANDSHAKE_WANT_ASYNC:
+        if (!watchAsync(conn))
+        {
+            closeConnection(conn);
+        }
+        return;
+
+    default:
+        LOG4CXX_DEBUG(logger, "Could not secure the connection to client at " <<
+                      conn->sock->getRemoteAddress());
+        closeConnection(conn);
+        return;
+    }
+
+    if (!watchEvents(conn, events))
+    {
+        closeConnection(conn);
+    }
+}
+
+void EventLoop::handleRead(EventLoopConnection* conn)
+{
+    // Read until the socket has no more data for us, unless the client is
+    // being held back until it accepts the output that is queued for it
+    if (isReading(conn))
+    {
+        int ret;
+        while (0 < (ret = conn->sock->fillBuffer()))
+        {
+            conn->lastActivity = now();
+        }
+        if (-1 == ret)
+        {
+            // The client closed the connection or it failed. The requests
+            // that it sent before then are still answered.
+            conn->inputClosed = true;
+        }
+    }
+
+    serviceConnection(conn);
+}
+
+bool EventLoop::isReading(EventLoopConnection* conn)
+{
+    return !conn->inputClosed && !conn->closeAfterWrite &&
+           !server->isPipelineFull(conn->outputQueue.size(), conn->queuedBytes);
+}
+
+long long EventLoop::now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+bool EventLoop::processInput(EventLoopConnection* conn)
+{
+    bool queued = false;
+
+    // Serve the requests that have arrived, in order, until the responses
+    // that are waiting for the client reach the caps. The rest are served
+    // once the client has accepted some of them.
+    while (!conn->closeAfterWrite && 0 < conn->sock->getBufferedLength() &&
+           !server->isPipelineFull(conn->outputQueue.size(), conn->queuedBytes))
+    {
+        // Try to parse a whole request out of the data received so far
+        RestRequest& request = conn->request;
+        request.reset();
+        size_t consumed;
+        int errorCode;
+        RequestParser::Status status = RequestParser::parse(conn->sock->getBufferedData(),
+                                                            conn->sock->getBufferedLength(),
+                                                            server->maxBodySize, &request,
+                                                            &consumed, &errorCode);
+        if (RequestParser::INVALID == status)
+        {
+            // Tell the client what was wrong with the request and hang up
+            LOG4CXX_DEBUG(logger, "Invalid request from client at " <<
+                          conn->sock->getRemoteAddress() << ", responding with " << errorCode);
+            RestResponse* response = takeResponse();
+            RestServer::fillErrorResponse(errorCode, response);
+            response->addHeader("Connection", "close");
+            conn->closeAfterWrite = true;
+            queueOutput(conn, nullptr, response->getHeaderBlock(&conn->arena), response);
+            return true;
+        }
+        if (RequestParser::COMPLETE != status)
+        {
+            if (RequestParser::EXPECT_CONTINUE == status && !conn->continueSent)
+            {
+                // The client is waiting for permission to send the body
+                queueOutput(conn, nullptr,
+                            std::pmr::string("HTTP/1.1 100 Continue\r\n\r\n", &conn->arena),
+                            nullptr);
+                conn->continueSent = true;
+                queued = true;
+            }
+            break;
+        }
+        conn->sock->consume(consumed);
+        conn->continueSent = false;
+        LOG4CXX_TRACE(logger, "Received request " << request.toString() <<
+                      " from client at " << conn->sock->getRemoteAddress());
+
+        // Route the request to the appropriate handler, unless its response
+        // has already been serialized
+        conn->requestCount++;
+        HandlerData* handlerData = server->findRoute(&request);
+        const StaticResponse* staticResponse = handlerData->staticResponse;
+        if (nullptr != staticResponse)
+        {
+            conn->closeAfterWrite = !server->keepConnectionAlive(&request, staticResponse,
+                                                                  conn->requestCount);
+            queueOutput(conn, staticResponse,
+                        staticResponse->getClosingBlock(!conn->closeAfterWrite, &conn->arena),
+                        nullptr);
+            queued = true;
+            continue;
+        }
+        RestResponse* response = takeResponse();
+        (handlerData->handler)(request, *response);
+        conn->closeAfterWrite = !server->keepConnectionAlive(&request, response,
+                                                              conn->requestCount);
+
+        // Queue the response behind any that have not been written yet
+        queueOutput(conn, nullptr, response->getHeaderBlock(&conn->arena), response);
+        queued = true;
+    }
+
+    return queued;
+}
+
+void EventLoop::queueOutput(EventLoopConnection* conn, const StaticResponse* staticResponse,
+                            std::pmr::string header, RestResponse* response)
+{
+    LOG4CXX_TRACE(logger, "Sending response " <<
+                  ((nullptr != staticResponse) ? staticResponse->getHead() : "") << header <<
+                  " to client at " << conn->sock->getRemoteAddress());
+
+    // Moving the header in keeps it in the memory it was built in
+    conn->outputQueue.push_back({staticResponse, std::move(header), response});
+    conn->queuedBytes += conn->outputQueue.back().getLength();
+}
+
+void EventLoop::releaseResponse(RestResponse* response)
+{
+    if (nullptr == response)
+    {
+        return;
+    }
+
+    response->reset();
+    ObjectPool<RestResponse>::release(response);
+}
+
+void EventLoop::run()
+{
+    struct epoll_event events[MAX_EVENTS];
+
+    // Wake up often enough to close idle connections on time
+    int idleCheckInterval = server->keepAliveTimeout;
+    if (0 >= idleCheckInterval || MAX_IDLE_CHECK_INTERVAL < idleCheckInterval)
+    {
+        idleCheckInterval = MAX_IDLE_CHECK_INTERVAL;
+    }
+
+    while (running)
+    {
+        int count = epoll_wait(epollFd, events, MAX_EVENTS, idleCheckInterval);
+        if (-1 == count)
+        {
+            if (EINTR != errno)
+            {
+                LOG4CXX_ERROR(logger, "epoll_wait failed: " << strerror(errno));
+                break;
+            }
+            continue;
+        }
+
+        for (int i = 0; i < count && running; i++)
+        {
+            int fd = events[i].data.fd;
+            if (fd == wakeFd)
+            {
+                // stop() was called
+                continue;
+            }
+            Socket* listener = nullptr;
+            vector<Socket*>::iterator listenIter;
+            for (listenIter = listenSockets.begin(); listenIter != listenSockets.end(); listenIter++)
+            {
+                if (fd == (*listenIter)->getHandle())
+                {
+                    listener = *listenIter;
+                    break;
+                }
+            }
+            if (nullptr != listener)
+            {
+                acceptClients(listener);
+                continue;
+            }
+
+            // The connection may have been closed while handling an earlier event
+            map<int, EventLoopConnection*>::iterator iter = connections.find(fd);
+            if (iter == connections.end())
+            {
+                // The crypto pool has finished an operation that a handshake
+                // was waiting for
+                iter = asyncWaits.find(fd);
+                if (iter != asyncWaits.end())
+                {
+                    continueHandshake(iter->second);
+                }
+                continue;
+            }
+            EventLoopConnection* conn = iter->second;
+
+            if (conn->handshaking && -1 != conn->asyncFd)
+            {
+                // Only a client that has gone away is reported while the
+                // handshake waits for the crypto pool
+                if (events[i].events & (EPOLLHUP | EPOLLERR))
+                {
+                    closeConnection(conn);
+                }
+            }
+            else if (conn->handshaking)
+            {
+                continueHandshake(conn);
+            }
+            else if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+            {
+                handleRead(conn);
+            }
+            else
+            {
+                // The socket has room for more of the output
+                serviceConnection(conn);
+            }
+        }
+
+        if (running && now() - lastIdleCheck >= idleCheckInterval)
+        {
+            closeIdleConnections();
+        }
+    }
+
+    // Close the connections on this thread, since a handshake that is paused
+    // for the crypto pool can only be abandoned by the thread that started it
+    while (!connections.empty())
+    {
+        closeConnection(connections.begin()->second);
+    }
+}
+
+void EventLoop::serviceConnection(EventLoopConnection* conn)
+{
+#ifdef CPPRESTLIB_HTTP2
+    if (nullptr != conn->http2)
+    {
+        serviceHttp2(conn);
+        return;
+    }
+#endif
+
+    // Alternate between serving requests and writing their responses until
+    // the socket is full or there is nothing left to do. Requests that were
+    // held back by the caps are already in the input buffer, so no event
+    // will announce them: they are served as soon as the queue has drained.
+    for (;;)
+    {
+        bool queued = processInput(conn);
+        bool heldBack = server->isPipelineFull(conn->outputQueue.size(), conn->queuedBytes);
+        if (!writeOutput(conn))
+        {
+            closeConnection(conn);
+            return;
+        }
+        if (0 < conn->queuedBytes || (!queued && !heldBack))
+        {
+            break;
+        }
+    }
+
+    // Hang up once everything has been sent, if the connection is finished
+    if (0 == conn->queuedBytes && (conn->closeAfterWrite || conn->inputClosed))
+    {
+        closeConnection(conn);
+        return;
+    }
+
+    if (!updateEvents(conn))
+    {
+        closeConnection(conn);
+    }
+}
+
+#ifdef CPPRESTLIB_HTTP2
+void EventLoop::serviceHttp2(EventLoopConnection* conn)
+{
+    Http2Session* session = conn->http2;
+
+    // Serve the requests that the new frames complete, then write the
+    // responses and anything else that the session has to send
+    if (!session->receive())
+    {
+        closeConnection(conn);
+        return;
+    }
+    int ret = session->send();
+    if (-1 == ret)
+    {
+        closeConnection(conn);
+        return;
+    }
+    if (0 < ret)
+    {
+        conn->lastActivity = now();
+    }
+
+    // The frames that the socket did not take count as the connection's
+    // queued output, which holds back reading and sets the write timeout
+    conn->queuedBytes = session->getPendingLength();
+
+    // Hang up once the session is over, or once a client that has stopped
+    // sending has been sent everything
+    if (session->isFinished() || (conn->inputClosed && 0 == conn->queuedBytes))
+    {
+        closeConnection(conn);
+        return;
+    }
+
+    if (!updateEvents(conn))
+    {
+        closeConnection(conn);
+    }
+}
+#endif
+
+bool EventLoop::start()
+{
+    // Create the epoll instance
+    if (-1 == (epollFd = epoll_create1(EPOLL_CLOEXEC)))
+    {
+        LOG4CXX_ERROR(logger, "Could not create epoll instance: " << strerror(errno));
+        return false;
+    }
+
+    // Create the descriptor used to wake up the loop
+    if (-1 == (wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)))
+    {
+        LOG4CXX_ERROR(logger, "Could not create eventfd: " << strerror(errno));
+        return false;
+    }
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = wakeFd;
+    if (-1 == epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event))
+    {
+        LOG4CXX_ERROR(logger, "Could not add eventfd to epoll: " << strerror(errno));
+        return false;
+    }
+
+    // Watch the listen sockets. EPOLLEXCLUSIVE keeps a new connection from
+    // waking up every loop, but it is not supported by older kernels.
+    vector<Socket*>::iterator iter;
+    for (iter = listenSockets.begin(); iter != listenSockets.end(); iter++)
+    {
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN | EPOLLEXCLUSIVE;
+        event.data.fd = (*iter)->getHandle();
+        if (-1 == epoll_ctl(epollFd, EPOLL_CTL_ADD, event.data.fd, &event))
+        {
+            event.events = EPOLLIN;
+            if (-1 == epoll_ctl(epollFd, EPOLL_CTL_ADD, event.data.fd, &event))
+            {
+                LOG4CXX_ERROR(logger, "Could not add listen socket to epoll: " << strerror(errno));
+                return false;
+            }
+        }
+    }
+
+    // Start the loop's thread
+    running = true;
+    if (0 != pthread_create(&threadId, nullptr, EventLoop::eventLoopThread,
+                            (void*)this))
+    {
+        LOG4CXX_ERROR(logger, "Could not start event loop thread");
+        running = false;
+        return false;
+    }
+
+    return true;
+}
+
+void EventLoop::stop()
+{
+    if (!running)
+    {
+        return;
+    }
+
+    // Wake up the loop and wait for it to exit
+    running = false;
+    uint64_t val = 1;
+    if (sizeof(val) != ::write(wakeFd, &val, sizeof(val)))
+    {
+        LOG4CXX_ERROR(logger, "Could not wake up event loop: " << strerror(errno));
+    }
+    pthread_join(threadId, nullptr);
+}
+
+RestResponse* EventLoop::takeResponse()
+{
+    RestResponse* response = ObjectPool<RestResponse>::take();
+    if (nullptr == response)
+    {
+        return new RestResponse;
+    }
+
+    return response;
+}
+
+void EventLoop::unwatchAsync(EventLoopConnection* conn)
+{
+    if (-1 == conn->asyncFd)
+    {
+        return;
+    }
+
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, conn->asyncFd, nullptr);
+    asyncWaits.erase(conn->asyncFd);
+    conn->asyncFd = -1;
+}
+
+bool EventLoop::updateEvents(EventLoopConnection* conn)
+{
+    // Wait for more requests unless reading is paused, and for room in the
+    // socket while there is output to write
+    uint32_t events = 0;
+    if (isReading(conn))
+    {
+        events |= EPOLLIN;
+    }
+    if (0 < conn->queuedBytes)
+    {
+        events |= EPOLLOUT;
+    }
+
+    return watchEvents(conn, events);
+}
+
+bool EventLoop::watchAsync(EventLoopConnection* conn)
+{
+    int fd = conn->sock->getAsyncWaitHandle();
+    if (-1 == fd)
+    {
+        return false;
+    }
+    if (fd != conn->asyncFd)
+    {
+        unwatchAsync(conn);
+
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (-1 == epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event))
+        {
+            LOG4CXX_ERROR(logger, "Could not add crypto pool handle to epoll: " << strerror(errno));
+            return false;
+        }
+        asyncWaits[fd] = conn;
+        conn->asyncFd = fd;
+    }
+
+    // The socket has nothing to offer until the handshake resumes
+    return watchEvents(conn, 0);
+}
+
+bool EventLoop::watchEvents(EventLoopConnection* conn, uint32_t events)
+{
+    if (conn->events == events)
+    {
+        return true;
+    }
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.fd = conn->sock->getHandle();
+    if (-1 == epoll_ctl(epollFd, EPOLL_CTL_MOD, event.data.fd, &event))
+    {
+        LOG4CXX_ERROR(logger, "Could not update client connection in epoll: " << strerror(errno));
+        return false;
+    }
+    conn->events = events;
+
+    return true;
+}
+
+bool EventLoop::writeOutput(EventLoopConnection* conn)
+{
+    // Write until all of the output has been sent or the socket is full
+    while (0 < conn->queuedBytes)
+    {
+        // Gather the headers and bodies that have not been written yet
+        struct iovec iov[MAX_WRITE_BUFFERS];
+        int count = 0;
+        size_t skip = conn->outputOffset;
+        deque<EventLoopOutput>::iterator iter;
+        for (iter = conn->outputQueue.begin();
+             iter != conn->outputQueue.end() && MAX_WRITE_BUFFERS - 2 > count; iter++)
+        {
+            if (nullptr != iter->staticResponse)
+            {
+                addBuffer(iov, &count, iter->staticResponse->getHead(), &skip);
+            }
+            addBuffer(iov, &count, iter->header, &skip);
+            if (nullptr != iter->staticResponse)
+            {
+                addBuffer(iov, &count, iter->staticResponse->getBody(), &skip);
+            }
+            if (nullptr != iter->response)
+            {
+                addBuffer(iov, &count, iter->response->getBody(), &skip);
+            }
+        }
+
+        int ret = conn->sock->writev(iov, count);
+        if (-1 == ret)
+        {
+            return false;
+        }
+        if (0 == ret)
+        {
+            // Wait for the socket to become writable again
+            return true;
+        }
+        conn->queuedBytes -= ret;
+        conn->lastActivity = now();
+
+        // Release the output that has been completely written
+        size_t written = conn->outputOffset + ret;
+        while (!conn->outputQueue.empty())
+        {
+            EventLoopOutput& output = conn->outputQueue.front();
+            size_t length = output.getLength();
+            if (written < length)
+            {
+                break;
+            }
+            written -= length;
+            releaseResponse(output.response);
+            conn->outputQueue.pop_front();
+        }
+        conn->outputOffset = written;
+
+        // Once everything has been sent, nothing is left in the arena
+        if (conn->outputQueue.empty())
+        {
+            conn->request.reset();
+            conn->arena.reset();
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,312 @@
+#ifndef EVENTLOOP_H
+#define EVENTLOOP_H
+
+#include "RequestArena.h"
+#include "RestRequest.h"
+#include "RestResponse.h"
+#include "Socket.h"
+#include "StaticResponse.h"
+
+#include <log4cxx/logger.h>
+#include <pthread.h>
+
+#include <deque>
+#include <map>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+namespace kaoisoft
+{
+    /** Forward references */
+    class Http2Session;
+    class RestServer;
+
+    /**
+     * Data waiting to be written to a client.
+     */
+    struct EventLoopOutput
+    {
+        const StaticResponse* staticResponse;   // Static response whose head comes first and whose body follows the header, or nullptr
+        std::pmr::string header;                // Status line and headers, the closing block of a static response or a complete interim response
+        RestResponse* response;                 // Response whose body follows the header, or nullptr
+
+        /**
+         * Gets the number of bytes that are written for the output.
+         *
+         * @return Number of bytes
+         */
+        size_t getLength() const
+        {
+            size_t length = header.length();
+            if (nullptr != staticResponse)
+            {
+                length += staticResponse->getHead().length() + staticResponse->getBody().length();
+            }
+            if (nullptr != response)
+            {
+                length += response->getBody().length();
+            }
+            return length;
+        }
+    };
+
+    /**
+     * State of a client connection that is owned by an event loop.
+     */
+    struct EventLoopConnection
+    {
+        Socket* sock;                               // Connection to the client
+        bool handshaking;                           // Whether the connection is still being secured
+        int asyncFd;                                // Handle that the handshake waits on in epoll, or -1
+        Http2Session* http2;                        // Session that serves the connection if the client chose HTTP/2, or nullptr
+        RequestArena arena;                         // Memory for the request being served and the queued headers
+        RestRequest request{&arena};                // Request being served, reused for each one
+        std::deque<EventLoopOutput> outputQueue;    // Output waiting to be written, in order
+        size_t outputOffset;                        // Number of bytes of the first output that have been written
+        size_t queuedBytes;                         // Number of queued bytes that have not been written
+        bool closeAfterWrite;                       // Whether to close the connection once the output is written
+        bool inputClosed;                           // Whether the client has stopped sending
+        uint32_t events;                            // Events that epoll is watching for
+        bool continueSent;                          // Whether "100 Continue" was sent for the request being received
+        int requestCount;                           // Number of requests served on the connection
+        long long lastActivity;                     // When data was last read or written, or when the connection was accepted while it is being secured (milliseconds)
+    };
+
+    /**
+     * epoll-based reactor that accepts client connections and serves their
+     * requests from a single thread.
+     *
+     * A server in EVENT_LOOP mode runs one of these per core. Every loop
+     * watches one or more of the server's listen sockets (with EPOLLEXCLUSIVE,
+     * so that a new connection on a shared socket only wakes one of them) and
+     * owns the client sockets that it accepted for the rest of their lives.
+     *
+     * The handshake that secures a connection is driven by the loop too, one
+     * step each time the socket is ready, so a loop has any number of
+     * handshakes in progress at once and a client that stalls part way
+     * through only holds on to its own connection. A handshake that waits for
+     * a private key operation on the server's crypto pool is woken by the
+     * handle that the pool signals, which the loop watches in the meantime.
+     * A client that chooses HTTP/2 while securing its connection is served by
+     * an Http2Session, which the loop feeds and flushes in the same way.
+     */
+    class EventLoop
+    {
+    private:
+        RestServer* server;                             // Server whose routes are used to handle requests
+        std::vector<Socket*> listenSockets;             // Sockets that clients connect to
+        int epollFd;                                    // epoll instance
+        int wakeFd;                                     // eventfd used to wake up the loop when stopping
+        bool running;                                   // Whether the loop should keep running
+        pthread_t threadId;                             // ID of the thread running the loop
+        long long lastIdleCheck;                        // When idle connections were last looked for (milliseconds)
+        std::map<int, EventLoopConnection*> connections;    // Client connections, keyed by socket handle
+        std::map<int, EventLoopConnection*> asyncWaits;     // Connections whose handshake waits for the crypto pool, keyed by the handle it signals
+        log4cxx::LoggerPtr logger;                      // Logger for instances of this class
+
+    private:
+        /**
+         * Accepts the pending client connections, up to the server's accept
+         * batch size.
+         *
+         * @param listener Listen socket that is ready
+         */
+        void acceptClients(Socket* listener);
+
+        /**
+         * Closes the connections that have been idle for longer than the
+         * server's keep-alive timeout, those whose client has not accepted
+         * any output within the server's write timeout and those that have
+         * not been secured within the server's handshake timeout.
+         */
+        void closeIdleConnections();
+
+        /**
+         * Closes a client connection and releases its resources.
+         *
+         * @param conn Connection to close
+         */
+        void closeConnection(EventLoopConnection* conn);
+
+        /**
+         * Performs as much of a connection's handshake as can be done without
+         * waiting. Once the handshake is complete the client is verified and
+         * the connection is served; if it fails the connection is closed.
+         *
+         * @param conn Connection being secured
+         */
+        void continueHandshake(EventLoopConnection* conn);
+
+        /**
+         * Receives all of the available data from a client into its socket's
+         * input buffer and then serves the connection.
+         *
+         * @param conn Connection to read from
+         */
+        void handleRead(EventLoopConnection* conn);
+
+        /**
+         * Checks whether the loop should read from a client. Reading stops
+         * while the connection's unsent responses are at the server's caps, so
+         * a client that does not read its responses is held back by TCP flow
+         * control instead of making the server queue more.
+         *
+         * @param conn Connection to check
+         *
+         * @return true if the connection may be read from
+         */
+        bool isReading(EventLoopConnection* conn);
+
+        /**
+         * Gets the current time from a monotonic clock.
+         *
+         * @return The time in milliseconds
+         */
+        static long long now();
+
+        /**
+         * Parses the data received from a client and routes each complete
+         * request, queueing the responses in order, until the connection's
+         * unsent output reaches the server's cap. Invalid requests are
+         * answered with an error and the connection is closed once it has
+         * been sent.
+         *
+         * @param conn Connection whose input is parsed
+         *
+         * @return true if any output was queued
+         */
+        bool processInput(EventLoopConnection* conn);
+
+        /**
+         * Adds output to the end of a connection's queue. The connection takes
+         * ownership of the response.
+         *
+         * @param conn Connection to write to
+         * @param staticResponse Static response that the header closes, or
+         *                       nullptr
+         * @param header Status line and headers, normally in the connection's
+         *               arena
+         * @param response Response whose body follows the header, or nullptr
+         */
+        void queueOutput(EventLoopConnection* conn, const StaticResponse* staticResponse,
+                         std::pmr::string header, RestResponse* response);
+
+        /**
+         * Finishes with a response that has been sent, resetting it and
+         * keeping it in the calling thread's ObjectPool for reuse.
+         *
+         * @param response Response to release, or nullptr
+         */
+        void releaseResponse(RestResponse* response);
+
+        /**
+         * Runs the loop until stop() is called.
+         */
+        void run();
+
+        /**
+         * Serves the requests that a client has sent and writes the queued
+         * output, until nothing more can be done without waiting for the
+         * socket. The connection is closed once it has finished or failed;
+         * otherwise epoll is told what to wait for.
+         *
+         * @param conn Connection to serve
+         */
+        void serviceConnection(EventLoopConnection* conn);
+
+        /**
+         * Serves a connection on which the client chose HTTP/2: the frames
+         * that have arrived are processed, which serves the requests that
+         * they complete, and the frames that are ready are written. The
+         * connection is closed once the session is over or has failed.
+         *
+         * @param conn Connection to serve
+         */
+        void serviceHttp2(EventLoopConnection* conn);
+
+        /**
+         * Gets a response for a request to fill in, reusing one that has
+         * already been sent if there is one.
+         *
+         * @return The response, which is new or reset
+         */
+        RestResponse* takeResponse();
+
+        /**
+         * Stops watching the handle that a connection's handshake waited on.
+         *
+         * @param conn Connection whose handshake no longer waits
+         */
+        void unwatchAsync(EventLoopConnection* conn);
+
+        /**
+         * Changes the events that epoll watches for on a connection to match
+         * its state.
+         *
+         * @param conn Connection to update
+         *
+         * @return true if successful
+         */
+        bool updateEvents(EventLoopConnection* conn);
+
+        /**
+         * Watches the handle that a connection's handshake is waiting on
+         * instead of the connection's socket.
+         *
+         * @param conn Connection whose handshake waits
+         *
+         * @return true if successful
+         */
+        bool watchAsync(EventLoopConnection* conn);
+
+        /**
+         * Changes the events that epoll watches for on a connection.
+         *
+         * @param conn Connection to update
+         * @param events Events to watch for
+         *
+         * @return true if successful
+         */
+        bool watchEvents(EventLoopConnection* conn, uint32_t events);
+
+        /**
+         * Writes as much of the queued output as the socket will accept. The
+         * headers and bodies of several responses are written together with
+         * one scatter-gather call.
+         *
+         * @param conn Connection to write to
+         *
+         * @return true if successful
+         */
+        bool writeOutput(EventLoopConnection* conn);
+
+    public:
+        EventLoop(RestServer* server, const std::vector<Socket*>& listenSockets);
+        virtual ~EventLoop();
+
+        /**
+         * Creates the epoll instance and starts the loop's thread.
+         *
+         * @return true if successful
+         */
+        bool start();
+
+        /**
+         * Stops the loop and waits for its thread to exit.
+         */
+        void stop();
+
+    public:
+        /**
+         * Runs in its own thread and drives a single event loop.
+         *
+         * @param Pointer to the event loop instance
+         *
+         * @return nullptr
+         */
+        static void* eventLoopThread(void* args);
+    };
+}
+
+#endif // EVENTLOOP_H
@@ -0,0 +1,44 @@
+#include "HeaderMap.h"
+
+#include <strings.h>
+
+using namespace kaoisoft;
+using namespace std;
+
+bool HeaderNames::equal(std::string_view name1, std::string_view name2)
+{
+    return name1.length() == name2.length() &&
+           0 == strncasecmp(name1.data(), name2.data(), name1.length());
+}
+
+HeaderNames::Id HeaderNames::getId(std::string_view name)
+{
+    // The length picks the one or two well-known names that the name can be
+    switch (name.length())
+    {
+    case 4:
+        if (equal(name, "Host"))
+        {
+            return HOST;
+        }
+        return equal(name, "Date") ? DATE : OTHER;
+
+    case 6:
+        return equal(name, "Expect") ? EXPECT : OTHER;
+
+    case 10:
+        return equal(name, "Connection") ? CONNECTION : OTHER;
+
+    case 12:
+        return equal(name, "Content-Type") ? CONTENT_TYPE : OTHER;
+
+    case 14:
+        return equal(name, "Content-Length") ? CONTENT_LENGTH : OTHER;
+
+    case 17:
+        return equal(name, "Transfer-Encoding") ? TRANSFER_ENCODING : OTHER;
+
+    default:
+        return OTHER;
+    }
+}
@@ -0,0 +1,282 @@
+#ifndef HEADERMAP_H
+#define HEADERMAP_H
+
+#include <stddef.h>
+
+#include <map>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/* Number of headers that a header map holds without allocating */
+#define HEADER_MAP_INLINE_COUNT 16
+
+namespace kaoisoft
+{
+    /**
+     * Headers that the library looks up often. A header map works out which
+     * of these a header is when it is added, so finding one later compares a
+     * number instead of a name.
+     */
+    class HeaderNames
+    {
+    public:
+        enum Id { OTHER, CONNECTION, CONTENT_LENGTH, CONTENT_TYPE, DATE, EXPECT, HOST,
+                  TRANSFER_ENCODING };
+
+    public:
+        /**
+         * Compares two header names without regard to case.
+         *
+         * @param name1 First name
+         * @param name2 Second name
+         *
+         * @return true if the names are the same
+         */
+        static bool equal(std::string_view name1, std::string_view name2);
+
+        /**
+         * Identifies a header name.
+         *
+         * @param name Header name, in any case
+         *
+         * @return The header's ID, or OTHER if it is not a well-known one
+         */
+        static Id getId(std::string_view name);
+    };
+
+    /**
+     * Headers of a request or response, in the order they were added.
+     *
+     * The first HEADER_MAP_INLINE_COUNT headers are stored in the map itself,
+     * so a typical message's headers cost no allocations and are found by a
+     * short walk over contiguous memory. Names are compared without regard to
+     * case. When a name occurs more than once, lookups find the last one.
+     *
+     * StringType is std::string for headers that the map owns, or
+     * std::string_view for headers that point into a buffer that outlives
+     * the map.
+     */
+    template <typename StringType>
+    class HeaderMap
+    {
+    public:
+        /**
+         * A header.
+         */
+        struct Entry
+        {
+            StringType name;                            // Header name, as it was given
+            StringType value;                           // Header value
+            HeaderNames::Id id = HeaderNames::OTHER;    // Which well-known header this is, or OTHER
+        };
+
+    private:
+        Entry inlineEntries[HEADER_MAP_INLINE_COUNT];   // First headers
+        std::vector<Entry> overflow;                    // Headers after the first HEADER_MAP_INLINE_COUNT
+        size_t count;                                   // Number of headers
+
+    private:
+        /**
+         * Finds the last header with a name.
+         *
+         * @param name Header name
+         * @param id ID of the name
+         *
+         * @return The header's index, or count if there is none
+         */
+        size_t indexOf(std::string_view name, HeaderNames::Id id) const;
+
+    public:
+        HeaderMap() { count = 0; }
+        HeaderMap(const HeaderMap& other) = default;
+        HeaderMap(HeaderMap&& other) = default;
+        HeaderMap& operator=(const HeaderMap& other) = default;
+
+        /**
+         * Moves another map's headers into this one. Only the entries that
+         * are in use are moved, rather than all of the inline ones.
+         *
+         * @param other Map whose headers are taken, which is left empty
+         *
+         * @return This map
+         */
+        HeaderMap& operator=(HeaderMap&& other);
+
+        /**
+         * Adds a header after the existing ones, even if one with the same
+         * name is already present.
+         *
+         * @param name Header name
+         * @param value Header value
+         * @param id ID of the name, if it has already been worked out
+         */
+        void add(StringType name, StringType value)
+        {
+            HeaderNames::Id id = HeaderNames::getId(name);
+            add(std::move(name), std::move(value), id);
+        }
+        void add(StringType name, StringType value, HeaderNames::Id id);
+
+        /**
+         * Gets a header.
+         *
+         * @param index Position of the header, less than size()
+         *
+         * @return The header
+         */
+        const Entry& at(size_t index) const
+        {
+            return (HEADER_MAP_INLINE_COUNT > index) ? inlineEntries[index] :
+                                                       overflow[index - HEADER_MAP_INLINE_COUNT];
+        }
+
+        /**
+         * Removes all of the headers.
+         */
+        void clear() { count = 0; overflow.clear(); }
+
+        /**
+         * Finds the value of the last header with a name.
+         *
+         * @param name Header name
+         *
+         * @return The value, or nullptr if there is no such header
+         */
+        const StringType* find(std::string_view name) const;
+
+        /**
+         * Finds the value of the last header that is a well-known one.
+         *
+         * @param id ID of the header
+         *
+         * @return The value, or nullptr if there is no such header
+         */
+        const StringType* find(HeaderNames::Id id) const;
+
+        /**
+         * Sets a header, replacing the last one with the same name if there is
+         * one, or adding it otherwise.
+         *
+         * @param name Header name
+         * @param value Header value
+         */
+        void set(StringType name, StringType value);
+
+        /**
+         * Gets the number of headers.
+         *
+         * @return The number of headers
+         */
+        size_t size() const { return count; }
+
+        /**
+         * Copies the headers into a map, for code that works with
+         * std::map. Later headers replace earlier ones with the same name.
+         *
+         * @param headers Map into which the headers are copied
+         */
+        void toMap(std::map<std::string, std::string>* headers) const;
+    };
+
+    template <typename StringType>
+    void HeaderMap<StringType>::add(StringType name, StringType value, HeaderNames::Id id)
+    {
+        Entry* entry;
+        if (HEADER_MAP_INLINE_COUNT > count)
+        {
+            entry = &inlineEntries[count];
+        }
+        else
+        {
+            overflow.emplace_back();
+            entry = &overflow.back();
+        }
+        entry->name = std::move(name);
+        entry->value = std::move(value);
+        entry->id = id;
+        count++;
+    }
+
+    template <typename StringType>
+    HeaderMap<StringType>& HeaderMap<StringType>::operator=(HeaderMap&& other)
+    {
+        if (this == &other)
+        {
+            return *this;
+        }
+
+        size_t inlineCount = (HEADER_MAP_INLINE_COUNT > other.count) ? other.count : HEADER_MAP_INLINE_COUNT;
+        for (size_t i = 0; i < inlineCount; i++)
+        {
+            inlineEntries[i] = std::move(other.inlineEntries[i]);
+        }
+        overflow = std::move(other.overflow);
+        count = other.count;
+        other.overflow.clear();
+        other.count = 0;
+
+        return *this;
+    }
+
+    template <typename StringType>
+    const StringType* HeaderMap<StringType>::find(std::string_view name) const
+    {
+        size_t index = indexOf(name, HeaderNames::getId(name));
+        return (index < count) ? &at(index).value : nullptr;
+    }
+
+    template <typename StringType>
+    const StringType* HeaderMap<StringType>::find(HeaderNames::Id id) const
+    {
+        size_t index = indexOf(std::string_view(), id);
+        return (index < count) ? &at(index).value : nullptr;
+    }
+
+    template <typename StringType>
+    size_t HeaderMap<StringType>::indexOf(std::string_view name, HeaderNames::Id id) const
+    {
+        // Well-known headers are matched by ID alone
+        for (size_t i = count; 0 < i; i--)
+        {
+            const Entry& entry = at(i - 1);
+            if (id == entry.id &&
+                (HeaderNames::OTHER != id || HeaderNames::equal(entry.name, name)))
+            {
+                return i - 1;
+            }
+        }
+
+        return count;
+    }
+
+    template <typename StringType>
+    void HeaderMap<StringType>::set(StringType name, StringType value)
+    {
+        HeaderNames::Id id = HeaderNames::getId(name);
+        size_t index = indexOf(name, id);
+        if (index == count)
+        {
+            add(std::move(name), std::move(value), id);
+            return;
+        }
+
+        Entry& entry = (HEADER_MAP_INLINE_COUNT > index) ?
+                    inlineEntries[index] : overflow[index - HEADER_MAP_INLINE_COUNT];
+        entry.name = std::move(name);
+        entry.value = std::move(value);
+    }
+
+    template <typename StringType>
+    void HeaderMap<StringType>::toMap(std::map<std::string, std::string>* headers) const
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            const Entry& entry = at(i);
+            (*headers)[std::string(entry.name)] = std::string(entry.value);
+        }
+    }
+}
+
+#endif // HEADERMAP_H
@@ -0,0 +1,562 @@
+#include "Http2Session.h"
+#include "HttpDate.h"
+#include "ObjectPool.h"
+#include "RestServer.h"
+
+#include <ctype.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+using namespace kaoisoft;
+using namespace std;
+using namespace log4cxx;
+
+/* Frames are gathered until there are this many bytes before being written */
+#define HTTP2_WRITE_BATCH 65536
+
+/* Headers that are added to each response besides its own: :status, date
+   and content-length */
+#define HTTP2_EXTRA_HEADERS 3
+
+std::atomic<unsigned long long> Http2Session::connectionCount(0);
+std::atomic<unsigned long long> Http2Session::streamCount(0);
+
+/* Callbacks shared by every session */
+static nghttp2_session_callbacks* callbacks = nullptr;
+
+/* Makes sure that the callbacks are only set up once */
+static pthread_once_t callbacksOnce = PTHREAD_ONCE_INIT;
+
+/**
+ * Keeps a copy of a value in storage owned by a request.
+ *
+ * @param request Request that owns the copy
+ * @param data Value to copy
+ * @param length Length of the value
+ *
+ * @return A view of the copy
+ */
+static string_view keepView(RestRequest* request, const uint8_t* data, size_t length)
+{
+    std::pmr::string* str = request->addStorage();
+    str->assign((const char*)data, length);
+
+    return *str;
+}
+
+/**
+ * Adds a header to a list of headers to send. nghttp2 copies the name and
+ * value when the list is submitted.
+ *
+ * @param nva List of headers
+ * @param name Header name, in lower case
+ * @param nameLength Length of the name
+ * @param value Header value
+ * @param valueLength Length of the value
+ */
+static void addNameValue(std::pmr::vector<nghttp2_nv>* nva, const char* name, size_t nameLength,
+                         const char* value, size_t valueLength)
+{
+    nghttp2_nv nv;
+    nv.name = (uint8_t*)name;
+    nv.namelen = nameLength;
+    nv.value = (uint8_t*)value;
+    nv.valuelen = valueLength;
+    nv.flags = NGHTTP2_NV_FLAG_NONE;
+    nva->push_back(nv);
+}
+
+/**
+ * Checks whether a header only has a meaning for a single HTTP/1.1
+ * connection, which HTTP/2 does not allow in a message.
+ *
+ * @param entry Header to check
+ *
+ * @return true if the header must not be sent
+ */
+static bool isConnectionHeader(const HeaderMap<string>::Entry& entry)
+{
+    return HeaderNames::CONNECTION == entry.id || HeaderNames::TRANSFER_ENCODING == entry.id ||
+           HeaderNames::equal(entry.name, "Keep-Alive") ||
+           HeaderNames::equal(entry.name, "Proxy-Connection") ||
+           HeaderNames::equal(entry.name, "Upgrade");
+}
+
+/**
+ * Finishes with a stream that has been closed, keeping it in the calling
+ * thread's ObjectPool for reuse along with the memory that it has grown.
+ *
+ * @param stream Stream to release
+ */
+static void releaseStream(Http2Stream* stream)
+{
+    // The body lives in the arena, so it gives its memory back before the
+    // arena is reset
+    std::pmr::string(&stream->arena).swap(stream->body);
+    stream->request.reset();
+    stream->response.reset();
+    stream->arena.reset();
+    ObjectPool<Http2Stream>::release(stream);
+}
+
+Http2Session::Http2Session(RestServer* server, Socket* sock)
+{
+    this->server = server;
+    this->sock = sock;
+    session = nullptr;
+    outputOffset = 0;
+    requestCount = 0;
+    goingAway = false;
+
+    // Create the logger
+    logger = Logger::getLogger("com.kaoisoft.Http2Session");
+}
+
+Http2Session::~Http2Session()
+{
+    // nghttp2 does not report the streams that are still open
+    if (nullptr != session)
+    {
+        nghttp2_session_del(session);
+    }
+    map<int32_t, Http2Stream*>::iterator iter;
+    for (iter = streams.begin(); iter != streams.end(); iter++)
+    {
+        releaseStream(iter->second);
+    }
+}
+
+void Http2Session::createCallbacks()
+{
+    if (0 != nghttp2_session_callbacks_new(&callbacks))
+    {
+        callbacks = nullptr;
+        return;
+    }
+    nghttp2_session_callbacks_set_on_begin_headers_callback(callbacks, onBeginHeaders);
+    nghttp2_session_callbacks_set_on_header_callback(callbacks, onHeader);
+    nghttp2_session_callbacks_set_on_data_chunk_recv_callback(callbacks, onDataChunk);
+    nghttp2_session_callbacks_set_on_frame_recv_callback(callbacks, onFrameReceived);
+    nghttp2_session_callbacks_set_on_stream_close_callback(callbacks, onStreamClose);
+}
+
+void Http2Session::getStatistics(Http2Statistics* stats)
+{
+    stats->connections = connectionCount.load(memory_order_relaxed);
+    stats->streams = streamCount.load(memory_order_relaxed);
+}
+
+bool Http2Session::handleRequest(Http2Stream* stream)
+{
+    RestRequest& request = stream->request;
+    requestCount++;
+    streamCount.fetch_add(1, memory_order_relaxed);
+    LOG4CXX_TRACE(logger, "Received request " << request.toString() << " on stream " <<
+                  stream->id << " from client at " << sock->getRemoteAddress());
+
+    bool submitted;
+    if (stream->bodyTooLarge)
+    {
+        RestServer::fillErrorResponse(413, &stream->response);
+        submitted = submitResponse(stream, stream->response.getCode(),
+                                   stream->response.getHeaderMap(), stream->response.getBody());
+    }
+    else
+    {
+        // Route the request to the appropriate handler, unless its response
+        // has already been serialized
+        request.setBodyView(stream->body);
+        HandlerData* handlerData = server->findRoute(&request);
+        const StaticResponse* staticResponse = handlerData->staticResponse;
+        if (nullptr != staticResponse)
+        {
+            submitted = submitResponse(stream, staticResponse->getCode(),
+                                       staticResponse->getHeaderMap(), staticResponse->getBody());
+        }
+        else
+        {
+            (handlerData->handler)(request, stream->response);
+            submitted = submitResponse(stream, stream->response.getCode(),
+                                       stream->response.getHeaderMap(),
+                                       stream->response.getBody());
+        }
+    }
+
+    // Tell the client to go elsewhere for its later requests once the
+    // connection has served its share or the server is stopping. The
+    // streams that it has already started are still served.
+    if (!goingAway && (!server->listening || (0 < server->maxRequestsPerConnection &&
+                                              requestCount >= server->maxRequestsPerConnection)))
+    {
+        nghttp2_submit_goaway(session, NGHTTP2_FLAG_NONE,
+                              nghttp2_session_get_last_proc_stream_id(session),
+                              NGHTTP2_NO_ERROR, nullptr, 0);
+        goingAway = true;
+    }
+
+    return submitted;
+}
+
+bool Http2Session::isFinished()
+{
+    return 0 == getPendingLength() && 0 == nghttp2_session_want_read(session) &&
+           0 == nghttp2_session_want_write(session);
+}
+
+int Http2Session::onBeginHeaders(nghttp2_session* session, const nghttp2_frame* frame,
+                                 void* userData)
+{
+    Http2Session* inst = (Http2Session*)userData;
+    if (NGHTTP2_HEADERS != frame->hd.type || NGHTTP2_HCAT_REQUEST != frame->headers.cat)
+    {
+        return 0;
+    }
+
+    Http2Stream* stream = ObjectPool<Http2Stream>::take();
+    if (nullptr == stream)
+    {
+        stream = new Http2Stream;
+    }
+    stream->id = frame->hd.stream_id;
+    stream->bodyTooLarge = false;
+    stream->responseOffset = 0;
+    stream->request.setProtocolView("HTTP/2");
+    inst->streams[stream->id] = stream;
+    nghttp2_session_set_stream_user_data(session, stream->id, stream);
+
+    return 0;
+}
+
+int Http2Session::onDataChunk(nghttp2_session* session, uint8_t flags, int32_t streamId,
+                              const uint8_t* data, size_t length, void* userData)
+{
+    // Prevent unused parameter warnings
+    (void)flags;
+
+    Http2Session* inst = (Http2Session*)userData;
+    Http2Stream* stream = (Http2Stream*)nghttp2_session_get_stream_user_data(session, streamId);
+    if (nullptr == stream || stream->bodyTooLarge)
+    {
+        return 0;
+    }
+
+    // A body that is too large is discarded and answered with 413 once it
+    // has all arrived, as it is for HTTP/1.1
+    if (inst->server->maxBodySize - stream->body.length() < length)
+    {
+        stream->bodyTooLarge = true;
+        return 0;
+    }
+    stream->body.append((const char*)data, length);
+
+    return 0;
+}
+
+int Http2Session::onFrameReceived(nghttp2_session* session, const nghttp2_frame* frame,
+                                  void* userData)
+{
+    Http2Session* inst = (Http2Session*)userData;
+
+    // A request is complete once the frame that ends its stream has arrived
+    if ((NGHTTP2_HEADERS != frame->hd.type && NGHTTP2_DATA != frame->hd.type) ||
+        0 == (frame->hd.flags & NGHTTP2_FLAG_END_STREAM))
+    {
+        return 0;
+    }
+    Http2Stream* stream = (Http2Stream*)nghttp2_session_get_stream_user_data(session,
+                                                                              frame->hd.stream_id);
+    if (nullptr == stream)
+    {
+        return 0;
+    }
+
+    return inst->handleRequest(stream) ? 0 : NGHTTP2_ERR_CALLBACK_FAILURE;
+}
+
+int Http2Session::onHeader(nghttp2_session* session, const nghttp2_frame* frame,
+                           const uint8_t* name, size_t nameLength, const uint8_t* value,
+                           size_t valueLength, uint8_t flags, void* userData)
+{
+    // Prevent unused parameter warnings
+    (void)flags;
+    (void)userData;
+
+    if (NGHTTP2_HEADERS != frame->hd.type || NGHTTP2_HCAT_REQUEST != frame->headers.cat)
+    {
+        return 0;
+    }
+    Http2Stream* stream = (Http2Stream*)nghttp2_session_get_stream_user_data(session,
+                                                                              frame->hd.stream_id);
+    if (nullptr == stream)
+    {
+        return 0;
+    }
+    RestRequest& request = stream->request;
+
+    // nghttp2 has already checked the pseudo-headers, which take the place
+    // of the request line and the Host header
+    string_view headerName((const char*)name, nameLength);
+    if (0 == headerName.compare(":method"))
+    {
+        request.setMethod(string_view((const char*)value, valueLength));
+    }
+    else if (0 == headerName.compare(":path"))
+    {
+        request.setPathView(keepView(&request, value, valueLength));
+    }
+    else if (0 == headerName.compare(":authority"))
+    {
+        request.addHeaderView("host", keepView(&request, value, valueLength), HeaderNames::HOST);
+    }
+    else if (':' != headerName[0])
+    {
+        request.addHeaderView(keepView(&request, name, nameLength),
+                              keepView(&request, value, valueLength));
+    }
+
+    return 0;
+}
+
+int Http2Session::onStreamClose(nghttp2_session* session, int32_t streamId, uint32_t errorCode,
+                                void* userData)
+{
+    // Prevent unused parameter warnings
+    (void)session;
+
+    Http2Session* inst = (Http2Session*)userData;
+    map<int32_t, Http2Stream*>::iterator iter = inst->streams.find(streamId);
+    if (iter == inst->streams.end())
+    {
+        return 0;
+    }
+    if (NGHTTP2_NO_ERROR != errorCode)
+    {
+        LOG4CXX_DEBUG(inst->logger, "Stream " << streamId << " from client at " <<
+                      inst->sock->getRemoteAddress() << " was reset: " <<
+                      nghttp2_http2_strerror(errorCode));
+    }
+
+    releaseStream(iter->second);
+    inst->streams.erase(iter);
+
+    return 0;
+}
+
+ssize_t Http2Session::readResponseBody(nghttp2_session* session, int32_t streamId,
+                                       uint8_t* buff, size_t length, uint32_t* flags,
+                                       nghttp2_data_source* source, void* userData)
+{
+    // Prevent unused parameter warnings
+    (void)session;
+    (void)streamId;
+    (void)userData;
+
+    Http2Stream* stream = (Http2Stream*)source->ptr;
+    size_t remaining = stream->responseBody.length() - stream->responseOffset;
+    if (length > remaining)
+    {
+        length = remaining;
+    }
+    memcpy(buff, stream->responseBody.data() + stream->responseOffset, length);
+    stream->responseOffset += length;
+    if (stream->responseOffset == stream->responseBody.length())
+    {
+        *flags |= NGHTTP2_DATA_FLAG_EOF;
+    }
+
+    return length;
+}
+
+bool Http2Session::receive()
+{
+    ssize_t ret = nghttp2_session_mem_recv(session, (const uint8_t*)sock->getBufferedData(),
+                                           sock->getBufferedLength());
+    if (0 > ret)
+    {
+        LOG4CXX_DEBUG(logger, "HTTP/2 error on connection from client at " <<
+                      sock->getRemoteAddress() << ": " << nghttp2_strerror((int)ret));
+        return false;
+    }
+
+    // Everything that was received has been copied out of the buffer
+    sock->consume(ret);
+
+    return true;
+}
+
+int Http2Session::send()
+{
+    int total = 0;
+    for (;;)
+    {
+        // Gather the next frames once the previous ones have been written
+        if (outputOffset == output.length())
+        {
+            output.clear();
+            outputOffset = 0;
+            const uint8_t* data;
+            ssize_t length = 0;
+            while (HTTP2_WRITE_BATCH > output.length() &&
+                   0 < (length = nghttp2_session_mem_send(session, &data)))
+            {
+                output.append((const char*)data, length);
+            }
+            if (0 > length)
+            {
+                LOG4CXX_ERROR(logger, "Could not build HTTP/2 frames for client at " <<
+                              sock->getRemoteAddress() << ": " << nghttp2_strerror((int)length));
+                return -1;
+            }
+            if (output.empty())
+            {
+                return total;
+            }
+        }
+
+        // The same data is passed again if the socket was full
+        struct iovec iov;
+        iov.iov_base = (void*)(output.data() + outputOffset);
+        iov.iov_len = output.length() - outputOffset;
+        int ret = sock->writev(&iov, 1);
+        if (-1 == ret)
+        {
+            return -1;
+        }
+        if (0 == ret)
+        {
+            return total;
+        }
+        outputOffset += ret;
+        total += ret;
+    }
+}
+
+void Http2Session::serve()
+{
+    if (!start())
+    {
+        return;
+    }
+
+    for (;;)
+    {
+        // Write everything that is ready, waiting for the client to accept it
+        do
+        {
+            int ret = send();
+            if (-1 == ret)
+            {
+                return;
+            }
+            if (0 == ret && 0 < getPendingLength() && !sock->waitWritable(server->writeTimeout))
+            {
+                LOG4CXX_DEBUG(logger, "Client at " << sock->getRemoteAddress() <<
+                              " stopped accepting HTTP/2 frames");
+                return;
+            }
+        } while (0 < getPendingLength());
+        if (isFinished())
+        {
+            return;
+        }
+
+        // Wait for more frames. A client that is sending a request gets the
+        // read timeout rather than the keep-alive one.
+        int timeout = streams.empty() ? server->keepAliveTimeout : server->readTimeout;
+        if (!sock->hasPendingData() && !sock->waitReadable(timeout))
+        {
+            return;
+        }
+        if (-1 == sock->fillBuffer() || !receive())
+        {
+            return;
+        }
+    }
+}
+
+bool Http2Session::start()
+{
+    pthread_once(&callbacksOnce, createCallbacks);
+    if (nullptr == callbacks)
+    {
+        LOG4CXX_ERROR(logger, "Could not create the HTTP/2 callbacks");
+        return false;
+    }
+
+    if (0 != nghttp2_session_server_new(&session, callbacks, this))
+    {
+        LOG4CXX_ERROR(logger, "Could not create an HTTP/2 session");
+        session = nullptr;
+        return false;
+    }
+
+    // Limit the number of streams that the client may have open at once
+    nghttp2_settings_entry settings[1];
+    settings[0].settings_id = NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS;
+    settings[0].value = (uint32_t)server->http2MaxConcurrentStreams;
+    if (0 != nghttp2_submit_settings(session, NGHTTP2_FLAG_NONE, settings, 1))
+    {
+        LOG4CXX_ERROR(logger, "Could not queue the HTTP/2 settings");
+        return false;
+    }
+    connectionCount.fetch_add(1, memory_order_relaxed);
+    LOG4CXX_DEBUG(logger, "Client at " << sock->getRemoteAddress() << " is using HTTP/2");
+
+    return true;
+}
+
+bool Http2Session::submitResponse(Http2Stream* stream, int code,
+                                  const HeaderMap<string>& headers, string_view body)
+{
+    LOG4CXX_TRACE(logger, "Sending response " << code << " on stream " << stream->id <<
+                  " to client at " << sock->getRemoteAddress());
+
+    // The list and the lower case names are only needed until nghttp2 has
+    // copied them, so they come from the stream's arena
+    std::pmr::vector<nghttp2_nv> nva(&stream->arena);
+    nva.reserve(headers.size() + HTTP2_EXTRA_HEADERS);
+    char status[16];
+    int statusLength = snprintf(status, sizeof(status), "%d", code);
+    addNameValue(&nva, ":status", 7, status, statusLength);
+    for (size_t i = 0; i < headers.size(); i++)
+    {
+        // The real length is always added below
+        const HeaderMap<string>::Entry& entry = headers.at(i);
+        if (HeaderNames::CONTENT_LENGTH == entry.id || isConnectionHeader(entry))
+        {
+            continue;
+        }
+        char* name = (char*)stream->arena.allocate(entry.name.length(), 1);
+        for (size_t j = 0; j < entry.name.length(); j++)
+        {
+            name[j] = tolower((unsigned char)entry.name[j]);
+        }
+        addNameValue(&nva, name, entry.name.length(), entry.value.data(), entry.value.length());
+    }
+    string_view date;
+    if (nullptr == headers.find(HeaderNames::DATE))
+    {
+        date = HttpDate::now();
+        addNameValue(&nva, "date", 4, date.data(), date.length());
+    }
+    string contentLength = std::to_string(body.length());
+    addNameValue(&nva, "content-length", 14, contentLength.data(), contentLength.length());
+
+    // A response without a body ends the stream with its headers
+    stream->responseBody = body;
+    stream->responseOffset = 0;
+    nghttp2_data_provider provider;
+    provider.source.ptr = stream;
+    provider.read_callback = readResponseBody;
+    int ret = nghttp2_submit_response(session, stream->id, nva.data(), nva.size(),
+                                      body.empty() ? nullptr : &provider);
+    if (0 != ret)
+    {
+        LOG4CXX_ERROR(logger, "Could not submit the response on stream " << stream->id <<
+                      ": " << nghttp2_strerror(ret));
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,228 @@
+#ifndef HTTP2SESSION_H
+#define HTTP2SESSION_H
+
+#include "RequestArena.h"
+#include "RestRequest.h"
+#include "RestResponse.h"
+#include "Socket.h"
+#include "StaticResponse.h"
+
+#include <log4cxx/logger.h>
+#include <nghttp2/nghttp2.h>
+
+#include <atomic>
+#include <map>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* Protocol ID with which clients ask for HTTP/2 through ALPN */
+#define HTTP2_ALPN_ID "h2"
+
+namespace kaoisoft
+{
+    /** Forward reference */
+    class RestServer;
+
+    /**
+     * Snapshot of the HTTP/2 connections that have been served.
+     */
+    struct Http2Statistics
+    {
+        unsigned long long connections;     // Connections that negotiated HTTP/2
+        unsigned long long streams;         // Requests served on them
+    };
+
+    /**
+     * State of a request on an HTTP/2 connection. Streams are kept in an
+     * ObjectPool for the connection's later requests.
+     */
+    struct Http2Stream
+    {
+        int32_t id;                                 // Stream ID
+        RequestArena arena;                         // Memory for the request and the response headers
+        RestRequest request{&arena};                // Request being received
+        std::pmr::string body{&arena};              // Request body, which arrives in DATA frames
+        bool bodyTooLarge;                          // Whether the body is larger than the server accepts
+        RestResponse response;                      // Response filled in by the handler
+        std::string_view responseBody;              // Body being sent, from the response or a static response
+        size_t responseOffset;                      // Number of bytes of the body that have been sent
+    };
+
+    /**
+     * Server side of an HTTP/2 connection, which a client asked for through
+     * ALPN while securing it.
+     *
+     * The framing, HPACK header compression, stream multiplexing and flow
+     * control are done by nghttp2. Each stream's request is dispatched
+     * through the server's routes as soon as it is complete, so handlers are
+     * the same as for HTTP/1.1, and the responses of the streams are
+     * interleaved on the connection as flow control allows. The session
+     * reads from the socket's input buffer and gathers the frames that it
+     * sends into one write, so it can be driven by an event loop (receive()
+     * and send()) or by a thread of its own (serve()).
+     *
+     * The server's maximum number of requests per connection applies to
+     * streams: once it is reached the client is sent GOAWAY, and the
+     * connection is closed when the streams that were started have finished.
+     */
+    class Http2Session
+    {
+    private:
+        RestServer* server;                         // Server whose routes are used to handle requests
+        Socket* sock;                               // Connection to the client
+        nghttp2_session* session;                   // nghttp2's state of the connection
+        std::map<int32_t, Http2Stream*> streams;    // Streams that are open, keyed by ID
+        std::string output;                         // Frames waiting to be written
+        size_t outputOffset;                        // Number of bytes of the output that have been written
+        int requestCount;                           // Number of requests served on the connection
+        bool goingAway;                             // Whether the client has been told to stop starting streams
+        log4cxx::LoggerPtr logger;                  // Logger for instances of this class
+
+    private:
+        static std::atomic<unsigned long long> connectionCount;    // Connections that negotiated HTTP/2
+        static std::atomic<unsigned long long> streamCount;        // Requests served on them
+
+    private:
+        /**
+         * Creates the nghttp2 callbacks that every session uses.
+         */
+        static void createCallbacks();
+
+        /**
+         * Serves a request whose headers and body have all arrived.
+         *
+         * @param stream Stream of the request
+         *
+         * @return true if successful
+         */
+        bool handleRequest(Http2Stream* stream);
+
+        /**
+         * Called by nghttp2 when a client starts a new stream.
+         */
+        static int onBeginHeaders(nghttp2_session* session, const nghttp2_frame* frame,
+                                  void* userData);
+
+        /**
+         * Called by nghttp2 with a chunk of a request's body.
+         */
+        static int onDataChunk(nghttp2_session* session, uint8_t flags, int32_t streamId,
+                               const uint8_t* data, size_t length, void* userData);
+
+        /**
+         * Called by nghttp2 once a frame has been received, which completes a
+         * request if it ends the stream.
+         */
+        static int onFrameReceived(nghttp2_session* session, const nghttp2_frame* frame,
+                                   void* userData);
+
+        /**
+         * Called by nghttp2 with each header of a request, already
+         * decompressed.
+         */
+        static int onHeader(nghttp2_session* session, const nghttp2_frame* frame,
+                            const uint8_t* name, size_t nameLength, const uint8_t* value,
+                            size_t valueLength, uint8_t flags, void* userData);
+
+        /**
+         * Called by nghttp2 once a stream has been closed, after its response
+         * has been sent or the stream was reset.
+         */
+        static int onStreamClose(nghttp2_session* session, int32_t streamId, uint32_t errorCode,
+                                 void* userData);
+
+        /**
+         * Called by nghttp2 for the next part of a response body that flow
+         * control lets it send.
+         */
+        static ssize_t readResponseBody(nghttp2_session* session, int32_t streamId,
+                                        uint8_t* buff, size_t length, uint32_t* flags,
+                                        nghttp2_data_source* source, void* userData);
+
+        /**
+         * Submits a response for a stream. The status and headers are
+         * compressed into a HEADERS frame, and the body, which must stay
+         * valid until the stream is closed, follows in DATA frames.
+         *
+         * @param stream Stream to respond on
+         * @param code HTTP status code
+         * @param headers Response headers, whose names are sent in lower case
+         *                without the headers that HTTP/2 does not allow
+         * @param body Response body
+         *
+         * @return true if successful
+         */
+        bool submitResponse(Http2Stream* stream, int code, const HeaderMap<std::string>& headers,
+                            std::string_view body);
+
+    public:
+        /**
+         * @param server Server whose routes are used to handle requests
+         * @param sock Connection to the client, which has been secured and
+         *             must outlive the session
+         */
+        Http2Session(RestServer* server, Socket* sock);
+        virtual ~Http2Session();
+
+        /**
+         * Gets the totals of the HTTP/2 connections of every server in the
+         * process.
+         *
+         * @param stats Structure into which the statistics are stored
+         */
+        static void getStatistics(Http2Statistics* stats);
+
+        /**
+         * Gets the number of bytes of frames that are waiting for the socket
+         * to accept them.
+         *
+         * @return Number of bytes
+         */
+        size_t getPendingLength() { return output.length() - outputOffset; }
+
+        /**
+         * Checks whether the connection is finished with: both sides have
+         * stopped sending, or GOAWAY has been exchanged and every stream has
+         * been closed, and all of the output has been written.
+         *
+         * @return true if the connection should be closed
+         */
+        bool isFinished();
+
+        /**
+         * Processes the frames in the socket's input buffer, serving each
+         * request that they complete. The data is consumed from the buffer.
+         *
+         * @return true if successful, false if the client broke the protocol
+         */
+        bool receive();
+
+        /**
+         * Writes as many frames as the socket accepts without waiting. Frames
+         * that do not fit stay queued for the next call.
+         *
+         * @return The number of bytes written, or -1 if an error occurred
+         */
+        int send();
+
+        /**
+         * Serves the connection on the calling thread until the client closes
+         * it, it stays idle for longer than the server's keep-alive timeout or
+         * it is finished with.
+         */
+        void serve();
+
+        /**
+         * Sets up nghttp2 and queues the server's SETTINGS frame, which
+         * limits the number of streams that the client may have open at once
+         * to the server's HTTP/2 stream concurrency.
+         *
+         * @return true if successful
+         */
+        bool start();
+    };
+}
+
+#endif // HTTP2SESSION_H
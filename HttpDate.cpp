@@ -0,0 +1,52 @@
+#include "HttpDate.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+using namespace kaoisoft;
+using namespace std;
+
+/* Names used in dates, which must not depend on the locale */
+static const char* dayNames[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+static const char* monthNames[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+
+/* Date shared by all threads, and the second that it was formatted for */
+static pthread_mutex_t sharedMutex = PTHREAD_MUTEX_INITIALIZER;
+static time_t sharedSecond = 0;
+static char sharedDate[HTTP_DATE_LENGTH];
+
+/* Calling thread's copy of the shared date */
+static thread_local time_t localSecond = 0;
+static thread_local char localDate[HTTP_DATE_LENGTH];
+
+string_view HttpDate::now()
+{
+    // A coarse clock is plenty for a value that changes once a second
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+    if (ts.tv_sec != localSecond)
+    {
+        pthread_mutex_lock(&sharedMutex);
+        if (ts.tv_sec > sharedSecond)
+        {
+            // The compiler cannot tell that the fields fit, so format the
+            // date with room to spare
+            struct tm tm;
+            char date[64];
+            gmtime_r(&ts.tv_sec, &tm);
+            snprintf(date, sizeof(date), "%s, %02d %s %04d %02d:%02d:%02d GMT",
+                     dayNames[tm.tm_wday], tm.tm_mday, monthNames[tm.tm_mon],
+                     tm.tm_year + 1900, tm.tm_hour, tm.tm_min, tm.tm_sec);
+            memcpy(sharedDate, date, HTTP_DATE_LENGTH);
+            sharedSecond = ts.tv_sec;
+        }
+        memcpy(localDate, sharedDate, sizeof(localDate));
+        localSecond = ts.tv_sec;
+        pthread_mutex_unlock(&sharedMutex);
+    }
+
+    return string_view(localDate, HTTP_DATE_LENGTH);
+}
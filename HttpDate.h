@@ -0,0 +1,33 @@
+#ifndef HTTPDATE_H
+#define HTTPDATE_H
+
+#include <string_view>
+
+/* Length of a date in the format of the Date header, such as
+   "Sun, 06 Nov 1994 08:49:37 GMT" */
+#define HTTP_DATE_LENGTH 29
+
+namespace kaoisoft
+{
+    /**
+     * Current time in the format of the HTTP Date header.
+     *
+     * The date is formatted at most once a second for the whole process,
+     * under a lock that each thread only takes when the second changes. Each
+     * thread keeps its own copy of the formatted date, so reading it is
+     * otherwise free.
+     */
+    class HttpDate
+    {
+    public:
+        /**
+         * Gets the current date.
+         *
+         * @return The date, as a view of the calling thread's copy. It stays
+         *         valid until the thread calls this again in a later second.
+         */
+        static std::string_view now();
+    };
+}
+
+#endif // HTTPDATE_H
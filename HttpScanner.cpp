@@ -0,0 +1,305 @@
+#include "HttpScanner.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HTTP_SCANNER_X86
+#include <immintrin.h>
+#endif
+
+using namespace kaoisoft;
+
+/**
+ * Which bytes are token characters (RFC 9110 tchar).
+ */
+static const bool tokenChars[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 1, 0, 1, 1, 1, 1, 1, 0, 0, 1, 1, 0, 1, 1, 0,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0,
+    0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 0, 1, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+/**
+ * Finds the first control character other than tab, or DEL. Line feeds and
+ * carriage returns are included.
+ */
+static size_t findSpecialScalar(const char* data, size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        unsigned char ch = (unsigned char)data[i];
+        if ((0x20 > ch && '\t' != ch) || 0x7f == ch)
+        {
+            return i;
+        }
+    }
+
+    return length;
+}
+
+/**
+ * Finds the first character that is not a token character.
+ */
+static size_t findNonTokenScalar(const char* data, size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        if (!tokenChars[(unsigned char)data[i]])
+        {
+            return i;
+        }
+    }
+
+    return length;
+}
+
+#ifdef HTTP_SCANNER_X86
+/**
+ * SSE4.2 version of findSpecialScalar().
+ */
+__attribute__((target("sse4.2")))
+static size_t findSpecialSse42(const char* data, size_t length)
+{
+    // Ranges of the bytes to stop at
+    static const char ranges[16] __attribute__((aligned(16))) = "\x00\x08" "\x0a\x1f" "\x7f\x7f";
+    const __m128i rangesVector = _mm_load_si128((const __m128i*)ranges);
+
+    size_t pos = 0;
+    for (; pos + 16 <= length; pos += 16)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(data + pos));
+        int index = _mm_cmpestri(rangesVector, 6, chunk, 16,
+                                 _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_LEAST_SIGNIFICANT);
+        if (16 != index)
+        {
+            return pos + index;
+        }
+    }
+
+    return pos + findSpecialScalar(data + pos, length - pos);
+}
+
+/**
+ * Finds the first character that may not be a token character. Eight ranges
+ * cannot describe the token characters exactly, so '|' and '~' are stopped at
+ * too and have to be checked by the caller.
+ */
+__attribute__((target("sse4.2")))
+static size_t findNonTokenSse42(const char* data, size_t length)
+{
+    static const char ranges[16] __attribute__((aligned(16))) = {
+        '\x00', ' ', '"', '"', '(', ')', ',', ',', '/', '/', ':', '@', '[', ']', '{', '\xff'
+    };
+    const __m128i rangesVector = _mm_load_si128((const __m128i*)ranges);
+
+    size_t pos = 0;
+    for (; pos + 16 <= length; pos += 16)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(data + pos));
+        int index = _mm_cmpestri(rangesVector, 16, chunk, 16,
+                                 _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_LEAST_SIGNIFICANT);
+        if (16 != index)
+        {
+            return pos + index;
+        }
+    }
+
+    return pos + findNonTokenScalar(data + pos, length - pos);
+}
+
+/**
+ * AVX2 version of findSpecialScalar().
+ */
+__attribute__((target("avx2")))
+static size_t findSpecialAvx2(const char* data, size_t length)
+{
+    const __m256i controlMax = _mm256_set1_epi8(0x1f);
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i del = _mm256_set1_epi8(0x7f);
+
+    size_t pos = 0;
+    for (; pos + 32 <= length; pos += 32)
+    {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)(data + pos));
+
+        // Bytes that are unchanged by min(byte, 0x1f) are control characters
+        __m256i control = _mm256_cmpeq_epi8(_mm256_min_epu8(chunk, controlMax), chunk);
+        __m256i special = _mm256_or_si256(_mm256_andnot_si256(_mm256_cmpeq_epi8(chunk, tab), control),
+                                          _mm256_cmpeq_epi8(chunk, del));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(special);
+        if (0 != mask)
+        {
+            return pos + __builtin_ctz(mask);
+        }
+    }
+
+    // The upper halves of the registers must be cleared before running SSE
+    // code, which would otherwise be slowed down
+    _mm256_zeroupper();
+
+    return pos + findSpecialSse42(data + pos, length - pos);
+}
+
+/**
+ * AVX2 version of findNonTokenScalar(). Each byte is classified exactly with
+ * two table lookups: one for its low nibble, giving the high nibbles that form
+ * token characters with it, and one for its high nibble.
+ */
+__attribute__((target("avx2")))
+static size_t findNonTokenAvx2(const char* data, size_t length)
+{
+    static const unsigned char lowTable[32] = {
+        0xe8, 0xfc, 0xf8, 0xfc, 0xfc, 0xfc, 0xfc, 0xfc, 0xf8, 0xf8, 0xf4, 0x54, 0xd0, 0x54, 0xf4, 0x70,
+        0xe8, 0xfc, 0xf8, 0xfc, 0xfc, 0xfc, 0xfc, 0xfc, 0xf8, 0xf8, 0xf4, 0x54, 0xd0, 0x54, 0xf4, 0x70
+    };
+    static const unsigned char highTable[32] = {
+        0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0, 0, 0, 0, 0, 0, 0, 0,
+        0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0, 0, 0, 0, 0, 0, 0, 0
+    };
+    const __m256i lowVector = _mm256_loadu_si256((const __m256i*)lowTable);
+    const __m256i highVector = _mm256_loadu_si256((const __m256i*)highTable);
+    const __m256i nibbleMask = _mm256_set1_epi8(0x0f);
+
+    size_t pos = 0;
+    for (; pos + 32 <= length; pos += 32)
+    {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)(data + pos));
+        __m256i low = _mm256_and_si256(chunk, nibbleMask);
+        __m256i high = _mm256_and_si256(_mm256_srli_epi16(chunk, 4), nibbleMask);
+        __m256i bits = _mm256_and_si256(_mm256_shuffle_epi8(lowVector, low),
+                                        _mm256_shuffle_epi8(highVector, high));
+        __m256i nonToken = _mm256_cmpeq_epi8(bits, _mm256_setzero_si256());
+        unsigned mask = (unsigned)_mm256_movemask_epi8(nonToken);
+        if (0 != mask)
+        {
+            return pos + __builtin_ctz(mask);
+        }
+    }
+
+    return pos + findNonTokenScalar(data + pos, length - pos);
+}
+#endif // HTTP_SCANNER_X86
+
+/* Implementations in use, which start out as the scalar ones */
+static size_t (*findSpecial)(const char*, size_t) = findSpecialScalar;
+static size_t (*findNonToken)(const char*, size_t) = findNonTokenScalar;
+static HttpScanner::Level currentLevel = HttpScanner::SCALAR;
+
+/**
+ * Switches to the best implementation that the CPU supports when the library
+ * is loaded.
+ */
+static struct LevelSelector
+{
+    LevelSelector()
+    {
+        if (!HttpScanner::setLevel(HttpScanner::AVX2))
+        {
+            HttpScanner::setLevel(HttpScanner::SSE42);
+        }
+    }
+} levelSelector;
+
+size_t HttpScanner::findLineEnd(const char* data, size_t length)
+{
+    size_t pos = findSpecial(data, length);
+    if (pos == length || '\r' != data[pos])
+    {
+        return pos;
+    }
+
+    // A carriage return must be followed by the line feed
+    if (pos + 1 == length)
+    {
+        return length;
+    }
+
+    return ('\n' == data[pos + 1]) ? pos + 1 : pos;
+}
+
+HttpScanner::Level HttpScanner::getLevel()
+{
+    return currentLevel;
+}
+
+const char* HttpScanner::getLevelName(Level level)
+{
+    switch (level)
+    {
+    case SSE42:
+        return "SSE4.2";
+
+    case AVX2:
+        return "AVX2";
+
+    default:
+        return "scalar";
+    }
+}
+
+size_t HttpScanner::scanToken(const char* data, size_t length)
+{
+    // Some implementations also stop at characters that turn out to be
+    // token characters, in which case the scan carries on after them
+    size_t pos = 0;
+    while (pos < length)
+    {
+        pos += findNonToken(data + pos, length - pos);
+        if (pos == length || !tokenChars[(unsigned char)data[pos]])
+        {
+            break;
+        }
+        pos++;
+    }
+
+    return pos;
+}
+
+bool HttpScanner::setLevel(Level level)
+{
+    switch (level)
+    {
+    case SCALAR:
+        findSpecial = findSpecialScalar;
+        findNonToken = findNonTokenScalar;
+        break;
+
+#ifdef HTTP_SCANNER_X86
+    case SSE42:
+        __builtin_cpu_init();
+        if (!__builtin_cpu_supports("sse4.2"))
+        {
+            return false;
+        }
+        findSpecial = findSpecialSse42;
+        findNonToken = findNonTokenSse42;
+        break;
+
+    case AVX2:
+        __builtin_cpu_init();
+        if (!__builtin_cpu_supports("avx2"))
+        {
+            return false;
+        }
+        findSpecial = findSpecialAvx2;
+        findNonToken = findNonTokenAvx2;
+        break;
+#endif
+
+    default:
+        return false;
+    }
+    currentLevel = level;
+
+    return true;
+}
@@ -0,0 +1,85 @@
+#ifndef HTTPSCANNER_H
+#define HTTPSCANNER_H
+
+#include <stddef.h>
+
+namespace kaoisoft
+{
+    /**
+     * Scans the request line and headers of HTTP/1.x requests for the
+     * characters that end or delimit their parts, checking the characters
+     * that are passed over at the same time.
+     *
+     * Where the CPU supports it, 16 (SSE4.2) or 32 (AVX2) bytes are looked
+     * at per step. The best implementation is picked when the library is
+     * loaded; all of them give the same results.
+     */
+    class HttpScanner
+    {
+    public:
+        /**
+         * Instruction sets that the scanner can use.
+         *
+         *   SCALAR - one byte at a time, available everywhere
+         *   SSE42 - SSE4.2 string instructions
+         *   AVX2 - AVX2 byte comparisons and table lookups
+         */
+        enum Level { SCALAR, SSE42, AVX2 };
+
+    public:
+        /**
+         * Finds the end of a line. Control characters other than tab are not
+         * allowed in a request line or header, nor is DEL, and a carriage
+         * return is only allowed right before the line feed.
+         *
+         * @param data Start of the line
+         * @param length Number of bytes available
+         *
+         * @return The offset of the line feed that ends the line, the offset
+         *         of the first character that is not allowed if it comes
+         *         first, or length if neither has been found
+         */
+        static size_t findLineEnd(const char* data, size_t length);
+
+        /**
+         * Measures the token (RFC 9110 tchar characters) at the start of some
+         * data. Methods and header names are tokens.
+         *
+         * @param data Start of the data
+         * @param length Number of bytes available
+         *
+         * @return The number of token characters before the first one that is
+         *         not, or length if they all are
+         */
+        static size_t scanToken(const char* data, size_t length);
+
+        /**
+         * Gets the instruction set that the scanner uses.
+         *
+         * @return The level in use
+         */
+        static Level getLevel();
+
+        /**
+         * Gets the name of an instruction set.
+         *
+         * @param level Level to name
+         *
+         * @return The level's name
+         */
+        static const char* getLevelName(Level level);
+
+        /**
+         * Makes the scanner use a particular instruction set, so that the
+         * implementations can be compared. This is not thread safe and is
+         * meant for tests and benchmarks.
+         *
+         * @param level Level to use
+         *
+         * @return true if the CPU supports the level
+         */
+        static bool setLevel(Level level);
+    };
+}
+
+#endif // HTTPSCANNER_H
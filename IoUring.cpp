@@ -0,0 +1,310 @@
+#include "IoUring.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace kaoisoft;
+using namespace std;
+using namespace log4cxx;
+
+/**
+ * Calls io_uring_setup(2).
+ */
+static int ioUringSetup(unsigned entries, struct io_uring_params* params)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+/**
+ * Calls io_uring_enter(2).
+ */
+static int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete,
+                        unsigned flags, void* arg, size_t argSize)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags,
+                        arg, argSize);
+}
+
+/**
+ * Calls io_uring_register(2).
+ */
+static int ioUringRegister(int fd, unsigned opcode, void* arg, unsigned count)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, count);
+}
+
+
+IoUring::IoUring()
+{
+    ringFd = -1;
+    sqRing = MAP_FAILED;
+    sqRingSize = 0;
+    cqRing = MAP_FAILED;
+    cqRingSize = 0;
+    sqes = (struct io_uring_sqe*)MAP_FAILED;
+    sqesSize = 0;
+    sqHead = nullptr;
+    sqTail = nullptr;
+    sqArray = nullptr;
+    sqMask = 0;
+    sqEntries = 0;
+    sqLocalTail = 0;
+    cqHead = nullptr;
+    cqTail = nullptr;
+    cqMask = 0;
+    cqes = nullptr;
+    bufRing = (struct io_uring_buf_ring*)MAP_FAILED;
+    bufRingSize = 0;
+    bufData = nullptr;
+    bufCount = 0;
+    bufSize = 0;
+    bufTail = 0;
+
+    // Create the logger
+    logger = Logger::getLogger("com.kaoisoft.IoUring");
+}
+
+IoUring::~IoUring()
+{
+    // Closing the instance cancels its requests and unregisters the buffers
+    if (-1 != ringFd)
+    {
+        close(ringFd);
+    }
+
+    if (MAP_FAILED != (void*)bufRing)
+    {
+        munmap(bufRing, bufRingSize);
+    }
+    free(bufData);
+    if (MAP_FAILED != (void*)sqes)
+    {
+        munmap(sqes, sqesSize);
+    }
+    if (MAP_FAILED != cqRing && cqRing != sqRing)
+    {
+        munmap(cqRing, cqRingSize);
+    }
+    if (MAP_FAILED != sqRing)
+    {
+        munmap(sqRing, sqRingSize);
+    }
+}
+
+struct io_uring_sqe* IoUring::getSqe()
+{
+    // Make room by submitting what is already queued
+    if (sqLocalTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries)
+    {
+        submit(0);
+        if (sqLocalTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries)
+        {
+            return nullptr;
+        }
+    }
+
+    unsigned index = sqLocalTail & sqMask;
+    struct io_uring_sqe* sqe = &sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqArray[index] = index;
+    sqLocalTail++;
+
+    return sqe;
+}
+
+bool IoUring::enable()
+{
+    if (0 != ioUringRegister(ringFd, IORING_REGISTER_ENABLE_RINGS, nullptr, 0))
+    {
+        LOG4CXX_ERROR(logger, "Could not enable io_uring instance: " << strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+bool IoUring::init(unsigned entries, unsigned flags)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = flags;
+    if (-1 == (ringFd = ioUringSetup(entries, &params)))
+    {
+        LOG4CXX_ERROR(logger, "Could not create io_uring instance: " << strerror(errno));
+        return false;
+    }
+
+    // Map the rings. Newer kernels put both of them in one mapping.
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (cqRingSize > sqRingSize)
+        {
+            sqRingSize = cqRingSize;
+        }
+        cqRingSize = sqRingSize;
+    }
+    sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                  ringFd, IORING_OFF_SQ_RING);
+    if (MAP_FAILED == sqRing)
+    {
+        LOG4CXX_ERROR(logger, "Could not map io_uring submission queue: " << strerror(errno));
+        return false;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        cqRing = sqRing;
+    }
+    else
+    {
+        cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ringFd, IORING_OFF_CQ_RING);
+        if (MAP_FAILED == cqRing)
+        {
+            LOG4CXX_ERROR(logger, "Could not map io_uring completion queue: " << strerror(errno));
+            return false;
+        }
+    }
+    sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqes = (struct io_uring_sqe*)mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE,
+                                      MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+    if (MAP_FAILED == (void*)sqes)
+    {
+        LOG4CXX_ERROR(logger, "Could not map io_uring submission entries: " << strerror(errno));
+        return false;
+    }
+
+    char* sq = (char*)sqRing;
+    sqHead = (unsigned*)(sq + params.sq_off.head);
+    sqTail = (unsigned*)(sq + params.sq_off.tail);
+    sqArray = (unsigned*)(sq + params.sq_off.array);
+    sqMask = *(unsigned*)(sq + params.sq_off.ring_mask);
+    sqEntries = params.sq_entries;
+    sqLocalTail = *sqTail;
+
+    char* cq = (char*)cqRing;
+    cqHead = (unsigned*)(cq + params.cq_off.head);
+    cqTail = (unsigned*)(cq + params.cq_off.tail);
+    cqMask = *(unsigned*)(cq + params.cq_off.ring_mask);
+    cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    return true;
+}
+
+struct io_uring_cqe* IoUring::peekCqe()
+{
+    unsigned head = *cqHead;
+    if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE))
+    {
+        return nullptr;
+    }
+
+    return &cqes[head & cqMask];
+}
+
+void IoUring::returnBuffer(uint16_t id)
+{
+    // The entries start at the front of the ring. The kernel header's bufs
+    // member is misplaced when it is compiled as C++, so it is not used.
+    struct io_uring_buf* buf = (struct io_uring_buf*)bufRing + (bufTail & (bufCount - 1));
+    buf->addr = (uint64_t)(uintptr_t)getBuffer(id);
+    buf->len = bufSize;
+    buf->bid = id;
+    bufTail++;
+    __atomic_store_n(&bufRing->tail, bufTail, __ATOMIC_RELEASE);
+}
+
+void IoUring::seenCqe()
+{
+    __atomic_store_n(cqHead, *cqHead + 1, __ATOMIC_RELEASE);
+}
+
+bool IoUring::setUpBuffers(uint16_t group, unsigned count, unsigned size)
+{
+    // The ring must be page aligned, so it gets its own mapping
+    bufRingSize = count * sizeof(struct io_uring_buf);
+    bufRing = (struct io_uring_buf_ring*)mmap(nullptr, bufRingSize, PROT_READ | PROT_WRITE,
+                                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == (void*)bufRing)
+    {
+        LOG4CXX_ERROR(logger, "Could not allocate provided buffer ring: " << strerror(errno));
+        return false;
+    }
+    bufData = (char*)malloc((size_t)count * size);
+    if (nullptr == bufData)
+    {
+        LOG4CXX_ERROR(logger, "Could not allocate " << (size_t)count * size <<
+                      " bytes for provided buffers");
+        return false;
+    }
+    bufCount = count;
+    bufSize = size;
+    bufTail = 0;
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)bufRing;
+    reg.ring_entries = count;
+    reg.bgid = group;
+    if (0 != ioUringRegister(ringFd, IORING_REGISTER_PBUF_RING, &reg, 1))
+    {
+        LOG4CXX_ERROR(logger, "Could not register provided buffer ring: " << strerror(errno));
+        return false;
+    }
+
+    // Give all of the buffers to the kernel
+    for (unsigned i = 0; i < count; i++)
+    {
+        returnBuffer((uint16_t)i);
+    }
+
+    return true;
+}
+
+bool IoUring::submit(int timeout)
+{
+    // Make the new entries visible to the kernel
+    __atomic_store_n(sqTail, sqLocalTail, __ATOMIC_RELEASE);
+    unsigned toSubmit = sqLocalTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+
+    int ret;
+    if (0 == timeout)
+    {
+        if (0 == toSubmit)
+        {
+            return true;
+        }
+        ret = ioUringEnter(ringFd, toSubmit, 0, 0, nullptr, 0);
+    }
+    else if (0 > timeout)
+    {
+        ret = ioUringEnter(ringFd, toSubmit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+    }
+    else
+    {
+        struct __kernel_timespec ts;
+        ts.tv_sec = timeout / 1000;
+        ts.tv_nsec = (timeout % 1000) * 1000000LL;
+        struct io_uring_getevents_arg arg;
+        memset(&arg, 0, sizeof(arg));
+        arg.ts = (uint64_t)(uintptr_t)&ts;
+        ret = ioUringEnter(ringFd, toSubmit, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+                           &arg, sizeof(arg));
+    }
+
+    // Running out of time or being interrupted is not an error, and a full
+    // completion queue empties as the caller handles the completions
+    if (-1 == ret && ETIME != errno && EINTR != errno && EBUSY != errno && EAGAIN != errno)
+    {
+        LOG4CXX_ERROR(logger, "io_uring_enter failed: " << strerror(errno));
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,137 @@
+#ifndef IOURING_H
+#define IOURING_H
+
+#include <log4cxx/logger.h>
+#include <linux/io_uring.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace kaoisoft
+{
+    /**
+     * Minimal wrapper around a Linux io_uring instance. The rings are driven
+     * with the raw system calls, so no extra library is needed.
+     *
+     * The instance can also own a ring of provided buffers, which the kernel
+     * picks from when a receive is submitted with IOSQE_BUFFER_SELECT. Each
+     * buffer must be given back with returnBuffer() once its data has been
+     * used.
+     *
+     * Only one thread may use an instance at a time.
+     */
+    class IoUring
+    {
+    private:
+        int ringFd;                         // io_uring instance
+        void* sqRing;                       // Mapped submission queue ring
+        size_t sqRingSize;                  // Size of sqRing
+        void* cqRing;                       // Mapped completion queue ring, which may be sqRing
+        size_t cqRingSize;                  // Size of cqRing
+        struct io_uring_sqe* sqes;          // Mapped submission queue entries
+        size_t sqesSize;                    // Size of sqes
+        unsigned* sqHead;                   // First entry that the kernel has not consumed
+        unsigned* sqTail;                   // Entry after the last one made visible to the kernel
+        unsigned* sqArray;                  // Indexes of the entries to submit
+        unsigned sqMask;                    // Mask applied to submission queue positions
+        unsigned sqEntries;                 // Number of submission queue entries
+        unsigned sqLocalTail;               // Entry after the last one handed out by getSqe()
+        unsigned* cqHead;                   // First completion that has not been seen
+        unsigned* cqTail;                   // Completion after the last one posted by the kernel
+        unsigned cqMask;                    // Mask applied to completion queue positions
+        struct io_uring_cqe* cqes;          // Completion queue entries
+        struct io_uring_buf_ring* bufRing;  // Ring of provided buffers
+        size_t bufRingSize;                 // Size of bufRing
+        char* bufData;                      // Memory of the provided buffers
+        unsigned bufCount;                  // Number of provided buffers
+        unsigned bufSize;                   // Size of each provided buffer
+        uint16_t bufTail;                   // Position after the last buffer given to the kernel
+        log4cxx::LoggerPtr logger;          // Logger for instances of this class
+
+    public:
+        IoUring();
+        virtual ~IoUring();
+
+        /**
+         * Enables an instance that was created with IORING_SETUP_R_DISABLED.
+         * With IORING_SETUP_SINGLE_ISSUER, the calling thread becomes the
+         * only one that may submit requests.
+         *
+         * @return true if successful
+         */
+        bool enable();
+
+        /**
+         * Creates the io_uring instance and maps its rings.
+         *
+         * @param entries Number of submission queue entries
+         * @param flags IORING_SETUP_* flags
+         *
+         * @return true if successful
+         */
+        bool init(unsigned entries, unsigned flags);
+
+        /**
+         * Allocates a ring of provided buffers and registers it with the
+         * kernel.
+         *
+         * @param group Buffer group ID used in IOSQE_BUFFER_SELECT requests
+         * @param count Number of buffers, a power of 2
+         * @param size Size of each buffer
+         *
+         * @return true if successful
+         */
+        bool setUpBuffers(uint16_t group, unsigned count, unsigned size);
+
+        /**
+         * Gets a provided buffer that the kernel has filled.
+         *
+         * @param id Buffer ID from a completion's flags
+         *
+         * @return The buffer's data
+         */
+        const char* getBuffer(uint16_t id) { return bufData + (size_t)id * bufSize; }
+
+        /**
+         * Gives a provided buffer back to the kernel.
+         *
+         * @param id Buffer ID from a completion's flags
+         */
+        void returnBuffer(uint16_t id);
+
+        /**
+         * Gets an empty submission queue entry. If the queue is full, the
+         * entries in it are submitted first.
+         *
+         * @return The entry, or nullptr if the queue is still full
+         */
+        struct io_uring_sqe* getSqe();
+
+        /**
+         * Submits the entries obtained from getSqe() and, if asked to, waits
+         * for at least one completion.
+         *
+         * @param timeout Maximum number of milliseconds to wait, 0 to return
+         *                without waiting or -1 to wait forever
+         *
+         * @return true if successful (including when the timeout expired),
+         *         false if an error occurred
+         */
+        bool submit(int timeout);
+
+        /**
+         * Gets the next completion without waiting.
+         *
+         * @return The completion, or nullptr if there is none
+         */
+        struct io_uring_cqe* peekCqe();
+
+        /**
+         * Marks the completion returned by peekCqe() as seen, so that its slot
+         * can be reused.
+         */
+        void seenCqe();
+    };
+}
+
+#endif // IOURING_H
@@ -0,0 +1,816 @@
+#include "IoUringLoop.h"
+#include "ObjectPool.h"
+#include "RequestParser.h"
+#include "RestServer.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace kaoisoft;
+using namespace std;
+using namespace log4cxx;
+
+/* Number of submission queue entries in each ring */
+#define IO_URING_ENTRIES 256
+
+/* Each ring is only used by its loop's thread, so the kernel can leave the
+ * work of completing requests until the loop asks for completions, instead of
+ * interrupting it. The ring is enabled by that thread. */
+#define IO_URING_SETUP_FLAGS (IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN | \
+                              IORING_SETUP_R_DISABLED)
+
+/* Provided buffers that received data lands in */
+#define IO_URING_BUFFER_GROUP 0
+#define IO_URING_BUFFER_COUNT 256
+#define IO_URING_BUFFER_SIZE 16384
+
+/* Bits of a request's user data that hold the kind of request */
+#define OPERATION_BITS 3
+#define OPERATION_MASK ((1ULL << OPERATION_BITS) - 1)
+
+/* Longest time between checks for idle connections (milliseconds) */
+#define MAX_IDLE_CHECK_INTERVAL 1000
+
+/**
+ * Adds the part of a buffer that has not been written yet to a list of
+ * buffers to write.
+ *
+ * @param iov List of buffers
+ * @param count Number of buffers in the list, which is updated
+ * @param buffer Buffer to add
+ * @param skip Number of bytes at the start of the remaining buffers that have
+ *             already been written, which is updated
+ */
+static void addBuffer(struct iovec* iov, int* count, string_view buffer, size_t* skip)
+{
+    if (*skip >= buffer.length())
+    {
+        *skip -= buffer.length();
+        return;
+    }
+
+    iov[*count].iov_base = (void*)(buffer.data() + *skip);
+    iov[*count].iov_len = buffer.length() - *skip;
+    (*count)++;
+    *skip = 0;
+}
+
+/**
+ * Keeps a connection whose socket has been closed for reuse by the next one,
+ * along with the memory that its request, arena and output queue have grown.
+ *
+ * @param conn Connection to recycle, whose responses have been released
+ */
+static void recycleConnection(IoUringConnection* conn)
+{
+    conn->outputQueue.clear();
+    conn->request.reset();
+    conn->arena.reset();
+    ObjectPool<IoUringConnection>::release(conn);
+}
+
+/**
+ * Tries out a multishot receive into a provided buffer on a ring that is set
+ * up like the loops' rings, which needs the newest of the io_uring features
+ * that the loops use.
+ *
+ * @return true if it worked
+ */
+static bool probeIoUring()
+{
+    IoUring ring;
+    if (!ring.init(8, IO_URING_SETUP_FLAGS) || !ring.enable() ||
+        !ring.setUpBuffers(IO_URING_BUFFER_GROUP, 1, 64))
+    {
+        return false;
+    }
+
+    int fds[2];
+    if (0 != socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds))
+    {
+        return false;
+    }
+    bool supported = false;
+    struct io_uring_sqe* sqe = ring.getSqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fds[0];
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = IO_URING_BUFFER_GROUP;
+    if (1 == ::write(fds[1], "x", 1) && ring.submit(1000))
+    {
+        struct io_uring_cqe* cqe = ring.peekCqe();
+        supported = (nullptr != cqe && 1 == cqe->res && (cqe->flags & IORING_CQE_F_BUFFER));
+    }
+    close(fds[0]);
+    close(fds[1]);
+
+    return supported;
+}
+
+
+IoUringLoop::IoUringLoop(RestServer* server, const vector<Socket*>& listenSockets)
+{
+    this->server = server;
+    this->listenSockets = listenSockets;
+    wakeFd = -1;
+    wakeValue = 0;
+    running = false;
+    closingCount = 0;
+    lastIdleCheck = now();
+
+    // Create the logger
+    logger = Logger::getLogger("com.kaoisoft.IoUringLoop");
+}
+
+IoUringLoop::~IoUringLoop()
+{
+    // Connections are only left here if the loop's thread never ran, so none
+    // of them have requests in progress
+    map<int, IoUringConnection*>::iterator iter;
+    for (iter = connections.begin(); iter != connections.end(); iter++)
+    {
+        IoUringConnection* conn = iter->second;
+        deque<EventLoopOutput>::iterator outputIter;
+        for (outputIter = conn->outputQueue.begin(); outputIter != conn->outputQueue.end(); outputIter++)
+        {
+            releaseResponse(outputIter->response);
+        }
+        conn->sock->recycle();
+        recycleConnection(conn);
+    }
+    connections.clear();
+
+    if (-1 != wakeFd)
+    {
+        close(wakeFd);
+    }
+}
+
+bool IoUringLoop::armAccept(size_t index)
+{
+    struct io_uring_sqe* sqe = ring.getSqe();
+    if (nullptr == sqe)
+    {
+        LOG4CXX_ERROR(logger, "io_uring submission queue is full");
+        return false;
+    }
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listenSockets[index]->getHandle();
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = (index << OPERATION_BITS) | ACCEPT;
+
+    return true;
+}
+
+bool IoUringLoop::armReceive(IoUringConnection* conn)
+{
+    struct io_uring_sqe* sqe = ring.getSqe();
+    if (nullptr == sqe)
+    {
+        LOG4CXX_ERROR(logger, "io_uring submission queue is full");
+        return false;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = conn->sock->getHandle();
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = IO_URING_BUFFER_GROUP;
+    sqe->user_data = (uint64_t)(uintptr_t)conn | RECEIVE;
+    conn->receiving = true;
+
+    return true;
+}
+
+bool IoUringLoop::armWake()
+{
+    struct io_uring_sqe* sqe = ring.getSqe();
+    if (nullptr == sqe)
+    {
+        LOG4CXX_ERROR(logger, "io_uring submission queue is full");
+        return false;
+    }
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = wakeFd;
+    sqe->addr = (uint64_t)(uintptr_t)&wakeValue;
+    sqe->len = sizeof(wakeValue);
+    sqe->user_data = WAKE;
+
+    return true;
+}
+
+void IoUringLoop::closeConnection(IoUringConnection* conn)
+{
+    if (conn->closing)
+    {
+        return;
+    }
+    conn->closing = true;
+    closingCount++;
+    connections.erase(conn->sock->getHandle());
+
+    LOG4CXX_DEBUG(logger, "Closing connection to client at " <<
+                  conn->sock->getRemoteAddress());
+
+    // Cut short the requests that are still using the connection. The socket
+    // stays open until they have finished, so that its handle is not reused.
+    if (conn->receiving || conn->sending)
+    {
+        struct io_uring_sqe* sqe = ring.getSqe();
+        if (nullptr != sqe)
+        {
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->fd = conn->sock->getHandle();
+            sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+            sqe->user_data = CANCEL;
+        }
+        else
+        {
+            shutdown(conn->sock->getHandle(), SHUT_RDWR);
+        }
+    }
+
+    releaseConnection(conn);
+}
+
+void IoUringLoop::closeIdleConnections()
+{
+    long long currentTime = now();
+    lastIdleCheck = currentTime;
+
+    map<int, IoUringConnection*>::iterator iter = connections.begin();
+    while (iter != connections.end())
+    {
+        IoUringConnection* conn = iter->second;
+        iter++;
+
+        // A client that is being sent a response must keep accepting it, and
+        // a client that has sent part of a request gets the read timeout
+        int timeout = server->keepAliveTimeout;
+        if (0 < conn->queuedBytes)
+        {
+            timeout = server->writeTimeout;
+        }
+        else if (0 < conn->sock->getBufferedLength())
+        {
+            timeout = server->readTimeout;
+        }
+        if (currentTime - conn->lastActivity > timeout)
+        {
+            LOG4CXX_DEBUG(logger, "Connection to client at " << conn->sock->getRemoteAddress() <<
+                          " has been idle for too long");
+            closeConnection(conn);
+        }
+    }
+}
+
+void IoUringLoop::handleAccept(struct io_uring_cqe* cqe, size_t index)
+{
+    // A multishot accept stops after an error, so start it again
+    if (!(cqe->flags & IORING_CQE_F_MORE) && running)
+    {
+        armAccept(index);
+    }
+    if (0 > cqe->res)
+    {
+        // The client may have given up on the connection
+        if (-ECONNABORTED != cqe->res && -EAGAIN != cqe->res && -ECANCELED != cqe->res)
+        {
+            LOG4CXX_ERROR(logger, "Failed to accept client connection: " << strerror(-cqe->res));
+        }
+        return;
+    }
+    int sock = cqe->res;
+    if (!running)
+    {
+        close(sock);
+        return;
+    }
+
+    // Create the socket object
+    Socket* socket = server->createSocketObject(sock);
+    struct sockaddr_in sin;
+    socklen_t sin_len = sizeof(sin);
+    if (0 == getpeername(sock, (struct sockaddr *) &sin, &sin_len))
+    {
+        socket->setRemoteAddress(inet_ntoa(sin.sin_addr));
+    }
+    socket->setNoDelay();
+    LOG4CXX_DEBUG(logger, "Accepted a connection from a client at " <<
+                  socket->getRemoteAddress());
+
+    // Prepare the connection for use
+    if (!server->prepareClient(socket))
+    {
+        socket->recycle();
+        return;
+    }
+
+    // Start receiving from the client
+    IoUringConnection* conn = ObjectPool<IoUringConnection>::take();
+    if (nullptr == conn)
+    {
+        conn = new IoUringConnection;
+    }
+    conn->sock = socket;
+    conn->outputOffset = 0;
+    conn->queuedBytes = 0;
+    conn->sending = false;
+    conn->receiving = false;
+    conn->cancelling = false;
+    conn->closing = false;
+    conn->closeAfterWrite = false;
+    conn->inputClosed = false;
+    conn->continueSent = false;
+    conn->requestCount = 0;
+    conn->lastActivity = now();
+    connections[sock] = conn;
+    if (!armReceive(conn))
+    {
+        closeConnection(conn);
+    }
+}
+
+void IoUringLoop::handleCompletion(struct io_uring_cqe* cqe)
+{
+    uint64_t userData = cqe->user_data;
+    IoUringConnection* conn = (IoUringConnection*)(uintptr_t)(userData & ~OPERATION_MASK);
+    switch (userData & OPERATION_MASK)
+    {
+    case ACCEPT:
+        handleAccept(cqe, (size_t)(userData >> OPERATION_BITS));
+        break;
+    case RECEIVE:
+        handleReceive(conn, cqe);
+        break;
+    case SEND:
+        handleSend(conn, cqe->res);
+        break;
+    default:
+        // A cancellation finished, or stop() was called
+        break;
+    }
+}
+
+void IoUringLoop::handleReceive(IoUringConnection* conn, struct io_uring_cqe* cqe)
+{
+    int result = cqe->res;
+    if (!(cqe->flags & IORING_CQE_F_MORE))
+    {
+        conn->receiving = false;
+        conn->cancelling = false;
+    }
+
+    // Move the data into the connection's input buffer and give the
+    // provided buffer back right away
+    bool failed = false;
+    if (cqe->flags & IORING_CQE_F_BUFFER)
+    {
+        uint16_t id = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        if (0 < result && !conn->closing)
+        {
+            failed = !conn->sock->appendBuffer(ring.getBuffer(id), result);
+        }
+        ring.returnBuffer(id);
+    }
+
+    if (conn->closing)
+    {
+        releaseConnection(conn);
+        return;
+    }
+    if (0 < result)
+    {
+        conn->lastActivity = now();
+    }
+    else if (0 == result)
+    {
+        // The client closed its side of the connection. The requests that it
+        // sent before then are still answered.
+        conn->inputClosed = true;
+    }
+    else if (-ENOBUFS != result && -ECANCELED != result)
+    {
+        // The connection failed
+        failed = true;
+    }
+    if (failed)
+    {
+        closeConnection(conn);
+        return;
+    }
+
+    // A receive that ran out of buffers or was paused is started again by
+    // serviceConnection() when the connection may read
+    serviceConnection(conn);
+}
+
+void IoUringLoop::handleSend(IoUringConnection* conn, int result)
+{
+    conn->sending = false;
+    if (conn->closing)
+    {
+        releaseConnection(conn);
+        return;
+    }
+    if (0 > result)
+    {
+        LOG4CXX_DEBUG(logger, "Could not write to client at " << conn->sock->getRemoteAddress() <<
+                      ": " << strerror(-result));
+        closeConnection(conn);
+        return;
+    }
+    conn->queuedBytes -= result;
+    conn->lastActivity = now();
+
+    // Release the output that has been completely written
+    size_t written = conn->outputOffset + result;
+    while (!conn->outputQueue.empty())
+    {
+        EventLoopOutput& output = conn->outputQueue.front();
+        size_t length = output.getLength();
+        if (written < length)
+        {
+            break;
+        }
+        written -= length;
+        releaseResponse(output.response);
+        conn->outputQueue.pop_front();
+    }
+    conn->outputOffset = written;
+
+    // Once everything has been sent, nothing is left in the arena
+    if (conn->outputQueue.empty())
+    {
+        conn->request.reset();
+        conn->arena.reset();
+    }
+
+    serviceConnection(conn);
+}
+
+bool IoUringLoop::isReading(IoUringConnection* conn)
+{
+    return !conn->inputClosed && !conn->closeAfterWrite &&
+           !server->isPipelineFull(conn->outputQueue.size(), conn->queuedBytes);
+}
+
+bool IoUringLoop::isSupported()
+{
+    static bool supported = probeIoUring();
+
+    return supported;
+}
+
+void* IoUringLoop::ioUringLoopThread(void* args)
+{
+    IoUringLoop* inst = (IoUringLoop*)args;
+
+    inst->run();
+
+    return nullptr;
+}
+
+long long IoUringLoop::now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+void IoUringLoop::processInput(IoUringConnection* conn)
+{
+    // Serve the requests that have arrived, in order, until the responses
+    // that are waiting for the client reach the caps. The rest are served
+    // once the client has accepted some of them.
+    while (!conn->closeAfterWrite && 0 < conn->sock->getBufferedLength() &&
+           !server->isPipelineFull(conn->outputQueue.size(), conn->queuedBytes))
+    {
+        // Try to parse a whole request out of the data received so far
+        RestRequest& request = conn->request;
+        request.reset();
+        size_t consumed;
+        int errorCode;
+        RequestParser::Status status = RequestParser::parse(conn->sock->getBufferedData(),
+                                                            conn->sock->getBufferedLength(),
+                                                            server->maxBodySize, &request,
+                                                            &consumed, &errorCode);
+        if (RequestParser::INVALID == status)
+        {
+            // Tell the client what was wrong with the request and hang up
+            LOG4CXX_DEBUG(logger, "Invalid request from client at " <<
+                          conn->sock->getRemoteAddress() << ", responding with " << errorCode);
+            RestResponse* response = takeResponse();
+            RestServer::fillErrorResponse(errorCode, response);
+            response->addHeader("Connection", "close");
+            conn->closeAfterWrite = true;
+            queueOutput(conn, nullptr, response->getHeaderBlock(&conn->arena), response);
+            return;
+        }
+        if (RequestParser::COMPLETE != status)
+        {
+            if (RequestParser::EXPECT_CONTINUE == status && !conn->continueSent)
+            {
+                // The client is waiting for permission to send the body
+                queueOutput(conn, nullptr,
+                            std::pmr::string("HTTP/1.1 100 Continue\r\n\r\n", &conn->arena),
+                            nullptr);
+                conn->continueSent = true;
+            }
+            return;
+        }
+        conn->sock->consume(consumed);
+        conn->continueSent = false;
+        LOG4CXX_TRACE(logger, "Received request " << request.toString() <<
+                      " from client at " << conn->sock->getRemoteAddress());
+
+        // Route the request to the appropriate handler, unless its response
+        // has already been serialized
+        conn->requestCount++;
+        HandlerData* handlerData = server->findRoute(&request);
+        const StaticResponse* staticResponse = handlerData->staticResponse;
+        if (nullptr != staticResponse)
+        {
+            conn->closeAfterWrite = !server->keepConnectionAlive(&request, staticResponse,
+                                                                  conn->requestCount);
+            queueOutput(conn, staticResponse,
+                        staticResponse->getClosingBlock(!conn->closeAfterWrite, &conn->arena),
+                        nullptr);
+            continue;
+        }
+        RestResponse* response = takeResponse();
+        (handlerData->handler)(request, *response);
+        conn->closeAfterWrite = !server->keepConnectionAlive(&request, response,
+                                                              conn->requestCount);
+
+        // Queue the response behind any that have not been written yet
+        queueOutput(conn, nullptr, response->getHeaderBlock(&conn->arena), response);
+    }
+}
+
+void IoUringLoop::queueOutput(IoUringConnection* conn, const StaticResponse* staticResponse,
+                              std::pmr::string header, RestResponse* response)
+{
+    LOG4CXX_TRACE(logger, "Sending response " <<
+                  ((nullptr != staticResponse) ? staticResponse->getHead() : "") << header <<
+                  " to client at " << conn->sock->getRemoteAddress());
+
+    // Moving the header in keeps it in the memory it was built in
+    conn->outputQueue.push_back({staticResponse, std::move(header), response});
+    conn->queuedBytes += conn->outputQueue.back().getLength();
+}
+
+void IoUringLoop::releaseConnection(IoUringConnection* conn)
+{
+    if (!conn->closing || conn->receiving || conn->sending)
+    {
+        return;
+    }
+    closingCount--;
+
+    deque<EventLoopOutput>::iterator iter;
+    for (iter = conn->outputQueue.begin(); iter != conn->outputQueue.end(); iter++)
+    {
+        releaseResponse(iter->response);
+    }
+    conn->sock->recycle();
+    recycleConnection(conn);
+}
+
+void IoUringLoop::releaseResponse(RestResponse* response)
+{
+    if (nullptr == response)
+    {
+        return;
+    }
+
+    response->reset();
+    ObjectPool<RestResponse>::release(response);
+}
+
+void IoUringLoop::run()
+{
+    // Wake up often enough to close idle connections on time
+    int idleCheckInterval = server->keepAliveTimeout;
+    if (0 >= idleCheckInterval || MAX_IDLE_CHECK_INTERVAL < idleCheckInterval)
+    {
+        idleCheckInterval = MAX_IDLE_CHECK_INTERVAL;
+    }
+
+    // The thread that enables the ring is the only one allowed to use it
+    if (!ring.enable())
+    {
+        return;
+    }
+
+    while (running)
+    {
+        // Submit the new requests and wait for something to finish
+        if (!ring.submit(idleCheckInterval))
+        {
+            break;
+        }
+
+        struct io_uring_cqe* cqe;
+        while (running && nullptr != (cqe = ring.peekCqe()))
+        {
+            handleCompletion(cqe);
+            ring.seenCqe();
+        }
+
+        if (running && now() - lastIdleCheck >= idleCheckInterval)
+        {
+            closeIdleConnections();
+        }
+    }
+
+    // Requests that are still in progress would use the connections after
+    // they have been released, so cancel them all and wait for them to finish
+    while (!connections.empty())
+    {
+        closeConnection(connections.begin()->second);
+    }
+    for (size_t i = 0; i < listenSockets.size(); i++)
+    {
+        struct io_uring_sqe* sqe = ring.getSqe();
+        if (nullptr != sqe)
+        {
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->fd = listenSockets[i]->getHandle();
+            sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+            sqe->user_data = CANCEL;
+        }
+    }
+    while (0 < closingCount && ring.submit(MAX_IDLE_CHECK_INTERVAL))
+    {
+        struct io_uring_cqe* cqe;
+        while (nullptr != (cqe = ring.peekCqe()))
+        {
+            handleCompletion(cqe);
+            ring.seenCqe();
+        }
+    }
+}
+
+bool IoUringLoop::sendOutput(IoUringConnection* conn)
+{
+    // Gather the headers and bodies that have not been written yet
+    int count = 0;
+    size_t skip = conn->outputOffset;
+    deque<EventLoopOutput>::iterator iter;
+    for (iter = conn->outputQueue.begin();
+         iter != conn->outputQueue.end() && IO_URING_MAX_SEND_BUFFERS - 2 > count; iter++)
+    {
+        if (nullptr != iter->staticResponse)
+        {
+            addBuffer(conn->iov, &count, iter->staticResponse->getHead(), &skip);
+        }
+        addBuffer(conn->iov, &count, iter->header, &skip);
+        if (nullptr != iter->staticResponse)
+        {
+            addBuffer(conn->iov, &count, iter->staticResponse->getBody(), &skip);
+        }
+        if (nullptr != iter->response)
+        {
+            addBuffer(conn->iov, &count, iter->response->getBody(), &skip);
+        }
+    }
+    memset(&conn->msg, 0, sizeof(conn->msg));
+    conn->msg.msg_iov = conn->iov;
+    conn->msg.msg_iovlen = count;
+
+    struct io_uring_sqe* sqe = ring.getSqe();
+    if (nullptr == sqe)
+    {
+        LOG4CXX_ERROR(logger, "io_uring submission queue is full");
+        return false;
+    }
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = conn->sock->getHandle();
+    sqe->addr = (uint64_t)(uintptr_t)&conn->msg;
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = (uint64_t)(uintptr_t)conn | SEND;
+    conn->sending = true;
+
+    return true;
+}
+
+void IoUringLoop::serviceConnection(IoUringConnection* conn)
+{
+    processInput(conn);
+
+    // Only one send is in progress at a time, so that the output stays in
+    // order. When it finishes, the rest of the output is sent.
+    if (!conn->sending && 0 < conn->queuedBytes && !sendOutput(conn))
+    {
+        closeConnection(conn);
+        return;
+    }
+
+    // Hang up once everything has been sent, if the connection is finished
+    if (0 == conn->queuedBytes && (conn->closeAfterWrite || conn->inputClosed))
+    {
+        closeConnection(conn);
+        return;
+    }
+
+    // Receive only while there is room for more output
+    if (isReading(conn))
+    {
+        if (!conn->receiving && !armReceive(conn))
+        {
+            closeConnection(conn);
+        }
+    }
+    else if (conn->receiving && !conn->cancelling)
+    {
+        struct io_uring_sqe* sqe = ring.getSqe();
+        if (nullptr != sqe)
+        {
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->addr = (uint64_t)(uintptr_t)conn | RECEIVE;
+            sqe->user_data = CANCEL;
+            conn->cancelling = true;
+        }
+    }
+}
+
+bool IoUringLoop::start()
+{
+    // Create the ring and the buffers that received data lands in
+    if (!ring.init(IO_URING_ENTRIES, IO_URING_SETUP_FLAGS) ||
+        !ring.setUpBuffers(IO_URING_BUFFER_GROUP, IO_URING_BUFFER_COUNT, IO_URING_BUFFER_SIZE))
+    {
+        return false;
+    }
+
+    // Create the descriptor used to wake up the loop
+    if (-1 == (wakeFd = eventfd(0, EFD_CLOEXEC)))
+    {
+        LOG4CXX_ERROR(logger, "Could not create eventfd: " << strerror(errno));
+        return false;
+    }
+
+    // Queue the first requests. They are submitted by the loop's thread, which
+    // then owns them.
+    if (!armWake())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < listenSockets.size(); i++)
+    {
+        if (!armAccept(i))
+        {
+            return false;
+        }
+    }
+
+    // Start the loop's thread
+    running = true;
+    if (0 != pthread_create(&threadId, nullptr, IoUringLoop::ioUringLoopThread,
+                            (void*)this))
+    {
+        LOG4CXX_ERROR(logger, "Could not start io_uring loop thread");
+        running = false;
+        return false;
+    }
+
+    return true;
+}
+
+void IoUringLoop::stop()
+{
+    if (!running)
+    {
+        return;
+    }
+
+    // Wake up the loop and wait for it to exit. Its outstanding requests are
+    // cancelled when the thread exits.
+    running = false;
+    uint64_t val = 1;
+    if (sizeof(val) != ::write(wakeFd, &val, sizeof(val)))
+    {
+        LOG4CXX_ERROR(logger, "Could not wake up io_uring loop: " << strerror(errno));
+    }
+    pthread_join(threadId, nullptr);
+}
+
+RestResponse* IoUringLoop::takeResponse()
+{
+    RestResponse* response = ObjectPool<RestResponse>::take();
+    if (nullptr == response)
+    {
+        return new RestResponse;
+    }
+
+    return response;
+}
@@ -0,0 +1,286 @@
+#ifndef IOURINGLOOP_H
+#define IOURINGLOOP_H
+
+#include "EventLoop.h"
+#include "IoUring.h"
+#include "Socket.h"
+
+#include <log4cxx/logger.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <deque>
+#include <map>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+/* Most buffers gathered into one io_uring send */
+#define IO_URING_MAX_SEND_BUFFERS 16
+
+namespace kaoisoft
+{
+    /** Forward reference */
+    class RestServer;
+
+    /**
+     * State of a client connection that is owned by an io_uring loop.
+     */
+    struct IoUringConnection
+    {
+        Socket* sock;                               // Connection to the client
+        RequestArena arena;                         // Memory for the request being served and the queued headers
+        RestRequest request{&arena};                // Request being served, reused for each one
+        std::deque<EventLoopOutput> outputQueue;    // Output waiting to be written, in order
+        size_t outputOffset;                        // Number of bytes of the first output that have been written
+        size_t queuedBytes;                         // Number of queued bytes that have not been written
+        struct iovec iov[IO_URING_MAX_SEND_BUFFERS];    // Buffers of the send in progress
+        struct msghdr msg;                          // Message of the send in progress
+        bool sending;                               // Whether a send is in progress
+        bool receiving;                             // Whether a multishot receive is armed
+        bool cancelling;                            // Whether the receive is being cancelled
+        bool closing;                               // Whether the connection is waiting for its requests to finish before being released
+        bool closeAfterWrite;                       // Whether to close the connection once the output is written
+        bool inputClosed;                           // Whether the client has stopped sending
+        bool continueSent;                          // Whether "100 Continue" was sent for the request being received
+        int requestCount;                           // Number of requests served on the connection
+        long long lastActivity;                     // When data was last read or written (milliseconds)
+    };
+
+    /**
+     * io_uring-based loop that accepts plain (non-TLS) client connections and
+     * serves their requests from a single thread.
+     *
+     * A server in IO_URING mode runs one of these per core instead of an
+     * EventLoop. Each loop has its own ring, on which it keeps a multishot
+     * accept armed for each of its listen sockets and a multishot receive for
+     * each connection. Received data lands in a ring of provided buffers, so
+     * no buffer is tied up by a connection that is waiting for data, and
+     * responses are sent with one gathered sendmsg per batch. Accepting,
+     * receiving and sending therefore cost no system calls beyond the one
+     * io_uring_enter() per pass of the loop.
+     */
+    class IoUringLoop
+    {
+    private:
+        /**
+         * Kinds of requests submitted to the ring. The kind is kept in the low
+         * bits of a request's user data, above a connection pointer or a
+         * listen socket index.
+         */
+        enum Operation { ACCEPT, RECEIVE, SEND, CANCEL, WAKE };
+
+        RestServer* server;                             // Server whose routes are used to handle requests
+        std::vector<Socket*> listenSockets;             // Sockets that clients connect to
+        IoUring ring;                                   // Ring used for all of the loop's I/O
+        int wakeFd;                                     // eventfd used to wake up the loop when stopping
+        uint64_t wakeValue;                             // Value read from wakeFd
+        bool running;                                   // Whether the loop should keep running
+        int closingCount;                               // Number of closed connections that have not been released
+        pthread_t threadId;                             // ID of the thread running the loop
+        long long lastIdleCheck;                        // When idle connections were last looked for (milliseconds)
+        std::map<int, IoUringConnection*> connections;  // Client connections, keyed by socket handle
+        log4cxx::LoggerPtr logger;                      // Logger for instances of this class
+
+    private:
+        /**
+         * Starts accepting clients on one of the listen sockets.
+         *
+         * @param index Index of the listen socket
+         *
+         * @return true if successful
+         */
+        bool armAccept(size_t index);
+
+        /**
+         * Starts receiving data from a client.
+         *
+         * @param conn Connection to receive from
+         *
+         * @return true if successful
+         */
+        bool armReceive(IoUringConnection* conn);
+
+        /**
+         * Starts waiting for stop() to be called.
+         *
+         * @return true if successful
+         */
+        bool armWake();
+
+        /**
+         * Closes a client connection. Its resources are released once the
+         * requests that are still using them have finished.
+         *
+         * @param conn Connection to close
+         */
+        void closeConnection(IoUringConnection* conn);
+
+        /**
+         * Closes the connections that have been idle for longer than the
+         * server's keep-alive timeout, and those whose client has not
+         * accepted any output within the server's write timeout.
+         */
+        void closeIdleConnections();
+
+        /**
+         * Handles a completion by passing it to the handler for its kind of
+         * request.
+         *
+         * @param cqe Completion
+         */
+        void handleCompletion(struct io_uring_cqe* cqe);
+
+        /**
+         * Handles a completed accept.
+         *
+         * @param cqe Completion
+         * @param index Index of the listen socket
+         */
+        void handleAccept(struct io_uring_cqe* cqe, size_t index);
+
+        /**
+         * Handles received data, or the end of a multishot receive.
+         *
+         * @param conn Connection that was received from
+         * @param cqe Completion
+         */
+        void handleReceive(IoUringConnection* conn, struct io_uring_cqe* cqe);
+
+        /**
+         * Handles a completed send.
+         *
+         * @param conn Connection that was written to
+         * @param result Number of bytes sent, or a negated error code
+         */
+        void handleSend(IoUringConnection* conn, int result);
+
+        /**
+         * Checks whether the loop should receive data from a client. Receiving
+         * stops while the connection's unsent responses are at the server's caps.
+         *
+         * @param conn Connection to check
+         *
+         * @return true if the connection may be received from
+         */
+        bool isReading(IoUringConnection* conn);
+
+        /**
+         * Gets the current time from a monotonic clock.
+         *
+         * @return The time in milliseconds
+         */
+        static long long now();
+
+        /**
+         * Parses the data received from a client and routes each complete
+         * request, queueing the responses in order, until the connection's
+         * unsent output reaches the server's cap. Invalid requests are
+         * answered with an error and the connection is closed once it has
+         * been sent.
+         *
+         * @param conn Connection whose input is parsed
+         */
+        void processInput(IoUringConnection* conn);
+
+        /**
+         * Adds output to the end of a connection's queue. The connection takes
+         * ownership of the response.
+         *
+         * @param conn Connection to write to
+         * @param staticResponse Static response that the header closes, or
+         *                       nullptr
+         * @param header Status line and headers, normally in the connection's
+         *               arena
+         * @param response Response whose body follows the header, or nullptr
+         */
+        void queueOutput(IoUringConnection* conn, const StaticResponse* staticResponse,
+                         std::pmr::string header, RestResponse* response);
+
+        /**
+         * Releases a closed connection if none of its requests are still in
+         * progress.
+         *
+         * @param conn Connection to release
+         */
+        void releaseConnection(IoUringConnection* conn);
+
+        /**
+         * Finishes with a response that has been sent, resetting it and
+         * keeping it in the calling thread's ObjectPool for reuse.
+         *
+         * @param response Response to release, or nullptr
+         */
+        void releaseResponse(RestResponse* response);
+
+        /**
+         * Runs the loop until stop() is called.
+         */
+        void run();
+
+        /**
+         * Submits a send of as much of the queued output as fits in one
+         * gathered message.
+         *
+         * @param conn Connection to write to
+         *
+         * @return true if successful
+         */
+        bool sendOutput(IoUringConnection* conn);
+
+        /**
+         * Serves the requests that a client has sent, starts sending the
+         * output and starts or stops receiving to match the connection's
+         * state. The connection is closed once it has finished or failed.
+         *
+         * @param conn Connection to serve
+         */
+        void serviceConnection(IoUringConnection* conn);
+
+        /**
+         * Gets a response for a request to fill in, reusing one that has
+         * already been sent if there is one.
+         *
+         * @return The response, which is new or reset
+         */
+        RestResponse* takeResponse();
+
+    public:
+        IoUringLoop(RestServer* server, const std::vector<Socket*>& listenSockets);
+        virtual ~IoUringLoop();
+
+        /**
+         * Checks whether the running kernel supports what the loop needs:
+         * io_uring itself, provided buffer rings and multishot accept and
+         * receive (Linux 6.1 or later). The result is worked out once.
+         *
+         * @return true if io_uring loops can be used
+         */
+        static bool isSupported();
+
+        /**
+         * Creates the ring and starts the loop's thread.
+         *
+         * @return true if successful
+         */
+        bool start();
+
+        /**
+         * Stops the loop and waits for its thread to exit.
+         */
+        void stop();
+
+    public:
+        /**
+         * Runs in its own thread and drives a single io_uring loop.
+         *
+         * @param Pointer to the io_uring loop instance
+         *
+         * @return nullptr
+         */
+        static void* ioUringLoopThread(void* args);
+    };
+}
+
+#endif // IOURINGLOOP_H
@@ -0,0 +1,231 @@
+#ifndef OBJECTPOOL_H
+#define OBJECTPOOL_H
+
+#include <pthread.h>
+
+#include <atomic>
+#include <vector>
+
+/* Most objects of one type that a thread keeps for reuse */
+#define OBJECT_POOL_THREAD_CAPACITY 64
+
+/* Number of objects that are moved between a thread and the shared pool at once */
+#define OBJECT_POOL_BATCH_SIZE 16
+
+/* Most objects of one type that are kept for any thread to reuse */
+#define OBJECT_POOL_SHARED_CAPACITY 256
+
+namespace kaoisoft
+{
+    /**
+     * Snapshot of how well an object pool is working.
+     */
+    struct ObjectPoolStatistics
+    {
+        unsigned long long hits;        // Number of takes that reused an object
+        unsigned long long misses;      // Number of takes that found the pool empty
+        unsigned long long discarded;   // Number of released objects that were deleted because the pools were full
+    };
+
+    /**
+     * Free lists of objects of one type, so that objects which are needed
+     * for every connection or request are reused instead of being created
+     * and deleted each time.
+     *
+     * Each thread keeps up to OBJECT_POOL_THREAD_CAPACITY objects of its own,
+     * which it takes and releases without locking. Objects that are created
+     * on one thread and released on another, such as the connections that an
+     * accept thread hands to worker threads, flow back through a shared pool:
+     * a thread that has released more objects than it has taken puts them
+     * straight into the shared pool, and a thread that finds its own pool
+     * empty refills it from the shared one in batches of
+     * OBJECT_POOL_BATCH_SIZE. A thread that exits gives its objects to the
+     * shared pool too. Released objects that would take either pool over its
+     * capacity are deleted, so an idle server does not hold on to more than
+     * that.
+     *
+     * The pool only stores objects. The caller creates an object when
+     * take() returns nullptr, puts it back into a reusable state before
+     * releasing it, and sets it up again after taking it.
+     *
+     * The statistics are totals for the whole process.
+     */
+    template <typename T>
+    class ObjectPool
+    {
+    private:
+        /**
+         * Objects that any thread may take.
+         */
+        struct SharedPool
+        {
+            pthread_mutex_t mutex;          // Protects the objects
+            std::vector<T*> objects;        // Released objects
+
+            SharedPool()
+            {
+                pthread_mutex_init(&mutex, nullptr);
+                objects.reserve(OBJECT_POOL_SHARED_CAPACITY);
+            }
+
+            ~SharedPool()
+            {
+                for (size_t i = 0; i < objects.size(); i++)
+                {
+                    delete objects[i];
+                }
+                pthread_mutex_destroy(&mutex);
+            }
+        };
+
+        /**
+         * Objects that only one thread uses.
+         */
+        struct LocalPool
+        {
+            std::vector<T*> objects;        // Released objects
+            long long balance;              // Number of objects taken minus the number released
+
+            LocalPool()
+            {
+                objects.reserve(OBJECT_POOL_THREAD_CAPACITY);
+                balance = 0;
+            }
+
+            ~LocalPool()
+            {
+                // Let other threads reuse what this one leaves behind
+                giveBack(this, objects.size());
+            }
+        };
+
+        static inline std::atomic<unsigned long long> totalHits{0};        // Hits by all threads
+        static inline std::atomic<unsigned long long> totalMisses{0};      // Misses by all threads
+        static inline std::atomic<unsigned long long> totalDiscarded{0};   // Objects deleted by all threads
+
+    private:
+        /**
+         * Gets the shared pool. It is created the first time it is needed,
+         * so that it is destroyed before anything that the objects in it use.
+         *
+         * @return The shared pool
+         */
+        static SharedPool* getSharedPool()
+        {
+            static SharedPool sharedPool;
+            return &sharedPool;
+        }
+
+        /**
+         * Gets the calling thread's pool.
+         *
+         * @return The thread's pool
+         */
+        static LocalPool* getLocalPool()
+        {
+            static thread_local LocalPool localPool;
+            return &localPool;
+        }
+
+        /**
+         * Moves objects from the end of a thread's pool to the shared pool,
+         * deleting those that do not fit.
+         *
+         * @param pool Thread's pool
+         * @param count Number of objects to move
+         */
+        static void giveBack(LocalPool* pool, size_t count)
+        {
+            SharedPool* sharedPool = getSharedPool();
+            size_t first = pool->objects.size() - count;
+
+            pthread_mutex_lock(&sharedPool->mutex);
+            size_t i = first;
+            while (i < pool->objects.size() &&
+                   OBJECT_POOL_SHARED_CAPACITY > sharedPool->objects.size())
+            {
+                sharedPool->objects.push_back(pool->objects[i++]);
+            }
+            pthread_mutex_unlock(&sharedPool->mutex);
+
+            totalDiscarded.fetch_add(pool->objects.size() - i, std::memory_order_relaxed);
+            for (; i < pool->objects.size(); i++)
+            {
+                delete pool->objects[i];
+            }
+            pool->objects.resize(first);
+        }
+
+    public:
+        /**
+         * Takes an object that was released earlier.
+         *
+         * @return The object, or nullptr if there is none and the caller must
+         *         create one
+         */
+        static T* take()
+        {
+            LocalPool* pool = getLocalPool();
+            pool->balance++;
+            if (pool->objects.empty())
+            {
+                // Refill from the shared pool
+                SharedPool* sharedPool = getSharedPool();
+                pthread_mutex_lock(&sharedPool->mutex);
+                while (!sharedPool->objects.empty() &&
+                       OBJECT_POOL_BATCH_SIZE > pool->objects.size())
+                {
+                    pool->objects.push_back(sharedPool->objects.back());
+                    sharedPool->objects.pop_back();
+                }
+                pthread_mutex_unlock(&sharedPool->mutex);
+            }
+
+            if (pool->objects.empty())
+            {
+                totalMisses.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            T* object = pool->objects.back();
+            pool->objects.pop_back();
+            totalHits.fetch_add(1, std::memory_order_relaxed);
+
+            return object;
+        }
+
+        /**
+         * Releases an object so that it can be taken again.
+         *
+         * @param object Object to release, which must already be reusable
+         */
+        static void release(T* object)
+        {
+            LocalPool* pool = getLocalPool();
+            pool->balance--;
+            pool->objects.push_back(object);
+            if (0 > pool->balance)
+            {
+                // This thread would never take the object back
+                giveBack(pool, 1);
+            }
+            else if (OBJECT_POOL_THREAD_CAPACITY < pool->objects.size())
+            {
+                giveBack(pool, OBJECT_POOL_BATCH_SIZE);
+            }
+        }
+
+        /**
+         * Gets the totals for all threads.
+         *
+         * @param stats Structure into which the statistics are stored
+         */
+        static void getStatistics(ObjectPoolStatistics* stats)
+        {
+            stats->hits = totalHits.load(std::memory_order_relaxed);
+            stats->misses = totalMisses.load(std::memory_order_relaxed);
+            stats->discarded = totalDiscarded.load(std::memory_order_relaxed);
+        }
+    };
+}
+
+#endif // OBJECTPOOL_H
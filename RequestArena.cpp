@@ -0,0 +1,65 @@
+#include "RequestArena.h"
+
+#include <new>
+
+using namespace kaoisoft;
+using namespace std;
+
+RequestArena::RequestArena()
+{
+    block = nullptr;
+    used = 0;
+}
+
+RequestArena::~RequestArena()
+{
+    delete[] block;
+}
+
+void* RequestArena::do_allocate(size_t bytes, size_t alignment)
+{
+    // The block is aligned for any fundamental type, but not for more than that
+    if (alignof(max_align_t) >= alignment)
+    {
+        if (nullptr == block)
+        {
+            block = new char[REQUEST_ARENA_SIZE];
+        }
+
+        size_t start = (used + alignment - 1) & ~(alignment - 1);
+        if (start <= REQUEST_ARENA_SIZE && bytes <= REQUEST_ARENA_SIZE - start)
+        {
+            used = start + bytes;
+            return block + start;
+        }
+    }
+
+    // Fall back to the heap
+    if (__STDCPP_DEFAULT_NEW_ALIGNMENT__ >= alignment)
+    {
+        return ::operator new(bytes);
+    }
+    return ::operator new(bytes, align_val_t(alignment));
+}
+
+void RequestArena::do_deallocate(void* ptr, size_t bytes, size_t alignment)
+{
+    // Memory in the block is only given back by reset()
+    char* start = (char*)ptr;
+    if (nullptr != block && start >= block && start < block + REQUEST_ARENA_SIZE)
+    {
+        return;
+    }
+
+    if (__STDCPP_DEFAULT_NEW_ALIGNMENT__ >= alignment)
+    {
+        ::operator delete(ptr, bytes);
+        return;
+    }
+    ::operator delete(ptr, bytes, align_val_t(alignment));
+}
+
+bool RequestArena::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+    return this == &other;
+}
@@ -0,0 +1,73 @@
+#ifndef REQUESTARENA_H
+#define REQUESTARENA_H
+
+#include <stddef.h>
+
+#include <memory_resource>
+
+/* Number of bytes that an arena hands out before it falls back to the heap */
+#define REQUEST_ARENA_SIZE 4096
+
+namespace kaoisoft
+{
+    /**
+     * Memory for the things that only live while a connection's requests are
+     * being served: copies made by the request, the decoded body of a chunked
+     * request and the serialized response headers.
+     *
+     * Allocations are carved out of one block, one after another, and are not
+     * given back one at a time. Instead the whole arena is reset at once when
+     * everything that was drawn from it has been sent. An allocation that does
+     * not fit in what is left of the block comes from the heap and is freed
+     * normally, so a large request cannot make the arena grow. The block is
+     * allocated the first time the arena is used and kept until the arena is
+     * destroyed, so a connection that is served many requests only allocates
+     * it once.
+     *
+     * The response's own status line, headers and body are not drawn from the
+     * arena. Handlers build them through RestResponse's std::string interface
+     * and often move their own strings into it, which an arena string could
+     * only take by copying, and most bodies are larger than the block anyway.
+     * Responses are reused through an object pool instead, and
+     * RestResponse::reset() bounds the memory that a reused response keeps.
+     *
+     * This is a std::pmr::memory_resource, so standard containers draw from it
+     * through std::pmr::polymorphic_allocator. An arena is used by one thread
+     * at a time.
+     */
+    class RequestArena : public std::pmr::memory_resource
+    {
+    private:
+        char* block;        // Memory that is handed out, or nullptr until the arena is first used
+        size_t used;        // Number of bytes of the block handed out since the last reset
+
+    protected:
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void* ptr, size_t bytes, size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+    public:
+        RequestArena();
+        RequestArena(const RequestArena& other) = delete;
+        virtual ~RequestArena();
+
+        RequestArena& operator=(const RequestArena& other) = delete;
+
+        /**
+         * Gets the number of bytes of the block that have been handed out
+         * since the last reset.
+         *
+         * @return Number of bytes
+         */
+        size_t getUsed() { return used; }
+
+        /**
+         * Makes the whole block available again. Nothing that was allocated
+         * from the block may be used afterwards, although it may still be
+         * freed, which does nothing.
+         */
+        void reset() { used = 0; }
+    };
+}
+
+#endif // REQUESTARENA_H
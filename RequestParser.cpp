@@ -0,0 +1,447 @@
+#include "RequestParser.h"
+#include "HttpScanner.h"
+
+#include <ctype.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+using namespace kaoisoft;
+using namespace std;
+
+/* Largest request line plus headers (or chunked trailers) that is accepted */
+#define MAX_HEADER_SIZE 65536
+
+/* Longest chunk size line that is accepted */
+#define MAX_CHUNK_LINE 1024
+
+/* Most digits accepted in a Content-Length value */
+#define MAX_CONTENT_LENGTH_DIGITS 18
+
+/**
+ * Removes leading and trailing spaces and tabs from a range of characters.
+ */
+static void trimRange(const char** start, size_t* length)
+{
+    while (0 < *length && (' ' == **start || '\t' == **start))
+    {
+        (*start)++;
+        (*length)--;
+    }
+    while (0 < *length && (' ' == (*start)[*length - 1] || '\t' == (*start)[*length - 1]))
+    {
+        (*length)--;
+    }
+}
+
+/**
+ * Checks whether the last coding in a Transfer-Encoding value is chunked.
+ * It must be a whole token, either the entire value or preceded by a comma
+ * and optional whitespace, so that a coding such as "xchunked" is not
+ * mistaken for it.
+ */
+static bool isChunkedLast(const char* value, size_t length)
+{
+    if (7 > length || 0 != strncasecmp(value + length - 7, "chunked", 7))
+    {
+        return false;
+    }
+
+    size_t pos = length - 7;
+    while (0 < pos && (' ' == value[pos - 1] || '\t' == value[pos - 1]))
+    {
+        pos--;
+    }
+
+    return 0 == pos || ',' == value[pos - 1];
+}
+
+/**
+ * Splits a request line of the form "METHOD SP PATH SP PROTOCOL", giving the
+ * request views of its parts. The method must be a token. The scan for the
+ * method may look past the end of the line, up to the available bytes, so
+ * that it can take bigger steps.
+ */
+static bool splitRequestLine(const char* line, size_t length, size_t available,
+                             RestRequest* request)
+{
+    size_t methodLength = HttpScanner::scanToken(line, available);
+    if (0 == methodLength || methodLength >= length || ' ' != line[methodLength])
+    {
+        return false;
+    }
+    const char* path = line + methodLength + 1;
+    const char* sp = (const char*)memchr(path, ' ', line + length - path);
+    if (nullptr == sp || sp == path || sp + 1 == line + length ||
+        nullptr != memchr(sp + 1, ' ', line + length - (sp + 1)))
+    {
+        return false;
+    }
+
+    request->setMethod(string_view(line, methodLength));
+    request->setPathView(string_view(path, sp - path));
+    request->setProtocolView(string_view(sp + 1, line + length - sp - 1));
+
+    return true;
+}
+
+/**
+ * Splits a header line at the colon that follows its name, which must be a
+ * token, and trims the value. As for the request line, the scan for the name
+ * may look at all of the available bytes.
+ */
+static bool splitHeader(const char* line, size_t length, size_t available,
+                        string_view* name, string_view* value)
+{
+    size_t nameLength = HttpScanner::scanToken(line, available);
+    if (0 == nameLength || nameLength >= length || ':' != line[nameLength])
+    {
+        return false;
+    }
+    const char* valueStart = line + nameLength + 1;
+    size_t valueLength = length - nameLength - 1;
+    trimRange(&valueStart, &valueLength);
+    *name = string_view(line, nameLength);
+    *value = string_view(valueStart, valueLength);
+
+    return true;
+}
+
+size_t RequestParser::parseHead(const char* data, size_t length, RestRequest* request)
+{
+    size_t pos = 0;
+    bool requestLine = true;
+
+    while (pos < length)
+    {
+        // Find the end of the line. Lines with characters that are not
+        // allowed are skipped.
+        size_t lineEnd = pos + HttpScanner::findLineEnd(data + pos, length - pos);
+        bool valid = (lineEnd == length || '\n' == data[lineEnd]);
+        if (!valid)
+        {
+            const char* lf = (const char*)memchr(data + lineEnd, '\n', length - lineEnd);
+            lineEnd = (nullptr != lf) ? lf - data : length;
+        }
+        size_t next = (lineEnd < length) ? lineEnd + 1 : length;
+        const char* line = data + pos;
+        size_t lineLength = lineEnd - pos;
+        if (0 < lineLength && '\r' == line[lineLength - 1])
+        {
+            lineLength--;
+        }
+
+        if (requestLine)
+        {
+            // Empty lines in front of the request line are ignored
+            if (0 < lineLength)
+            {
+                if (!valid || !splitRequestLine(line, lineLength, length - pos, request))
+                {
+                    return length;
+                }
+                requestLine = false;
+            }
+        }
+        else if (0 == lineLength)
+        {
+            // The blank line ends the headers
+            return next;
+        }
+        else
+        {
+            string_view name;
+            string_view value;
+            if (valid && splitHeader(line, lineLength, length - pos, &name, &value))
+            {
+                request->addHeaderView(name, value);
+            }
+        }
+
+        pos = next;
+    }
+
+    return length;
+}
+
+RequestParser::Status RequestParser::parseChunkedBody(const char* data, size_t length,
+                                                      size_t maxBodySize, std::pmr::string* body,
+                                                      size_t* consumed, int* errorCode)
+{
+    size_t pos = 0;
+    size_t total = 0;
+
+    while (true)
+    {
+        // Wait for the chunk size line
+        const char* lf = (const char*)memchr(data + pos, '\n', length - pos);
+        if (nullptr == lf)
+        {
+            if (length - pos > MAX_CHUNK_LINE)
+            {
+                *errorCode = 400;
+                return INVALID;
+            }
+            return INCOMPLETE;
+        }
+        size_t lineEnd = lf - data;
+
+        // Parse the hexadecimal chunk size. Chunk extensions are ignored.
+        size_t size = 0;
+        size_t i;
+        for (i = pos; i < lineEnd && isxdigit((unsigned char)data[i]); i++)
+        {
+            if (size > (SIZE_MAX >> 4))
+            {
+                *errorCode = 413;
+                return INVALID;
+            }
+            char ch = data[i];
+            size = size * 16 + (('0' <= ch && ch <= '9') ? ch - '0' : (ch | 0x20) - 'a' + 10);
+        }
+        if (i == pos ||
+            (i < lineEnd && ';' != data[i] && '\r' != data[i] && ' ' != data[i] && '\t' != data[i]))
+        {
+            *errorCode = 400;
+            return INVALID;
+        }
+        pos = lineEnd + 1;
+
+        if (0 == size)
+        {
+            // The last chunk is followed by optional trailers and a blank line
+            while (true)
+            {
+                lf = (const char*)memchr(data + pos, '\n', length - pos);
+                if (nullptr == lf)
+                {
+                    if (length - pos > MAX_HEADER_SIZE)
+                    {
+                        *errorCode = 431;
+                        return INVALID;
+                    }
+                    return INCOMPLETE;
+                }
+                size_t lineLength = lf - (data + pos);
+                pos = lf - data + 1;
+                if (0 == lineLength || (1 == lineLength && '\r' == data[pos - 2]))
+                {
+                    *consumed = pos;
+                    return COMPLETE;
+                }
+            }
+        }
+
+        // Wait for the chunk's data and its CRLF
+        if (size > maxBodySize - total)
+        {
+            *errorCode = 413;
+            return INVALID;
+        }
+        if (length - pos < size + 2)
+        {
+            return INCOMPLETE;
+        }
+        if ('\r' != data[pos + size] || '\n' != data[pos + size + 1])
+        {
+            *errorCode = 400;
+            return INVALID;
+        }
+        if (nullptr != body)
+        {
+            body->append(data + pos, size);
+        }
+        total += size;
+        pos += size + 2;
+    }
+}
+
+RequestParser::Status RequestParser::parse(const char* data, size_t length,
+                                           size_t maxBodySize, RestRequest* request,
+                                           size_t* consumed, int* errorCode)
+{
+    size_t pos = 0;
+    size_t start = 0;
+    size_t headEnd = 0;
+    bool requestLine = true;
+    const char* contentLength = nullptr;
+    size_t contentLengthLength = 0;
+    bool transferEncoding = false;
+    bool chunked = false;
+    bool expectContinue = false;
+
+    if (0 == length)
+    {
+        return INCOMPLETE;
+    }
+
+    // Find the blank line that ends the headers, giving the request views of
+    // the parts and noting the headers that determine where the body ends.
+    // Headers kept from an earlier call, made before all of them had
+    // arrived, are dropped first.
+    request->clearHeaders();
+    while (0 == headEnd)
+    {
+        size_t lineEnd = pos + HttpScanner::findLineEnd(data + pos, length - pos);
+        if (lineEnd == length)
+        {
+            if (length - start > MAX_HEADER_SIZE)
+            {
+                *errorCode = 431;
+                return INVALID;
+            }
+            return INCOMPLETE;
+        }
+        if ('\n' != data[lineEnd])
+        {
+            // A control character where none is allowed
+            *errorCode = 400;
+            return INVALID;
+        }
+        const char* line = data + pos;
+        size_t lineLength = lineEnd - pos;
+        if (0 < lineLength && '\r' == line[lineLength - 1])
+        {
+            lineLength--;
+        }
+        if (lineEnd - start > MAX_HEADER_SIZE)
+        {
+            *errorCode = 431;
+            return INVALID;
+        }
+
+        if (requestLine)
+        {
+            if (0 == lineLength)
+            {
+                // Ignore empty lines in front of the request line
+                start = lineEnd + 1;
+            }
+            else if (!splitRequestLine(line, lineLength, length - pos, request))
+            {
+                *errorCode = 400;
+                return INVALID;
+            }
+            else
+            {
+                requestLine = false;
+            }
+        }
+        else if (0 == lineLength)
+        {
+            headEnd = lineEnd + 1;
+        }
+        else
+        {
+            string_view name;
+            string_view value;
+            if (!splitHeader(line, lineLength, length - pos, &name, &value))
+            {
+                *errorCode = 400;
+                return INVALID;
+            }
+            HeaderNames::Id id = HeaderNames::getId(name);
+            request->addHeaderView(name, value, id);
+
+            if (HeaderNames::CONTENT_LENGTH == id)
+            {
+                // Conflicting lengths make the end of the request ambiguous
+                if (nullptr != contentLength &&
+                    (value.length() != contentLengthLength ||
+                     0 != memcmp(value.data(), contentLength, contentLengthLength)))
+                {
+                    *errorCode = 400;
+                    return INVALID;
+                }
+                contentLength = value.data();
+                contentLengthLength = value.length();
+            }
+            else if (HeaderNames::TRANSFER_ENCODING == id)
+            {
+                // chunked must be the last coding applied
+                transferEncoding = true;
+                chunked = isChunkedLast(value.data(), value.length());
+            }
+            else if (HeaderNames::EXPECT == id)
+            {
+                expectContinue = 12 == value.length() &&
+                                 0 == strncasecmp(value.data(), "100-continue", 12);
+            }
+        }
+
+        pos = lineEnd + 1;
+    }
+
+    // Find the end of the body
+    size_t bodyEnd = headEnd;
+    size_t bodyLength = 0;
+    if (transferEncoding)
+    {
+        if (nullptr != contentLength)
+        {
+            // A request with both could be framed differently by a proxy
+            *errorCode = 400;
+            return INVALID;
+        }
+        if (!chunked)
+        {
+            *errorCode = 501;
+            return INVALID;
+        }
+
+        size_t encodedLength;
+        Status status = parseChunkedBody(data + headEnd, length - headEnd, maxBodySize,
+                                         nullptr, &encodedLength, errorCode);
+        if (COMPLETE != status)
+        {
+            return (INCOMPLETE == status && expectContinue && length == headEnd) ?
+                        EXPECT_CONTINUE : status;
+        }
+        bodyEnd = headEnd + encodedLength;
+    }
+    else if (nullptr != contentLength)
+    {
+        if (0 == contentLengthLength || MAX_CONTENT_LENGTH_DIGITS < contentLengthLength)
+        {
+            *errorCode = (0 == contentLengthLength) ? 400 : 413;
+            return INVALID;
+        }
+        for (size_t i = 0; i < contentLengthLength; i++)
+        {
+            if (!isdigit((unsigned char)contentLength[i]))
+            {
+                *errorCode = 400;
+                return INVALID;
+            }
+            bodyLength = bodyLength * 10 + (contentLength[i] - '0');
+        }
+        if (bodyLength > maxBodySize)
+        {
+            *errorCode = 413;
+            return INVALID;
+        }
+        if (length - headEnd < bodyLength)
+        {
+            return (expectContinue && length == headEnd) ? EXPECT_CONTINUE : INCOMPLETE;
+        }
+        bodyEnd = headEnd + bodyLength;
+    }
+
+    // The whole request has arrived
+    if (transferEncoding)
+    {
+        // The decoded body is built in the request's storage
+        std::pmr::string* body = request->addStorage();
+        size_t encodedLength;
+        parseChunkedBody(data + headEnd, length - headEnd, maxBodySize, body,
+                         &encodedLength, errorCode);
+        request->setBodyView(*body);
+    }
+    else
+    {
+        request->setBodyView(string_view(data + headEnd, bodyLength));
+    }
+    *consumed = bodyEnd;
+
+    return COMPLETE;
+}
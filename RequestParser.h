@@ -0,0 +1,90 @@
+#ifndef REQUESTPARSER_H
+#define REQUESTPARSER_H
+
+#include "RestRequest.h"
+
+#include <memory_resource>
+#include <string>
+
+namespace kaoisoft
+{
+    /**
+     * Parses HTTP/1.x requests out of a connection's input buffer.
+     *
+     * The end of a request is found from its Content-Length or
+     * Transfer-Encoding: chunked header, so a body that arrives in pieces is
+     * waited for, and the bytes after a request are left for the next one.
+     * The parser keeps no state between calls; it is simply called again when
+     * more data has arrived.
+     *
+     * Nothing is copied out of the buffer: the request that is filled in is
+     * given views of the method, path, protocol, headers and body, so the
+     * buffer must not change while the request is in use. Only a chunked
+     * body, which has to be decoded, is stored in the request itself.
+     */
+    class RequestParser
+    {
+    public:
+        /**
+         * Result of trying to parse a request.
+         *
+         *   INCOMPLETE - more data is needed
+         *   EXPECT_CONTINUE - the headers are complete and the client is
+         *                     waiting for a "100 Continue" before sending the
+         *                     body
+         *   COMPLETE - a whole request was parsed
+         *   INVALID - the request cannot be handled; the error code holds the
+         *             HTTP status to send back
+         */
+        enum Status { INCOMPLETE, EXPECT_CONTINUE, COMPLETE, INVALID };
+
+    private:
+        /**
+         * Walks a chunked body, optionally decoding it.
+         *
+         * @param data Start of the body
+         * @param length Number of bytes available
+         * @param maxBodySize Largest decoded body that is accepted
+         * @param body String into which the decoded body is stored, or nullptr
+         * @param consumed Set to the size of the encoded body, including the trailers
+         * @param errorCode Set to the HTTP status when INVALID is returned
+         *
+         * @return INCOMPLETE, COMPLETE or INVALID
+         */
+        static Status parseChunkedBody(const char* data, size_t length,
+                                       size_t maxBodySize, std::pmr::string* body,
+                                       size_t* consumed, int* errorCode);
+
+    public:
+        /**
+         * Parses the request line and headers.
+         *
+         * @param data Start of the request
+         * @param length Number of bytes available
+         * @param request Request that is given views of the method, path,
+         *                protocol and headers
+         *
+         * @return The offset just past the blank line that ends the headers,
+         *         or length if there is no blank line
+         */
+        static size_t parseHead(const char* data, size_t length, RestRequest* request);
+
+        /**
+         * Tries to parse a complete request, including its body.
+         *
+         * @param data Start of the request
+         * @param length Number of bytes available
+         * @param maxBodySize Largest body that is accepted
+         * @param request Request that is filled in when COMPLETE is returned
+         * @param consumed Set to the number of bytes that make up the request
+         *                 when COMPLETE is returned
+         * @param errorCode Set to the HTTP status when INVALID is returned
+         *
+         * @return The parsing status
+         */
+        static Status parse(const char* data, size_t length, size_t maxBodySize,
+                            RestRequest* request, size_t* consumed, int* errorCode);
+    };
+}
+
+#endif // REQUESTPARSER_H
@@ -1,6 +1,5 @@
 #include "RestRequest.h"
-
-#include <StringUtils.h>
+#include "RequestParser.h"
 
 using namespace kaoisoft;
 using namespace std;
@@ -10,75 +9,140 @@ RestRequest::RestRequest()
     method = Method::INVALID;
     path = "/";
     protocol = "HTTP1.1";
-    body = "";
+}
+
+RestRequest::RestRequest(std::pmr::memory_resource* resource)
+    : storage(resource)
+{
+    method = Method::INVALID;
+    path = "/";
+    protocol = "HTTP1.1";
 }
 
 RestRequest::RestRequest(const char* data, size_t len)
 {
-    // Convert the data to a string
-    string str(data, 0, len);
+    method = Method::INVALID;
+    path = "/";
+    protocol = "HTTP1.1";
+
+    // Keep a single copy of the data, which everything else points into
+    string_view copy = keep(string_view(data, len));
+
+    // Parse the request line and headers
+    size_t start = RequestParser::parseHead(copy.data(), len, this);
 
-    // Parse the first line
-    size_t start = 0;
-    size_t index = str.find("\r\n", start);
-    string line(data, 0, index);
-    shared_ptr<vector<string>> parts = StringUtils::split(line, " ");
-    if (3 != parts->size())
+    // The rest of the data is the body
+    if (start < len)
     {
-        return;
+        body = copy.substr(start);
     }
-    string methodStr = parts->at(0);
-    setMethod(methodStr);
-    path = parts->at(1);
-    protocol = parts->at(2);
+}
+
+RestRequest::RestRequest(const RestRequest& other)
+{
+    copyFrom(other);
+}
 
-    // Parse out the headers
-    start = index + 2;    // skip over the first line's CRLF
-    while (string::npos != (index = str.find("\r\n", start)))
+RestRequest& RestRequest::operator=(const RestRequest& other)
+{
+    if (this != &other)
     {
-        // Get the next line
-        line = StringUtils::trim(string(data, start, index - start));
-        if (0 == line.length())     // The line after the last header will be blank
-        {
-            start = index + 2;
-            break;
-        }
+        copyFrom(other);
+    }
 
-        // Get the header and its value
-        parts = StringUtils::split(line, ":");
-        if (2 == parts->size())
-        {
-            headers[StringUtils::trim(parts->at(0))] = StringUtils::trim(parts->at(1));
-        }
+    return *this;
+}
 
-        // Prepare for the next line
-        start = index + 2;
-    }
+void RestRequest::addHeader(const std::string& name, const std::string& value)
+{
+    string_view nameView = keep(name);
+    addHeaderView(nameView, keep(value));
+}
 
-    // Copy the rest of the data into the body
-    if (start < len)
+void RestRequest::copyFrom(const RestRequest& other)
+{
+    // The other request's views may point into a buffer that is about to be
+    // reused, so everything is copied
+    storage.clear();
+    method = other.method;
+    params.clear();
+    for (size_t i = 0; i < other.params.size(); i++)
+    {
+        string_view name = keep(other.params[i].first);
+        params.emplace_back(name, keep(other.params[i].second));
+    }
+    path = keep(other.path);
+    protocol = keep(other.protocol);
+    body = keep(other.body);
+    headers.clear();
+    for (size_t i = 0; i < other.headers.size(); i++)
     {
-        body = string(data, start, len - start);
+        const HeaderMap<string_view>::Entry& entry = other.headers.at(i);
+        headers.add(keep(entry.name), keep(entry.value), entry.id);
     }
 }
 
-void RestRequest::addHeader(std::string name, std::string value)
+string_view RestRequest::getHeaderView(std::string_view name) const
 {
-    headers[name] = value;
+    const string_view* value = headers.find(name);
+    return (nullptr != value) ? *value : string_view();
 }
 
-void RestRequest::getHeaders(std::map<std::string, std::string>* headers)
+string_view RestRequest::getHeaderView(HeaderNames::Id id) const
 {
-    map<string, string>::iterator iter;
-    for (iter = (this->headers).begin(); iter != (this->headers).end(); iter++)
+    const string_view* value = headers.find(id);
+    return (nullptr != value) ? *value : string_view();
+}
+
+void RestRequest::getHeaders(std::map<std::string, std::string>* headers) const
+{
+    (this->headers).toMap(headers);
+}
+
+string_view RestRequest::getParam(std::string_view name) const
+{
+    for (size_t i = params.size(); 0 < i; i--)
+    {
+        if (name == params[i - 1].first)
+        {
+            return params[i - 1].second;
+        }
+    }
+
+    return string_view();
+}
+
+map<string, string> RestRequest::getParams() const
+{
+    // Later parameters replace earlier ones with the same name
+    map<string, string> copy;
+    for (size_t i = 0; i < params.size(); i++)
     {
-        (*headers)[iter->first] = iter->second;
+        copy[string(params[i].first)] = string(params[i].second);
     }
+
+    return copy;
 }
 
-void RestRequest::addParam(std::string name, std::string value)
+string_view RestRequest::keep(std::string_view value)
 {
-    params[name] = value;
+    // List elements never move, so views of them stay valid
+    storage.emplace_back(value);
+
+    return storage.back();
+}
+
+std::pmr::string* RestRequest::addStorage()
+{
+    storage.emplace_back();
+
+    return &storage.back();
+}
+
+void RestRequest::addParam(const std::string& name, const std::string& value)
+{
+    string_view nameView = keep(name);
+    addParamView(nameView, keep(value));
 }
 
 string RestRequest::getMethodString(Method method)
@@ -108,11 +172,11 @@ void RestRequest::setHeaders(std::map<std::string, std::string>* headers)
     map<string, string>::iterator iter;
     for (iter = headers->begin(); iter != headers->end(); iter++)
     {
-        (this->headers)[iter->first] = iter->second;
+        addHeader(iter->first, iter->second);
     }
 }
 
-void RestRequest::setMethod(string methodStr)
+void RestRequest::setMethod(string_view methodStr)
 {
     if (0 == methodStr.compare("GET"))
     {
@@ -136,17 +200,28 @@ void RestRequest::setMethod(string methodStr)
     }
 }
 
-void RestRequest::setParams(std::map<std::string, std::string> params)
+void RestRequest::reset()
+{
+    method = Method::INVALID;
+    path = "/";
+    protocol = "HTTP1.1";
+    params.clear();
+    headers.clear();
+    body = string_view();
+    storage.clear();
+}
+
+void RestRequest::setParams(const std::map<std::string, std::string>& params)
 {
     (this->params).clear();
-    map<string, string>::iterator iter;
+    map<string, string>::const_iterator iter;
     for (iter = params.begin(); iter != params.end(); iter++)
     {
-        (this->params)[iter->first] = iter->second;
+        addParam(iter->first, iter->second);
     }
 }
 
-string RestRequest::toString()
+string RestRequest::toString() const
 {
     string str;
 
@@ -157,12 +232,11 @@ string RestRequest::toString()
     str.append(protocol);
     str.append("\r\n");
 
-    map<string, string>::iterator iter;
-    for (iter = headers.begin(); iter != headers.end(); iter++)
+    for (size_t i = 0; i < headers.size(); i++)
     {
-        str.append(iter->first);
+        str.append(headers.at(i).name);
         str.append(": ");
-        str.append(iter->second);
+        str.append(headers.at(i).value);
         str.append("\r\n");
     }
     str.append("\r\n");
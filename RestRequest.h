@@ -1,8 +1,14 @@
 #ifndef RESTREQUEST_H
 #define RESTREQUEST_H
 
+#include "HeaderMap.h"
+
+#include <list>
 #include <map>
+#include <memory_resource>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 namespace kaoisoft {
@@ -16,6 +22,21 @@ namespace kaoisoft {
      *      Accept: application/json
      *      <blank line>
      *      <body, if present>
+     *
+     * The path, protocol, headers and body are held as views. A request that
+     * the server parses points into the connection's receive buffer, so no
+     * copies are made unless a handler asks for one through the getters that
+     * return std::string. Those views are only valid until the handler
+     * returns; a handler that keeps any of them longer must copy it.
+     * Values given to the setters that take std::string are copied into
+     * storage owned by the request, which draws its memory from the resource
+     * that the request was created with. The server gives each connection's
+     * request the connection's RequestArena, so those copies cost no heap
+     * allocations.
+     *
+     * A connection keeps one request and reuses it for each request that it
+     * receives, so the memory that the request has grown is kept from one
+     * request to the next.
      */
     class RestRequest
     {
@@ -24,38 +45,200 @@ namespace kaoisoft {
 
     private:
         Method method;                                  // Request method
-        std::string path;                               // Request path (i.e.: /test)
-        std::map<std::string, std::string> params;      // Map of request parameters
-        std::string protocol;                           // HTTP protocol (HTTP/?.?)
-        std::map<std::string, std::string> headers;     // headers
-        std::string body;                               // Body text
+        std::string_view path;                          // Request path (i.e.: /test)
+        std::vector<std::pair<std::string_view, std::string_view>> params;  // Request parameters, in the order they were added
+        std::string_view protocol;                      // HTTP protocol (HTTP/?.?)
+        HeaderMap<std::string_view> headers;            // Headers, in the order received
+        std::string_view body;                          // Body text
+        std::pmr::list<std::pmr::string> storage;       // Copies that views point into, for values that were not parsed in place
+
+    private:
+        /**
+         * Replaces the contents of this request with copies of another's.
+         *
+         * @param other Request to copy
+         */
+        void copyFrom(const RestRequest& other);
+
+        /**
+         * Copies a value into storage owned by the request.
+         *
+         * @param value Value to keep
+         *
+         * @return A view of the kept value
+         */
+        std::string_view keep(std::string_view value);
 
     public:
         RestRequest();
+
+        /**
+         * Creates a request whose storage draws from a memory resource. The
+         * resource must outlive the request, and must not be reset while the
+         * request holds anything that it stored.
+         *
+         * @param resource Memory resource
+         */
+        explicit RestRequest(std::pmr::memory_resource* resource);
         RestRequest(const char* data, size_t len);
+        RestRequest(const RestRequest& other);
+        RestRequest& operator=(const RestRequest& other);
+
+        /**
+         * Gets a copy of the body. The accessors that return a std::string
+         * copy what they return, so that handlers written for them keep
+         * working. getBodyView() gets the body without copying it.
+         *
+         * @return Body text
+         */
+        std::string getBody() const { return std::string(body); }
+
+        /**
+         * Gets a view of the body, which is valid while the request is.
+         *
+         * @return Body text
+         */
+        std::string_view getBodyView() const { return body; }
+        void setBody(const std::string& body) { this->body = keep(body); }
+
+        /**
+         * Sets the body to a view of data that outlives the request.
+         *
+         * @param body Body text
+         */
+        void setBodyView(std::string_view body) { this->body = body; }
+
+        /**
+         * Gets the value of a header. Header names are compared without
+         * regard to case.
+         *
+         * @param name Header name
+         *
+         * @return Copy of the header's value, or an empty string if it is not
+         *         present
+         */
+        std::string getHeader(std::string_view name) const { return std::string(getHeaderView(name)); }
+
+        /**
+         * Gets a view of the value of a header. Header names are compared
+         * without regard to case, and the last of several headers with the
+         * same name wins.
+         *
+         * @param name Header name
+         *
+         * @return The header's value, or an empty view if it is not present
+         */
+        std::string_view getHeaderView(std::string_view name) const;
+
+        /**
+         * Gets a view of the value of a well-known header.
+         *
+         * @param id Header ID
+         *
+         * @return The header's value, or an empty view if it is not present
+         */
+        std::string_view getHeaderView(HeaderNames::Id id) const;
 
-        std::string getBody() { return body; }
-        void setBody(std::string body) { this->body = body; }
+        /**
+         * Gets all of the headers, for walking over them without copying.
+         *
+         * @return The headers, in the order received
+         */
+        const HeaderMap<std::string_view>& getHeaderMap() const { return headers; }
+        void getHeaders(std::map<std::string, std::string>* headers) const;
+        void addHeader(const std::string& name, const std::string& value);
+        void clearHeaders() { headers.clear(); }
 
-        void getHeaders(std::map<std::string, std::string>* headers);
-        void addHeader(std::string name, std::string value);
+        /**
+         * Adds a header whose name and value are views of data that outlives
+         * the request.
+         *
+         * @param name Header name
+         * @param value Header value
+         * @param id ID of the name, if it has already been worked out
+         */
+        void addHeaderView(std::string_view name, std::string_view value) { headers.add(name, value); }
+        void addHeaderView(std::string_view name, std::string_view value, HeaderNames::Id id)
+        {
+            headers.add(name, value, id);
+        }
         void setHeaders(std::map<std::string, std::string>* headers);
 
-        Method getMethod() { return method; }
+        Method getMethod() const { return method; }
         void setMethod(Method method) { this->method = method; }
-        void setMethod(std::string methodStr);
+        void setMethod(std::string_view methodStr);
+
+        /**
+         * Gets a copy of the path. getPathView() gets it without copying it.
+         *
+         * @return Request path
+         */
+        std::string getPath() const { return std::string(path); }
+        std::string_view getPathView() const { return path; }
+        void setPath(const std::string& path) { this->path = keep(path); }
+
+        /**
+         * Sets the path to a view of data that outlives the request.
+         *
+         * @param path Request path
+         */
+        void setPathView(std::string_view path) { this->path = path; }
+
+        /**
+         * Gets a view of the value of a parameter that was captured from the
+         * path. If there are several with the same name, the last one wins.
+         *
+         * @param name Parameter name
+         *
+         * @return The parameter's value, or an empty view if it is not present
+         */
+        std::string_view getParam(std::string_view name) const;
+
+        /**
+         * Gets copies of all of the parameters. getParam() finds one without
+         * copying anything.
+         *
+         * @return Map of parameter names and values
+         */
+        std::map<std::string, std::string> getParams() const;
+        void addParam(const std::string& name, const std::string& value);
+
+        /**
+         * Adds a parameter whose name and value are views of data that
+         * outlives the request.
+         *
+         * @param name Parameter name
+         * @param value Parameter value
+         */
+        void addParamView(std::string_view name, std::string_view value) { params.emplace_back(name, value); }
+        void setParams(const std::map<std::string, std::string>& params);
+
+        std::string getProtocol() const { return std::string(protocol); }
+        std::string_view getProtocolView() const { return protocol; }
+        void setProtocol(const std::string& protocol) { this->protocol = keep(protocol); }
 
-        std::string getPath() { return path; }
-        void setPath(std::string path) { this->path = path; }
+        /**
+         * Sets the protocol to a view of data that outlives the request.
+         *
+         * @param protocol HTTP protocol
+         */
+        void setProtocolView(std::string_view protocol) { this->protocol = protocol; }
 
-        std::map<std::string, std::string> getParams() { return params; }
-        void addParam(std::string name, std::string value);
-        void setParams(std::map<std::string, std::string> params);
+        /**
+         * Adds an empty string to the request's storage, for building a value
+         * in place. The string stays where it is until the request is reset.
+         *
+         * @return The string, which uses the request's memory resource
+         */
+        std::pmr::string* addStorage();
 
-        std::string getProtocol() { return protocol; }
-        void setProtocol(std::string protocol) { this->protocol = protocol; }
+        /**
+         * Empties the request so that it can be reused for another one. The
+         * memory that it has grown is kept.
+         */
+        void reset();
 
-        std::string toString();
+        std::string toString() const;
 
     public:
         /**
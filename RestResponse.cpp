@@ -1,8 +1,16 @@
 #include "RestResponse.h"
+#include "HttpDate.h"
 
 using namespace kaoisoft;
 using namespace std;
 
+/* Room for the parts of a header block other than the protocol, reason and
+   headers: the status code, separators, Date and Content-Length */
+#define HEADER_BLOCK_EXTRA 88
+
+/* Largest body capacity that is kept when a response is reset for reuse */
+#define MAX_KEPT_BODY_SIZE (64 * 1024)
+
 RestResponse::RestResponse()
 {
     protocol = "HTTP/1.1";
@@ -16,15 +24,144 @@ RestResponse::~RestResponse()
 
 void RestResponse::addHeader(string name, string value)
 {
-    headers[name] = value;
+    headers.set(std::move(name), std::move(value));
 }
 
-void RestResponse::getHeaders(std::map<std::string, std::string>* headers)
+template <class StringType>
+void RestResponse::appendHeaderBlock(StringType* str) const
 {
-    map<string, string>::iterator iter;
-    for (iter = (this->headers).begin(); iter != (this->headers).end(); iter++)
+    // Make room for the whole block at once
+    size_t length = protocol.length() + reason.length() + HEADER_BLOCK_EXTRA;
+    for (size_t i = 0; i < headers.size(); i++)
+    {
+        length += headers.at(i).name.length() + headers.at(i).value.length() + 4;
+    }
+    str->reserve(str->length() + length);
+
+    str->append(protocol);
+    str->append(" ");
+    str->append(std::to_string(code));
+    str->append(" ");
+    str->append(reason);
+    str->append("\r\n");
+    for (size_t i = 0; i < headers.size(); i++)
     {
-        (*headers)[iter->first] = iter->second;
+        // The real length is always added below
+        const HeaderMap<string>::Entry& entry = headers.at(i);
+        if (HeaderNames::CONTENT_LENGTH == entry.id)
+        {
+            continue;
+        }
+        str->append(entry.name);
+        str->append(": ");
+        str->append(entry.value);
+        str->append("\r\n");
+    }
+    if (nullptr == headers.find(HeaderNames::DATE))
+    {
+        str->append("Date: ");
+        str->append(HttpDate::now());
+        str->append("\r\n");
+    }
+    str->append("Content-Length: ");
+    str->append(std::to_string(body.length()));
+    str->append("\r\n");
+    str->append("\r\n");
+}
+
+string RestResponse::getHeaderBlock() const
+{
+    string str;
+    appendHeaderBlock(&str);
+
+    return str;
+}
+
+std::pmr::string RestResponse::getHeaderBlock(std::pmr::memory_resource* resource) const
+{
+    std::pmr::string str(resource);
+    appendHeaderBlock(&str);
+
+    return str;
+}
+
+string_view RestResponse::getHeaderView(std::string_view name) const
+{
+    const string* value = headers.find(name);
+    return (nullptr != value) ? string_view(*value) : string_view();
+}
+
+string_view RestResponse::getHeaderView(HeaderNames::Id id) const
+{
+    const string* value = headers.find(id);
+    return (nullptr != value) ? string_view(*value) : string_view();
+}
+
+string RestResponse::getReasonPhrase(int code)
+{
+    switch (code)
+    {
+    case 100:
+        return "Continue";
+
+    case 200:
+        return "OK";
+
+    case 201:
+        return "Created";
+
+    case 204:
+        return "No Content";
+
+    case 400:
+        return "Bad Request";
+
+    case 403:
+        return "Forbidden";
+
+    case 404:
+        return "Not Found";
+
+    case 408:
+        return "Request Timeout";
+
+    case 413:
+        return "Payload Too Large";
+
+    case 431:
+        return "Request Header Fields Too Large";
+
+    case 500:
+        return "Internal Server Error";
+
+    case 501:
+        return "Not Implemented";
+
+    case 503:
+        return "Service Unavailable";
+
+    default:
+        return "Unknown";
+    }
+}
+
+void RestResponse::getHeaders(std::map<std::string, std::string>* headers) const
+{
+    (this->headers).toMap(headers);
+}
+
+void RestResponse::reset()
+{
+    protocol = "HTTP/1.1";
+    code = 500;
+    reason = "Internal Server Error";
+    headers.clear();
+    body.clear();
+
+    // Don't hold on to the memory of an unusually large body
+    if (MAX_KEPT_BODY_SIZE < body.capacity())
+    {
+        string().swap(body);
     }
 }
 
@@ -33,11 +170,12 @@ void RestResponse::setHeaders(map<string, string> headers)
     // Remove the existing headers
     (this->headers).clear();
 
-    // Copy the supplied headers
-    map<string, string>::iterator iter;
-    for (iter = headers.begin(); iter != headers.end(); iter++)
+    // Move the supplied headers out of the map, which is ours. Names that
+    // differ only in case replace each other.
+    while (!headers.empty())
     {
-        (this->headers)[iter->first] = iter->second;
+        map<string, string>::node_type node = headers.extract(headers.begin());
+        (this->headers).set(std::move(node.key()), std::move(node.mapped()));
     }
 }
 
@@ -46,31 +184,9 @@ void RestResponse::setHeaders(map<string, string> headers)
  *
  * @return
  */
-string RestResponse::toString()
+string RestResponse::toString() const
 {
-    string str = "";
-
-    str.append(protocol);
-    str.append(" ");
-    str.append(std::to_string(code));
-    str.append(" ");
-    str.append(reason);
-    str.append("\r\n");
-    if (0 < headers.size())
-    {
-        map<string, string>::iterator iter;
-        for (iter = headers.begin(); iter != headers.end(); iter++)
-        {
-            str.append(iter->first);
-            str.append(": ");
-            str.append(iter->second);
-            str.append("\r\n");
-        }
-    }
-    str.append("Content-Length: ");
-    str.append(std::to_string(body.length()));
-    str.append("\r\n");
-    str.append("\r\n");
+    string str = getHeaderBlock();
     if (0 < body.length())
     {
         str.append(body);
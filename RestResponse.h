@@ -1,13 +1,21 @@
 #ifndef RESTRESPONSE_H
 #define RESTRESPONSE_H
 
+#include "HeaderMap.h"
+
 #include <map>
+#include <memory_resource>
 #include <string>
+#include <string_view>
+#include <utility>
 
 namespace kaoisoft
 {
     /**
      * Data sent back to a client in response to a request.
+     *
+     * The server keeps responses and reuses them for later requests, so a
+     * handler fills in the one that it is given rather than creating its own.
      */
     class RestResponse
     {
@@ -15,30 +23,123 @@ namespace kaoisoft
         std::string protocol;
         int code;
         std::string reason;
-        std::map<std::string, std::string> headers;
+        HeaderMap<std::string> headers;
         std::string body;
 
+    private:
+        /**
+         * Appends the status line and headers to a string.
+         *
+         * @param str String to append to
+         */
+        template <class StringType>
+        void appendHeaderBlock(StringType* str) const;
+
     public:
         RestResponse();
+        RestResponse(const RestResponse& other) = default;
+        RestResponse(RestResponse&& other) = default;
         virtual ~RestResponse();
 
-        std::string getBody() { return body; }
-        void setBody(std::string body) { this->body = body; }
+        RestResponse& operator=(const RestResponse& other) = default;
+        RestResponse& operator=(RestResponse&& other) = default;
+
+        const std::string& getBody() const { return body; }
+        void setBody(std::string body) { this->body = std::move(body); }
 
-        int getCode() { return code; }
+        int getCode() const { return code; }
         void setCode(int code) { this->code = code; }
 
+        /**
+         * Sets a header, replacing any header with the same name. Header
+         * names are compared without regard to case. A Content-Length header
+         * is not sent, since the length is always worked out from the body.
+         *
+         * @param name Header name
+         * @param value Header value
+         */
         void addHeader(std::string name, std::string value);
-        void getHeaders(std::map<std::string, std::string>* headers);
+
+        /**
+         * Gets the value of a header. Header names are compared without
+         * regard to case.
+         *
+         * @param name Header name
+         *
+         * @return The header's value, or an empty string if it is not present
+         */
+        std::string getHeader(std::string_view name) const { return std::string(getHeaderView(name)); }
+
+        /**
+         * Gets a view of the value of a header, which is valid until the
+         * headers are changed.
+         *
+         * @param name Header name
+         *
+         * @return The header's value, or an empty view if it is not present
+         */
+        std::string_view getHeaderView(std::string_view name) const;
+
+        /**
+         * Gets a view of the value of a well-known header, which is valid
+         * until the headers are changed.
+         *
+         * @param id Header ID
+         *
+         * @return The header's value, or an empty view if it is not present
+         */
+        std::string_view getHeaderView(HeaderNames::Id id) const;
+
+        /**
+         * Gets all of the headers, for walking over them without copying.
+         *
+         * @return The headers, in the order they were added
+         */
+        const HeaderMap<std::string>& getHeaderMap() const { return headers; }
+        void getHeaders(std::map<std::string, std::string>* headers) const;
         void setHeaders(std::map<std::string, std::string> headers);
 
-        std::string getProtocol() { return protocol; }
-        void setProtocol(std::string protocol) { this->protocol = protocol; }
+        const std::string& getProtocol() const { return protocol; }
+        void setProtocol(std::string protocol) { this->protocol = std::move(protocol); }
+
+        const std::string& getReason() const { return reason; }
+        void setReason(std::string reason) { this->reason = std::move(reason); }
+
+        /**
+         * Puts the response back the way a new one starts out, so that it can
+         * be reused for another request. The memory that it has grown is
+         * kept, unless the body grew unusually large.
+         */
+        void reset();
 
-        std::string getReason() { return reason; }
-        void setReason(std::string reason) { this->reason = reason; }
+        /**
+         * Builds the status line and headers, including Content-Length and the
+         * blank line that ends the headers. The body is sent after this.
+         *
+         * @return The response's header block
+         */
+        std::string getHeaderBlock() const;
 
-        std::string toString();
+        /**
+         * Builds the header block in memory drawn from a memory resource.
+         *
+         * @param resource Memory resource, which must outlive the block
+         *
+         * @return The response's header block
+         */
+        std::pmr::string getHeaderBlock(std::pmr::memory_resource* resource) const;
+
+        std::string toString() const;
+
+    public:
+        /**
+         * Gets the standard reason phrase for a status code.
+         *
+         * @param code HTTP status code
+         *
+         * @return The reason phrase, or "Unknown" if the code is not recognized
+         */
+        static std::string getReasonPhrase(int code);
     };
 };
 
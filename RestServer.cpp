@@ -1,40 +1,212 @@
 #include "RestServer.h"
-#include "StringUtils.h"
+#include "EventLoop.h"
+#ifdef CPPRESTLIB_HTTP2
+#include "Http2Session.h"
+#endif
+#ifdef CPPRESTLIB_IO_URING
+#include "IoUringLoop.h"
+#endif
+#include "ObjectPool.h"
+#include "RequestArena.h"
+#include "RequestParser.h"
 
 #include <unistd.h>
 #include <arpa/inet.h>
+#include <errno.h>
+#include <poll.h>
 #include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
 
 using namespace kaoisoft;
 using namespace std;
 using namespace log4cxx;
 
+/* Default number of worker threads in THREAD_POOL mode */
+#define DEFAULT_THREAD_POOL_SIZE 16
+
+/* Default number of clients that may wait for a worker in THREAD_POOL mode */
+#define DEFAULT_THREAD_POOL_QUEUE_DEPTH 256
+
+/* Default number of milliseconds an idle persistent connection is kept open */
+#define DEFAULT_KEEP_ALIVE_TIMEOUT 5000
+
+/* Default number of requests served on a persistent connection */
+#define DEFAULT_MAX_REQUESTS_PER_CONNECTION 100
+
+/* Default largest request body that is accepted (bytes) */
+#define DEFAULT_MAX_BODY_SIZE (1024 * 1024)
+
+/* Default number of milliseconds that a client may take to secure its connection */
+#define DEFAULT_HANDSHAKE_TIMEOUT 10000
+
+/* Default number of milliseconds to wait for the rest of a request */
+#define DEFAULT_READ_TIMEOUT 30000
+
+/* Default number of milliseconds to wait for a client to accept more of a response */
+#define DEFAULT_WRITE_TIMEOUT 30000
+
+/* Default most unsent response data queued for a connection (bytes) */
+#define DEFAULT_MAX_OUTPUT_BUFFER (1024 * 1024)
+
+/* Default most unsent responses to pipelined requests queued for a connection */
+#define DEFAULT_MAX_PIPELINED_REQUESTS 16
+
+/* Most buffers gathered into one write */
+#define MAX_WRITE_BUFFERS 16
+
+/* Default number of connections accepted each time the listen socket is ready */
+#define DEFAULT_ACCEPT_BATCH_SIZE 64
+
+/* Default most streams a client may have open at once on an HTTP/2 connection */
+#define DEFAULT_HTTP2_MAX_CONCURRENT_STREAMS 100
+
+/**
+ * Checks whether a header value contains a token, without regard to case.
+ */
+static bool containsIgnoreCase(string_view value, const char* token)
+{
+    size_t length = strlen(token);
+    for (size_t i = 0; i + length <= value.length(); i++)
+    {
+        if (0 == strncasecmp(value.data() + i, token, length))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Adds a buffer to the ones gathered for a write, if it is not empty.
+ */
+static void addBuffer(struct iovec* iov, int* count, string_view buffer)
+{
+    if (buffer.empty())
+    {
+        return;
+    }
+
+    iov[*count].iov_base = (void*)buffer.data();
+    iov[*count].iov_len = buffer.length();
+    (*count)++;
+}
+
+/**
+ * Takes a response from the pool, or creates one if the pool is empty.
+ */
+static RestResponse* takeResponse()
+{
+    RestResponse* response = ObjectPool<RestResponse>::take();
+    if (nullptr == response)
+    {
+        return new RestResponse;
+    }
+
+    return response;
+}
+
+/**
+ * Appends the statistics of an object pool as a JSON member.
+ */
+static void appendPoolStatistics(string* str, const char* name, const ObjectPoolStatistics& stats)
+{
+    unsigned long long takes = stats.hits + stats.misses;
+
+    str->append("\"");
+    str->append(name);
+    str->append("\":{\"hits\":");
+    str->append(std::to_string(stats.hits));
+    str->append(",\"misses\":");
+    str->append(std::to_string(stats.misses));
+    str->append(",\"discarded\":");
+    str->append(std::to_string(stats.discarded));
+    str->append(",\"hitRatePercent\":");
+    str->append(std::to_string((0 < takes) ? stats.hits * 100 / takes : 0));
+    str->append("}");
+}
+
+/**
+ * Gets the number of cores that are online.
+ */
+static int getCoreCount()
+{
+    int count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    return (0 < count) ? count : 1;
+}
+
 bool RestServer::initialized = false;
 string RestServer::version = "1.0";
 
 RestServer::RestServer()
 {
-    listenSocket = nullptr;
+    listenSocketCount = 1;
     listening = false;
+    routesData = nullptr;
     missingPageText = "<html><body><h1>Page Not Found</h1></body></html>";
     port = -1;
+    serverMode = THREAD_PER_CONNECTION;
+    eventLoopCount = 0;
+    threadPoolSize = DEFAULT_THREAD_POOL_SIZE;
+    threadPoolQueueDepth = DEFAULT_THREAD_POOL_QUEUE_DEPTH;
+    threadPoolFullPolicy = ThreadPool::BLOCK;
+    threadPool = nullptr;
+    pthread_mutex_init(&clientMutex, nullptr);
+    pthread_cond_init(&clientThreadsDone, nullptr);
+    clientThreadCount = 0;
+    keepAliveTimeout = DEFAULT_KEEP_ALIVE_TIMEOUT;
+    maxRequestsPerConnection = DEFAULT_MAX_REQUESTS_PER_CONNECTION;
+    maxBodySize = DEFAULT_MAX_BODY_SIZE;
+    readTimeout = DEFAULT_READ_TIMEOUT;
+    handshakeTimeout = DEFAULT_HANDSHAKE_TIMEOUT;
+    writeTimeout = DEFAULT_WRITE_TIMEOUT;
+    maxOutputBuffer = DEFAULT_MAX_OUTPUT_BUFFER;
+    maxPipelinedRequests = DEFAULT_MAX_PIPELINED_REQUESTS;
+    acceptBatchSize = DEFAULT_ACCEPT_BATCH_SIZE;
+    http2MaxConcurrentStreams = DEFAULT_HTTP2_MAX_CONCURRENT_STREAMS;
 
     // Create the logger
     logger = Logger::getLogger("com.kaoisoft.RestServer");
 
-    // Add the system routes
-    addRoute(RestRequest::Method::GET, "/system/routes",
-             RestServer::getRoutes, this);
-    addRoute(RestRequest::Method::GET, "/system/version",
-             RestServer::getVersion, nullptr);
+    // Requests that no route matches are answered by the default handler
+    // until the server starts, when its response is serialized
+    notFoundData.handler = [this](const RestRequest& request, RestResponse& response)
+                           {
+                               defaultHandler(request, response);
+                           };
 
+    // Add the system routes. The list of routes is also serialized when the
+    // server starts, once all of the routes have been added.
+    addRoute(RestRequest::Method::GET, "/system/routes",
+             [this](const RestRequest& request, RestResponse& response)
+             {
+                 getRoutes(request, response);
+             });
+    routesData = routes[generateRouteKey(RestRequest::Method::GET, "/system/routes")];
+    addRoute(RestRequest::Method::GET, "/system/statistics",
+             [this](const RestRequest& request, RestResponse& response)
+             {
+                 getStatistics(request, response);
+             });
+    RestRequest versionRequest;
+    RestResponse versionResponse;
+    getVersion(versionRequest, versionResponse);
+    addStaticRoute(RestRequest::Method::GET, "/system/version", versionResponse);
 }
 
 RestServer::~RestServer()
 {
-    if (nullptr != listenSocket)
+    // Stop the event loops before the listen socket they use is closed
+    if (listening)
+    {
+        stop();
+    }
+
+    vector<Socket*>::iterator sockIter;
+    for (sockIter = listenSockets.begin(); sockIter != listenSockets.end(); sockIter++)
     {
-        delete listenSocket;
+        delete *sockIter;
     }
 
     // Free the routes' resources
@@ -46,75 +218,236 @@ RestServer::~RestServer()
         delete iter->second;
     }
 
+    pthread_cond_destroy(&clientThreadsDone);
+    pthread_mutex_destroy(&clientMutex);
+
     LOG4CXX_DEBUG(logger, "Server listening on port " << port << " has been stopped");
 }
 
-void RestServer::addRoute(RestRequest::Method method, string path,
-                                ROUTE_HANDLER handler, void* extra)
+void RestServer::addHandlerData(RestRequest::Method method, const string& path,
+                                HandlerData* handlerData)
 {
-    // Create the handler data
-    struct HandlerData* handlerData = new struct HandlerData;
-    handlerData->handler = handler;
-    handlerData->extra = extra;
-
     // Add the route
+    if (!router.addRoute(method, path, handlerData))
+    {
+        // Say why it was refused
+        const string* conflict = router.findParamConflict(method, path);
+        if (nullptr != conflict)
+        {
+            LOG4CXX_ERROR(logger, "Ignoring route " << RestRequest::getMethodString(method) <<
+                          " " << path << ", which conflicts with the existing parameter name {" <<
+                          *conflict << "} at the same place");
+        }
+        else
+        {
+            LOG4CXX_ERROR(logger, "Ignoring malformed route " <<
+                          RestRequest::getMethodString(method) << " " << path);
+        }
+        delete handlerData;
+        return;
+    }
     string key = generateRouteKey(method, path);
+    map<string, HandlerData*>::iterator iter = routes.find(key);
+    if (iter != routes.end())
+    {
+        if (iter->second == routesData)
+        {
+            routesData = nullptr;
+        }
+        delete iter->second;
+    }
     routes[key] = handlerData;
 
     LOG4CXX_DEBUG(logger, "Added route " <<
                   RestRequest::getMethodString(method) << " " << path);
 }
 
-void* RestServer::clientAcceptThread(void* args)
+void RestServer::addRoute(RestRequest::Method method, string path,
+                          REQUEST_HANDLER handler)
+{
+    // Create the handler data
+    struct HandlerData* handlerData = new struct HandlerData;
+    handlerData->handler = std::move(handler);
+
+    addHandlerData(method, path, handlerData);
+}
+
+void RestServer::addRoute(RestRequest::Method method, string path,
+                                ROUTE_HANDLER handler, void* extra)
+{
+    addRoute(method, std::move(path),
+             [handler, extra](const RestRequest& request, RestResponse& response)
+             {
+                 // These handlers predate the const request, but the request
+                 // belongs to the server, which does not mind it being changed
+                 RestResponse* created = handler(const_cast<RestRequest*>(&request), extra);
+                 if (nullptr != created)
+                 {
+                     response = std::move(*created);
+                     delete created;
+                 }
+             });
+}
+
+void RestServer::addStaticRoute(RestRequest::Method method, string path,
+                                const RestResponse& response)
+{
+    // The handler is never called, since the response is always sent instead
+    struct HandlerData* handlerData = new struct HandlerData;
+    handlerData->staticResponse = new StaticResponse(response);
+
+    addHandlerData(method, path, handlerData);
+}
+
+void RestServer::appendStatistics(string* str)
+{
+    // Prevent unused parameter warning
+    (void)str;
+}
+
+Socket* RestServer::acceptClient(Socket* listener)
 {
     struct sockaddr_in sin;
-    socklen_t sin_len;
+    socklen_t sin_len = sizeof(sin);
+
+    // Accept the connection, making it non-blocking at the same time
     int sock;
+    while (-1 == (sock = accept4(listener->getHandle(), (struct sockaddr *) &sin, &sin_len,
+                                 SOCK_NONBLOCK | SOCK_CLOEXEC)) && EINTR == errno)
+    {
+    }
+    if (-1 == sock)
+    {
+        // Another thread may have taken the connection, or the client may
+        // have given up on it
+        if (EWOULDBLOCK != errno && EAGAIN != errno && ECONNABORTED != errno)
+        {
+            LOG4CXX_ERROR(logger, "Failed to accept client connection: " << strerror(errno));
+        }
+        return nullptr;
+    }
 
-    // Get the class instance
-    RestServer* inst = (RestServer*)args;
+    // Create the socket object
+    Socket* socket = createSocketObject(sock);
+    socket->setRemoteAddress(inet_ntoa(sin.sin_addr));
+    socket->setNoDelay();
+    LOG4CXX_DEBUG(logger, "Accepted a connection from a client at " <<
+                  socket->getRemoteAddress());
+
+    return socket;
+}
+
+void* RestServer::clientAcceptThread(void* args)
+{
+    struct pollfd pfd;
+    int accepted = 0;
+
+    // Save the arguments
+    struct ClientAcceptArgs* clientAcceptArgs = (struct ClientAcceptArgs*)args;
+    RestServer* inst = clientAcceptArgs->inst;
+    Socket* listener = clientAcceptArgs->listener;
+    delete clientAcceptArgs;
 
     // Run until told to stop
     while (inst->listening)
     {
-        // Check for a client connection
-        sin_len = sizeof(sin);
-        sock = accept((inst->listenSocket)->getHandle(), (struct sockaddr *) &sin, &sin_len);
-        if (-1 == sock)
+        // Wait for a client to connect. The wait ends when stop() cancels
+        // this thread. A full batch means more clients may be waiting.
+        if (accepted < inst->acceptBatchSize)
         {
-            if (EWOULDBLOCK != errno && EAGAIN != errno)
+            pfd.fd = listener->getHandle();
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            if (-1 == poll(&pfd, 1, -1))
             {
-                LOG4CXX_ERROR(inst->logger, "Failed to accept client connection");
+                if (EINTR != errno)
+                {
+                    LOG4CXX_ERROR(inst->logger, "Could not wait for client connections: " <<
+                                  strerror(errno));
+                    break;
+                }
+                continue;
             }
+        }
 
-            // Pause before checking again
-            if (inst->listening)
+        // Accept the clients that are waiting, up to the batch size
+        for (accepted = 0; accepted < inst->acceptBatchSize && inst->listening; accepted++)
+        {
+            Socket* socket = inst->acceptClient(listener);
+            if (nullptr == socket)
             {
-                sleep(1);
+                break;
             }
-            continue;
+            inst->dispatchClient(socket);
         }
-        if (!(inst->listening))
+    }
+
+    return nullptr;
+}
+
+void RestServer::dispatchClient(Socket* socket)
+{
+    struct ClientHandlerArgs* args = ObjectPool<ClientHandlerArgs>::take();
+    if (nullptr == args)
+    {
+        args = new struct ClientHandlerArgs;
+    }
+    args->inst = this;
+    args->sock = socket;
+
+    if (THREAD_POOL == serverMode)
+    {
+        // Queue the client for a worker thread. Cancellation is held off
+        // so that stop() cannot end this thread while it waits for room
+        // in the queue.
+        int cancelState;
+        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancelState);
+        bool queued = threadPool->submit(RestServer::clientHandlerThread, (void*)args);
+        pthread_setcancelstate(cancelState, nullptr);
+        if (!queued)
         {
-            break;
+            if (ThreadPool::REJECT == threadPool->getFullPolicy())
+            {
+                LOG4CXX_WARN(logger, "All workers are busy, rejecting client at " <<
+                             socket->getRemoteAddress());
+                rejectClient(socket);
+            }
+            else
+            {
+                LOG4CXX_WARN(logger, "All workers are busy, dropping client at " <<
+                             socket->getRemoteAddress());
+            }
+            socket->recycle();
+            ObjectPool<ClientHandlerArgs>::release(args);
         }
+        return;
+    }
 
-        // Create the socket object
-        Socket* socket = inst->createSocketObject(sock);
-        socket->setRemoteAddress(inet_ntoa(sin.sin_addr));
-        LOG4CXX_DEBUG(inst->logger, "Accepted a connection from a client at " <<
+    // Start a thread to manage this client. It is counted before it starts,
+    // so that stop() waits for it even if it has not run yet, and
+    // cancellation is held off so that the count stays right.
+    int cancelState;
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancelState);
+    pthread_mutex_lock(&clientMutex);
+    clientThreadCount++;
+    pthread_mutex_unlock(&clientMutex);
+    pthread_t threadId;
+    if (0 != pthread_create(&threadId, nullptr, RestServer::clientHandlerThread,
+                            (void*)args))
+    {
+        LOG4CXX_ERROR(logger, "Could not start a thread for client at " <<
                       socket->getRemoteAddress());
-
-        // Start a thread to manage this client
-        struct ClientHandlerArgs* args = new struct ClientHandlerArgs;
-        args->inst = inst;
-        args->sock = socket;
-        pthread_t threadId;
-        pthread_create(&threadId, nullptr, RestServer::clientHandlerThread,
-                       (void*)args);
+        socket->recycle();
+        ObjectPool<ClientHandlerArgs>::release(args);
+        pthread_mutex_lock(&clientMutex);
+        clientThreadCount--;
+        pthread_mutex_unlock(&clientMutex);
     }
-
-    return nullptr;
+    else
+    {
+        pthread_detach(threadId);
+    }
+    pthread_setcancelstate(cancelState, nullptr);
 }
 
 void* RestServer::clientHandlerThread(void *args)
@@ -123,9 +456,37 @@ void* RestServer::clientHandlerThread(void *args)
     struct ClientHandlerArgs* clientHandlerArgs = (struct ClientHandlerArgs*)args;
     RestServer* inst = clientHandlerArgs->inst;
     Socket* socket = clientHandlerArgs->sock;
-    delete clientHandlerArgs;
+    ObjectPool<ClientHandlerArgs>::release(clientHandlerArgs);
 
-    inst->manageClient(socket);
+    // Serve the client unless the server is stopping. While it is served,
+    // stop() can hang up on it.
+    pthread_mutex_lock(&inst->clientMutex);
+    bool serve = inst->listening;
+    if (serve)
+    {
+        inst->clientSockets.insert(socket);
+    }
+    pthread_mutex_unlock(&inst->clientMutex);
+    if (serve)
+    {
+        inst->manageClient(socket);
+    }
+
+    // Close the connection
+    pthread_mutex_lock(&inst->clientMutex);
+    inst->clientSockets.erase(socket);
+    pthread_mutex_unlock(&inst->clientMutex);
+    socket->recycle();
+
+    // Let stop() know that the thread no longer uses the server. In
+    // THREAD_POOL mode, stop() waits for the workers instead.
+    if (THREAD_PER_CONNECTION == inst->serverMode)
+    {
+        pthread_mutex_lock(&inst->clientMutex);
+        inst->clientThreadCount--;
+        pthread_cond_broadcast(&inst->clientThreadsDone);
+        pthread_mutex_unlock(&inst->clientMutex);
+    }
 
     return nullptr;
 }
@@ -133,127 +494,316 @@ void* RestServer::clientHandlerThread(void *args)
 bool RestServer::createListenSocket(int port)
 {
     struct sockaddr_in sin;
-    int val;
+    int val = 1;
 
-    /* Create a socket */
-    int sock;
-    if ((sock = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
-        LOG4CXX_ERROR(logger, "Cannot create a socket");
-        return false;
-    }
-    listenSocket = new Socket(sock);
+    // Share the port between several sockets if asked to
+    int count = (0 < listenSocketCount) ? listenSocketCount : getCoreCount();
 
-    /* We don't want bind() to fail with EBUSY */
-    if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &val, sizeof(val)) < 0) {
-        LOG4CXX_ERROR(logger, "Could not set SO_REUSEADDR on the socket");
-        return false;
+    for (int i = 0; i < count; i++)
+    {
+        /* Create a socket */
+        int sock;
+        if ((sock = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0) {
+            LOG4CXX_ERROR(logger, "Cannot create a socket");
+            return false;
+        }
+        Socket* listenSocket = new Socket(sock);
+        listenSockets.push_back(listenSocket);
+
+        /* We don't want bind() to fail with EBUSY */
+        if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &val, sizeof(val)) < 0) {
+            LOG4CXX_ERROR(logger, "Could not set SO_REUSEADDR on the socket");
+            return false;
+        }
+
+        /* Let the kernel balance connections across the sockets */
+        if (1 < count && setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &val, sizeof(val)) < 0) {
+            LOG4CXX_ERROR(logger, "Could not set SO_REUSEPORT on the socket");
+            return false;
+        }
+
+        /* Fill up the server's socket structure */
+        memset(&sin, 0, sizeof(sin));
+        sin.sin_family = AF_INET;
+        sin.sin_addr.s_addr = INADDR_ANY;
+        sin.sin_port = htons(port);
+
+        /* Bind the socket to the specified port number */
+        if (bind(listenSocket->getHandle(), (struct sockaddr *) &sin, sizeof(sin)) < 0) {
+            LOG4CXX_ERROR(logger, "Could not bind the socket");
+            return false;
+        }
+
+        /* Specify that this is a listener socket */
+        if (listen(listenSocket->getHandle(), SOMAXCONN) < 0) {
+            LOG4CXX_ERROR(logger, "Failed to listen on this socket");
+            return false;
+        }
     }
 
-    // Set the socket to non-blocking
-    listenSocket->setNonBlocking();
+    LOG4CXX_DEBUG(logger, "Opened " << count << " listen sockets on port " << port);
 
-    /* Fill up the server's socket structure */
-    memset(&sin, 0, sizeof(sin));
-    sin.sin_family = AF_INET;
-    sin.sin_addr.s_addr = INADDR_ANY;
-    sin.sin_port = htons(port);
+    return true;
+}
 
-    /* Bind the socket to the specified port number */
-    if (bind(listenSocket->getHandle(), (struct sockaddr *) &sin, sizeof(sin)) < 0) {
-        LOG4CXX_ERROR(logger, "Could not bind the socket");
-        return false;
+Socket* RestServer::createSocketObject(int sock)
+{
+    return Socket::create(sock);
+}
+
+void RestServer::getSocketPoolStatistics(ObjectPoolStatistics* stats)
+{
+    ObjectPool<Socket>::getStatistics(stats);
+}
+
+bool RestServer::decideKeepAlive(RestRequest* request, string_view connection,
+                                 int requestCount)
+{
+    // HTTP/1.1 connections are persistent unless the client says otherwise,
+    // while HTTP/1.0 clients have to ask for it.
+    string_view requested = request->getHeaderView(HeaderNames::CONNECTION);
+    bool keepAlive;
+    if (containsIgnoreCase(requested, "close"))
+    {
+        keepAlive = false;
+    }
+    else if (containsIgnoreCase(requested, "keep-alive"))
+    {
+        keepAlive = true;
+    }
+    else
+    {
+        keepAlive = (0 == request->getProtocolView().compare("HTTP/1.1"));
     }
 
-    /* Specify that this is a listener socket */
-    if (listen(listenSocket->getHandle(), SOMAXCONN) < 0) {
-        LOG4CXX_ERROR(logger, "Failed to listen on this socket");
+    // The handler may also ask for the connection to be closed
+    if (containsIgnoreCase(connection, "close"))
+    {
+        keepAlive = false;
+    }
+
+    // Enforce the server's limits
+    if (!listening ||
+        (0 < maxRequestsPerConnection && requestCount >= maxRequestsPerConnection))
+    {
+        keepAlive = false;
+    }
+
+    return keepAlive;
+}
+
+bool RestServer::isPipelineFull(size_t count, size_t bytes)
+{
+    // A connection with nothing queued may always be served, even if a cap is 0
+    if (0 == count)
+    {
         return false;
     }
 
-    return true;
+    return (0 < maxPipelinedRequests && (size_t)maxPipelinedRequests <= count) ||
+           maxOutputBuffer <= bytes;
 }
 
-Socket* RestServer::createSocketObject(int sock)
+bool RestServer::keepConnectionAlive(RestRequest* request, RestResponse* response,
+                                     int requestCount)
+{
+    bool keepAlive = decideKeepAlive(request, response->getHeaderView(HeaderNames::CONNECTION),
+                                     requestCount);
+    response->addHeader("Connection", keepAlive ? "keep-alive" : "close");
+
+    return keepAlive;
+}
+
+bool RestServer::keepConnectionAlive(RestRequest* request, const StaticResponse* response,
+                                     int requestCount)
 {
-    return new Socket(sock);
+    return decideKeepAlive(request, response->getConnectionView(), requestCount);
 }
 
 void RestServer::manageClient(Socket* sock)
 {
-    // Set the client socket to non-blocking
-    sock->setNonBlocking();
+    // Prepare the connection for use
+    if (!prepareClient(sock))
+    {
+        return;
+    }
+
+#ifdef CPPRESTLIB_HTTP2
+    // The client may have chosen HTTP/2 while securing the connection
+    if (HTTP2_ALPN_ID == sock->getApplicationProtocol())
+    {
+        Http2Session session(this, sock);
+        session.serve();
+        return;
+    }
+#endif
+
+    // The same request is used for every request on the connection, and
+    // anything that it stores or that is built for a response comes from the
+    // arena. Responses are queued until they are written together.
+    RequestArena arena;
+    RestRequest request(&arena);
+    vector<EventLoopOutput> pipeline;
+    size_t pipelineBytes = 0;
+    int requestCount = 0;
+    bool keepAlive = true;
+    while (keepAlive)
+    {
+        // Serve the next pipelined request straight from the input buffer,
+        // unless the queued responses have reached the caps
+        int errorCode = 0;
+        size_t consumed;
+        bool parsed = false;
+        if (!pipeline.empty() && !isPipelineFull(pipeline.size(), pipelineBytes))
+        {
+            request.reset();
+            parsed = (RequestParser::COMPLETE ==
+                      RequestParser::parse(sock->getBufferedData(), sock->getBufferedLength(),
+                                           maxBodySize, &request, &consumed, &errorCode));
+        }
+        if (parsed)
+        {
+            sock->consume(consumed);
+        }
+        else
+        {
+            // Write the queued responses before waiting for the client.
+            // Nothing drawn from the arena is needed after that.
+            if (!sendPipeline(sock, &pipeline))
+            {
+                break;
+            }
+            pipelineBytes = 0;
+            request.reset();
+            arena.reset();
+
+            // Read the next request
+            if (!readRequest(sock, &request, &errorCode))
+            {
+                if (0 != errorCode)
+                {
+                    // Tell the client what was wrong with the request
+                    RestResponse* response = takeResponse();
+                    fillErrorResponse(errorCode, response);
+                    response->addHeader("Connection", "close");
+                    pipeline.push_back({nullptr, response->getHeaderBlock(&arena), response});
+                }
+                break;
+            }
+        }
+        requestCount++;
+        LOG4CXX_TRACE(logger, "Received request " << request.toString() <<
+                      " from client at " << sock->getRemoteAddress());
+
+        // Route the request to the appropriate handler, unless its response
+        // has already been serialized
+        HandlerData* handlerData = findRoute(&request);
+        const StaticResponse* staticResponse = handlerData->staticResponse;
+        if (nullptr != staticResponse)
+        {
+            keepAlive = keepConnectionAlive(&request, staticResponse, requestCount);
+            pipeline.push_back({staticResponse, staticResponse->getClosingBlock(keepAlive, &arena),
+                                nullptr});
+        }
+        else
+        {
+            RestResponse* response = takeResponse();
+            (handlerData->handler)(request, *response);
+            keepAlive = keepConnectionAlive(&request, response, requestCount);
+            pipeline.push_back({nullptr, response->getHeaderBlock(&arena), response});
+        }
+        pipelineBytes += pipeline.back().getLength();
+    }
+
+    // Write whatever is left before the connection is closed
+    sendPipeline(sock, &pipeline);
+}
+
+bool RestServer::prepareClient(Socket* sock)
+{
+    // Plain connections have no handshake
+    return verifyClient(sock);
+}
 
-    // Read the request
-    RestRequest* request = readRequest(sock);
-    LOG4CXX_TRACE(logger, "Received request " << request->toString() <<
-                  " from client at " << sock->getRemoteAddress());
+void RestServer::fillErrorResponse(int code, RestResponse* response)
+{
+    string reason = RestResponse::getReasonPhrase(code);
 
-    // Route the request to the appropriate handler
-    RestResponse* response = routeRequest(request);
-    string responseStr = response->toString();
+    response->setCode(code);
+    response->setBody("<html><body><h1>" + reason + "</h1></body></html>");
+    response->setReason(std::move(reason));
+    response->addHeader("Content-Type", "text/html");
+}
 
-    // Write the response
-    sock->write(responseStr.c_str(), responseStr.length());
-    LOG4CXX_TRACE(logger, "Sent response " << responseStr <<
-                  " to client at " << sock->getRemoteAddress());
+void RestServer::rejectClient(Socket* sock)
+{
+    RestResponse response;
+    fillErrorResponse(503, &response);
+    response.addHeader("Retry-After", "1");
+    response.addHeader("Connection", "close");
 
-    // Clean up
-    delete request;
-    delete response;
+    sendResponse(sock, &response, std::pmr::get_default_resource());
 }
 
-RestResponse* RestServer::defaultHandler(RestRequest* request, void* extra)
+void RestServer::defaultHandler(const RestRequest& request, RestResponse& response)
 {
     // Prevent unused parameter warning
     (void)request;
 
-    // Get the server instance
-    RestServer* inst = (RestServer*)extra;
-
     // Send the response
-    RestResponse* response = new RestResponse;
-    response->setCode(404);
-    response->setReason("Not Found");
-    map<string, string> headers;
-    headers["Content-Type"] = "text/html";
-    response->setHeaders(headers);
-    response->setBody(inst->missingPageText);
-
-    return response;
+    response.setCode(404);
+    response.setReason("Not Found");
+    response.addHeader("Content-Type", "text/html");
+    response.setBody(missingPageText);
 }
 
 string RestServer::generateRouteKey(RestRequest::Method method, string path)
 {
+    // A trailing {*} is the same route as a trailing *
+    if (path.length() >= 3 && 0 == path.compare(path.length() - 3, 3, "{*}"))
+    {
+        path.replace(path.length() - 3, 3, "*");
+    }
+
     return RestRequest::getMethodString(method) + ":" + path;
 }
 
+vector<Socket*> RestServer::getLoopListenSockets(int index, int count)
+{
+    vector<Socket*> loopSockets;
+    int socketCount = (int)listenSockets.size();
+    for (int i = index % socketCount; i < socketCount; i += count)
+    {
+        loopSockets.push_back(listenSockets[i]);
+    }
+
+    return loopSockets;
+}
+
 void RestServer::getRouteKeyComponents(string key, string& method,
                                              string& path)
 {
-    // Split the key on the colon
-    shared_ptr<vector<string>> parts = StringUtils::split(key, ":");
+    // Split the key on the first colon, since the path may contain colons
+    size_t colon = key.find(':');
 
     // Save the components
-    method = parts->at(0);
-    path = parts->at(1);
+    method = key.substr(0, colon);
+    path = key.substr(colon + 1);
 }
 
-RestResponse* RestServer::getRoutes(RestRequest* request, void* extra)
+void RestServer::getRoutes(const RestRequest& request, RestResponse& response)
 {
     // Prevent unused parameter warning
     (void)request;
 
-    // Get the server instance
-    RestServer* inst = (RestServer*)extra;
-
     // Build the list of routes
     string str("{\"routes\":[");
     string method, path;
     map<string, HandlerData*>::iterator iter;
-    for (iter = (inst->routes).begin(); iter != (inst->routes).end(); iter++)
+    for (iter = routes.begin(); iter != routes.end(); iter++)
     {
         // Add a comma after the previous route
-        if (iter != (inst->routes).begin())
+        if (iter != routes.begin())
         {
             str.append(",");
         }
@@ -268,143 +818,264 @@ RestResponse* RestServer::getRoutes(RestRequest* request, void* extra)
         str.append(path);
         str.append("\"}");
     }
-    str.append("]");
+    str.append("]}");
 
     // Send the response
-    RestResponse* response = new RestResponse;
-    response->setCode(200);
-    response->setReason("OK");
-    map<string, string> headers;
-    headers["Content-Type"] = "application/json";
-    response->setHeaders(headers);
-    response->setBody(str);
+    response.setCode(200);
+    response.setReason("OK");
+    response.addHeader("Content-Type", "application/json");
+    response.setBody(std::move(str));
+}
 
-    return response;
+void RestServer::getStatistics(const RestRequest& request, RestResponse& response)
+{
+    // Prevent unused parameter warning
+    (void)request;
+
+    // Build the statistics
+    string str("{\"port\":");
+    str.append(std::to_string(port));
+    str.append(",\"listenSockets\":");
+    str.append(std::to_string(listenSockets.size()));
+    ThreadPoolStatistics poolStats;
+    if (getThreadPoolStatistics(&poolStats))
+    {
+        str.append(",\"threadPool\":{\"size\":");
+        str.append(std::to_string(poolStats.size));
+        str.append(",\"queueCapacity\":");
+        str.append(std::to_string(poolStats.queueCapacity));
+        str.append(",\"queueDepth\":");
+        str.append(std::to_string(poolStats.queueDepth));
+        str.append(",\"maxQueueDepth\":");
+        str.append(std::to_string(poolStats.maxQueueDepth));
+        str.append(",\"submitted\":");
+        str.append(std::to_string(poolStats.submitted));
+        str.append(",\"completed\":");
+        str.append(std::to_string(poolStats.completed));
+        str.append(",\"rejected\":");
+        str.append(std::to_string(poolStats.rejected));
+        str.append(",\"averageQueueWaitMicros\":");
+        str.append(std::to_string(poolStats.averageWaitMicros));
+        str.append(",\"maxQueueWaitMicros\":");
+        str.append(std::to_string(poolStats.maxWaitMicros));
+        str.append("}");
+    }
+
+    // Add how often the per-connection and per-request objects are reused
+    ObjectPoolStatistics objectStats;
+    str.append(",\"objectPools\":{");
+    getSocketPoolStatistics(&objectStats);
+    appendPoolStatistics(&str, "sockets", objectStats);
+    ObjectPool<ClientHandlerArgs>::getStatistics(&objectStats);
+    str.append(",");
+    appendPoolStatistics(&str, "clientHandlerArgs", objectStats);
+    ObjectPool<EventLoopConnection>::getStatistics(&objectStats);
+    str.append(",");
+    appendPoolStatistics(&str, "eventLoopConnections", objectStats);
+#ifdef CPPRESTLIB_HTTP2
+    ObjectPool<Http2Stream>::getStatistics(&objectStats);
+    str.append(",");
+    appendPoolStatistics(&str, "http2Streams", objectStats);
+#endif
+#ifdef CPPRESTLIB_IO_URING
+    ObjectPool<IoUringConnection>::getStatistics(&objectStats);
+    str.append(",");
+    appendPoolStatistics(&str, "ioUringConnections", objectStats);
+#endif
+    ObjectPool<RestResponse>::getStatistics(&objectStats);
+    str.append(",");
+    appendPoolStatistics(&str, "responses", objectStats);
+    str.append("}");
+    appendStatistics(&str);
+    str.append("}");
+
+    // Send the response
+    response.setCode(200);
+    response.setReason("OK");
+    response.addHeader("Content-Type", "application/json");
+    response.setBody(std::move(str));
+}
+
+bool RestServer::getThreadPoolStatistics(ThreadPoolStatistics* stats)
+{
+    if (nullptr == threadPool)
+    {
+        return false;
+    }
+
+    threadPool->getStatistics(stats);
+
+    return true;
 }
 
-RestResponse* RestServer::getVersion(RestRequest* request, void* extra)
+void RestServer::getVersion(const RestRequest& request, RestResponse& response)
 {
     // Prevent unused parameter warning
     (void)request;
-    (void)extra;
 
     string body = "{\"version\":\"";
     body.append(version);
     body.append("\"}");
 
     // Send the response
-    RestResponse* response = new RestResponse;
-    response->setCode(200);
-    response->setReason("OK");
-    map<string, string> headers;
-    headers["Content-Type"] = "application/json";
-    response->setHeaders(headers);
-    response->setBody(body);
-
-    return response;
+    response.setCode(200);
+    response.setReason("OK");
+    response.addHeader("Content-Type", "application/json");
+    response.setBody(std::move(body));
 }
 
-string RestServer::readBody(Socket* socket)
+bool RestServer::verifyClient(Socket* sock)
 {
-    string str;
-
-    // Read one character at a time until there is no more data to read.
-    char ch;
-    int ret;
-    while (1 == (ret = socket->read(&ch, 1)))
-    {
-        str.append(1, ch);
-    }
+    // Prevent unused parameter warning
+    (void)sock;
 
-    return str;
+    // Plain connections are not checked
+    return true;
 }
 
-string RestServer::readLine(Socket* socket)
+bool RestServer::readRequest(Socket* socket, RestRequest* request, int* errorCode)
 {
-    string str;
+    bool continueSent = false;
+    size_t consumed;
 
-    // Read one character at a time until a linefeed is encountered or until
-    // there is no more data to read.
-    char ch, prev = ' ';
-    int ret;
-    while (1 == (ret = socket->read(&ch, 1)))
+    *errorCode = 0;
+    request->reset();
+    while (true)
     {
-        if ('\n' == ch)
+        // Try to parse a whole request out of the data received so far
+        RequestParser::Status status = RequestParser::parse(socket->getBufferedData(),
+                                                            socket->getBufferedLength(),
+                                                            maxBodySize, request,
+                                                            &consumed, errorCode);
+        if (RequestParser::COMPLETE == status)
         {
-            if ('\r' == prev)
+            socket->consume(consumed);
+            return true;
+        }
+        if (RequestParser::INVALID == status)
+        {
+            LOG4CXX_DEBUG(logger, "Invalid request from client at " <<
+                          socket->getRemoteAddress() << ", responding with " << *errorCode);
+            return false;
+        }
+        if (RequestParser::EXPECT_CONTINUE == status && !continueSent)
+        {
+            // The client is waiting for permission to send the body
+            static const char continueStr[] = "HTTP/1.1 100 Continue\r\n\r\n";
+            struct iovec iov;
+            iov.iov_base = (void*)continueStr;
+            iov.iov_len = sizeof(continueStr) - 1;
+            if (!socket->writeAll(&iov, 1, writeTimeout))
             {
-                // Remove the CR from the end of the string
-                str = str.substr(0, str.length() - 1);
+                return false;
             }
+            continueSent = true;
+        }
+
+        // Receive more data, waiting for it if necessary
+        int ret = socket->fillBuffer();
+        if (0 == ret)
+        {
+            int timeout = (0 == socket->getBufferedLength()) ? keepAliveTimeout : readTimeout;
+            if (!socket->waitReadable(timeout))
+            {
+                LOG4CXX_DEBUG(logger, "Timed out waiting for a request from client at " <<
+                              socket->getRemoteAddress());
+                break;
+            }
+            ret = socket->fillBuffer();
+        }
+        if (0 > ret)
+        {
+            // The client closed the connection
             break;
         }
-        str.append(1, ch);
-        prev = ch;
     }
 
-    return str;
+    return false;
 }
 
-RestRequest* RestServer::readRequest(Socket* socket)
+HandlerData* RestServer::findRoute(RestRequest* request)
 {
-    RestRequest* request = new RestRequest;
-    request->setMethod(RestRequest::Method::INVALID);
+    HandlerData* handlerData = router.findRoute(request->getMethod(), request->getPathView(),
+                                                request);
 
-    // Read the request line
-    string line = readLine(socket);
-    shared_ptr<vector<string>> parts = StringUtils::split(line, " ");
-    if (3 != parts->size())
+    return (nullptr != handlerData) ? handlerData : &notFoundData;
+}
+
+bool RestServer::sendPipeline(Socket* sock, vector<EventLoopOutput>* pipeline)
+{
+    // Write the headers and bodies in order, gathering as many of them into
+    // each call as fit, without copying the bodies
+    bool sent = true;
+    vector<EventLoopOutput>::iterator iter = pipeline->begin();
+    while (sent && iter != pipeline->end())
     {
-        printf("Request line '%s' is invalid\n", line.c_str());
-        return request;
+        struct iovec iov[MAX_WRITE_BUFFERS];
+        int count = 0;
+        for (; iter != pipeline->end() && MAX_WRITE_BUFFERS - 3 >= count; iter++)
+        {
+            if (nullptr != iter->staticResponse)
+            {
+                addBuffer(iov, &count, iter->staticResponse->getHead());
+            }
+            addBuffer(iov, &count, iter->header);
+            if (nullptr != iter->staticResponse)
+            {
+                addBuffer(iov, &count, iter->staticResponse->getBody());
+            }
+            if (nullptr != iter->response)
+            {
+                addBuffer(iov, &count, iter->response->getBody());
+            }
+            LOG4CXX_TRACE(logger, "Sending response " <<
+                          ((nullptr != iter->staticResponse) ? iter->staticResponse->getHead() : "") <<
+                          iter->header << " to client at " << sock->getRemoteAddress());
+        }
+        if (!sock->writeAll(iov, count, writeTimeout))
+        {
+            LOG4CXX_DEBUG(logger, "Could not send response to client at " <<
+                          sock->getRemoteAddress());
+            sent = false;
+        }
     }
-    request->setMethod(parts->at(0));
-    request->setPath(parts->at(1));
-    request->setProtocol(parts->at(2));
 
-    // Read the headers
-    line = readLine(socket);
-    while (0 < line.length())
+    // Keep the responses for later requests
+    for (iter = pipeline->begin(); iter != pipeline->end(); iter++)
     {
-        parts = StringUtils::split(line, ":");
-        request->addHeader(StringUtils::trim(parts->at(0)),
-                           StringUtils::trim(parts->at(1)));
-        line = readLine(socket);
+        if (nullptr != iter->response)
+        {
+            iter->response->reset();
+            ObjectPool<RestResponse>::release(iter->response);
+        }
     }
+    pipeline->clear();
 
-    // Read the body
-    request->setBody(readBody(socket));
-
-    return request;
+    return sent;
 }
 
-RestResponse* RestServer::routeRequest(RestRequest* request)
+bool RestServer::sendResponse(Socket* sock, RestResponse* response,
+                              std::pmr::memory_resource* resource)
 {
-    // Generate the key for the route
-    string routeKey = generateRouteKey(request->getMethod(), request->getPath());
-
-    // Route the request to the associated handler
-    HandlerData* handlerData = nullptr;
-    map<string, HandlerData*>::iterator iter;
-    for (iter = routes.begin(); iter != routes.end(); iter++)
-    {
-        if (0 == (iter->first).compare(routeKey))
-        {
-            handlerData = iter->second;
-            break;
-        }
-    }
-    if (nullptr == handlerData)
+    std::pmr::string headerBlock = response->getHeaderBlock(resource);
+    const string& body = response->getBody();
+
+    // Write the headers and the body together, without copying the body
+    struct iovec iov[2];
+    iov[0].iov_base = (void*)headerBlock.data();
+    iov[0].iov_len = headerBlock.length();
+    iov[1].iov_base = (void*)body.data();
+    iov[1].iov_len = body.length();
+    if (!sock->writeAll(iov, 2, writeTimeout))
     {
-        handlerData = new HandlerData;
-        handlerData->handler = RestServer::defaultHandler;
-        handlerData->extra = this;
+        LOG4CXX_DEBUG(logger, "Could not send response to client at " <<
+                      sock->getRemoteAddress());
+        return false;
     }
+    LOG4CXX_TRACE(logger, "Sent response " << headerBlock <<
+                  " to client at " << sock->getRemoteAddress());
 
-    // Call the handler
-    RestResponse* response = (handlerData->handler)(request, handlerData->extra);
-
-    return response;
+    return true;
 }
 
 bool RestServer::setUp(string port_str)
@@ -424,18 +1095,191 @@ bool RestServer::setUp(string port_str)
 
 void RestServer::start()
 {
+    if (listenSockets.empty())
+    {
+        LOG4CXX_ERROR(logger, "Cannot start the server before setUp() succeeds");
+        return;
+    }
+
+    // The routes are all known by now
+    updateStaticResponses();
+
     // Set the listening flag
     listening = true;
 
-    // Start the thread that will accept client connections
-    pthread_create(&threadId, nullptr, RestServer::clientAcceptThread,
-                   (void*)this);
+    if (IO_URING == serverMode)
+    {
+#ifdef CPPRESTLIB_IO_URING
+        if (!isSecure() && IoUringLoop::isSupported())
+        {
+            // Start the io_uring loops, which accept and manage the client
+            // connections
+            int count = (0 < eventLoopCount) ? eventLoopCount : getCoreCount();
+            for (int i = 0; i < count; i++)
+            {
+                IoUringLoop* ioUringLoop = new IoUringLoop(this, getLoopListenSockets(i, count));
+                if (!ioUringLoop->start())
+                {
+                    LOG4CXX_ERROR(logger, "Failed to start io_uring loop " << i);
+                    delete ioUringLoop;
+                    continue;
+                }
+                ioUringLoops.push_back(ioUringLoop);
+            }
+            LOG4CXX_DEBUG(logger, "Started " << ioUringLoops.size() <<
+                          " io_uring loops for port " << port);
+            return;
+        }
+        LOG4CXX_WARN(logger, "io_uring cannot be used for port " << port <<
+                     ", using event loops instead");
+#else
+        LOG4CXX_WARN(logger, "The library was built without io_uring support, using event loops instead");
+#endif
+        serverMode = EVENT_LOOP;
+    }
+
+    if (EVENT_LOOP == serverMode)
+    {
+        // Start the event loops, which accept and manage the client connections
+        int count = (0 < eventLoopCount) ? eventLoopCount : getCoreCount();
+        for (int i = 0; i < count; i++)
+        {
+            EventLoop* eventLoop = new EventLoop(this, getLoopListenSockets(i, count));
+            if (!eventLoop->start())
+            {
+                LOG4CXX_ERROR(logger, "Failed to start event loop " << i);
+                delete eventLoop;
+                continue;
+            }
+            eventLoops.push_back(eventLoop);
+        }
+        LOG4CXX_DEBUG(logger, "Started " << eventLoops.size() <<
+                      " event loops for port " << port);
+        return;
+    }
+
+    if (THREAD_POOL == serverMode)
+    {
+        // Start the workers that will manage the client connections
+        threadPool = new ThreadPool(threadPoolSize, threadPoolQueueDepth,
+                                    threadPoolFullPolicy);
+        if (!threadPool->start())
+        {
+            LOG4CXX_ERROR(logger, "Failed to start the worker threads");
+            delete threadPool;
+            threadPool = nullptr;
+            listening = false;
+            return;
+        }
+    }
+
+    // Start a thread to accept client connections on each listen socket
+    vector<Socket*>::iterator iter;
+    for (iter = listenSockets.begin(); iter != listenSockets.end(); iter++)
+    {
+        struct ClientAcceptArgs* args = new struct ClientAcceptArgs;
+        args->inst = this;
+        args->listener = *iter;
+
+        pthread_t threadId;
+        if (0 != pthread_create(&threadId, nullptr, RestServer::clientAcceptThread,
+                                (void*)args))
+        {
+            LOG4CXX_ERROR(logger, "Could not start a thread to accept client connections");
+            delete args;
+            continue;
+        }
+        acceptThreads.push_back(threadId);
+    }
 }
 
 void RestServer::stop()
 {
+    // Hang up on the clients that threads or workers are serving, which
+    // would otherwise keep using the server for as long as they keep their
+    // connections open. Clients that have not been served yet are closed
+    // without being served.
+    pthread_mutex_lock(&clientMutex);
     listening = false;
+    set<Socket*>::iterator clientIter;
+    for (clientIter = clientSockets.begin(); clientIter != clientSockets.end(); clientIter++)
+    {
+        shutdown((*clientIter)->getHandle(), SHUT_RDWR);
+    }
+    pthread_mutex_unlock(&clientMutex);
+
+#ifdef CPPRESTLIB_IO_URING
+    if (IO_URING == serverMode)
+    {
+        // Stop the io_uring loops, which also closes their client connections
+        vector<IoUringLoop*>::iterator iter;
+        for (iter = ioUringLoops.begin(); iter != ioUringLoops.end(); iter++)
+        {
+            (*iter)->stop();
+            delete *iter;
+        }
+        ioUringLoops.clear();
+        return;
+    }
+#endif
 
-    // Kill the thread
-    pthread_cancel(threadId);
+    if (EVENT_LOOP == serverMode)
+    {
+        // Stop the event loops, which also closes their client connections
+        vector<EventLoop*>::iterator iter;
+        for (iter = eventLoops.begin(); iter != eventLoops.end(); iter++)
+        {
+            (*iter)->stop();
+            delete *iter;
+        }
+        eventLoops.clear();
+        return;
+    }
+
+    // Let the workers finish the clients that are already queued. This also
+    // releases the accepting thread if it is waiting for room in the queue.
+    if (nullptr != threadPool)
+    {
+        threadPool->stop();
+    }
+
+    // Kill the accepting threads
+    vector<pthread_t>::iterator iter;
+    for (iter = acceptThreads.begin(); iter != acceptThreads.end(); iter++)
+    {
+        pthread_cancel(*iter);
+        pthread_join(*iter, nullptr);
+    }
+    acceptThreads.clear();
+
+    // Wait for the connection threads, which no longer get new clients
+    pthread_mutex_lock(&clientMutex);
+    while (0 < clientThreadCount)
+    {
+        pthread_cond_wait(&clientThreadsDone, &clientMutex);
+    }
+    pthread_mutex_unlock(&clientMutex);
+
+    if (nullptr != threadPool)
+    {
+        delete threadPool;
+        threadPool = nullptr;
+    }
+}
+
+void RestServer::updateStaticResponses()
+{
+    RestRequest request;
+    RestResponse response;
+    defaultHandler(request, response);
+    delete notFoundData.staticResponse;
+    notFoundData.staticResponse = new StaticResponse(response);
+
+    if (nullptr != routesData)
+    {
+        response.reset();
+        getRoutes(request, response);
+        delete routesData->staticResponse;
+        routesData->staticResponse = new StaticResponse(response);
+    }
 }
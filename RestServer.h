@@ -1,34 +1,38 @@
 #ifndef RESTSERVER_H
 #define RESTSERVER_H
 
+#include "ObjectPool.h"
 #include "RestRequest.h"
 #include "RestResponse.h"
+#include "Router.h"
 #include "Socket.h"
+#include "ThreadPool.h"
 
 #include <log4cxx/logger.h>
 
+#include <pthread.h>
+
+#include <memory_resource>
+#include <set>
+#include <vector>
+
 namespace kaoisoft
 {
-    /**
-     * Request handler
-     *
-     * Parameters:
-     *   RestRequest* - client's request
-     *   void* - extra data passed to the handler, this is set in the addRoute() method
-     */
-    typedef RestResponse*(*ROUTE_HANDLER)(RestRequest*, void*);
+    /** Forward references */
+    class EventLoop;
+    class IoUringLoop;
+    class RestServer;
+    struct EventLoopOutput;
 
     /**
-     * Data associated with a request handler
+     * Arguments passed to the client accept threads.
      */
-    struct HandlerData {
-        ROUTE_HANDLER handler;      // Handler function pointer
-        void* extra;                // Extra data passed to the handler
+    struct ClientAcceptArgs
+    {
+        RestServer* inst;       // Pointer the class instance
+        Socket* listener;       // Listen socket that the thread accepts clients from
     };
 
-    /** Forward reference */
-    class RestServer;
-
     /**
      * Arguments passed to the client handler threads.
      */
@@ -43,13 +47,59 @@ namespace kaoisoft
      */
     class RestServer
     {
+        friend class EventLoop;
+        friend class Http2Session;
+        friend class IoUringLoop;
+
+    public:
+        /**
+         * How client connections are serviced.
+         *
+         *   THREAD_PER_CONNECTION - a new thread is started for every client
+         *   EVENT_LOOP - epoll-based event loops (one per core by default)
+         *                multiplex all of the client connections
+         *   THREAD_POOL - clients are queued to a fixed-size pool of worker
+         *                 threads
+         *   IO_URING - like EVENT_LOOP, but the loops accept, receive and send
+         *              through io_uring (Linux 6.1 or later). This needs the
+         *              library to be built with CPPRESTLIB_IO_URING and only
+         *              serves plain HTTP; otherwise EVENT_LOOP is used.
+         */
+        enum ServerMode { THREAD_PER_CONNECTION, EVENT_LOOP, THREAD_POOL, IO_URING };
+
     protected:
         int port;                                       // Port that clients will connect to
-        Socket* listenSocket;                           // Socket that clients will connect to
+        std::vector<Socket*> listenSockets;             // Sockets that clients will connect to
+        int listenSocketCount;                          // Number of SO_REUSEPORT listen sockets (0 for one per core)
         bool listening;                                 // Whether the server is accepting client connections
-        pthread_t threadId;                             // ID of the thread that is accepting client connections
+        std::vector<pthread_t> acceptThreads;           // IDs of the threads that are accepting client connections
         std::map<std::string, HandlerData*> routes;     // Map of paths and their handlers
+        Router router;                                  // Finds the handler for a request
+        HandlerData* routesData;                        // Handler of /system/routes, or nullptr if it was replaced
+        HandlerData notFoundData;                       // Handler for requests that no route matches
         std::string missingPageText;                    // HTML response for missing page
+        ServerMode serverMode;                          // How client connections are serviced
+        int eventLoopCount;                             // Number of event loops to run in EVENT_LOOP mode
+        std::vector<EventLoop*> eventLoops;             // Event loops that are running
+        std::vector<IoUringLoop*> ioUringLoops;         // io_uring loops that are running
+        int threadPoolSize;                             // Number of worker threads in THREAD_POOL mode
+        size_t threadPoolQueueDepth;                    // Number of clients that may wait for a worker
+        ThreadPool::FullPolicy threadPoolFullPolicy;    // What to do with a client when the queue is full
+        ThreadPool* threadPool;                         // Worker threads in THREAD_POOL mode
+        pthread_mutex_t clientMutex;                    // Protects the client threads' state
+        pthread_cond_t clientThreadsDone;               // Signaled when a connection thread ends
+        int clientThreadCount;                          // Connection threads that have been started and not ended
+        std::set<Socket*> clientSockets;                // Connections being served by a thread or worker
+        int keepAliveTimeout;                           // Milliseconds an idle persistent connection is kept open
+        int maxRequestsPerConnection;                   // Requests served on a connection before it is closed (0 for no limit)
+        size_t maxBodySize;                             // Largest request body that is accepted
+        int readTimeout;                                // Milliseconds to wait for the rest of a partly received request
+        int handshakeTimeout;                           // Milliseconds a client may take to secure its connection
+        int writeTimeout;                               // Milliseconds to wait for a client to accept more of a response
+        size_t maxOutputBuffer;                         // Most unsent response data queued for a connection
+        int maxPipelinedRequests;                       // Most unsent responses queued for a connection (0 for no limit)
+        int acceptBatchSize;                            // Most connections accepted each time the listen socket is ready
+        int http2MaxConcurrentStreams;                  // Most streams a client may have open at once on an HTTP/2 connection
         log4cxx::LoggerPtr logger;                      // Logger for instances of this class
 
     protected:
@@ -58,16 +108,56 @@ namespace kaoisoft
 
     protected:
         /**
-         * Creates the socket that the clients will connect to.
+         * Adds a route's handler data, replacing any route that has the same
+         * method and path.
+         *
+         * @param method REST request method
+         * @param path Request path
+         * @param handlerData Handler data, which the server takes ownership of
+         */
+        void addHandlerData(kaoisoft::RestRequest::Method method, const std::string& path,
+                            HandlerData* handlerData);
+
+        /**
+         * Adds the statistics that a derived server keeps to the ones that
+         * /system/statistics returns.
+         *
+         * @param str JSON object that is being built, without its closing
+         *            brace. Each member that is added must start with a comma.
+         */
+        virtual void appendStatistics(std::string* str);
+
+        /**
+         * Accepts a pending client connection. The new connection is already
+         * in non-blocking mode.
+         *
+         * @param listener Socket that the client connected to
+         *
+         * @return The client's connection, or nullptr if there was no pending
+         *         connection or the accept failed
+         */
+        Socket* acceptClient(Socket* listener);
+
+        /**
+         * Hands a newly accepted client connection off to a new thread or,
+         * in THREAD_POOL mode, to the worker queue.
+         *
+         * @param socket Connection to the client
+         */
+        void dispatchClient(Socket* socket);
+
+        /**
+         * Creates the sockets that the clients will connect to.
         *
-        * @param port Port that the socket will be bound to
+        * @param port Port that the sockets will be bound to
         *
         * @return true if successful
          */
         bool createListenSocket(int port);
 
         /**
-         * Creates an instance of the socket wrapper class
+         * Creates an instance of the socket wrapper class. The instance is
+         * finished with its recycle() method.
          *
          * @param sock Handle to the socket to wrap
          *
@@ -76,28 +166,201 @@ namespace kaoisoft
         virtual Socket* createSocketObject(int sock);
 
         /**
-         * Manages a client connection.
+         * Gets the statistics of the pool from which createSocketObject()
+         * reuses socket objects.
+         *
+         * @param stats Structure into which the statistics are stored
+         */
+        virtual void getSocketPoolStatistics(ObjectPoolStatistics* stats);
+
+        /**
+         * Prepares a newly accepted client connection for use, performing its
+         * handshake and then calling verifyClient(). This is called by the
+         * thread that serves the client, before any request is read from it.
+         * The connection is already in non-blocking mode.
+         *
+         * Event loops do not call this. They drive the handshake themselves,
+         * so that it does not hold up their other connections, and only call
+         * verifyClient().
          *
          * @param sock Connection to the client
+         *
+         * @return true if the connection may be used, false if it should be closed
          */
-        virtual void manageClient(Socket* sock);
+        virtual bool prepareClient(Socket* sock);
+
+        /**
+         * Checks a client whose handshake has been completed. This is called
+         * in every server mode before any request is read from the client.
+         *
+         * @param sock Connection to the client
+         *
+         * @return true if the connection may be used, false if it should be closed
+         */
+        virtual bool verifyClient(Socket* sock);
 
         /**
-         * Routes a request to the appropriate handler.
+         * Gets the listen sockets that one of the server's loops watches. The
+         * sockets are dealt out so that every loop watches at least one and
+         * every socket is watched by at least one loop.
+         *
+         * @param index Index of the loop
+         * @param count Number of loops
+         *
+         * @return The loop's listen sockets
+         */
+        std::vector<Socket*> getLoopListenSockets(int index, int count);
+
+        /**
+         * Checks whether the server secures its connections, in which case
+         * they cannot be served by io_uring loops.
+         *
+         * @return true if connections use TLS
+         */
+        virtual bool isSecure() { return false; }
+
+        /**
+         * Decides whether a connection stays open after a response has been
+         * sent.
+         *
+         * The connection is kept open if the client asked for it (HTTP/1.1
+         * clients do unless they send "Connection: close"), the handler did not
+         * set "Connection: close", the server is still running and the
+         * connection has not reached the maximum number of requests.
          *
          * @param request Client's request
+         * @param connection Connection header of the response
+         * @param requestCount Number of requests served on the connection,
+         *                     including this one
          *
-         * @return The handler's generated response
+         * @return true if the connection should be kept open
          */
-        RestResponse* routeRequest(RestRequest* request);
+        bool decideKeepAlive(RestRequest* request, std::string_view connection,
+                             int requestCount);
+
+        /**
+         * Decides whether a connection stays open after a response has been
+         * sent, and sets the response's Connection header to match. See
+         * decideKeepAlive().
+         *
+         * @param request Client's request
+         * @param response Response that is about to be sent
+         * @param requestCount Number of requests served on the connection,
+         *                     including this one
+         *
+         * @return true if the connection should be kept open
+         */
+        bool keepConnectionAlive(RestRequest* request, RestResponse* response,
+                                 int requestCount);
+
+        /**
+         * Decides whether a connection stays open after a static response has
+         * been sent. The Connection header is added by the response's closing
+         * block. See decideKeepAlive().
+         *
+         * @param request Client's request
+         * @param response Response that is about to be sent
+         * @param requestCount Number of requests served on the connection,
+         *                     including this one
+         *
+         * @return true if the connection should be kept open
+         */
+        bool keepConnectionAlive(RestRequest* request, const StaticResponse* response,
+                                 int requestCount);
+
+        /**
+         * Checks whether a connection has as many unsent responses queued as
+         * the server allows. Its remaining requests are not served until some
+         * of them have been written.
+         *
+         * @param count Number of responses that are queued
+         * @param bytes Number of queued bytes that have not been written
+         *
+         * @return true if no more responses may be queued
+         */
+        bool isPipelineFull(size_t count, size_t bytes);
+
+        /**
+         * Manages a client connection. Requests are served until the client
+         * closes the connection, asks for it to be closed, stays idle for
+         * longer than the keep-alive timeout or reaches the maximum number of
+         * requests per connection. A connection on which the client chose
+         * HTTP/2 is served by an Http2Session.
+         *
+         * Requests that the client has pipelined are served in order straight
+         * from the input buffer, and their responses are written together
+         * once no complete request is left in it or the queued responses
+         * reach the server's caps.
+         *
+         * @param sock Connection to the client
+         */
+        virtual void manageClient(Socket* sock);
+
+        /**
+         * Tells a client that the server is too busy to handle its connection.
+         * This is called in THREAD_POOL mode, on the thread that accepts the
+         * connections, when the worker queue is full and the REJECT policy is
+         * in effect. The caller closes the connection afterwards.
+         *
+         * @param sock Connection to the client
+         */
+        virtual void rejectClient(Socket* sock);
+
+        /**
+         * Finds the route for a request. If the route has a static response,
+         * that is sent without calling the handler.
+         *
+         * @param request Client's request, to which the parameters captured
+         *                from its path are added
+         *
+         * @return The route's handler data, which is the not-found handler if
+         *         no route matches
+         */
+        HandlerData* findRoute(RestRequest* request);
+
+        /**
+         * Writes a response to a client. The header block and the body are
+         * written with one scatter-gather call where possible, so the body is
+         * never copied, and short writes are continued until the whole
+         * response has been sent.
+         *
+         * @param sock Connection to the client
+         * @param response Response to send
+         * @param resource Memory resource in which the header block is built
+         *
+         * @return true if the whole response was sent
+         */
+        bool sendResponse(Socket* sock, RestResponse* response,
+                          std::pmr::memory_resource* resource);
+
+        /**
+         * Writes queued responses to a client in as few scatter-gather calls
+         * as possible, so nothing is copied and the responses to pipelined
+         * requests share writes. The responses are released and the queue is
+         * emptied whether or not the writes succeed.
+         *
+         * @param sock Connection to the client
+         * @param pipeline Responses to send, in order
+         *
+         * @return true if all of the responses were sent
+         */
+        bool sendPipeline(Socket* sock, std::vector<EventLoopOutput>* pipeline);
+
+        /**
+         * Serializes the responses that the server sends for requests that no
+         * route matches and for /system/routes, so that the routes that were
+         * added by the time the server starts are listed.
+         */
+        void updateStaticResponses();
 
     protected:
 
         /** Handler for paths that don't have a defined handler */
-        static kaoisoft::RestResponse* defaultHandler(kaoisoft::RestRequest* request, void* extra);
+        void defaultHandler(const kaoisoft::RestRequest& request, kaoisoft::RestResponse& response);
 
         /**
-         * Generates a route key for the routing map.
+         * Generates a route key for the routing map. A path that ends in {*}
+         * has the same key as the one that ends in * instead.
          *
          * @param method
          * @param path
@@ -117,41 +380,65 @@ namespace kaoisoft
                                           std::string& path);
 
         /** Handler that returns a list of defined routes */
-        static kaoisoft::RestResponse* getRoutes(kaoisoft::RestRequest* request, void* extra);
+        void getRoutes(const kaoisoft::RestRequest& request, kaoisoft::RestResponse& response);
+
+        /** Handler that returns the server's statistics */
+        void getStatistics(const kaoisoft::RestRequest& request, kaoisoft::RestResponse& response);
 
         /** Handler that returns the library's version */
-        static kaoisoft::RestResponse* getVersion(kaoisoft::RestRequest* request, void* extra);
+        static void getVersion(const kaoisoft::RestRequest& request, kaoisoft::RestResponse& response);
 
         /**
-         * Reads the body of a REST request. Reads until there is no data left
-         * to read.
+         * Fills in the response sent to a client whose request could not be
+         * handled.
          *
-         * @param sslSocket Pointer to secure socket wrapper
-         *
-         * @return The data read
+         * @param code HTTP status code
+         * @param response Response to fill in, which must be new or reset
          */
-        static std::string readBody(Socket* socket);
+        static void fillErrorResponse(int code, RestResponse* response);
 
         /**
-         * Reads a line (until a linefeed is encountered).
+         * Reads a REST request from a socket. The end of the request is found
+         * from its Content-Length or Transfer-Encoding header, and the call
+         * waits (up to the read timeout) for the rest of a request that has
+         * only partly arrived. The request points into the socket's input
+         * buffer, so it must be finished with before the socket is read again.
          *
-         * @param sslSocket Pointer to secure socket wrapper
+         * @param socket Connection to the client
+         * @param request Request to read into, which is reset first
+         * @param errorCode Set to the HTTP status to send back if the request
+         *                  is invalid, or to 0 otherwise
          *
-         * @return The line read, excluding the trailing CR/LF
-         */
-        static std::string readLine(Socket* socket);
-
-        /**
-         * Reads a REST request from a socket.
+         * @return true if a request was read, false if the request is invalid,
+         *         the client closed the connection or the read timed out
          */
-        static RestRequest* readRequest(Socket* socket);
+        bool readRequest(Socket* socket, RestRequest* request, int* errorCode);
 
     public:
         RestServer();
         virtual ~RestServer();
 
         /**
-         * Adds a request route.
+         * Adds a request route. The path may contain {name} segments and end
+         * with a {name*} or * wildcard; the values they match are passed to
+         * the handler as the request's parameters. See Router for details.
+         *
+         * The handler is given the request, which belongs to the connection,
+         * and a response that it fills in. Both are reused for the
+         * connection's later requests, so serving a request makes no copies
+         * of them and allocates nothing for them once they have grown to fit.
+         *
+         * @param method REST request method
+         * @param path Request path
+         * @param handler Handler that will be called, such as a function or
+         *                a lambda
+         */
+        void addRoute(kaoisoft::RestRequest::Method method, std::string path,
+            REQUEST_HANDLER handler);
+
+        /**
+         * Adds a request route whose handler creates its own response. The
+         * response is moved into the server's one and then deleted.
          *
          * @param method REST request method
          * @param path Request path
@@ -161,6 +448,40 @@ namespace kaoisoft
         void addRoute(kaoisoft::RestRequest::Method method, std::string path,
             ROUTE_HANDLER handler, void* extraData);
 
+        /**
+         * Adds a route whose response never changes. The response is
+         * serialized once, here, and written to every client that asks for
+         * it without calling a handler. Only the Date header, which is added
+         * unless the response has its own, and the Connection header are
+         * filled in for each request.
+         *
+         * @param method REST request method
+         * @param path Request path, which may contain parameters and a
+         *             wildcard like any other route
+         * @param response Response to send
+         */
+        void addStaticRoute(kaoisoft::RestRequest::Method method, std::string path,
+            const RestResponse& response);
+
+        /**
+         * Gets how client connections are serviced. Once the server has been
+         * started, this is the mode that is actually in use, which is
+         * EVENT_LOOP if IO_URING was asked for but is not available.
+         *
+         * @return Server mode
+         */
+        ServerMode getServerMode() { return serverMode; }
+
+        /**
+         * Gets the statistics of the worker thread pool.
+         *
+         * @param stats Structure into which the statistics are stored
+         *
+         * @return true if successful, false if the server is not running in
+         *         THREAD_POOL mode
+         */
+        bool getThreadPoolStatistics(ThreadPoolStatistics* stats);
+
         /**
          * Prepares the server to begin handling clients.
          *
@@ -172,13 +493,169 @@ namespace kaoisoft
         */
         bool setUp(std::string port_str);
 
+        /**
+         * Sets the largest number of connections that are accepted each time
+         * the listen socket becomes ready. Any remaining connections are
+         * accepted on the next pass, after the accepted ones have been handed
+         * off.
+         *
+         * @param size Number of connections
+         */
+        void setAcceptBatchSize(int size) { acceptBatchSize = size; }
+
+        /**
+         * Sets how many requests a client may have in progress at once on an
+         * HTTP/2 connection, each on a stream of its own. The client is told
+         * the limit when the connection starts, and streams beyond it are
+         * refused. HTTP/2 is only offered by a SecureRestServer that has it
+         * enabled.
+         *
+         * @param count Number of streams
+         */
+        void setHttp2MaxConcurrentStreams(int count) { http2MaxConcurrentStreams = count; }
+
+        /**
+         * Sets how long a persistent connection may stay idle, waiting for the
+         * client's next request, before it is closed.
+         *
+         * @param timeout Timeout in milliseconds
+         */
+        void setKeepAliveTimeout(int timeout) { keepAliveTimeout = timeout; }
+
+        /**
+         * Sets how long a client may take to complete the handshake that
+         * secures its connection. A client that stalls part way through is
+         * disconnected once this has passed.
+         *
+         * @param timeout Timeout in milliseconds
+         */
+        void setHandshakeTimeout(int timeout) { handshakeTimeout = timeout; }
+
+        /**
+         * Sets the largest request body that is accepted. Larger requests are
+         * answered with 413 Payload Too Large.
+         *
+         * @param size Maximum body size in bytes
+         */
+        void setMaxBodySize(size_t size) { maxBodySize = size; }
+
+        /**
+         * Sets how much response data may be waiting to be sent to a client.
+         * Once a connection reaches this, no more of its requests are served
+         * until the client has accepted some of the data, so a client that
+         * sends requests faster than it reads the responses cannot make the
+         * server use more memory. A single response larger than this is still
+         * sent whole.
+         *
+         * @param size Maximum number of bytes
+         */
+        void setMaxOutputBuffer(size_t size) { maxOutputBuffer = size; }
+
+        /**
+         * Sets how many responses to pipelined requests may be waiting to be
+         * sent to a client. Once a connection reaches this, its remaining
+         * requests stay in the input buffer (and, in the event loop modes,
+         * the socket is not read) until the responses have been written.
+         *
+         * @param max Maximum number of responses, 1 to write each response
+         *            before serving the next request or 0 for no limit
+         */
+        void setMaxPipelinedRequests(int max) { maxPipelinedRequests = max; }
+
+        /**
+         * Sets the number of listen sockets that are opened on the server's
+         * port. When there is more than one, each is opened with SO_REUSEPORT
+         * and the kernel spreads new connections across them. Each socket has
+         * its own accepting thread or, in EVENT_LOOP mode, is shared by every
+         * Nth event loop, so accepting is no longer done in a single place.
+         * This must be called before setUp().
+         *
+         * Note that with SO_REUSEPORT, other processes run by the same user
+         * can also bind to the port.
+         *
+         * @param count Number of listen sockets, or 0 to open one per core
+         */
+        void setListenSocketCount(int count) { listenSocketCount = count; }
+
+        /**
+         * Sets the number of requests that are served on a persistent
+         * connection before it is closed.
+         *
+         * @param max Maximum number of requests, 1 to disable persistent
+         *            connections or 0 for no limit
+         */
+        void setMaxRequestsPerConnection(int max) { maxRequestsPerConnection = max; }
+
+        /**
+         * Sets how long to wait for more data from a client that has sent
+         * part of a request.
+         *
+         * @param timeout Timeout in milliseconds
+         */
+        void setReadTimeout(int timeout) { readTimeout = timeout; }
+
+        /**
+         * Sets how long to wait for a client to accept more of a response
+         * before the connection is closed. This keeps a client that stops
+         * reading from tying up a thread or a connection's memory.
+         *
+         * @param timeout Timeout in milliseconds
+         */
+        void setWriteTimeout(int timeout) { writeTimeout = timeout; }
+
+        /**
+         * Sets how client connections are serviced. This must be called before
+         * start().
+         *
+         * @param mode Server mode
+         */
+        void setServerMode(ServerMode mode) { serverMode = mode; }
+
+        /**
+         * Sets the number of event loops that are run in EVENT_LOOP or
+         * IO_URING mode. This must be called before start().
+         *
+         * @param count Number of event loops, or 0 to run one per core
+         */
+        void setEventLoopCount(int count) { eventLoopCount = count; }
+
+        /**
+         * Sets what happens to a new client in THREAD_POOL mode when all of the
+         * workers are busy and the queue is full. This must be called before
+         * start().
+         *
+         * @param policy BLOCK to stop accepting clients until there is room,
+         *               REJECT to send a 503 response, or DROP to close the
+         *               connection
+         */
+        void setThreadPoolFullPolicy(ThreadPool::FullPolicy policy) { threadPoolFullPolicy = policy; }
+
+        /**
+         * Sets the number of clients that may wait for a worker thread in
+         * THREAD_POOL mode. This must be called before start().
+         *
+         * @param depth Maximum number of queued clients
+         */
+        void setThreadPoolQueueDepth(size_t depth) { threadPoolQueueDepth = depth; }
+
+        /**
+         * Sets the number of worker threads in THREAD_POOL mode. This must be
+         * called before start().
+         *
+         * @param size Number of worker threads
+         */
+        void setThreadPoolSize(int size) { threadPoolSize = size; }
+
         /**
          * Tells the server to accept and manage client connections.
          */
         void start();
 
         /**
-         * Tells the server to stop accepting client connections.
+         * Tells the server to stop accepting client connections. The
+         * connections that are open are closed, and the call returns once no
+         * thread uses the server any more, so the server may be deleted
+         * straight afterwards.
          */
         void stop();
 
@@ -186,7 +663,8 @@ namespace kaoisoft
         /**
          * Runs in its own thread and listens for and accepts client connections.
          *
-         * @param Pointer to class instance
+         * @param Pointer to a struct containing the class instance and the
+         *        listen socket to accept clients from
          *
          * @return nullptr
          */
@@ -0,0 +1,379 @@
+#include "Router.h"
+
+#include <string.h>
+
+using namespace kaoisoft;
+using namespace std;
+
+Router::Router()
+{
+    for (int i = 0; i < RestRequest::INVALID; i++)
+    {
+        trees[i] = newNode("");
+    }
+}
+
+Router::~Router()
+{
+    for (int i = 0; i < RestRequest::INVALID; i++)
+    {
+        deleteNode(trees[i]);
+    }
+}
+
+bool Router::addRoute(RestRequest::Method method, const string& path,
+                      HandlerData* handlerData)
+{
+    if (0 > method || RestRequest::INVALID <= method || path.empty() || '/' != path[0])
+    {
+        return false;
+    }
+
+    // Check the parameters before changing the tree
+    int paramCount = 0;
+    for (size_t pos = 0; pos < path.length(); pos++)
+    {
+        if ('{' == path[pos] || '*' == path[pos])
+        {
+            // A parameter must fill a whole segment
+            size_t close = ('{' == path[pos]) ? path.find('}', pos) : pos;
+            if (string::npos == close || '/' != path[pos - 1] ||
+                (close + 1 < path.length() && '/' != path[close + 1]) ||
+                (close - pos == 1))
+            {
+                return false;
+            }
+
+            // A wildcard must end the path
+            bool wildcard = ('*' == path[close - (('{' == path[pos]) ? 1 : 0)]);
+            if (wildcard && close + 1 != path.length())
+            {
+                return false;
+            }
+
+            if (MAX_ROUTE_PARAMS < ++paramCount)
+            {
+                return false;
+            }
+            pos = close;
+        }
+        else if ('}' == path[pos])
+        {
+            return false;
+        }
+    }
+    if (nullptr != findParamConflict(method, path))
+    {
+        return false;
+    }
+
+    // Walk the path, adding nodes as needed
+    RouterNode* node = trees[method];
+    size_t start = 0;
+    while (start < path.length())
+    {
+        // Add the literal characters up to the next parameter
+        size_t pos = path.find_first_of("{*", start);
+        if (string::npos == pos)
+        {
+            pos = path.length();
+        }
+        node = insertLiteral(node, path.substr(start, pos - start));
+        if (path.length() == pos)
+        {
+            break;
+        }
+
+        // Get the parameter's name
+        string name;
+        size_t close = pos;
+        if ('{' == path[pos])
+        {
+            close = path.find('}', pos);
+            name = path.substr(pos + 1, close - pos - 1);
+        }
+        else
+        {
+            name = "*";
+        }
+
+        if (!name.empty() && '*' == name[name.length() - 1])
+        {
+            // The wildcard ends the path
+            if (name.length() > 1)
+            {
+                name.erase(name.length() - 1);
+            }
+            node->wildcardHandler = handlerData;
+            node->wildcardName = name;
+            return true;
+        }
+
+        // Parameters at the same place in different routes share a node,
+        // whose name was checked above
+        if (nullptr == node->paramChild)
+        {
+            node->paramChild = newNode("");
+            node->paramName = name;
+        }
+        node = node->paramChild;
+        start = close + 1;
+    }
+
+    node->handler = handlerData;
+
+    return true;
+}
+
+void Router::deleteNode(RouterNode* node)
+{
+    if (nullptr == node)
+    {
+        return;
+    }
+
+    vector<RouterNode*>::iterator iter;
+    for (iter = node->children.begin(); iter != node->children.end(); iter++)
+    {
+        deleteNode(*iter);
+    }
+    deleteNode(node->paramChild);
+
+    delete node;
+}
+
+const RouterNode* Router::findLiteral(const RouterNode* parent, const string& text)
+{
+    if (text.empty())
+    {
+        return parent;
+    }
+
+    // Only a child whose whole prefix matches leads any further
+    size_t index = parent->indices.find(text[0]);
+    if (string::npos == index)
+    {
+        return nullptr;
+    }
+    const RouterNode* child = parent->children[index];
+    if (0 != text.compare(0, child->prefix.length(), child->prefix))
+    {
+        return nullptr;
+    }
+
+    return findLiteral(child, text.substr(child->prefix.length()));
+}
+
+const string* Router::findParamConflict(RestRequest::Method method, const string& path)
+{
+    if (0 > method || RestRequest::INVALID <= method)
+    {
+        return nullptr;
+    }
+
+    // Follow the path as far as the tree already has it. Once it leaves the
+    // tree, the rest of the route would be added below new nodes.
+    const RouterNode* node = trees[method];
+    size_t start = 0;
+    while (nullptr != node && start < path.length())
+    {
+        size_t pos = path.find_first_of("{*", start);
+        if (string::npos == pos)
+        {
+            break;
+        }
+        node = findLiteral(node, path.substr(start, pos - start));
+        if (nullptr == node)
+        {
+            break;
+        }
+
+        // Get the parameter's name the way addRoute() does
+        string name("*");
+        size_t close = pos;
+        if ('{' == path[pos])
+        {
+            close = path.find('}', pos);
+            if (string::npos == close)
+            {
+                break;
+            }
+            name = path.substr(pos + 1, close - pos - 1);
+        }
+
+        if (!name.empty() && '*' == name[name.length() - 1])
+        {
+            // The wildcard ends the path, and its handler is shared by every
+            // route that spells it with the same name
+            if (name.length() > 1)
+            {
+                name.erase(name.length() - 1);
+            }
+            if (nullptr != node->wildcardHandler && 0 != node->wildcardName.compare(name))
+            {
+                return &(node->wildcardName);
+            }
+            break;
+        }
+
+        if (nullptr != node->paramChild && 0 != node->paramName.compare(name))
+        {
+            return &(node->paramName);
+        }
+        node = node->paramChild;
+        start = close + 1;
+    }
+
+    return nullptr;
+}
+
+HandlerData* Router::findRoute(RestRequest::Method method, string_view path,
+                               RestRequest* request)
+{
+    if (0 > method || RestRequest::INVALID <= method)
+    {
+        return nullptr;
+    }
+
+    // The query string is not part of the match
+    const char* data = path.data();
+    const char* query = (const char*)memchr(data, '?', path.length());
+    size_t end = (nullptr != query) ? query - data : path.length();
+
+    // Match the path without allocating anything
+    RouteMatch match;
+    match.handler = nullptr;
+    match.paramCount = 0;
+    if (!matchNode(trees[method], data, 0, end, &match))
+    {
+        return nullptr;
+    }
+
+    // Save the captured parameters. The names belong to the tree and the
+    // values to the path, so neither is copied.
+    if (nullptr != request)
+    {
+        for (int i = 0; i < match.paramCount; i++)
+        {
+            request->addParamView(*(match.params[i].name),
+                                  string_view(match.params[i].value, match.params[i].length));
+        }
+    }
+
+    return match.handler;
+}
+
+RouterNode* Router::insertLiteral(RouterNode* parent, const string& text)
+{
+    if (text.empty())
+    {
+        return parent;
+    }
+
+    // Find the child that starts with the same character
+    size_t index = parent->indices.find(text[0]);
+    if (string::npos == index)
+    {
+        RouterNode* child = newNode(text);
+        parent->indices.push_back(text[0]);
+        parent->children.push_back(child);
+        return child;
+    }
+    RouterNode* child = parent->children[index];
+
+    // Find how much of the child's prefix matches
+    size_t common = 0;
+    size_t max = (text.length() < child->prefix.length()) ? text.length() : child->prefix.length();
+    while (common < max && text[common] == child->prefix[common])
+    {
+        common++;
+    }
+
+    // Split the child if only part of its prefix matches
+    if (common < child->prefix.length())
+    {
+        RouterNode* split = newNode(child->prefix.substr(0, common));
+        child->prefix.erase(0, common);
+        split->indices.push_back(child->prefix[0]);
+        split->children.push_back(child);
+        parent->children[index] = split;
+        child = split;
+    }
+
+    return insertLiteral(child, text.substr(common));
+}
+
+bool Router::matchNode(const RouterNode* node, const char* path, size_t pos,
+                       size_t end, RouteMatch* match)
+{
+    // Match the node's literal characters
+    size_t length = node->prefix.length();
+    if (end - pos < length || 0 != memcmp(path + pos, node->prefix.data(), length))
+    {
+        return false;
+    }
+    pos += length;
+
+    if (pos == end)
+    {
+        if (nullptr != node->handler)
+        {
+            match->handler = node->handler;
+            return true;
+        }
+    }
+    else
+    {
+        // Literal children take priority
+        const char* index = (const char*)memchr(node->indices.data(), path[pos],
+                                                node->indices.length());
+        if (nullptr != index &&
+            matchNode(node->children[index - node->indices.data()], path, pos, end, match))
+        {
+            return true;
+        }
+
+        // Then a parameter, which takes the rest of the segment
+        if (nullptr != node->paramChild && MAX_ROUTE_PARAMS > match->paramCount)
+        {
+            const char* slash = (const char*)memchr(path + pos, '/', end - pos);
+            size_t segmentEnd = (nullptr != slash) ? slash - path : end;
+            if (segmentEnd > pos)
+            {
+                RouteParam* param = &(match->params[match->paramCount++]);
+                param->name = &(node->paramName);
+                param->value = path + pos;
+                param->length = segmentEnd - pos;
+                if (matchNode(node->paramChild, path, segmentEnd, end, match))
+                {
+                    return true;
+                }
+                match->paramCount--;
+            }
+        }
+    }
+
+    // Finally a wildcard, which takes the rest of the path
+    if (nullptr != node->wildcardHandler && MAX_ROUTE_PARAMS > match->paramCount)
+    {
+        RouteParam* param = &(match->params[match->paramCount++]);
+        param->name = &(node->wildcardName);
+        param->value = path + pos;
+        param->length = end - pos;
+        match->handler = node->wildcardHandler;
+        return true;
+    }
+
+    return false;
+}
+
+RouterNode* Router::newNode(const string& prefix)
+{
+    RouterNode* node = new RouterNode;
+    node->prefix = prefix;
+    node->paramChild = nullptr;
+    node->handler = nullptr;
+    node->wildcardHandler = nullptr;
+
+    return node;
+}
@@ -0,0 +1,228 @@
+#ifndef ROUTER_H
+#define ROUTER_H
+
+#include "RestRequest.h"
+#include "RestResponse.h"
+#include "StaticResponse.h"
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* Most parameters that a route's path may contain */
+#define MAX_ROUTE_PARAMS 16
+
+namespace kaoisoft
+{
+    /**
+     * Request handler
+     *
+     * Parameters:
+     *   RestRequest* - client's request
+     *   void* - extra data passed to the handler, this is set in the addRoute() method
+     *
+     * The handler returns a new response, which the server deletes. Handlers
+     * of this kind are wrapped in a REQUEST_HANDLER.
+     */
+    typedef RestResponse*(*ROUTE_HANDLER)(RestRequest*, void*);
+
+    /**
+     * Request handler that fills in a response owned by the server
+     *
+     * Parameters:
+     *   const RestRequest& - client's request, which the server owns
+     *   RestResponse& - response to fill in, which starts out as a new
+     *                   response would
+     *
+     * Any callable can be used, such as a lambda that captures the data it
+     * needs, so no extra pointer is passed.
+     */
+    typedef std::function<void(const RestRequest&, RestResponse&)> REQUEST_HANDLER;
+
+    /**
+     * Data associated with a request handler
+     */
+    struct HandlerData {
+        REQUEST_HANDLER handler;            // Handler to call
+        StaticResponse* staticResponse;     // Response that is sent instead of calling the handler, or nullptr
+
+        HandlerData() { staticResponse = nullptr; }
+        HandlerData(const HandlerData& other) = delete;
+        ~HandlerData() { delete staticResponse; }
+
+        HandlerData& operator=(const HandlerData& other) = delete;
+    };
+
+    /**
+     * Node of a router's radix tree. Each node matches a run of literal
+     * characters; its children continue the path from where it ends.
+     */
+    struct RouterNode
+    {
+        std::string prefix;                 // Literal characters matched by this node
+        std::string indices;                // First character of each child's prefix
+        std::vector<RouterNode*> children;  // Literal children, in the same order as indices
+        RouterNode* paramChild;             // Node that continues after a {name} segment, or nullptr
+        std::string paramName;              // Name of the {name} segment
+        HandlerData* handler;               // Handler for paths that end here, or nullptr
+        HandlerData* wildcardHandler;       // Handler for any remainder of the path, or nullptr
+        std::string wildcardName;           // Name under which the remainder is captured
+    };
+
+    /**
+     * Finds the handler for a request's method and path.
+     *
+     * Routes are kept in a compressed radix tree per request method, so a
+     * lookup takes time proportional to the length of the path rather than to
+     * the number of routes. Route paths may contain:
+     *
+     *   {name}  - matches one non-empty path segment, which is captured as the
+     *             request parameter "name"
+     *   {name*} - at the end of the path, matches the rest of the path
+     *             (including slashes, possibly empty), captured as "name"
+     *   *       - at the end of the path, the same as {*}
+     *
+     * Since * and {*} are two ways of writing the same route, adding one
+     * replaces the other. A wildcard whose name differs from that of the
+     * wildcard already at the same place is rejected, like a parameter.
+     *
+     * Literal segments take priority over parameters, which take priority over
+     * wildcards. Query strings are not part of the match. A lookup that finds
+     * nothing allocates no memory.
+     *
+     * The router does not own the handler data that is added to it.
+     */
+    class Router
+    {
+    private:
+        /**
+         * Parameter captured while matching a path.
+         */
+        struct RouteParam
+        {
+            const std::string* name;    // Parameter name, owned by the tree
+            const char* value;          // Start of the value within the path
+            size_t length;              // Length of the value
+        };
+
+        /**
+         * State of a lookup.
+         */
+        struct RouteMatch
+        {
+            HandlerData* handler;                       // Handler that was found
+            RouteParam params[MAX_ROUTE_PARAMS];        // Captured parameters
+            int paramCount;                             // Number of captured parameters
+        };
+
+        RouterNode* trees[RestRequest::INVALID];        // Root of the tree for each method
+
+    private:
+        /**
+         * Releases a node and all of its descendants.
+         *
+         * @param node Node to release
+         */
+        static void deleteNode(RouterNode* node);
+
+        /**
+         * Follows a run of literal characters below a node without changing
+         * the tree.
+         *
+         * @param parent Node below which the characters are looked for
+         * @param text Literal characters
+         *
+         * @return The node at which the characters end, or nullptr if they
+         *         end part way through a node or leave the tree
+         */
+        static const RouterNode* findLiteral(const RouterNode* parent, const std::string& text);
+
+        /**
+         * Adds a run of literal characters below a node, splitting existing
+         * nodes where they only partly match.
+         *
+         * @param parent Node below which the characters are added
+         * @param text Literal characters
+         *
+         * @return The node at which the characters end
+         */
+        static RouterNode* insertLiteral(RouterNode* parent, const std::string& text);
+
+        /**
+         * Tries to match the rest of a path against a node and its
+         * descendants.
+         *
+         * @param node Node to match
+         * @param path Path being looked up
+         * @param pos Offset of the first character that has not been matched
+         * @param end Offset of the end of the path
+         * @param match Lookup state, which is updated when a handler is found
+         *
+         * @return true if a handler was found
+         */
+        static bool matchNode(const RouterNode* node, const char* path, size_t pos,
+                              size_t end, RouteMatch* match);
+
+        /**
+         * Creates an empty node.
+         *
+         * @param prefix Literal characters matched by the node
+         *
+         * @return The node, which the caller must release
+         */
+        static RouterNode* newNode(const std::string& prefix);
+
+    public:
+        Router();
+        virtual ~Router();
+
+        /**
+         * Adds a route. A route that has the same method and path as an
+         * existing one replaces it.
+         *
+         * @param method Request method
+         * @param path Route path, which may contain parameters and a wildcard
+         * @param handlerData Handler to call for matching requests
+         *
+         * @return true if successful, false if the path is malformed or a
+         *         parameter conflicts with an existing route's. The tree is
+         *         not changed when false is returned.
+         */
+        bool addRoute(RestRequest::Method method, const std::string& path,
+                      HandlerData* handlerData);
+
+        /**
+         * Checks whether a route would give a parameter or a wildcard a
+         * different name than an existing route does at the same place, as
+         * /users/{userId} would after /users/{id}, or /files/{rest*} after
+         * /files/{path*}.
+         *
+         * @param method Request method
+         * @param path Route path
+         *
+         * @return The existing parameter's name, or nullptr if there is no
+         *         conflict
+         */
+        const std::string* findParamConflict(RestRequest::Method method,
+                                             const std::string& path);
+
+        /**
+         * Finds the handler for a request. If one is found, the parameters
+         * captured from the path are added to the request, as views of the
+         * path and of the route's parameter names. The path must therefore
+         * outlive the request's use of them, as must the router.
+         *
+         * @param method Request method
+         * @param path Request path, which may include a query string
+         * @param request Request to which the captured parameters are added,
+         *                or nullptr
+         *
+         * @return The handler, or nullptr if no route matches
+         */
+        HandlerData* findRoute(RestRequest::Method method, std::string_view path,
+                               RestRequest* request);
+    };
+}
+
+#endif // ROUTER_H
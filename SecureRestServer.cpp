@@ -13,6 +13,16 @@
 
 #include "SecureRestServer.h"
 #include "SslSocket.h"
+#ifdef CPPRESTLIB_HTTP2
+#include "Http2Session.h"
+#endif
+
+#include <openssl/crypto.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#endif
 
 using namespace kaoisoft;
 using namespace std;
@@ -21,11 +31,149 @@ using namespace log4cxx;
 /* Buffer size to be used for transfers */
 #define BUFSIZE 128
 
+/* Default most sessions kept in the server-side cache */
+#define DEFAULT_SESSION_CACHE_SIZE 20480
+
+/* Default number of seconds for which a session may be resumed */
+#define DEFAULT_SESSION_TIMEOUT 7200
+
+/* Default number of seconds for which a ticket key encrypts new tickets */
+#define DEFAULT_TICKET_KEY_LIFETIME 3600
+
+/* Sessions can only be resumed by servers with the same context */
+#define SESSION_ID_CONTEXT "CppRestLib"
+
+/* Most private key operations that may wait for a crypto thread */
+#define CRYPTO_QUEUE_DEPTH 1024
+
+/* Lists the upper layer protocols that the kernel can put on TCP sockets */
+#define AVAILABLE_ULP_FILE "/proc/sys/net/ipv4/tcp_available_ulp"
+
+/* Application protocols offered through ALPN when HTTP/2 is enabled, in order
+   of preference, each preceded by its length */
+#define ALPN_PROTOCOLS "\x02h2\x08http/1.1"
+
 bool SecureRestServer::initialized = false;
 
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+/**
+ * Sets up the encryption and authentication of a session ticket, as OpenSSL's
+ * ticket key callback.
+ *
+ * @param ssl Connection that the ticket belongs to
+ * @param keyName Name of the key
+ * @param iv Initialization vector
+ * @param cipherCtx Cipher context to set up
+ * @param macCtx HMAC context to set up
+ * @param encrypt Whether a ticket is being issued
+ *
+ * @return See SecureRestServer::getTicketKey()
+ */
+static int ticketKeyCallback(SSL* ssl, unsigned char* keyName, unsigned char* iv,
+                             EVP_CIPHER_CTX* cipherCtx, EVP_MAC_CTX* macCtx, int encrypt)
+{
+    SecureRestServer* server = (SecureRestServer*)SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl));
+    unsigned char hmacKey[TICKET_HMAC_KEY_SIZE];
+    int ret = server->getTicketKey(keyName, iv, cipherCtx, hmacKey, encrypt);
+    if (0 < ret)
+    {
+        OSSL_PARAM params[2];
+        params[0] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, (char*)"SHA256", 0);
+        params[1] = OSSL_PARAM_construct_end();
+        if (1 != EVP_MAC_CTX_set_params(macCtx, params) ||
+            1 != EVP_MAC_init(macCtx, hmacKey, sizeof(hmacKey), nullptr))
+        {
+            ret = -1;
+        }
+    }
+    OPENSSL_cleanse(hmacKey, sizeof(hmacKey));
+
+    return ret;
+}
+#else
+/**
+ * Sets up the encryption and authentication of a session ticket, as OpenSSL's
+ * ticket key callback.
+ *
+ * @param ssl Connection that the ticket belongs to
+ * @param keyName Name of the key
+ * @param iv Initialization vector
+ * @param cipherCtx Cipher context to set up
+ * @param hmacCtx HMAC context to set up
+ * @param encrypt Whether a ticket is being issued
+ *
+ * @return See SecureRestServer::getTicketKey()
+ */
+static int ticketKeyCallback(SSL* ssl, unsigned char* keyName, unsigned char* iv,
+                             EVP_CIPHER_CTX* cipherCtx, HMAC_CTX* hmacCtx, int encrypt)
+{
+    SecureRestServer* server = (SecureRestServer*)SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl));
+    unsigned char hmacKey[TICKET_HMAC_KEY_SIZE];
+    int ret = server->getTicketKey(keyName, iv, cipherCtx, hmacKey, encrypt);
+    if (0 < ret && 1 != HMAC_Init_ex(hmacCtx, hmacKey, sizeof(hmacKey), EVP_sha256(), nullptr))
+    {
+        ret = -1;
+    }
+    OPENSSL_cleanse(hmacKey, sizeof(hmacKey));
+
+    return ret;
+}
+#endif
+
+#ifdef CPPRESTLIB_HTTP2
+/**
+ * Chooses the application protocol of a connection from those that the
+ * client offered through ALPN, as OpenSSL's ALPN select callback. HTTP/2 is
+ * preferred over HTTP/1.1.
+ *
+ * @param ssl Connection being secured
+ * @param out Set to the chosen protocol
+ * @param outLength Set to the length of the chosen protocol
+ * @param in Protocols offered by the client
+ * @param inLength Length of the offered protocols
+ * @param arg Unused
+ *
+ * @return SSL_TLSEXT_ERR_OK if a protocol was chosen, SSL_TLSEXT_ERR_NOACK to
+ *         go on without one
+ */
+static int selectApplicationProtocol(SSL* ssl, const unsigned char** out, unsigned char* outLength,
+                                     const unsigned char* in, unsigned int inLength, void* arg)
+{
+    // Prevent unused parameter warnings
+    (void)ssl;
+    (void)arg;
+
+    if (OPENSSL_NPN_NEGOTIATED != SSL_select_next_proto((unsigned char**)out, outLength,
+                                                        (const unsigned char*)ALPN_PROTOCOLS,
+                                                        sizeof(ALPN_PROTOCOLS) - 1, in, inLength))
+    {
+        return SSL_TLSEXT_ERR_NOACK;
+    }
+
+    return SSL_TLSEXT_ERR_OK;
+}
+#endif
+
 SecureRestServer::SecureRestServer()
 {
     ctx = nullptr;
+    sessionCacheSize = DEFAULT_SESSION_CACHE_SIZE;
+    sessionTimeout = DEFAULT_SESSION_TIMEOUT;
+    sessionTickets = true;
+    ticketKeyLifetime = DEFAULT_TICKET_KEY_LIFETIME;
+    pthread_mutex_init(&ticketKeyMutex, nullptr);
+    memset(ticketKeys, 0, sizeof(ticketKeys));
+    ticketKeyCount = 0;
+    ticketKeyRotations = 0;
+    resumedHandshakes = 0;
+    fullHandshakes = 0;
+    ktls = false;
+    ktlsSendConnections = 0;
+    ktlsReceiveConnections = 0;
+    ktlsFallbacks = 0;
+    cryptoThreads = 0;
+    cryptoPool = nullptr;
+    http2 = false;
 
 	// Initialize OpenSSL
 	if (!initialized)
@@ -41,18 +189,164 @@ SecureRestServer::SecureRestServer()
 
 SecureRestServer::~SecureRestServer()
 {
+    // Stop handling clients before the context they use is freed
+    if (listening)
+    {
+        stop();
+    }
+
+    // Let the crypto threads finish before the key that they use is freed
+    if (nullptr != cryptoPool)
+    {
+        cryptoPool->stop();
+    }
 	if (nullptr != ctx)
 	{
 		SSL_CTX_free(ctx);
 	}
+    delete cryptoPool;
+
+    // Do not leave the ticket keys in memory
+    OPENSSL_cleanse(ticketKeys, sizeof(ticketKeys));
+    pthread_mutex_destroy(&ticketKeyMutex);
+}
+
+bool SecureRestServer::applyTlsConfig()
+{
+    // Protocol versions
+    if (0 != tlsConfig.getMinProtocolVersion() &&
+        1 != SSL_CTX_set_min_proto_version(ctx, tlsConfig.getMinProtocolVersion()))
+    {
+        LOG4CXX_ERROR(logger, "Could not set the minimum protocol version to " <<
+                      tlsConfig.getMinProtocolVersion());
+        return false;
+    }
+    if (0 != tlsConfig.getMaxProtocolVersion() &&
+        1 != SSL_CTX_set_max_proto_version(ctx, tlsConfig.getMaxProtocolVersion()))
+    {
+        LOG4CXX_ERROR(logger, "Could not set the maximum protocol version to " <<
+                      tlsConfig.getMaxProtocolVersion());
+        return false;
+    }
+
+    // Ciphers and key exchange groups
+    if (!tlsConfig.getCipherList().empty() &&
+        1 != SSL_CTX_set_cipher_list(ctx, tlsConfig.getCipherList().c_str()))
+    {
+        LOG4CXX_ERROR(logger, "Invalid cipher list: " << tlsConfig.getCipherList());
+        return false;
+    }
+    if (!tlsConfig.getCipherSuites().empty() &&
+        1 != SSL_CTX_set_ciphersuites(ctx, tlsConfig.getCipherSuites().c_str()))
+    {
+        LOG4CXX_ERROR(logger, "Invalid TLS 1.3 cipher suites: " << tlsConfig.getCipherSuites());
+        return false;
+    }
+    if (!tlsConfig.getGroups().empty() &&
+        1 != SSL_CTX_set1_groups_list(ctx, tlsConfig.getGroups().c_str()))
+    {
+        LOG4CXX_ERROR(logger, "Invalid key exchange groups: " << tlsConfig.getGroups());
+        return false;
+    }
+    if (tlsConfig.isPreferServerCiphers())
+    {
+        SSL_CTX_set_options(ctx, SSL_OP_CIPHER_SERVER_PREFERENCE);
+    }
+
+    // Certificates for other kinds of keys, each of which must match its key
+    const vector<pair<string, string>>& certificates = tlsConfig.getCertificates();
+    for (size_t i = 0; i < certificates.size(); i++)
+    {
+        if (1 != SSL_CTX_use_certificate_chain_file(ctx, certificates[i].first.c_str()) ||
+            1 != SSL_CTX_use_PrivateKey_file(ctx, certificates[i].second.c_str(), SSL_FILETYPE_PEM) ||
+            1 != SSL_CTX_check_private_key(ctx))
+        {
+            LOG4CXX_ERROR(logger, "Could not set the certificate " << certificates[i].first <<
+                          " with the key " << certificates[i].second);
+            return false;
+        }
+    }
+
+    if (tlsConfig.isReleaseBuffers())
+    {
+        SSL_CTX_set_mode(ctx, SSL_MODE_RELEASE_BUFFERS);
+    }
+
+    return true;
+}
+
+void SecureRestServer::appendStatistics(string* str)
+{
+    TlsSessionStatistics stats;
+    getTlsSessionStatistics(&stats);
+    unsigned long long total = stats.resumed + stats.full;
+
+    str->append(",\"tlsSessions\":{\"resumed\":");
+    str->append(std::to_string(stats.resumed));
+    str->append(",\"full\":");
+    str->append(std::to_string(stats.full));
+    str->append(",\"resumedPercent\":");
+    str->append(std::to_string((0 < total) ? stats.resumed * 100 / total : 0));
+    str->append(",\"cachedSessions\":");
+    str->append(std::to_string(stats.cachedSessions));
+    str->append(",\"ticketKeyRotations\":");
+    str->append(std::to_string(stats.ticketKeyRotations));
+    str->append("}");
+
+    KtlsStatistics ktlsStats;
+    getKtlsStatistics(&ktlsStats);
+    str->append(",\"ktls\":{\"enabled\":");
+    str->append(ktlsStats.enabled ? "true" : "false");
+    str->append(",\"sendOffloaded\":");
+    str->append(std::to_string(ktlsStats.sendOffloaded));
+    str->append(",\"receiveOffloaded\":");
+    str->append(std::to_string(ktlsStats.receiveOffloaded));
+    str->append(",\"notOffloaded\":");
+    str->append(std::to_string(ktlsStats.notOffloaded));
+    str->append("}");
+
+    CryptoPoolStatistics cryptoStats;
+    ThreadPoolStatistics threadStats;
+    if (getCryptoPoolStatistics(&cryptoStats, &threadStats))
+    {
+        str->append(",\"cryptoPool\":{\"threads\":");
+        str->append(std::to_string(threadStats.size));
+        str->append(",\"offloaded\":");
+        str->append(std::to_string(cryptoStats.offloaded));
+        str->append(",\"inlined\":");
+        str->append(std::to_string(cryptoStats.inlined));
+        str->append(",\"cancelled\":");
+        str->append(std::to_string(cryptoStats.cancelled));
+        str->append(",\"queueDepth\":");
+        str->append(std::to_string(threadStats.queueDepth));
+        str->append(",\"maxQueueDepth\":");
+        str->append(std::to_string(threadStats.maxQueueDepth));
+        str->append(",\"averageQueueWaitMicros\":");
+        str->append(std::to_string(threadStats.averageWaitMicros));
+        str->append(",\"maxQueueWaitMicros\":");
+        str->append(std::to_string(threadStats.maxWaitMicros));
+        str->append("}");
+    }
+
+#ifdef CPPRESTLIB_HTTP2
+    Http2Statistics http2Stats;
+    Http2Session::getStatistics(&http2Stats);
+    str->append(",\"http2\":{\"enabled\":");
+    str->append(http2 ? "true" : "false");
+    str->append(",\"connections\":");
+    str->append(std::to_string(http2Stats.connections));
+    str->append(",\"streams\":");
+    str->append(std::to_string(http2Stats.streams));
+    str->append("}");
+#endif
 }
 
 bool SecureRestServer::createSecureContext(string ca_pem,
 										   string cert_pem,
 										   string key_pem)
 {
-    /* Get a default context */
-    if (!(ctx = SSL_CTX_new(SSLv23_server_method()))) {
+    /* Get a context for any protocol version, which the TLS configuration narrows */
+    if (!(ctx = SSL_CTX_new(TLS_server_method()))) {
         LOG4CXX_ERROR(logger, "SSL_CTX_new failed");
         return false;
     }
@@ -103,52 +397,365 @@ bool SecureRestServer::createSecureContext(string ca_pem,
     /* We accept only certificates signed only by the CA himself */
     SSL_CTX_set_verify_depth(ctx, 1);
 
+    if (!applyTlsConfig())
+    {
+		SSL_CTX_free(ctx);
+		ctx = nullptr;
+        return false;
+    }
+
+    if (!enableSessionResumption())
+    {
+		SSL_CTX_free(ctx);
+		ctx = nullptr;
+        return false;
+    }
+
+    if (0 < cryptoThreads && !enableCryptoPool())
+    {
+		SSL_CTX_free(ctx);
+		ctx = nullptr;
+        return false;
+    }
+
+    if (ktls)
+    {
+        enableKtls();
+    }
+
+    if (http2)
+    {
+        enableHttp2();
+    }
+
     return true;
 }
 
 Socket* SecureRestServer::createSocketObject(int sock)
 {
-    return new SslSocket(ctx, sock);
+    return SslSocket::create(ctx, sock);
+}
+
+void SecureRestServer::getSocketPoolStatistics(ObjectPoolStatistics* stats)
+{
+    ObjectPool<SslSocket>::getStatistics(stats);
+}
+
+bool SecureRestServer::enableCryptoPool()
+{
+    cryptoPool = new CryptoPool(cryptoThreads, CRYPTO_QUEUE_DEPTH);
+    if (!cryptoPool->start())
+    {
+        delete cryptoPool;
+        cryptoPool = nullptr;
+        return false;
+    }
+
+    // Only signatures are queued. The RSA key exchange, which decrypts with
+    // the key instead and has no forward secrecy, is not offered.
+    string cipherList = tlsConfig.getCipherList().empty() ? "DEFAULT" : tlsConfig.getCipherList();
+    cipherList.append(":!kRSA");
+    if (1 != SSL_CTX_set_cipher_list(ctx, cipherList.c_str()))
+    {
+        LOG4CXX_ERROR(logger, "Could not remove the RSA key exchange from the cipher list");
+        delete cryptoPool;
+        cryptoPool = nullptr;
+        return false;
+    }
+
+    // Replace each certificate's key with one whose operations are queued on
+    // the pool. Setting a key makes its certificate the current one again.
+    int ret = SSL_CTX_set_current_cert(ctx, SSL_CERT_SET_FIRST);
+    while (1 == ret)
+    {
+        EVP_PKEY* key = cryptoPool->wrapKey(SSL_CTX_get0_privatekey(ctx));
+        if (nullptr == key || 1 != SSL_CTX_use_PrivateKey(ctx, key))
+        {
+            LOG4CXX_ERROR(logger, "Could not give the server's key to the crypto pool");
+            EVP_PKEY_free(key);
+            delete cryptoPool;
+            cryptoPool = nullptr;
+            return false;
+        }
+        EVP_PKEY_free(key);
+        ret = SSL_CTX_set_current_cert(ctx, SSL_CERT_SET_NEXT);
+    }
+
+    // Run each handshake as a job that can be paused while it waits
+    SSL_CTX_set_mode(ctx, SSL_MODE_ASYNC);
+    LOG4CXX_DEBUG(logger, "Started " << cryptoThreads << " crypto threads");
+
+    return true;
+}
+
+void SecureRestServer::enableHttp2()
+{
+#ifdef CPPRESTLIB_HTTP2
+    SSL_CTX_set_alpn_select_cb(ctx, selectApplicationProtocol, nullptr);
+#else
+    LOG4CXX_WARN(logger, "The library was built without HTTP/2, so clients will be "
+                 "served with HTTP/1.1");
+#endif
+}
+
+void SecureRestServer::enableKtls()
+{
+#ifdef SSL_OP_ENABLE_KTLS
+    SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+
+    // Without the kernel's tls module every connection falls back to
+    // OpenSSL, which is worth knowing before the first one does
+    FILE* file = fopen(AVAILABLE_ULP_FILE, "r");
+    if (nullptr != file)
+    {
+        char ulps[BUFSIZE];
+        if (nullptr == fgets(ulps, sizeof(ulps), file) || nullptr == strstr(ulps, "tls"))
+        {
+            LOG4CXX_WARN(logger, "The kernel's tls module is not loaded, so connections "
+                         "will be encrypted by OpenSSL");
+        }
+        fclose(file);
+    }
+#else
+    LOG4CXX_WARN(logger, "This version of OpenSSL does not support kernel TLS, so "
+                 "connections will be encrypted by OpenSSL");
+#endif
+}
+
+bool SecureRestServer::enableSessionResumption()
+{
+    // A resumed session skips the client's certificate, so only sessions that
+    // this server verified may be resumed
+    SSL_CTX_set_app_data(ctx, this);
+    if (1 != SSL_CTX_set_session_id_context(ctx, (const unsigned char*)SESSION_ID_CONTEXT,
+                                            strlen(SESSION_ID_CONTEXT)))
+    {
+        LOG4CXX_ERROR(logger, "Could not set the session ID context");
+        return false;
+    }
+    SSL_CTX_set_timeout(ctx, sessionTimeout);
+
+    // Remember sessions so that clients can resume them by their ID
+    if (0 < sessionCacheSize)
+    {
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+        SSL_CTX_sess_set_cache_size(ctx, sessionCacheSize);
+    }
+    else
+    {
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+    }
+
+    // Let clients keep their sessions in tickets that only this server can
+    // read
+    if (!sessionTickets)
+    {
+        SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+        return true;
+    }
+    pthread_mutex_lock(&ticketKeyMutex);
+    bool generated = generateTicketKey();
+    pthread_mutex_unlock(&ticketKeyMutex);
+    if (!generated)
+    {
+        return false;
+    }
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, ticketKeyCallback);
+#else
+    SSL_CTX_set_tlsext_ticket_key_cb(ctx, ticketKeyCallback);
+#endif
+
+    return true;
+}
+
+bool SecureRestServer::generateTicketKey()
+{
+    SessionTicketKey key;
+    if (1 != RAND_bytes(key.name, sizeof(key.name)) ||
+        1 != RAND_bytes(key.aesKey, sizeof(key.aesKey)) ||
+        1 != RAND_bytes(key.hmacKey, sizeof(key.hmacKey)))
+    {
+        LOG4CXX_ERROR(logger, "Could not generate a session ticket key");
+        return false;
+    }
+    key.created = time(nullptr);
+
+    // The current key becomes the previous one
+    ticketKeys[1] = ticketKeys[0];
+    ticketKeys[0] = key;
+    OPENSSL_cleanse(&key, sizeof(key));
+    if (2 > ticketKeyCount)
+    {
+        ticketKeyCount++;
+    }
+    ticketKeyRotations++;
+    LOG4CXX_DEBUG(logger, "Generated session ticket key " << ticketKeyRotations);
+
+    return true;
+}
+
+int SecureRestServer::getTicketKey(unsigned char* keyName, unsigned char* iv,
+                                   EVP_CIPHER_CTX* cipherCtx, unsigned char* hmacKey,
+                                   int encrypt)
+{
+    pthread_mutex_lock(&ticketKeyMutex);
+
+    // Replace the current key once its lifetime is over
+    if (time(nullptr) - ticketKeys[0].created >= ticketKeyLifetime)
+    {
+        generateTicketKey();
+    }
+
+    int ret;
+    if (encrypt)
+    {
+        // Issue the ticket with the current key
+        const SessionTicketKey& key = ticketKeys[0];
+        ret = -1;
+        if (1 == RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) &&
+            1 == EVP_EncryptInit_ex(cipherCtx, EVP_aes_256_cbc(), nullptr, key.aesKey, iv))
+        {
+            memcpy(keyName, key.name, sizeof(key.name));
+            memcpy(hmacKey, key.hmacKey, sizeof(key.hmacKey));
+            ret = 1;
+        }
+    }
+    else
+    {
+        // Find the key that the ticket was issued with. One issued with the
+        // previous key is renewed, so that the client keeps a valid ticket.
+        ret = 0;
+        for (int i = 0; i < ticketKeyCount; i++)
+        {
+            const SessionTicketKey& key = ticketKeys[i];
+            if (0 != memcmp(keyName, key.name, sizeof(key.name)))
+            {
+                continue;
+            }
+            ret = -1;
+            if (1 == EVP_DecryptInit_ex(cipherCtx, EVP_aes_256_cbc(), nullptr, key.aesKey, iv))
+            {
+                memcpy(hmacKey, key.hmacKey, sizeof(key.hmacKey));
+                ret = (0 == i) ? 1 : 2;
+            }
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&ticketKeyMutex);
+
+    return ret;
+}
+
+bool SecureRestServer::getCryptoPoolStatistics(CryptoPoolStatistics* stats,
+                                               ThreadPoolStatistics* threadStats)
+{
+    if (nullptr == cryptoPool)
+    {
+        return false;
+    }
+
+    cryptoPool->getStatistics(stats);
+    cryptoPool->getThreadPoolStatistics(threadStats);
+
+    return true;
+}
+
+void SecureRestServer::getKtlsStatistics(KtlsStatistics* stats)
+{
+    stats->enabled = ktls;
+    stats->sendOffloaded = ktlsSendConnections.load(memory_order_relaxed);
+    stats->receiveOffloaded = ktlsReceiveConnections.load(memory_order_relaxed);
+    stats->notOffloaded = ktlsFallbacks.load(memory_order_relaxed);
+}
+
+void SecureRestServer::getTlsSessionStatistics(TlsSessionStatistics* stats)
+{
+    stats->resumed = resumedHandshakes.load(memory_order_relaxed);
+    stats->full = fullHandshakes.load(memory_order_relaxed);
+    stats->cachedSessions = (nullptr != ctx) ? SSL_CTX_sess_number(ctx) : 0;
+    pthread_mutex_lock(&ticketKeyMutex);
+    stats->ticketKeyRotations = ticketKeyRotations;
+    pthread_mutex_unlock(&ticketKeyMutex);
 }
 
-void SecureRestServer::manageClient(Socket* sock)
+bool SecureRestServer::prepareClient(Socket* sock)
 {
     // Cast the connection object to a secure object
     SslSocket* sslSocket = (SslSocket*)sock;
 
     // Perform secure handshake with the client
-    if (sslSocket->performHandshake() != 1) {
+    if (sslSocket->performHandshake(handshakeTimeout) != 1) {
         LOG4CXX_ERROR(logger, "Could not perform SSL handshake");
-        return;
+        return false;
+    }
+
+    return verifyClient(sock);
+}
+
+void SecureRestServer::rejectClient(Socket* sock)
+{
+    // The caller closes the connection
+    (void)sock;
+}
+
+void SecureRestServer::rotateSessionTicketKey()
+{
+    pthread_mutex_lock(&ticketKeyMutex);
+    if (0 < ticketKeyCount)
+    {
+        generateTicketKey();
     }
+    pthread_mutex_unlock(&ticketKeyMutex);
+}
+
+bool SecureRestServer::verifyClient(Socket* sock)
+{
+    SslSocket* sslSocket = (SslSocket*)sock;
     if (!sslSocket->clientVerified())
     {
         LOG4CXX_ERROR(logger, "Client's certifcate is not acceptable");
-        return;
+        return false;
     }
     LOG4CXX_DEBUG(logger, "Accepted client certificate with DN " <<
                   sslSocket->getClientDN());
 
-    // Set the client socket to non-blocking
-    sslSocket->setNonBlocking();
-
-    // Read the request
-    RestRequest* request = readRequest(sslSocket);
-    LOG4CXX_TRACE(logger, "Received request " << request->toString() <<
-                  " from client at " << sock->getRemoteAddress());
-
-    // Route the request to the appropriate handler
-    RestResponse* response = routeRequest(request);
-    string responseStr = response->toString();
+    // Count how often clients skip the full handshake
+    if (sslSocket->isSessionReused())
+    {
+        resumedHandshakes.fetch_add(1, memory_order_relaxed);
+    }
+    else
+    {
+        fullHandshakes.fetch_add(1, memory_order_relaxed);
+    }
 
-    // Write the response
-    sslSocket->write(responseStr.c_str(), responseStr.length());
-    LOG4CXX_TRACE(logger, "Sent response " << responseStr <<
-                  " to client at " << sock->getRemoteAddress());
+    // Find out whether the kernel took over the encryption. Depending on the
+    // kernel, the cipher and the TLS version, it may only do one direction.
+    if (ktls)
+    {
+        bool send = sslSocket->isKtlsSend();
+        bool receive = sslSocket->isKtlsReceive();
+        if (send)
+        {
+            ktlsSendConnections.fetch_add(1, memory_order_relaxed);
+        }
+        if (receive)
+        {
+            ktlsReceiveConnections.fetch_add(1, memory_order_relaxed);
+        }
+        if (!send && !receive)
+        {
+            ktlsFallbacks.fetch_add(1, memory_order_relaxed);
+        }
+        LOG4CXX_DEBUG(logger, "Kernel TLS for client at " << sock->getRemoteAddress() <<
+                      ": send " << (send ? "offloaded" : "in OpenSSL") <<
+                      ", receive " << (receive ? "offloaded" : "in OpenSSL") <<
+                      " (" << SSL_get_cipher_name(sslSocket->getSsl()) << ")");
+    }
 
-    // Clean up
-    delete request;
-    delete response;
+    return true;
 }
 
 bool SecureRestServer::setUp(
@@ -164,3 +771,14 @@ bool SecureRestServer::setUp(
 	
 	return createSecureContext(ca_pem, cert_pem, key_pem);
 }
+
+bool SecureRestServer::setUp(std::string port_str,
+                             std::string ca_pem,
+                             std::string cert_pem,
+                             std::string key_pem,
+                             const TlsConfig& config)
+{
+    tlsConfig = config;
+
+    return setUp(port_str, ca_pem, cert_pem, key_pem);
+}
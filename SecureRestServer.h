@@ -1,18 +1,62 @@
 #ifndef SECURERESTSERVER_H
 #define SECURERESTSERVER_H
 
+#include "CryptoPool.h"
 #include "RestServer.h"
 #include "SslSocket.h"
+#include "TlsConfig.h"
 #include "RestRequest.h"
 #include "RestResponse.h"
 
+#include <openssl/evp.h>
 #include <openssl/ssl.h>
 #include <pthread.h>
+#include <time.h>
 
+#include <atomic>
 #include <string>
 
+/* Sizes of the parts of a session ticket key */
+#define TICKET_KEY_NAME_SIZE 16
+#define TICKET_AES_KEY_SIZE 32
+#define TICKET_HMAC_KEY_SIZE 32
+
 namespace kaoisoft
 {
+    /**
+     * Key with which session tickets are encrypted and authenticated.
+     */
+    struct SessionTicketKey
+    {
+        unsigned char name[TICKET_KEY_NAME_SIZE];       // Identifies the key in the tickets it encrypted
+        unsigned char aesKey[TICKET_AES_KEY_SIZE];      // AES-256-CBC key
+        unsigned char hmacKey[TICKET_HMAC_KEY_SIZE];    // HMAC-SHA256 key
+        time_t created;                                 // When the key was generated
+    };
+
+    /**
+     * Snapshot of how often clients resume their TLS sessions.
+     */
+    struct TlsSessionStatistics
+    {
+        unsigned long long resumed;             // Handshakes that resumed a session (resumption hits)
+        unsigned long long full;                // Full handshakes (resumption misses)
+        long cachedSessions;                    // Sessions in the server-side cache
+        unsigned long long ticketKeyRotations;  // Number of ticket keys that have been generated
+    };
+
+    /**
+     * Snapshot of how many connections have their record encryption done by
+     * the kernel (kernel TLS).
+     */
+    struct KtlsStatistics
+    {
+        bool enabled;                           // Whether kernel TLS was requested
+        unsigned long long sendOffloaded;       // Connections whose writes the kernel encrypts
+        unsigned long long receiveOffloaded;    // Connections whose reads the kernel decrypts
+        unsigned long long notOffloaded;        // Connections that OpenSSL encrypts both ways (fallbacks)
+    };
+
 	/**
 	* REST server that communicates with clients via secure communications.
 	*/
@@ -20,11 +64,36 @@ namespace kaoisoft
 	{
 	private:
         SSL_CTX* ctx;                   // Context for secure communications with clients
+        long sessionCacheSize;          // Most sessions kept in the server-side cache (0 to disable it)
+        long sessionTimeout;            // Seconds for which a session may be resumed
+        bool sessionTickets;            // Whether clients are given session tickets
+        long ticketKeyLifetime;         // Seconds for which a ticket key encrypts new tickets
+        pthread_mutex_t ticketKeyMutex; // Protects the ticket keys
+        SessionTicketKey ticketKeys[2]; // Key for new tickets, then the one it replaced
+        int ticketKeyCount;             // Number of ticket keys that have been generated, up to 2
+        unsigned long long ticketKeyRotations;          // Number of ticket keys that have been generated
+        std::atomic<unsigned long long> resumedHandshakes;  // Handshakes that resumed a session
+        std::atomic<unsigned long long> fullHandshakes;     // Handshakes that did not
+        bool ktls;                      // Whether record encryption is handed to the kernel when it can
+        std::atomic<unsigned long long> ktlsSendConnections;    // Connections whose writes the kernel encrypts
+        std::atomic<unsigned long long> ktlsReceiveConnections; // Connections whose reads the kernel decrypts
+        std::atomic<unsigned long long> ktlsFallbacks;          // Connections that the kernel does not help with
+        int cryptoThreads;              // Number of threads that perform private key operations (0 to use the connection's thread)
+        CryptoPool* cryptoPool;         // Performs private key operations, or nullptr
+        TlsConfig tlsConfig;            // Protocol versions, ciphers, groups and extra certificates
+        bool http2;                     // Whether clients may choose HTTP/2 through ALPN
 
     private:
         static bool initialized;        // Whether the OpenSSL library has been initialized
 
 	private:
+        /**
+         * Applies the TLS configuration to the secure context, after the
+         * certificate given to setUp() has been loaded.
+         *
+         * @return true if successful
+         */
+        bool applyTlsConfig();
 
         /**
 		* Creates the secure context for communications.
@@ -39,7 +108,50 @@ namespace kaoisoft
 								std::string cert_pem,
 								std::string key_pem);
 
+        /**
+         * Sets up the session cache and session tickets of the secure context.
+         *
+         * @return true if successful
+         */
+        bool enableSessionResumption();
+
+        /**
+         * Starts the crypto pool and gives the secure context a copy of the
+         * server's key whose private operations the pool performs, with
+         * handshakes running as async jobs that wait for it.
+         *
+         * @return true if successful
+         */
+        bool enableCryptoPool();
+
+        /**
+         * Offers HTTP/2 and HTTP/1.1 to clients through ALPN.
+         */
+        void enableHttp2();
+
+        /**
+         * Lets OpenSSL hand the record encryption of each connection to the
+         * kernel once its handshake is done.
+         */
+        void enableKtls();
+
+        /**
+         * Makes a new key for encrypting session tickets. The key that it
+         * replaces is kept for decrypting the tickets that it encrypted. The
+         * caller must hold the ticket key mutex.
+         *
+         * @return true if successful
+         */
+        bool generateTicketKey();
+
     protected:
+        /**
+         * Adds the session resumption, kernel TLS, crypto pool and HTTP/2
+         * statistics to /system/statistics.
+         *
+         * @param str JSON object that is being built
+         */
+        virtual void appendStatistics(std::string* str) override;
 
         /**
          * Creates an instance of the socket wrapper class
@@ -51,16 +163,184 @@ namespace kaoisoft
         virtual Socket* createSocketObject(int sock) override;
 
         /**
-         * Manages a client connection.
+         * Gets the statistics of the pool from which createSocketObject()
+         * reuses socket objects.
+         *
+         * @param stats Structure into which the statistics are stored
+         */
+        virtual void getSocketPoolStatistics(ObjectPoolStatistics* stats) override;
+
+        /**
+         * Checks whether the server secures its connections.
+         *
+         * @return true
+         */
+        virtual bool isSecure() override { return true; }
+
+        /**
+         * Performs the secure handshake with a newly accepted client and
+         * verifies the client's certificate.
          *
          * @param sock Connection to the client
+         *
+         * @return true if the connection may be used, false if it should be closed
          */
-        virtual void manageClient(Socket* sock) override;
+        virtual bool prepareClient(Socket* sock) override;
+
+        /**
+         * Verifies the certificate of a client whose handshake has been
+         * completed, and counts whether the client resumed a session and
+         * whether the kernel took over the connection's encryption.
+         *
+         * @param sock Connection to the client
+         *
+         * @return true if the connection may be used, false if it should be closed
+         */
+        virtual bool verifyClient(Socket* sock) override;
+
+        /**
+         * Closes the connection of a client that cannot be served. No HTTP
+         * response can be sent because the secure handshake has not been
+         * performed yet.
+         *
+         * @param sock Connection to the client
+         */
+        virtual void rejectClient(Socket* sock) override;
 
 	public:
 		SecureRestServer();
 		~SecureRestServer();
 
+        /**
+         * Gets the key for a session ticket. This is called by OpenSSL when
+         * it issues a ticket to a client or a client presents one. A key is
+         * used for new tickets for the ticket key lifetime and is then
+         * replaced; tickets that the previous key encrypted are still
+         * accepted, and are renewed with the current key.
+         *
+         * @param keyName Name of the key, which is stored when a ticket is
+         *                issued and looked up otherwise
+         * @param iv Initialization vector, which is generated when a ticket
+         *           is issued
+         * @param cipherCtx Cipher context that is set up with the key
+         * @param hmacKey Buffer of TICKET_HMAC_KEY_SIZE bytes into which the
+         *                key's HMAC key is copied
+         * @param encrypt Whether a ticket is being issued
+         *
+         * @return 1 if the key was found, 2 if it was found but the ticket
+         *         should be renewed, 0 if the key is not known any more or
+         *         -1 on error
+         */
+        int getTicketKey(unsigned char* keyName, unsigned char* iv, EVP_CIPHER_CTX* cipherCtx,
+                         unsigned char* hmacKey, int encrypt);
+
+        /**
+         * Gets how many private key operations the crypto pool performed.
+         *
+         * @param stats Structure into which the statistics are stored
+         * @param threadStats Structure into which the sizing and activity of
+         *                    the pool's threads are stored
+         *
+         * @return true if successful, false if there is no crypto pool
+         */
+        bool getCryptoPoolStatistics(CryptoPoolStatistics* stats, ThreadPoolStatistics* threadStats);
+
+        /**
+         * Gets how many connections the kernel encrypts.
+         *
+         * @param stats Structure into which the statistics are stored
+         */
+        void getKtlsStatistics(KtlsStatistics* stats);
+
+        /**
+         * Gets how often clients have resumed their sessions.
+         *
+         * @param stats Structure into which the statistics are stored
+         */
+        void getTlsSessionStatistics(TlsSessionStatistics* stats);
+
+        /**
+         * Replaces the key with which new session tickets are encrypted
+         * before its lifetime is over. Tickets that the old key encrypted are
+         * still accepted until the key is replaced again.
+         */
+        void rotateSessionTicketKey();
+
+        /**
+         * Sets how many threads perform the private key operations of full
+         * handshakes, such as RSA signatures. With a crypto pool, a thread
+         * that serves connections goes on serving the others while a
+         * handshake waits for its signature, so a burst of new connections
+         * does not hold up the established ones. Only RSA and EC keys can be
+         * used with a pool. This must be called before setUp().
+         *
+         * @param count Number of threads, or 0 to perform the operations on
+         *              the thread that serves the connection
+         */
+        void setCryptoThreadCount(int count) { cryptoThreads = count; }
+
+        /**
+         * Sets whether clients may choose HTTP/2, through ALPN while the
+         * connection is secured, so that a client can have many requests in
+         * progress at once on one connection instead of opening one
+         * connection per request. Streams are dispatched through the same
+         * routes as HTTP/1.1 requests, in every server mode; their number is
+         * limited by setHttp2MaxConcurrentStreams(). This needs the library
+         * to be built with CPPRESTLIB_HTTP2; otherwise clients are served
+         * with HTTP/1.1. This must be called before setUp().
+         *
+         * @param enabled true to offer HTTP/2
+         */
+        void setHttp2Enabled(bool enabled) { http2 = enabled; }
+
+        /**
+         * Sets whether the kernel encrypts and decrypts the TLS records of
+         * each connection (kernel TLS), so that large responses are not
+         * copied and encrypted in user space. This needs the kernel's tls
+         * module and a cipher that the kernel supports, such as AES-GCM;
+         * connections for which the kernel cannot do it fall back to
+         * OpenSSL, which is reported by getKtlsStatistics(). This must be
+         * called before setUp().
+         *
+         * @param enabled true to use kernel TLS where possible
+         */
+        void setKtlsEnabled(bool enabled) { ktls = enabled; }
+
+        /**
+         * Sets the most sessions that the server remembers, so that clients
+         * can resume them by their ID. This must be called before setUp().
+         *
+         * @param size Number of sessions, or 0 to disable the cache
+         */
+        void setSessionCacheSize(long size) { sessionCacheSize = size; }
+
+        /**
+         * Sets how long a client may resume a session, whether from the cache
+         * or with a ticket. This must be called before setUp().
+         *
+         * @param seconds Session lifetime in seconds
+         */
+        void setSessionTimeout(long seconds) { sessionTimeout = seconds; }
+
+        /**
+         * Sets whether clients are given session tickets, with which they can
+         * resume a session without the server remembering it. This must be
+         * called before setUp().
+         *
+         * @param enabled true to issue tickets
+         */
+        void setSessionTicketsEnabled(bool enabled) { sessionTickets = enabled; }
+
+        /**
+         * Sets how long a ticket key is used to encrypt new tickets before it
+         * is replaced. A ticket stays valid until the key after the one that
+         * encrypted it is replaced too, or the session times out. This must
+         * be called before setUp().
+         *
+         * @param seconds Key lifetime in seconds
+         */
+        void setTicketKeyLifetime(long seconds) { ticketKeyLifetime = seconds; }
+
 		/**
 		 * Prepares the server to begin handling clients.
 		 * 
@@ -75,6 +355,25 @@ namespace kaoisoft
 			std::string ca_pem,
 			std::string cert_pem,
 			std::string key_pem);
+
+        /**
+         * Prepares the server to begin handling clients, with the protocol
+         * versions, ciphers, groups and extra certificates of a TLS
+         * configuration.
+         *
+         * @param port_str Port on which to listen
+         * @param ca_pem Certificate Authorities certificate file
+         * @param cert_pem Server's public certificate file
+         * @param key_pem Server's private key file
+         * @param config TLS configuration
+         *
+         * @return true if successful
+         */
+        bool setUp(std::string port_str,
+                   std::string ca_pem,
+                   std::string cert_pem,
+                   std::string key_pem,
+                   const TlsConfig& config);
 	};
 }
 
@@ -1,17 +1,39 @@
 #include "Socket.h"
+#include "ObjectPool.h"
 
-#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include <typeinfo>
+
 using namespace log4cxx;
 using namespace kaoisoft;
+using namespace std;
+
+/* Number of bytes requested from the connection each time the input buffer is filled */
+#define READ_CHUNK_SIZE 16384
+
+/* Most buffers passed to a single writev() call by writeAll() */
+#define MAX_WRITE_BUFFERS 16
+
+/* Largest input buffer that is kept when a socket object is recycled */
+#define MAX_KEPT_BUFFER_SIZE (4 * READ_CHUNK_SIZE)
 
 Socket::Socket()
 {
     sock = -1;
     remoteAddr = "undefined";
+    inBuffer = nullptr;
+    inCapacity = 0;
+    inStart = 0;
+    inEnd = 0;
 
     // Create the logger
     logger = Logger::getLogger("com.kaoisoft.Socket");
@@ -21,6 +43,13 @@ Socket::Socket(int sock)
 {
     this->sock = sock;
     remoteAddr = "undefined";
+    inBuffer = nullptr;
+    inCapacity = 0;
+    inStart = 0;
+    inEnd = 0;
+
+    // Create the logger
+    logger = Logger::getLogger("com.kaoisoft.Socket");
 }
 
 Socket::~Socket()
@@ -30,9 +59,165 @@ Socket::~Socket()
     {
         close(sock);
     }
+
+    free(inBuffer);
+}
+
+Socket* Socket::create(int sock)
+{
+    Socket* socket = ObjectPool<Socket>::take();
+    if (nullptr == socket)
+    {
+        return new Socket(sock);
+    }
+
+    socket->attach(sock);
+
+    return socket;
+}
+
+void Socket::detach()
+{
+    if (-1 != sock)
+    {
+        close(sock);
+        sock = -1;
+    }
+    remoteAddr = "undefined";
+    inStart = 0;
+    inEnd = 0;
+
+    // Don't hold on to the memory of an unusually large request
+    if (MAX_KEPT_BUFFER_SIZE < inCapacity)
+    {
+        free(inBuffer);
+        inBuffer = nullptr;
+        inCapacity = 0;
+    }
+}
+
+void Socket::recycle()
+{
+    if (typeid(*this) != typeid(Socket))
+    {
+        delete this;
+        return;
+    }
+
+    detach();
+    ObjectPool<Socket>::release(this);
+}
+
+bool Socket::appendBuffer(const char* data, size_t length)
+{
+    if (!reserveBuffer(length))
+    {
+        return false;
+    }
+    memcpy(inBuffer + inEnd, data, length);
+    inEnd += length;
+
+    return true;
+}
+
+void Socket::consume(size_t count)
+{
+    inStart += (count < inEnd - inStart) ? count : inEnd - inStart;
+    if (inStart == inEnd)
+    {
+        // Start over at the front of the buffer
+        inStart = 0;
+        inEnd = 0;
+    }
+}
+
+int Socket::fillBuffer()
+{
+    if (!reserveBuffer(READ_CHUNK_SIZE))
+    {
+        return -1;
+    }
+
+    int ret = readSocket(inBuffer + inEnd, READ_CHUNK_SIZE);
+    if (0 < ret)
+    {
+        inEnd += ret;
+    }
+
+    return ret;
 }
 
 int Socket::read(char* buff, int max)
+{
+    // Return buffered data first
+    if (inStart < inEnd)
+    {
+        size_t count = inEnd - inStart;
+        if ((size_t)max < count)
+        {
+            count = max;
+        }
+        memcpy(buff, inBuffer + inStart, count);
+        consume(count);
+        return (int)count;
+    }
+
+    return readSocket(buff, max);
+}
+
+string Socket::readBytes(size_t count)
+{
+    // Receive data until there is enough or no more is available
+    while (inEnd - inStart < count && 0 < fillBuffer())
+    {
+    }
+
+    size_t available = inEnd - inStart;
+    if (0 == available)
+    {
+        return "";
+    }
+    string str(inBuffer + inStart, (count < available) ? count : available);
+    consume(str.length());
+
+    return str;
+}
+
+string Socket::readLine()
+{
+    // Receive data until a linefeed has arrived or no more is available
+    size_t scanned = 0;
+    const char* lf = nullptr;
+    while (true)
+    {
+        size_t available = inEnd - inStart;
+        if (scanned < available &&
+            nullptr != (lf = (const char*)memchr(inBuffer + inStart + scanned, '\n',
+                                                available - scanned)))
+        {
+            break;
+        }
+        scanned = available;
+        if (0 >= fillBuffer())
+        {
+            // Return what has arrived so far
+            return readBytes(available);
+        }
+    }
+
+    // Remove the line and its terminator from the buffer
+    size_t length = lf - (inBuffer + inStart);
+    string str(inBuffer + inStart, length);
+    consume(length + 1);
+    if (0 < str.length() && '\r' == str[str.length() - 1])
+    {
+        str.erase(str.length() - 1);
+    }
+
+    return str;
+}
+
+int Socket::readSocket(char* buff, int max)
 {
     int ret = ::read(sock, buff, max);
     if (-1 == ret)
@@ -42,21 +227,71 @@ int Socket::read(char* buff, int max)
             return 0;
         }
     }
+    else if (0 == ret && 0 < max)
+    {
+        // The client closed the connection
+        return -1;
+    }
     return ret;
 }
 
-bool Socket::setNonBlocking()
+bool Socket::reserveBuffer(size_t count)
+{
+    // Make room after the unconsumed data
+    if (inCapacity - inEnd < count)
+    {
+        size_t used = inEnd - inStart;
+        if (0 < inStart && inCapacity - used >= count)
+        {
+            // Move the unconsumed data to the front of the buffer
+            memmove(inBuffer, inBuffer + inStart, used);
+        }
+        else
+        {
+            // Grow the buffer
+            size_t capacity = (0 < inCapacity) ? inCapacity * 2 : READ_CHUNK_SIZE;
+            while (capacity - used < count)
+            {
+                capacity *= 2;
+            }
+            char* buffer = (char*)malloc(capacity);
+            if (nullptr == buffer)
+            {
+                LOG4CXX_ERROR(logger, "Could not allocate " << capacity << " bytes for the input buffer");
+                return false;
+            }
+            if (0 < used)
+            {
+                memcpy(buffer, inBuffer + inStart, used);
+            }
+            free(inBuffer);
+            inBuffer = buffer;
+            inCapacity = capacity;
+        }
+        inStart = 0;
+        inEnd = used;
+    }
+
+    return true;
+}
+
+bool Socket::setNoDelay()
 {
-    // Get the socket's current flags
-    int flags = fcntl(sock, F_GETFL);
-    if (-1 == flags)
+    int val = 1;
+    if (-1 == setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &val, sizeof(val)))
     {
-        LOG4CXX_ERROR(logger, "Cannot set socket to non-blocking. Could not get socket's flags: " << strerror(errno));
+        LOG4CXX_ERROR(logger, "Cannot disable Nagle's algorithm on socket: " << strerror(errno));
         return false;
     }
 
-    // Set the non-blocking flag
-    if (-1 == fcntl(sock, F_SETFL, flags | O_NONBLOCK))
+    return true;
+}
+
+bool Socket::setNonBlocking()
+{
+    // Set the non-blocking flag without reading the socket's other flags first
+    int val = 1;
+    if (-1 == ioctl(sock, FIONBIO, &val))
     {
         LOG4CXX_ERROR(logger, "Cannot set socket to non-blocking: " << strerror(errno));
         return false;
@@ -65,6 +300,51 @@ bool Socket::setNonBlocking()
     return true;
 }
 
+bool Socket::waitReadable(int timeout)
+{
+    if (hasPendingData())
+    {
+        return true;
+    }
+
+    struct pollfd pfd;
+    pfd.fd = sock;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    int ret;
+    while (-1 == (ret = poll(&pfd, 1, timeout)) && EINTR == errno)
+    {
+    }
+    if (-1 == ret)
+    {
+        LOG4CXX_ERROR(logger, "Could not wait for the socket to become readable: " << strerror(errno));
+        return false;
+    }
+
+    return 0 < ret;
+}
+
+bool Socket::waitWritable(int timeout)
+{
+    struct pollfd pfd;
+    pfd.fd = sock;
+    pfd.events = POLLOUT;
+    pfd.revents = 0;
+
+    int ret;
+    while (-1 == (ret = poll(&pfd, 1, timeout)) && EINTR == errno)
+    {
+    }
+    if (-1 == ret)
+    {
+        LOG4CXX_ERROR(logger, "Could not wait for the socket to become writable: " << strerror(errno));
+        return false;
+    }
+
+    return 0 < ret;
+}
+
 int Socket::write(const char* buff, int len)
 {
     int ret = ::write(sock, buff, len);
@@ -77,3 +357,83 @@ int Socket::write(const char* buff, int len)
     }
     return ret;
 }
+
+bool Socket::writeAll(const struct iovec* iov, int count, int timeout)
+{
+    struct iovec pending[MAX_WRITE_BUFFERS];
+    int index = 0;          // First buffer that has not been completely written
+    size_t offset = 0;      // Number of bytes of that buffer that have been written
+
+    while (index < count)
+    {
+        // Skip empty buffers
+        if (offset == iov[index].iov_len)
+        {
+            index++;
+            offset = 0;
+            continue;
+        }
+
+        // Gather the unwritten parts of the buffers
+        int pendingCount = 0;
+        for (int i = index; i < count && pendingCount < MAX_WRITE_BUFFERS; i++)
+        {
+            pending[pendingCount].iov_base = (char*)iov[i].iov_base + ((i == index) ? offset : 0);
+            pending[pendingCount].iov_len = iov[i].iov_len - ((i == index) ? offset : 0);
+            pendingCount++;
+        }
+
+        int ret = writev(pending, pendingCount);
+        if (-1 == ret)
+        {
+            return false;
+        }
+        if (0 == ret)
+        {
+            // Wait for the client to read some of the data
+            if (!waitWritable(timeout))
+            {
+                LOG4CXX_DEBUG(logger, "Timed out writing to client at " << remoteAddr);
+                return false;
+            }
+            continue;
+        }
+
+        // Move past the data that was written
+        size_t written = ret;
+        while (0 < written)
+        {
+            size_t remaining = iov[index].iov_len - offset;
+            if (written < remaining)
+            {
+                offset += written;
+                break;
+            }
+            written -= remaining;
+            index++;
+            offset = 0;
+        }
+    }
+
+    return true;
+}
+
+int Socket::writev(const struct iovec* iov, int count)
+{
+    // sendmsg() is used rather than ::writev() so that a client that has gone
+    // away causes an error instead of SIGPIPE
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = (struct iovec*)iov;
+    msg.msg_iovlen = count;
+
+    int ret = sendmsg(sock, &msg, MSG_NOSIGNAL);
+    if (-1 == ret)
+    {
+        if (EWOULDBLOCK == errno || EAGAIN == errno || EINTR == errno)
+        {
+            return 0;
+        }
+    }
+    return ret;
+}
@@ -3,27 +3,184 @@
 
 #include <log4cxx/logger.h>
 
+#include <sys/uio.h>
+
 #include <string>
+#include <string_view>
 
 namespace kaoisoft
 {
     /**
      * Wrapper around a POSIX TCP socket.
+     *
+     * Data is received in large chunks into an input buffer that belongs to
+     * the connection. Reads (including line and fixed-length reads) are served
+     * from that buffer, and bytes that are left over after a request has been
+     * read stay there for the next request.
+     *
+     * Connections to clients are created with create() and finished with
+     * recycle(), which keep finished objects, along with their input
+     * buffers, in an ObjectPool for the next connection.
      */
     class Socket
     {
+    public:
+        /**
+         * Progress of the handshake that secures a connection.
+         *
+         *   HANDSHAKE_DONE - the connection is ready for requests
+         *   HANDSHAKE_WANT_READ - the handshake continues once the socket is
+         *                         readable
+         *   HANDSHAKE_WANT_WRITE - the handshake continues once the socket is
+         *                          writable
+         *   HANDSHAKE_WANT_ASYNC - the handshake continues once the handle
+         *                          from getAsyncWaitHandle() is readable
+         *   HANDSHAKE_FAILED - the connection must be closed
+         */
+        enum HandshakeStatus { HANDSHAKE_DONE, HANDSHAKE_WANT_READ, HANDSHAKE_WANT_WRITE,
+                               HANDSHAKE_WANT_ASYNC, HANDSHAKE_FAILED };
+
     private:
         int sock;                   // Socket handle
         std::string remoteAddr;     // Address of the remote end of the connection
+        char* inBuffer;             // Data received from the socket
+        size_t inCapacity;          // Size of inBuffer
+        size_t inStart;             // Offset of the first byte in inBuffer that has not been consumed
+        size_t inEnd;               // Offset just past the last byte received into inBuffer
 
     protected:
         log4cxx::LoggerPtr logger;  // Logging object
 
+    protected:
+        /**
+         * Reads data directly from the connection, bypassing the input buffer.
+         *
+         * @param buff Buffer into which the data is stored
+         * @param max Maximum number of bytes to read
+         *
+         * @return The actual number of bytes read, 0 if no data is available on
+         *         a non-blocking socket, or -1 if an error occurred or the
+         *         connection was closed
+         */
+        virtual int readSocket(char* buff, int max);
+
+    private:
+        /**
+         * Makes room in the input buffer for more data after the bytes that
+         * have not been consumed yet.
+         *
+         * @param count Number of bytes to make room for
+         *
+         * @return true if successful
+         */
+        bool reserveBuffer(size_t count);
+
+    protected:
+        /**
+         * Starts wrapping a socket handle.
+         *
+         * @param sock Handle to the socket to wrap
+         */
+        void attach(int sock) { this->sock = sock; }
+
+        /**
+         * Closes the connection and forgets everything about it, so that the
+         * object can be reused for another one. Small input buffers are kept.
+         */
+        virtual void detach();
+
     public:
         Socket();
         Socket(int sock);
         virtual ~Socket();
 
+        /**
+         * Creates a socket object, reusing one that was recycled if possible.
+         *
+         * @param sock Handle to the socket to wrap
+         *
+         * @return The socket object, which must be finished with recycle()
+         */
+        static Socket* create(int sock);
+
+        /**
+         * Closes the connection and keeps the object for reuse by create().
+         * The object must not be used afterwards. Objects of derived classes
+         * that do not override this are deleted.
+         */
+        virtual void recycle();
+
+        /**
+         * Performs as much of the handshake that secures the connection as
+         * can be done without waiting. The caller calls this again when the
+         * socket is ready in the way that the returned status asks for.
+         * Plain connections have no handshake.
+         *
+         * @return The handshake's progress
+         */
+        virtual HandshakeStatus continueHandshake() { return HANDSHAKE_DONE; }
+
+        /**
+         * Gets the handle that becomes readable when an operation which the
+         * handshake is waiting for, such as a signature that is computed on
+         * another thread, has finished.
+         *
+         * @return The handle, or -1 if the handshake is not waiting for one
+         */
+        virtual int getAsyncWaitHandle() { return -1; }
+
+        /**
+         * Gets the application protocol that the client chose while securing
+         * the connection (ALPN), such as "h2" for HTTP/2.
+         *
+         * @return The protocol's ID, or an empty view if none was chosen
+         */
+        virtual std::string_view getApplicationProtocol() { return std::string_view(); }
+
+        /**
+         * Adds data that was received from the connection by other means,
+         * such as an io_uring completion, to the end of the input buffer.
+         *
+         * @param data Data received
+         * @param length Number of bytes received
+         *
+         * @return true if successful
+         */
+        bool appendBuffer(const char* data, size_t length);
+
+        /**
+         * Removes data from the front of the input buffer.
+         *
+         * @param count Number of bytes to remove
+         */
+        void consume(size_t count);
+
+        /**
+         * Receives the next chunk of data from the connection into the input
+         * buffer.
+         *
+         * @return The number of bytes received, 0 if no data is available on a
+         *         non-blocking socket, or -1 if an error occurred or the
+         *         connection was closed
+         */
+        int fillBuffer();
+
+        /**
+         * Gets the data in the input buffer that has not been consumed yet.
+         * The pointer is valid until the next call that reads from the socket.
+         *
+         * @return Pointer to the first unconsumed byte
+         */
+        const char* getBufferedData() { return inBuffer + inStart; }
+
+        /**
+         * Gets the number of bytes in the input buffer that have not been
+         * consumed yet.
+         *
+         * @return
+         */
+        size_t getBufferedLength() { return inEnd - inStart; }
+
         /**
          * Gets the wrapped socket handle.
          *
@@ -34,14 +191,53 @@ namespace kaoisoft
         std::string getRemoteAddress() { return remoteAddr; }
 
         /**
-         * Reads data from the socket.
+         * Checks whether data has already been received and buffered above the
+         * OS socket, so that it can be read without waiting for the socket to
+         * become readable.
+         *
+         * @return true if there is buffered data
+         */
+        virtual bool hasPendingData() { return inStart < inEnd; }
+
+        /**
+         * Reads data from the socket. Buffered data is returned first.
          *
          * @param buff Buffer into which the data is stored
          * @param max Maximum number of bytes to read
          *
-         * @return The actual number of bytes read or -1 if an error occurred
+         * @return The actual number of bytes read, 0 if no data is available on
+         *         a non-blocking socket, or -1 if an error occurred or the
+         *         connection was closed
          */
-        virtual int read(char* buff, int max);
+        int read(char* buff, int max);
+
+        /**
+         * Reads up to a number of bytes, stopping early if no more data is
+         * available.
+         *
+         * @param count Maximum number of bytes to read
+         *
+         * @return The data read
+         */
+        std::string readBytes(size_t count);
+
+        /**
+         * Reads a line (until a linefeed is encountered or until no more data
+         * is available).
+         *
+         * @return The line read, excluding the trailing CR/LF
+         */
+        std::string readLine();
+
+        /**
+         * Turns off Nagle's algorithm, so that a write is sent at once rather
+         * than held back until the client has acknowledged the previous one.
+         * Responses are already gathered into as few writes as possible, so
+         * nothing is gained by the kernel delaying them.
+         *
+         * @return true if successful
+         */
+        bool setNoDelay();
 
         /**
          * Sets the socket to non-blocking mode.
@@ -52,6 +248,26 @@ namespace kaoisoft
 
         void setRemoteAddress(std::string remoteAddr) { this->remoteAddr = remoteAddr; }
 
+        /**
+         * Waits for data to be available for reading.
+         *
+         * @param timeout Maximum number of milliseconds to wait, or -1 to wait forever
+         *
+         * @return true if data can be read (or the connection was closed by the
+         *         client), false if the timeout expired or an error occurred
+         */
+        bool waitReadable(int timeout);
+
+        /**
+         * Waits for the socket to accept more data.
+         *
+         * @param timeout Maximum number of milliseconds to wait, or -1 to wait forever
+         *
+         * @return true if data can be written, false if the timeout expired or
+         *         an error occurred
+         */
+        bool waitWritable(int timeout);
+
         /**
          * Writes data to the socket.
          *
@@ -61,6 +277,33 @@ namespace kaoisoft
          * @return The actual number of bytes written or -1 if an error occurred
          */
         virtual int write(const char* buff, int len);
+
+        /**
+         * Writes all of the data in a set of buffers, waiting for the socket
+         * whenever it is full. The buffers are written in order without being
+         * copied together first.
+         *
+         * @param iov Buffers to write
+         * @param count Number of buffers
+         * @param timeout Maximum number of milliseconds to wait each time the
+         *                socket is full, or -1 to wait forever
+         *
+         * @return true if everything was written, false if an error occurred
+         *         or the timeout expired
+         */
+        bool writeAll(const struct iovec* iov, int count, int timeout);
+
+        /**
+         * Writes data from a set of buffers to the socket, in order, with a
+         * single call. This may write less than the total length.
+         *
+         * @param iov Buffers to write
+         * @param count Number of buffers
+         *
+         * @return The actual number of bytes written, 0 if the socket is full,
+         *         or -1 if an error occurred
+         */
+        virtual int writev(const struct iovec* iov, int count);
     };
 }
 
@@ -1,15 +1,32 @@
 #include "SslSocket.h"
+#include "ObjectPool.h"
 
+#include <openssl/err.h>
 #include <openssl/x509.h>
 
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <typeinfo>
+
 using namespace kaoisoft;
 using namespace std;
 using namespace log4cxx;
 
+/* Largest amount of plaintext that fits in one TLS record */
+#define TLS_RECORD_SIZE 16384
+
 SslSocket::SslSocket(SSL_CTX* ctx, int sock) : Socket(sock)
 {
     // Create the logger
     logger = Logger::getLogger("com.kaoisoft.SslSocket");
+    ktlsSend = false;
+    asyncWait.fd = -1;
+    asyncWait.pending = nullptr;
 
     /* Get an SSL handle from the context */
     if (!(ssl = SSL_new(ctx))) {
@@ -20,22 +37,107 @@ SslSocket::SslSocket(SSL_CTX* ctx, int sock) : Socket(sock)
 
     /* Associate the newly accepted connection with this handle */
     SSL_set_fd(ssl, sock);
+
+    /* Let writes be completed in pieces on the non-blocking socket */
+    SSL_set_mode(ssl, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
 }
 
 SslSocket::SslSocket(SSL* ssl) : Socket(SSL_get_fd(ssl))
 {
     this->ssl = ssl;
+    ktlsSend = false;
+    asyncWait.fd = -1;
+    asyncWait.pending = nullptr;
+
+    /* Let writes be completed in pieces on the non-blocking socket */
+    SSL_set_mode(ssl, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
 }
 
 SslSocket::~SslSocket()
 {
     if (nullptr != ssl)
     {
-        SSL_shutdown(ssl);
+        abandonAsyncOperation();
+        if (SSL_is_init_finished(ssl))
+        {
+            SSL_shutdown(ssl);
+        }
         SSL_free(ssl);
+        ERR_clear_error();
+    }
+    if (-1 != asyncWait.fd)
+    {
+        close(asyncWait.fd);
     }
 }
 
+SslSocket* SslSocket::create(SSL_CTX* ctx, int sock)
+{
+    SslSocket* socket = ObjectPool<SslSocket>::take();
+    if (nullptr == socket)
+    {
+        return new SslSocket(ctx, sock);
+    }
+
+    socket->attach(sock);
+    socket->ktlsSend = false;
+    if (!(socket->ssl = SSL_new(ctx)))
+    {
+        LOG4CXX_ERROR(socket->logger, "Could not get an SSL handle from the context");
+        return socket;
+    }
+    SSL_set_fd(socket->ssl, sock);
+    SSL_set_mode(socket->ssl, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
+    return socket;
+}
+
+void SslSocket::detach()
+{
+    if (nullptr != ssl)
+    {
+        abandonAsyncOperation();
+
+        // A connection whose handshake never finished cannot be shut down.
+        // Errors left behind by this connection must not be mistaken for
+        // those of the next one that the thread serves.
+        if (SSL_is_init_finished(ssl))
+        {
+            SSL_shutdown(ssl);
+        }
+        SSL_free(ssl);
+        ssl = nullptr;
+        ERR_clear_error();
+    }
+
+    Socket::detach();
+}
+
+void SslSocket::abandonAsyncOperation()
+{
+    if (nullptr == asyncWait.pending)
+    {
+        return;
+    }
+
+    // The resumed job sees that the operation was cancelled and fails the
+    // handshake
+    CryptoPool::cancel(&asyncWait);
+    continueHandshake();
+}
+
+void SslSocket::recycle()
+{
+    if (typeid(*this) != typeid(SslSocket))
+    {
+        delete this;
+        return;
+    }
+
+    detach();
+    ObjectPool<SslSocket>::release(this);
+}
+
 bool SslSocket::clientVerified()
 {
     return X509_V_OK == SSL_get_verify_result(ssl);
@@ -58,12 +160,122 @@ string SslSocket::getClientDN()
     return subject;
 }
 
-int SslSocket::performHandshake()
+bool SslSocket::hasPendingData()
+{
+    return Socket::hasPendingData() || 0 < SSL_pending(ssl);
+}
+
+bool SslSocket::isKtlsReceive()
 {
-	return SSL_accept(ssl);
+    return nullptr != ssl && BIO_get_ktls_recv(SSL_get_rbio(ssl));
 }
 
-int SslSocket::read(char* buff, int max)
+SslSocket::HandshakeStatus SslSocket::continueHandshake()
+{
+    if (nullptr == ssl)
+    {
+        return HANDSHAKE_FAILED;
+    }
+
+    // Let a private key operation that is queued on the crypto pool find the
+    // connection that waits for it
+    CryptoPool::setCurrentWait(&asyncWait);
+    int ret = SSL_accept(ssl);
+    CryptoPool::setCurrentWait(nullptr);
+    if (1 == ret)
+    {
+        // OpenSSL hands the keys to the kernel, if it can, once the
+        // handshake is done
+        ktlsSend = BIO_get_ktls_send(SSL_get_wbio(ssl));
+        return HANDSHAKE_DONE;
+    }
+    int err = SSL_get_error(ssl, ret);
+    if (SSL_ERROR_WANT_READ == err)
+    {
+        return HANDSHAKE_WANT_READ;
+    }
+    if (SSL_ERROR_WANT_WRITE == err)
+    {
+        return HANDSHAKE_WANT_WRITE;
+    }
+    if (SSL_ERROR_WANT_ASYNC == err)
+    {
+        return HANDSHAKE_WANT_ASYNC;
+    }
+
+    unsigned long code = ERR_peek_error();
+    if (0 != code)
+    {
+        char reason[256];
+        ERR_error_string_n(code, reason, sizeof(reason));
+        LOG4CXX_DEBUG(logger, "Handshake with client at " << getRemoteAddress() <<
+                      " failed: " << reason);
+    }
+    ERR_clear_error();
+
+    return HANDSHAKE_FAILED;
+}
+
+string_view SslSocket::getApplicationProtocol()
+{
+    const unsigned char* protocol;
+    unsigned int length;
+    SSL_get0_alpn_selected(ssl, &protocol, &length);
+
+    return string_view((const char*)protocol, length);
+}
+
+int SslSocket::getAsyncWaitHandle()
+{
+    return (nullptr != asyncWait.pending) ? asyncWait.fd : -1;
+}
+
+int SslSocket::performHandshake(int timeout)
+{
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // The socket is non-blocking, so wait whenever OpenSSL needs to read or
+    // write more of the handshake
+    HandshakeStatus status;
+    while (HANDSHAKE_DONE != (status = continueHandshake()))
+    {
+        if (HANDSHAKE_FAILED == status)
+        {
+            return -1;
+        }
+
+        // Only wait for what is left of the timeout
+        int remaining = timeout;
+        if (0 <= timeout)
+        {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            long long elapsed = (ts.tv_sec - start.tv_sec) * 1000LL +
+                                (ts.tv_nsec - start.tv_nsec) / 1000000;
+            remaining = (elapsed < timeout) ? (int)(timeout - elapsed) : 0;
+        }
+
+        // An operation on the crypto pool signals its own handle
+        struct pollfd pfd;
+        pfd.fd = (HANDSHAKE_WANT_ASYNC == status) ? getAsyncWaitHandle() : getHandle();
+        pfd.events = (HANDSHAKE_WANT_WRITE == status) ? POLLOUT : POLLIN;
+        pfd.revents = 0;
+        int count;
+        while (-1 == (count = poll(&pfd, 1, remaining)) && EINTR == errno)
+        {
+        }
+        if (0 >= count)
+        {
+            LOG4CXX_DEBUG(logger, "Timed out waiting for the client's handshake");
+            return -1;
+        }
+    }
+
+    return 1;
+}
+
+int SslSocket::readSocket(char* buff, int max)
 {
     int ret = SSL_read(ssl, buff, max);
     if (0 >= ret)
@@ -86,6 +298,15 @@ int SslSocket::read(char* buff, int max)
 
 int SslSocket::write(const char* buff, int len)
 {
+    // The kernel builds the records itself
+    if (ktlsSend)
+    {
+        struct iovec iov;
+        iov.iov_base = (void*)buff;
+        iov.iov_len = len;
+        return Socket::writev(&iov, 1);
+    }
+
     int ret = SSL_write(ssl, buff, len);
     if (0 >= ret)
     {
@@ -104,3 +325,48 @@ int SslSocket::write(const char* buff, int len)
         return ret;
     }
 }
+
+int SslSocket::writev(const struct iovec* iov, int count)
+{
+    // Skip empty buffers
+    while (0 < count && 0 == iov->iov_len)
+    {
+        iov++;
+        count--;
+    }
+    if (0 == count)
+    {
+        return 0;
+    }
+
+    // The kernel builds the records from all of the buffers without them
+    // being copied here
+    if (ktlsSend)
+    {
+        return Socket::writev(iov, count);
+    }
+
+    // A buffer that fills a record by itself is written where it is
+    if (TLS_RECORD_SIZE <= iov->iov_len || 1 == count)
+    {
+        return write((const char*)iov->iov_base,
+                     ((size_t)INT_MAX < iov->iov_len) ? INT_MAX : (int)iov->iov_len);
+    }
+
+    // Gather the smaller buffers into a single record. Since the same data
+    // is passed again after the socket was full, the same record is rebuilt.
+    char record[TLS_RECORD_SIZE];
+    size_t length = 0;
+    for (int i = 0; i < count && TLS_RECORD_SIZE > length; i++)
+    {
+        size_t part = iov[i].iov_len;
+        if (TLS_RECORD_SIZE - length < part)
+        {
+            part = TLS_RECORD_SIZE - length;
+        }
+        memcpy(record + length, iov[i].iov_base, part);
+        length += part;
+    }
+
+    return write(record, (int)length);
+}
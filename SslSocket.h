@@ -1,6 +1,7 @@
 #ifndef _SSLSOCKET_H
 #define _SSLSOCKET_H
 
+#include "CryptoPool.h"
 #include "Socket.h"
 
 #include <openssl/ssl.h>
@@ -15,12 +16,85 @@ namespace kaoisoft
     class SslSocket : public Socket
 	{
 	private:
-        SSL* ssl;       // Secured connection
-		
+        SSL* ssl;                   // Secured connection
+        bool ktlsSend;              // Whether the kernel encrypts the records that are written
+        AsyncKeyWait asyncWait;     // Lets the handshake wait for the crypto pool
+
+    private:
+        /**
+         * Cancels the crypto pool operation that the handshake is waiting
+         * for, if any, and lets OpenSSL finish the paused job so that the SSL
+         * handle can be freed.
+         */
+        void abandonAsyncOperation();
+
+    protected:
+		/**
+		 * Reads decrypted data directly from the connection, bypassing the
+		 * input buffer.
+		 * 
+		 * @param buff Buffer into which the data is stored
+		 * @param max Maximum number of bytes to read
+		 * 
+		 * @return The actual number of bytes read, 0 if no data is available on
+		 *         a non-blocking socket, or -1 if an error occurred or the
+		 *         connection was closed
+		 */
+        virtual int readSocket(char* buff, int max) override;
+
+        /**
+         * Shuts the secured connection down and releases it, then closes the
+         * connection. A handshake that is waiting for the crypto pool is
+         * abandoned first. A new SSL handle is created when the object is reused,
+         * since OpenSSL only supports clearing one for the same peer.
+         */
+        virtual void detach() override;
+
 	public:
         SslSocket(SSL_CTX* ctx, int sock);
         SslSocket(SSL* ssl);
 		virtual ~SslSocket();
+
+        /**
+         * Creates a secured socket object, reusing one that was recycled if
+         * possible.
+         *
+         * @param ctx Context from which the SSL handle is created
+         * @param sock Handle to the socket to wrap
+         *
+         * @return The socket object, which must be finished with recycle()
+         */
+        static SslSocket* create(SSL_CTX* ctx, int sock);
+
+        /**
+         * Closes the connection and keeps the object for reuse by create().
+         * The object must not be used afterwards.
+         */
+        virtual void recycle() override;
+
+        /**
+         * Performs as much of the server side of the TLS handshake as can be
+         * done without waiting.
+         *
+         * @return The handshake's progress
+         */
+        virtual HandshakeStatus continueHandshake() override;
+
+        /**
+         * May be called after performHandshake() to get the application
+         * protocol that was agreed with the client through ALPN.
+         *
+         * @return The protocol's ID, or an empty view if none was chosen
+         */
+        virtual std::string_view getApplicationProtocol() override;
+
+        /**
+         * Gets the eventfd that is signaled when the crypto pool has finished
+         * an operation for the handshake.
+         *
+         * @return The handle, or -1 if the handshake is not waiting for one
+         */
+        virtual int getAsyncWaitHandle() override;
 		
         /**
          * May be called after performHandshake() to verify that the client's
@@ -39,22 +113,53 @@ namespace kaoisoft
          */
         std::string getClientDN();
 
+        SSL* getSsl() { return ssl; }
+
+        /**
+         * Checks whether buffered data or a decrypted record is waiting to be
+         * read.
+         *
+         * @return true if there is buffered data
+         */
+        virtual bool hasPendingData() override;
+
+        /**
+         * May be called after performHandshake() to find out whether the
+         * kernel decrypts the records that are read (kernel TLS).
+         *
+         * @return true if receiving is offloaded to the kernel
+         */
+        bool isKtlsReceive();
+
+        /**
+         * May be called after performHandshake() to find out whether the
+         * kernel encrypts the records that are written (kernel TLS). If it
+         * does, data is written straight to the socket instead of being
+         * passed through SSL_write().
+         *
+         * @return true if sending is offloaded to the kernel
+         */
+        bool isKtlsSend() { return ktlsSend; }
+
+        /**
+         * May be called after performHandshake() to find out whether the
+         * client resumed an earlier session instead of performing a full
+         * handshake.
+         *
+         * @return true if the session was resumed
+         */
+        bool isSessionReused() { return 1 == SSL_session_reused(ssl); }
+
 		/**
-		 * Performs the SSL handshake with the client.
+		 * Performs the SSL handshake with the client, waiting for the socket
+		 * whenever continueHandshake() asks for it.
+		 *
+		 * @param timeout Milliseconds that the whole handshake may take, or
+		 *                -1 to wait forever
 		 * 
 		 * @return 1 if successful
 		 */
-		int performHandshake();
-		
-		/**
-		 * Reads data from the socket.
-		 * 
-		 * @param buff Buffer into which the data is stored
-		 * @param max Maximum number of bytes to read
-		 * 
-		 * @return The actual number of bytes read or -1 if an error occurred
-		 */
-        virtual int read(char* buff, int max) override;
+		int performHandshake(int timeout);
 		
         void setSsl(SSL* ssl) { this->ssl = ssl; }
 
@@ -67,6 +172,24 @@ namespace kaoisoft
 		 * @return The actual number of bytes written or -1 if an error occurred
 		 */
         virtual int write(const char* buff, int len) override;
+
+        /**
+         * Writes data from a set of buffers to the socket. When the kernel
+         * encrypts the records, the buffers are handed to it in one call.
+         * Otherwise, since SSL_write() has no scatter-gather form, buffers
+         * that are smaller than a TLS record are gathered into one record
+         * instead of each being sent in a record of its own, and a large
+         * buffer at the front is written without being copied.
+         *
+         * After 0 is returned, the call must be repeated with the same data.
+         *
+         * @param iov Buffers to write
+         * @param count Number of buffers
+         *
+         * @return The actual number of bytes written, 0 if the socket is full,
+         *         or -1 if an error occurred
+         */
+        virtual int writev(const struct iovec* iov, int count) override;
 	};
 }
 
@@ -0,0 +1,68 @@
+#include "StaticResponse.h"
+#include "HttpDate.h"
+
+using namespace kaoisoft;
+using namespace std;
+
+/* Room for a closing block: the Date and Connection headers and the blank line */
+#define CLOSING_BLOCK_SIZE (HTTP_DATE_LENGTH + 48)
+
+StaticResponse::StaticResponse(const RestResponse& response)
+{
+    body = response.getBody();
+    code = response.getCode();
+    headers = response.getHeaderMap();
+    hasDate = false;
+
+    head.append(response.getProtocol());
+    head.append(" ");
+    head.append(std::to_string(response.getCode()));
+    head.append(" ");
+    head.append(response.getReason());
+    head.append("\r\n");
+    const HeaderMap<string>& headers = response.getHeaderMap();
+    for (size_t i = 0; i < headers.size(); i++)
+    {
+        // Content-Length is always the real one, and Connection is added for
+        // each request
+        const HeaderMap<string>::Entry& entry = headers.at(i);
+        if (HeaderNames::CONTENT_LENGTH == entry.id)
+        {
+            continue;
+        }
+        if (HeaderNames::CONNECTION == entry.id)
+        {
+            connection = entry.value;
+            continue;
+        }
+        if (HeaderNames::DATE == entry.id)
+        {
+            hasDate = true;
+        }
+        head.append(entry.name);
+        head.append(": ");
+        head.append(entry.value);
+        head.append("\r\n");
+    }
+    head.append("Content-Length: ");
+    head.append(std::to_string(body.length()));
+    head.append("\r\n");
+}
+
+std::pmr::string StaticResponse::getClosingBlock(bool keepAlive,
+                                                 std::pmr::memory_resource* resource) const
+{
+    std::pmr::string str(resource);
+    str.reserve(CLOSING_BLOCK_SIZE);
+
+    if (!hasDate)
+    {
+        str.append("Date: ");
+        str.append(HttpDate::now());
+        str.append("\r\n");
+    }
+    str.append(keepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n");
+    str.append("\r\n");
+
+    return str;
+}
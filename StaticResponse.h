@@ -0,0 +1,92 @@
+#ifndef STATICRESPONSE_H
+#define STATICRESPONSE_H
+
+#include "RestResponse.h"
+
+#include <memory_resource>
+#include <string>
+#include <string_view>
+
+namespace kaoisoft
+{
+    /**
+     * Response that never changes, serialized once so that it can be written
+     * to any number of clients without calling a handler or building it
+     * again.
+     *
+     * The status line, the headers and Content-Length are kept as one block,
+     * which is followed on the wire by a short closing block and the body.
+     * The closing block holds the only parts that differ from one request to
+     * the next: the Date header, unless the response has its own, and the
+     * Connection header, which depends on whether the connection is kept
+     * open.
+     *
+     * A static response is immutable once it has been created, so any number
+     * of threads may send it at the same time.
+     */
+    class StaticResponse
+    {
+    private:
+        std::string head;           // Status line, headers and Content-Length
+        int code;                   // HTTP status code
+        HeaderMap<std::string> headers;     // Headers, for protocols that encode them differently
+        std::string body;           // Body that follows the headers
+        std::string connection;     // Connection header that the response was given, or empty
+        bool hasDate;               // Whether the response has its own Date header
+
+    public:
+        /**
+         * Serializes a response.
+         *
+         * @param response Response to serialize. Its Connection header is
+         *                 only used to decide whether connections are kept
+         *                 open, and its Content-Length header is replaced by
+         *                 the body's real length.
+         */
+        explicit StaticResponse(const RestResponse& response);
+
+        const std::string& getBody() const { return body; }
+
+        int getCode() const { return code; }
+
+        /**
+         * Gets the response's own headers, for HTTP/2, which does not use the
+         * serialized head. Content-Length and Connection are included as the
+         * response was given them.
+         *
+         * @return The headers
+         */
+        const HeaderMap<std::string>& getHeaderMap() const { return headers; }
+
+        /**
+         * Gets the Connection header that the response was given, so that a
+         * response that asks for the connection to be closed still does.
+         *
+         * @return The header's value, or an empty view if there was none
+         */
+        std::string_view getConnectionView() const { return connection; }
+
+        /**
+         * Gets the status line, the headers and Content-Length, which are
+         * written before the closing block.
+         *
+         * @return The serialized block
+         */
+        const std::string& getHead() const { return head; }
+
+        /**
+         * Builds the block that is written between the head and the body: the
+         * current Date header, unless the response has its own, the
+         * Connection header and the blank line that ends the headers.
+         *
+         * @param keepAlive Whether the connection is kept open after the
+         *                  response has been sent
+         * @param resource Memory resource, which must outlive the block
+         *
+         * @return The closing block
+         */
+        std::pmr::string getClosingBlock(bool keepAlive, std::pmr::memory_resource* resource) const;
+    };
+}
+
+#endif // STATICRESPONSE_H
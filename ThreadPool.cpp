@@ -0,0 +1,186 @@
+#include "ThreadPool.h"
+
+using namespace kaoisoft;
+using namespace std;
+using namespace log4cxx;
+
+ThreadPool::ThreadPool(int size, size_t queueCapacity, FullPolicy fullPolicy)
+{
+    this->size = (0 < size) ? size : 1;
+    this->queueCapacity = (0 < queueCapacity) ? queueCapacity : 1;
+    this->fullPolicy = fullPolicy;
+    running = false;
+    maxQueueDepth = 0;
+    submitted = 0;
+    started = 0;
+    completed = 0;
+    rejected = 0;
+    totalWaitMicros = 0;
+    maxWaitMicros = 0;
+
+    pthread_mutex_init(&mutex, nullptr);
+    pthread_cond_init(&notEmpty, nullptr);
+    pthread_cond_init(&notFull, nullptr);
+
+    // Create the logger
+    logger = Logger::getLogger("com.kaoisoft.ThreadPool");
+}
+
+ThreadPool::~ThreadPool()
+{
+    stop();
+
+    pthread_cond_destroy(&notFull);
+    pthread_cond_destroy(&notEmpty);
+    pthread_mutex_destroy(&mutex);
+}
+
+void ThreadPool::getStatistics(ThreadPoolStatistics* stats)
+{
+    pthread_mutex_lock(&mutex);
+
+    stats->size = size;
+    stats->queueCapacity = queueCapacity;
+    stats->queueDepth = queue.size();
+    stats->maxQueueDepth = maxQueueDepth;
+    stats->submitted = submitted;
+    stats->completed = completed;
+    stats->rejected = rejected;
+    stats->averageWaitMicros = (0 < started) ? totalWaitMicros / started : 0;
+    stats->maxWaitMicros = maxWaitMicros;
+
+    pthread_mutex_unlock(&mutex);
+}
+
+void ThreadPool::runJobs()
+{
+    struct timespec now;
+
+    pthread_mutex_lock(&mutex);
+    while (true)
+    {
+        // Wait for a job
+        while (running && queue.empty())
+        {
+            pthread_cond_wait(&notEmpty, &mutex);
+        }
+        if (queue.empty())
+        {
+            // The pool was stopped and there is nothing left to do
+            break;
+        }
+
+        // Take the job from the queue
+        Job job = queue.front();
+        queue.pop_front();
+        pthread_cond_signal(&notFull);
+
+        // Record how long the job waited
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        unsigned long long waitMicros =
+                (now.tv_sec - job.queued.tv_sec) * 1000000ULL +
+                (now.tv_nsec - job.queued.tv_nsec) / 1000;
+        started++;
+        totalWaitMicros += waitMicros;
+        if (waitMicros > maxWaitMicros)
+        {
+            maxWaitMicros = waitMicros;
+        }
+
+        // Run the job without holding the lock
+        pthread_mutex_unlock(&mutex);
+        (job.function)(job.arg);
+        pthread_mutex_lock(&mutex);
+
+        completed++;
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+bool ThreadPool::start()
+{
+    pthread_mutex_lock(&mutex);
+    running = true;
+    pthread_mutex_unlock(&mutex);
+
+    // Start the workers
+    for (int i = 0; i < size; i++)
+    {
+        pthread_t threadId;
+        if (0 != pthread_create(&threadId, nullptr, ThreadPool::workerThread,
+                                (void*)this))
+        {
+            LOG4CXX_ERROR(logger, "Could not start worker thread " << i);
+            stop();
+            return false;
+        }
+        threads.push_back(threadId);
+    }
+
+    LOG4CXX_DEBUG(logger, "Started " << size << " worker threads with a queue of " <<
+                  queueCapacity << " jobs");
+
+    return true;
+}
+
+void ThreadPool::stop()
+{
+    // Wake up everybody that is waiting on the pool
+    pthread_mutex_lock(&mutex);
+    running = false;
+    pthread_cond_broadcast(&notEmpty);
+    pthread_cond_broadcast(&notFull);
+    pthread_mutex_unlock(&mutex);
+
+    // Wait for the workers to finish the jobs that are already queued
+    vector<pthread_t>::iterator iter;
+    for (iter = threads.begin(); iter != threads.end(); iter++)
+    {
+        pthread_join(*iter, nullptr);
+    }
+    threads.clear();
+}
+
+bool ThreadPool::submit(THREAD_POOL_JOB function, void* arg)
+{
+    Job job;
+    job.function = function;
+    job.arg = arg;
+
+    pthread_mutex_lock(&mutex);
+
+    // Wait for room in the queue, if that is what was asked for
+    while (running && queue.size() >= queueCapacity && BLOCK == fullPolicy)
+    {
+        pthread_cond_wait(&notFull, &mutex);
+    }
+    if (!running || queue.size() >= queueCapacity)
+    {
+        rejected++;
+        pthread_mutex_unlock(&mutex);
+        return false;
+    }
+
+    // Queue the job
+    clock_gettime(CLOCK_MONOTONIC, &job.queued);
+    queue.push_back(job);
+    submitted++;
+    if (queue.size() > maxQueueDepth)
+    {
+        maxQueueDepth = queue.size();
+    }
+    pthread_cond_signal(&notEmpty);
+
+    pthread_mutex_unlock(&mutex);
+
+    return true;
+}
+
+void* ThreadPool::workerThread(void* args)
+{
+    ThreadPool* inst = (ThreadPool*)args;
+
+    inst->runJobs();
+
+    return nullptr;
+}
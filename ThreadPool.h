@@ -0,0 +1,146 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <log4cxx/logger.h>
+#include <pthread.h>
+#include <time.h>
+
+#include <deque>
+#include <vector>
+
+namespace kaoisoft
+{
+    /**
+     * Job run by a thread pool. This has the same signature as a pthread start
+     * routine, so thread functions can be submitted to a pool unchanged. The
+     * return value is ignored.
+     *
+     * Parameters:
+     *   void* - argument that was passed to ThreadPool::submit()
+     */
+    typedef void*(*THREAD_POOL_JOB)(void*);
+
+    /**
+     * Snapshot of a thread pool's sizing and activity.
+     */
+    struct ThreadPoolStatistics
+    {
+        int size;                               // Number of worker threads
+        size_t queueCapacity;                   // Maximum number of queued jobs
+        size_t queueDepth;                      // Number of jobs that are currently queued
+        size_t maxQueueDepth;                   // Largest number of jobs that have been queued at once
+        unsigned long long submitted;           // Number of jobs that were queued
+        unsigned long long completed;           // Number of jobs that have finished running
+        unsigned long long rejected;            // Number of jobs that were refused because the queue was full
+        unsigned long long averageWaitMicros;   // Average time a job spent in the queue
+        unsigned long long maxWaitMicros;       // Longest time a job spent in the queue
+    };
+
+    /**
+     * Fixed-size pool of worker threads that run jobs from a bounded queue.
+     */
+    class ThreadPool
+    {
+    public:
+        /**
+         * What submit() does when the queue is full.
+         *
+         *   BLOCK - wait until there is room in the queue
+         *   REJECT - refuse the job so that the caller can tell the client
+         *   DROP - refuse the job so that the caller can discard it
+         */
+        enum FullPolicy { BLOCK, REJECT, DROP };
+
+    private:
+        /**
+         * A queued job.
+         */
+        struct Job
+        {
+            THREAD_POOL_JOB function;   // Function to run
+            void* arg;                  // Argument passed to the function
+            struct timespec queued;     // When the job was queued
+        };
+
+    private:
+        int size;                               // Number of worker threads
+        size_t queueCapacity;                   // Maximum number of queued jobs
+        FullPolicy fullPolicy;                  // What to do when the queue is full
+        std::deque<Job> queue;                  // Jobs waiting for a worker
+        std::vector<pthread_t> threads;         // Worker threads
+        bool running;                           // Whether jobs are being accepted
+        pthread_mutex_t mutex;                  // Protects the queue and the statistics
+        pthread_cond_t notEmpty;                // Signaled when a job is queued
+        pthread_cond_t notFull;                 // Signaled when a job is taken from the queue
+        size_t maxQueueDepth;                   // Largest number of jobs that have been queued at once
+        unsigned long long submitted;           // Number of jobs that were queued
+        unsigned long long started;             // Number of jobs that have been taken from the queue
+        unsigned long long completed;           // Number of jobs that have finished running
+        unsigned long long rejected;            // Number of jobs that were refused
+        unsigned long long totalWaitMicros;     // Total time jobs have spent in the queue
+        unsigned long long maxWaitMicros;       // Longest time a job spent in the queue
+        log4cxx::LoggerPtr logger;              // Logger for instances of this class
+
+    private:
+        /**
+         * Takes jobs from the queue and runs them until the pool is stopped
+         * and the queue is empty.
+         */
+        void runJobs();
+
+    public:
+        /**
+         * @param size Number of worker threads
+         * @param queueCapacity Maximum number of jobs that may wait for a worker
+         * @param fullPolicy What to do when the queue is full
+         */
+        ThreadPool(int size, size_t queueCapacity, FullPolicy fullPolicy);
+        virtual ~ThreadPool();
+
+        FullPolicy getFullPolicy() { return fullPolicy; }
+
+        /**
+         * Gets a snapshot of the pool's sizing and activity.
+         *
+         * @param stats Structure into which the statistics are stored
+         */
+        void getStatistics(ThreadPoolStatistics* stats);
+
+        /**
+         * Starts the worker threads.
+         *
+         * @return true if successful
+         */
+        bool start();
+
+        /**
+         * Stops accepting jobs and waits for the workers to finish the jobs
+         * that are already queued.
+         */
+        void stop();
+
+        /**
+         * Queues a job to be run by one of the workers.
+         *
+         * @param function Function to run
+         * @param arg Argument passed to the function
+         *
+         * @return true if the job was queued, false if the queue is full (and
+         *         the policy is not BLOCK) or the pool has been stopped. The
+         *         caller still owns arg when false is returned.
+         */
+        bool submit(THREAD_POOL_JOB function, void* arg);
+
+    public:
+        /**
+         * Runs in its own thread and executes queued jobs.
+         *
+         * @param Pointer to the pool instance
+         *
+         * @return nullptr
+         */
+        static void* workerThread(void* args);
+    };
+}
+
+#endif // THREADPOOL_H
@@ -0,0 +1,12 @@
+#include "TlsConfig.h"
+
+using namespace kaoisoft;
+using namespace std;
+
+TlsConfig::TlsConfig()
+{
+    minProtocolVersion = 0;
+    maxProtocolVersion = 0;
+    preferServerCiphers = false;
+    releaseBuffers = false;
+}
@@ -0,0 +1,175 @@
+#ifndef TLSCONFIG_H
+#define TLSCONFIG_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace kaoisoft
+{
+    /**
+     * Protocol versions, ciphers, key exchange groups and certificates with
+     * which a SecureRestServer secures its connections.
+     *
+     * Anything that is left unset keeps OpenSSL's default. Handshakes are
+     * cheapest with TLS 1.3 only (one round trip fewer than TLS 1.2), an
+     * ECDSA certificate (signing is far cheaper than with RSA) and the X25519
+     * group, for example:
+     *
+     *   config.setMinProtocolVersion(TLS1_3_VERSION);
+     *   config.setGroups("X25519:P-256");
+     *   config.addCertificate("server-ecdsa.crt", "server-ecdsa.key");
+     *
+     * Giving the server both an RSA and an ECDSA certificate lets each client
+     * be served with the cheapest certificate that it supports.
+     */
+    class TlsConfig
+    {
+    private:
+        int minProtocolVersion;         // Lowest protocol version, such as TLS1_2_VERSION, or 0 for the default
+        int maxProtocolVersion;         // Highest protocol version, or 0 for the highest supported
+        std::string cipherList;         // Ciphers for TLS 1.2 and earlier, or empty for the default
+        std::string cipherSuites;       // Cipher suites for TLS 1.3, or empty for the default
+        std::string groups;             // Key exchange groups in order of preference, or empty for the default
+        bool preferServerCiphers;       // Whether the server's order of preference wins over the client's
+        bool releaseBuffers;            // Whether idle connections give back their read and write buffers
+        std::vector<std::pair<std::string, std::string>> certificates;  // Certificate and key files besides the ones given to setUp()
+
+    public:
+        TlsConfig();
+
+        /**
+         * Adds a certificate for another kind of key, such as an ECDSA
+         * certificate next to the RSA one given to SecureRestServer::setUp().
+         * The server holds one certificate per kind of key, so a certificate
+         * replaces any earlier one of the same kind.
+         *
+         * @param cert_pem Certificate file
+         * @param key_pem Private key file for the certificate
+         */
+        void addCertificate(std::string cert_pem, std::string key_pem)
+        {
+            certificates.push_back(std::make_pair(cert_pem, key_pem));
+        }
+
+        /**
+         * Gets the certificates that were added with addCertificate().
+         *
+         * @return Pairs of certificate and key files
+         */
+        const std::vector<std::pair<std::string, std::string>>& getCertificates() const
+        {
+            return certificates;
+        }
+
+        /**
+         * Gets the ciphers for TLS 1.2 and earlier.
+         *
+         * @return OpenSSL cipher list, or an empty string for the default
+         */
+        const std::string& getCipherList() const { return cipherList; }
+
+        /**
+         * Gets the cipher suites for TLS 1.3.
+         *
+         * @return OpenSSL cipher suites, or an empty string for the default
+         */
+        const std::string& getCipherSuites() const { return cipherSuites; }
+
+        /**
+         * Gets the key exchange groups.
+         *
+         * @return Groups separated by colons, or an empty string for the default
+         */
+        const std::string& getGroups() const { return groups; }
+
+        /**
+         * Gets the highest protocol version.
+         *
+         * @return Version, or 0 for the highest supported
+         */
+        int getMaxProtocolVersion() const { return maxProtocolVersion; }
+
+        /**
+         * Gets the lowest protocol version.
+         *
+         * @return Version, or 0 for OpenSSL's default
+         */
+        int getMinProtocolVersion() const { return minProtocolVersion; }
+
+        /**
+         * Checks whether the server's order of preference is used to choose
+         * the cipher and group.
+         *
+         * @return true if the server's order wins
+         */
+        bool isPreferServerCiphers() const { return preferServerCiphers; }
+
+        /**
+         * Checks whether idle connections give back their buffers.
+         *
+         * @return true if the buffers are released
+         */
+        bool isReleaseBuffers() const { return releaseBuffers; }
+
+        /**
+         * Sets the ciphers for TLS 1.2 and earlier, such as
+         * "ECDHE+AESGCM:ECDHE+CHACHA20".
+         *
+         * @param list OpenSSL cipher list, or an empty string for the default
+         */
+        void setCipherList(std::string list) { cipherList = list; }
+
+        /**
+         * Sets the cipher suites for TLS 1.3, such as
+         * "TLS_AES_128_GCM_SHA256:TLS_CHACHA20_POLY1305_SHA256".
+         *
+         * @param suites OpenSSL cipher suites, or an empty string for the default
+         */
+        void setCipherSuites(std::string suites) { cipherSuites = suites; }
+
+        /**
+         * Sets the key exchange groups (curves) in order of preference, such
+         * as "X25519:P-256". A TLS 1.3 client that guessed the first group
+         * right needs no extra round trip.
+         *
+         * @param list Groups separated by colons, or an empty string for the default
+         */
+        void setGroups(std::string list) { groups = list; }
+
+        /**
+         * Sets the highest protocol version that clients may use.
+         *
+         * @param version Version, such as TLS1_2_VERSION, or 0 for the highest supported
+         */
+        void setMaxProtocolVersion(int version) { maxProtocolVersion = version; }
+
+        /**
+         * Sets the lowest protocol version that clients may use. With
+         * TLS1_3_VERSION, every handshake takes a single round trip.
+         *
+         * @param version Version, such as TLS1_3_VERSION, or 0 for OpenSSL's default
+         */
+        void setMinProtocolVersion(int version) { minProtocolVersion = version; }
+
+        /**
+         * Sets whether the cipher and group are chosen by the server's order
+         * of preference rather than the client's.
+         *
+         * @param prefer true to use the server's order
+         */
+        void setPreferServerCiphers(bool prefer) { preferServerCiphers = prefer; }
+
+        /**
+         * Sets whether a connection gives back its read and write buffers
+         * (about 34 KB) whenever it has nothing buffered, at the cost of
+         * allocating them again for the next record. This suits servers with
+         * many idle keep-alive connections.
+         *
+         * @param release true to release the buffers
+         */
+        void setReleaseBuffers(bool release) { releaseBuffers = release; }
+    };
+}
+
+#endif // TLSCONFIG_H
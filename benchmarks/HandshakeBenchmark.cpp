@@ -0,0 +1,353 @@
+/**
+ * Measures how many TLS handshakes per second a SecureRestServer can handle,
+ * with and without session resumption.
+ *
+ * A SecureRestServer is started in this process. Client threads then open
+ * connections to it for a fixed amount of time, each one sending a single
+ * request and closing the connection once the response has arrived. The test
+ * is run twice: once with every connection performing a full handshake, and
+ * once with every connection resuming the session of the client's previous
+ * connection. The number of resumed and full handshakes that the server
+ * counted is reported too.
+ *
+ * Usage:
+ *   handshake_benchmark [-m modes] [-c clients] [-d seconds] [-p threads] [-k] [-2]
+ *                       [-g groups] [-e ecdsa.crt ecdsa.key]
+ *                       ca.crt server.crt server.key client.crt client.key
+ *
+ *   -m  Server modes to test, separated by commas: 0 = thread per connection,
+ *       1 = event loop, 2 = thread pool (default 0)
+ *   -c  Number of client threads (default 8)
+ *   -d  Number of seconds to run each test (default 5)
+ *   -p  Number of crypto threads that perform the server's private key
+ *       operations (default 0, which performs them on the connection's thread)
+ *   -k  Disable session tickets, so that sessions are resumed from the
+ *       server's cache
+ *   -2  Limit the connections to TLS 1.2
+ *   -g  Key exchange groups that the server prefers, such as X25519:P-256
+ *   -e  Give the server a second certificate, such as an ECDSA one, which
+ *       the clients prefer over an RSA one
+ */
+
+#include <CppRestLib/SecureRestServer.h>
+
+#include <log4cxx/basicconfigurator.h>
+#include <log4cxx/level.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <openssl/ssl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+using namespace kaoisoft;
+using namespace std;
+
+/* Port used by the server under test */
+#define SECURE_PORT "18443"
+
+/* Request sent on each connection */
+#define REQUEST "GET /system/version HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n"
+
+/**
+ * Arguments passed to the client threads.
+ */
+struct ClientArgs
+{
+    int port;                       // Port to connect to
+    SSL_CTX* ctx;                   // Context for the connections
+    bool resume;                    // Whether to resume the previous connection's session
+    volatile bool* running;         // Cleared when the test is over
+    unsigned long long completed;   // Number of connections that were served
+    unsigned long long errors;      // Number of failed connections
+};
+
+/* Names of the server modes */
+static const char* modeNames[] = { "thread", "epoll", "pool", "io_uring" };
+
+/**
+ * Opens a connection to the server, sends the request and reads the whole
+ * response.
+ *
+ * @param port Port to connect to
+ * @param ctx Context for the connection
+ * @param session Session to resume, or nullptr. It is replaced by the
+ *                connection's session.
+ *
+ * @return true if successful
+ */
+static bool runConnection(int port, SSL_CTX* ctx, SSL_SESSION** session)
+{
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (-1 == sock)
+    {
+        return false;
+    }
+    int val = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &val, sizeof(val));
+
+    struct sockaddr_in sin;
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sin.sin_port = htons(port);
+    if (0 != connect(sock, (struct sockaddr*)&sin, sizeof(sin)))
+    {
+        close(sock);
+        return false;
+    }
+
+    SSL* ssl = SSL_new(ctx);
+    SSL_set_fd(ssl, sock);
+    if (nullptr != *session)
+    {
+        SSL_set_session(ssl, *session);
+    }
+    bool success = false;
+    if (1 == SSL_connect(ssl) &&
+        (int)strlen(REQUEST) == SSL_write(ssl, REQUEST, strlen(REQUEST)))
+    {
+        // The server closes the connection after the response. Reading it
+        // also picks up the session tickets that a TLS 1.3 server sends.
+        char buff[4096];
+        string response;
+        int ret;
+        while (0 < (ret = SSL_read(ssl, buff, sizeof(buff))))
+        {
+            response.append(buff, ret);
+        }
+        success = (0 == response.compare(0, 12, "HTTP/1.1 200"));
+    }
+
+    // Keep the session for the next connection. A session is only
+    // resumable if the connection was shut down properly.
+    if (success)
+    {
+        SSL_shutdown(ssl);
+        if (nullptr != *session)
+        {
+            SSL_SESSION_free(*session);
+        }
+        *session = SSL_get1_session(ssl);
+    }
+    SSL_free(ssl);
+    close(sock);
+
+    return success;
+}
+
+/**
+ * Runs in its own thread and opens connections until the test is over.
+ */
+static void* clientThread(void* args)
+{
+    ClientArgs* clientArgs = (ClientArgs*)args;
+    SSL_SESSION* session = nullptr;
+
+    while (*(clientArgs->running))
+    {
+        if (runConnection(clientArgs->port, clientArgs->ctx, &session))
+        {
+            clientArgs->completed++;
+        }
+        else
+        {
+            clientArgs->errors++;
+        }
+
+        // Start from scratch every time unless sessions are being resumed
+        if (!clientArgs->resume && nullptr != session)
+        {
+            SSL_SESSION_free(session);
+            session = nullptr;
+        }
+    }
+
+    if (nullptr != session)
+    {
+        SSL_SESSION_free(session);
+    }
+
+    return nullptr;
+}
+
+/**
+ * Opens connections to a server from several threads and reports the rate.
+ */
+static void runTest(const char* name, SecureRestServer* server, SSL_CTX* ctx, int clients,
+                    int seconds, bool resume)
+{
+    TlsSessionStatistics before, after;
+    server->getTlsSessionStatistics(&before);
+
+    // Start the clients
+    volatile bool running = true;
+    vector<ClientArgs> args(clients);
+    vector<pthread_t> threads(clients);
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < clients; i++)
+    {
+        args[i].port = atoi(SECURE_PORT);
+        args[i].ctx = ctx;
+        args[i].resume = resume;
+        args[i].running = &running;
+        args[i].completed = 0;
+        args[i].errors = 0;
+        pthread_create(&threads[i], nullptr, clientThread, &args[i]);
+    }
+
+    // Let them run
+    sleep(seconds);
+    running = false;
+    unsigned long long completed = 0, errors = 0;
+    for (int i = 0; i < clients; i++)
+    {
+        pthread_join(threads[i], nullptr);
+        completed += args[i].completed;
+        errors += args[i].errors;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    server->getTlsSessionStatistics(&after);
+
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("%-15s %-8s %3d clients: %9.0f handshakes/s (%llu resumed, %llu full, %llu errors)\n",
+           name, resume ? "resumed" : "full", clients, completed / elapsed,
+           after.resumed - before.resumed, after.full - before.full, errors);
+}
+
+int main(int argc, char* argv[])
+{
+    vector<int> modes;
+    int clients = 8;
+    int seconds = 5;
+    int cryptoThreads = 0;
+    bool tickets = true;
+    bool tls12 = false;
+    TlsConfig config;
+    vector<string> certs;
+
+    // Parse the arguments
+    for (int i = 1; i < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "-m") && i + 1 < argc)
+        {
+            // Collect the comma-separated modes
+            const char* arg = argv[++i];
+            while ('\0' != *arg)
+            {
+                modes.push_back(atoi(arg));
+                const char* comma = strchr(arg, ',');
+                arg = (nullptr != comma) ? comma + 1 : arg + strlen(arg);
+            }
+        }
+        else if (0 == strcmp(argv[i], "-c") && i + 1 < argc)
+        {
+            clients = atoi(argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "-d") && i + 1 < argc)
+        {
+            seconds = atoi(argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "-p") && i + 1 < argc)
+        {
+            cryptoThreads = atoi(argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "-k"))
+        {
+            tickets = false;
+        }
+        else if (0 == strcmp(argv[i], "-2"))
+        {
+            tls12 = true;
+        }
+        else if (0 == strcmp(argv[i], "-g") && i + 1 < argc)
+        {
+            config.setGroups(argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "-e") && i + 2 < argc)
+        {
+            config.addCertificate(argv[i + 1], argv[i + 2]);
+            i += 2;
+        }
+        else if ('-' != argv[i][0])
+        {
+            certs.push_back(argv[i]);
+        }
+        else
+        {
+            certs.clear();
+            break;
+        }
+    }
+    if (5 != certs.size())
+    {
+        fprintf(stderr, "Usage: %s [-m modes] [-c clients] [-d seconds] [-p threads] [-k] [-2]\n"
+                        "       [-g groups] [-e ecdsa.crt ecdsa.key]\n"
+                        "       ca.crt server.crt server.key client.crt client.key\n", argv[0]);
+        return 1;
+    }
+
+    if (modes.empty())
+    {
+        modes.push_back(RestServer::THREAD_PER_CONNECTION);
+    }
+    for (size_t i = 0; i < modes.size(); i++)
+    {
+        if (0 > modes[i] || RestServer::IO_URING < modes[i])
+        {
+            fprintf(stderr, "Unknown server mode %d\n", modes[i]);
+            return 1;
+        }
+    }
+
+    // Keep the library quiet
+    log4cxx::BasicConfigurator::configure();
+    log4cxx::Logger::getRootLogger()->setLevel(log4cxx::Level::getWarn());
+    signal(SIGPIPE, SIG_IGN);
+
+    // The clients verify the server and present their own certificate
+    SSL_CTX* ctx = SSL_CTX_new(TLS_client_method());
+    SSL_CTX_load_verify_locations(ctx, certs[0].c_str(), nullptr);
+    SSL_CTX_use_certificate_file(ctx, certs[3].c_str(), SSL_FILETYPE_PEM);
+    SSL_CTX_use_PrivateKey_file(ctx, certs[4].c_str(), SSL_FILETYPE_PEM);
+    if (tls12)
+    {
+        SSL_CTX_set_max_proto_version(ctx, TLS1_2_VERSION);
+    }
+
+    for (size_t i = 0; i < modes.size(); i++)
+    {
+        SecureRestServer server;
+        server.setServerMode((RestServer::ServerMode)modes[i]);
+        server.setSessionTicketsEnabled(tickets);
+        server.setCryptoThreadCount(cryptoThreads);
+        if (!server.setUp(SECURE_PORT, certs[0], certs[1], certs[2], config))
+        {
+            fprintf(stderr, "Could not set up the secure server\n");
+            return 1;
+        }
+        server.start();
+
+        // A mode that is not available falls back to another, so the mode
+        // that is actually used is reported
+        string name = string("tls/") + modeNames[server.getServerMode()];
+        runTest(name.c_str(), &server, ctx, clients, seconds, false);
+        runTest(name.c_str(), &server, ctx, clients, seconds, true);
+
+        server.stop();
+    }
+    SSL_CTX_free(ctx);
+
+    return 0;
+}
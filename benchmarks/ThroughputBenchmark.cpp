@@ -0,0 +1,497 @@
+/**
+ * Measures how many requests per second a server can handle.
+ *
+ * A RestServer (and, if certificates are given, a SecureRestServer) is started
+ * in this process. Client threads then open persistent connections to it and
+ * send requests back to back for a fixed amount of time. The number of heap
+ * allocations that the server makes for each request is reported too.
+ *
+ * Usage:
+ *   throughput_benchmark [-m modes] [-c connections] [-d seconds] [-b body_bytes]
+ *                        [-l listen_sockets] [-n] [-o] [-k]
+ *                        [-t ca.crt server.crt server.key client.crt client.key]
+ *
+ *   -m  Server modes to test, separated by commas: 0 = thread per connection,
+ *       1 = event loop, 2 = thread pool, 3 = io_uring (default 0). For
+ *       example, "-m 1,3" compares the epoll and io_uring loops.
+ *   -c  Number of client connections (default 8)
+ *   -d  Number of seconds to run each test (default 5)
+ *   -b  Size of each request's body (default 0)
+ *   -l  Number of SO_REUSEPORT listen sockets, 0 for one per core (default 1)
+ *   -n  Open a new connection for every request, to measure connection setup
+ *   -o  Use a handler that creates its own response (the ROUTE_HANDLER
+ *       kind) instead of filling in the server's one
+ *   -k  Let the kernel encrypt the TLS connections (kernel TLS), and report
+ *       how many connections it took over
+ *   -t  Also run the test over TLS, using the given certificate files
+ */
+
+#include <CppRestLib/RestServer.h>
+#include <CppRestLib/SecureRestServer.h>
+
+#include <log4cxx/basicconfigurator.h>
+#include <log4cxx/level.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <openssl/ssl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace kaoisoft;
+using namespace std;
+
+/* Ports used by the servers under test */
+#define PLAIN_PORT "18080"
+#define SECURE_PORT "18443"
+
+/**
+ * Arguments passed to the client threads.
+ */
+struct ClientArgs
+{
+    int port;                       // Port to connect to
+    SSL_CTX* ctx;                   // Context for TLS connections, or nullptr
+    string request;                 // Request text sent over and over
+    bool reconnect;                 // Whether to open a new connection for every request
+    volatile bool* running;         // Cleared when the test is over
+    unsigned long long completed;   // Number of responses received
+    unsigned long long errors;      // Number of failed requests
+};
+
+/* Names of the server modes */
+static const char* modeNames[] = { "thread", "epoll", "pool", "io_uring" };
+
+/* Number of times operator new has been called outside of the client threads */
+static atomic<unsigned long long> serverAllocations(0);
+
+/* Set in the client threads, whose allocations are not counted */
+static thread_local bool inClientThread = false;
+
+/**
+ * Counts the heap allocations made by the server.
+ */
+void* operator new(size_t size)
+{
+    if (!inClientThread)
+    {
+        serverAllocations.fetch_add(1, memory_order_relaxed);
+    }
+    void* ptr = malloc((0 < size) ? size : 1);
+    if (nullptr == ptr)
+    {
+        throw bad_alloc();
+    }
+
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t size) noexcept
+{
+    (void)size;
+    free(ptr);
+}
+
+/**
+ * Handler that answers every request with a short body.
+ */
+static void echoLength(const RestRequest& request, RestResponse& response)
+{
+    response.setCode(200);
+    response.setReason("OK");
+    response.addHeader("Content-Type", "text/plain");
+    response.setBody(std::to_string(request.getBodyView().length()));
+}
+
+/**
+ * echoLength() written as a handler that creates its own response.
+ */
+static RestResponse* echoLengthOld(RestRequest* request, void* extra)
+{
+    (void)extra;
+
+    RestResponse* response = new RestResponse;
+    response->setCode(200);
+    response->setReason("OK");
+    response->addHeader("Content-Type", "text/plain");
+    response->setBody(std::to_string(request->getBodyView().length()));
+
+    return response;
+}
+
+/**
+ * Opens a connection to the server.
+ */
+static int connectToServer(int port, SSL_CTX* ctx, SSL** ssl)
+{
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (-1 == sock)
+    {
+        return -1;
+    }
+    int val = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &val, sizeof(val));
+
+    struct sockaddr_in sin;
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sin.sin_port = htons(port);
+    if (0 != connect(sock, (struct sockaddr*)&sin, sizeof(sin)))
+    {
+        close(sock);
+        return -1;
+    }
+
+    *ssl = nullptr;
+    if (nullptr != ctx)
+    {
+        *ssl = SSL_new(ctx);
+        SSL_set_fd(*ssl, sock);
+        if (1 != SSL_connect(*ssl))
+        {
+            SSL_free(*ssl);
+            *ssl = nullptr;
+            close(sock);
+            return -1;
+        }
+    }
+
+    return sock;
+}
+
+/**
+ * Reads one complete response.
+ *
+ * @return true if successful
+ */
+static bool readResponse(int sock, SSL* ssl, string& buffer)
+{
+    char buff[16384];
+    size_t headerEnd;
+    size_t contentLength = 0;
+
+    while (true)
+    {
+        // Check whether the whole response has arrived
+        headerEnd = buffer.find("\r\n\r\n");
+        if (string::npos != headerEnd)
+        {
+            size_t pos = buffer.find("Content-Length: ");
+            if (string::npos != pos && pos < headerEnd)
+            {
+                contentLength = strtoul(buffer.c_str() + pos + 16, nullptr, 10);
+            }
+            if (buffer.length() >= headerEnd + 4 + contentLength)
+            {
+                buffer.erase(0, headerEnd + 4 + contentLength);
+                return true;
+            }
+        }
+
+        int ret = (nullptr != ssl) ? SSL_read(ssl, buff, sizeof(buff)) :
+                                     (int)::read(sock, buff, sizeof(buff));
+        if (0 >= ret)
+        {
+            return false;
+        }
+        buffer.append(buff, ret);
+    }
+}
+
+/**
+ * Runs in its own thread and sends requests until the test is over.
+ */
+static void* clientThread(void* args)
+{
+    ClientArgs* clientArgs = (ClientArgs*)args;
+    inClientThread = true;
+    string buffer;
+    SSL* ssl = nullptr;
+    int sock = -1;
+
+    while (*(clientArgs->running))
+    {
+        // (Re)connect if needed
+        if (-1 == sock)
+        {
+            buffer.clear();
+            if (-1 == (sock = connectToServer(clientArgs->port, clientArgs->ctx, &ssl)))
+            {
+                clientArgs->errors++;
+                usleep(1000);
+                continue;
+            }
+        }
+
+        // Send the request and wait for the response
+        const char* data = clientArgs->request.c_str();
+        int len = (int)clientArgs->request.length();
+        int ret = (nullptr != ssl) ? SSL_write(ssl, data, len) :
+                                     (int)::write(sock, data, len);
+        if (ret == len && readResponse(sock, ssl, buffer))
+        {
+            clientArgs->completed++;
+            if (!clientArgs->reconnect)
+            {
+                continue;
+            }
+        }
+        else
+        {
+            // The server closed the connection
+            clientArgs->errors++;
+        }
+        if (nullptr != ssl)
+        {
+            SSL_free(ssl);
+            ssl = nullptr;
+        }
+        close(sock);
+        sock = -1;
+    }
+
+    if (nullptr != ssl)
+    {
+        SSL_shutdown(ssl);
+        SSL_free(ssl);
+    }
+    if (-1 != sock)
+    {
+        close(sock);
+    }
+
+    return nullptr;
+}
+
+/**
+ * Sends requests to a server from several connections and reports the rate.
+ */
+static void runTest(const char* name, int port, SSL_CTX* ctx, int connections,
+                    int seconds, int bodyBytes, bool reconnect)
+{
+    // Build the request
+    string request = "POST /echo HTTP/1.1\r\nHost: localhost\r\n";
+    if (reconnect)
+    {
+        request.append("Connection: close\r\n");
+    }
+    request.append("Content-Type: text/plain\r\nContent-Length: ");
+    request.append(std::to_string(bodyBytes));
+    request.append("\r\n\r\n");
+    request.append(bodyBytes, 'x');
+
+    // Start the clients
+    volatile bool running = true;
+    vector<ClientArgs> args(connections);
+    vector<pthread_t> threads(connections);
+    struct timespec start, end;
+    unsigned long long startAllocations = serverAllocations.load();
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < connections; i++)
+    {
+        args[i].port = port;
+        args[i].ctx = ctx;
+        args[i].request = request;
+        args[i].reconnect = reconnect;
+        args[i].running = &running;
+        args[i].completed = 0;
+        args[i].errors = 0;
+        pthread_create(&threads[i], nullptr, clientThread, &args[i]);
+    }
+
+    // Let them run
+    sleep(seconds);
+    running = false;
+    unsigned long long completed = 0, errors = 0;
+    for (int i = 0; i < connections; i++)
+    {
+        pthread_join(threads[i], nullptr);
+        completed += args[i].completed;
+        errors += args[i].errors;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    unsigned long long allocations = serverAllocations.load() - startAllocations;
+
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("%-15s %3d connections, %6d byte bodies: %10.0f requests/s, %5.2f allocations/request "
+           "(%llu requests, %llu errors)\n", name, connections, bodyBytes, completed / elapsed,
+           (0 < completed) ? (double)allocations / completed : 0.0, completed, errors);
+}
+
+int main(int argc, char* argv[])
+{
+    vector<int> modes;
+    int connections = 8;
+    int seconds = 5;
+    int bodyBytes = 0;
+    int listenSockets = 1;
+    bool reconnect = false;
+    bool oldHandler = false;
+    bool ktls = false;
+    vector<string> certs;
+
+    // Parse the arguments
+    for (int i = 1; i < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "-m") && i + 1 < argc)
+        {
+            // Collect the comma-separated modes
+            const char* arg = argv[++i];
+            while ('\0' != *arg)
+            {
+                modes.push_back(atoi(arg));
+                const char* comma = strchr(arg, ',');
+                arg = (nullptr != comma) ? comma + 1 : arg + strlen(arg);
+            }
+        }
+        else if (0 == strcmp(argv[i], "-c") && i + 1 < argc)
+        {
+            connections = atoi(argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "-d") && i + 1 < argc)
+        {
+            seconds = atoi(argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "-b") && i + 1 < argc)
+        {
+            bodyBytes = atoi(argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "-l") && i + 1 < argc)
+        {
+            listenSockets = atoi(argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "-n"))
+        {
+            reconnect = true;
+        }
+        else if (0 == strcmp(argv[i], "-o"))
+        {
+            oldHandler = true;
+        }
+        else if (0 == strcmp(argv[i], "-k"))
+        {
+            ktls = true;
+        }
+        else if (0 == strcmp(argv[i], "-t") && i + 5 < argc)
+        {
+            for (int j = 0; j < 5; j++)
+            {
+                certs.push_back(argv[++i]);
+            }
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [-m modes] [-c connections] [-d seconds] [-b body_bytes]\n"
+                            "       [-l listen_sockets] [-n] [-o] [-k]\n"
+                            "       [-t ca.crt server.crt server.key client.crt client.key]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (modes.empty())
+    {
+        modes.push_back(RestServer::THREAD_PER_CONNECTION);
+    }
+    for (size_t i = 0; i < modes.size(); i++)
+    {
+        if (0 > modes[i] || RestServer::IO_URING < modes[i])
+        {
+            fprintf(stderr, "Unknown server mode %d\n", modes[i]);
+            return 1;
+        }
+    }
+
+    // Keep the library quiet
+    log4cxx::BasicConfigurator::configure();
+    log4cxx::Logger::getRootLogger()->setLevel(log4cxx::Level::getWarn());
+    signal(SIGPIPE, SIG_IGN);
+
+    for (size_t i = 0; i < modes.size(); i++)
+    {
+        // Plain server. A mode that is not available falls back to another,
+        // so the mode that is actually used is reported.
+        RestServer restServer;
+        restServer.setServerMode((RestServer::ServerMode)modes[i]);
+        restServer.setMaxRequestsPerConnection(0);
+        restServer.setListenSocketCount(listenSockets);
+        if (!restServer.setUp(PLAIN_PORT))
+        {
+            fprintf(stderr, "Could not set up the server\n");
+            return 1;
+        }
+        if (oldHandler)
+        {
+            restServer.addRoute(RestRequest::POST, "/echo", echoLengthOld, nullptr);
+        }
+        else
+        {
+            restServer.addRoute(RestRequest::POST, "/echo", echoLength);
+        }
+        restServer.start();
+        string name = string("plain/") + modeNames[restServer.getServerMode()];
+        runTest(name.c_str(), atoi(PLAIN_PORT), nullptr, connections, seconds, bodyBytes, reconnect);
+        restServer.stop();
+
+        // Secure server
+        if (!certs.empty())
+        {
+            SecureRestServer secureServer;
+            secureServer.setServerMode((RestServer::ServerMode)modes[i]);
+            secureServer.setMaxRequestsPerConnection(0);
+            secureServer.setListenSocketCount(listenSockets);
+            secureServer.setKtlsEnabled(ktls);
+            if (!secureServer.setUp(SECURE_PORT, certs[0], certs[1], certs[2]))
+            {
+                fprintf(stderr, "Could not set up the secure server\n");
+                return 1;
+            }
+            if (oldHandler)
+            {
+                secureServer.addRoute(RestRequest::POST, "/echo", echoLengthOld, nullptr);
+            }
+            else
+            {
+                secureServer.addRoute(RestRequest::POST, "/echo", echoLength);
+            }
+            secureServer.start();
+
+            SSL_CTX* ctx = SSL_CTX_new(TLS_client_method());
+            SSL_CTX_load_verify_locations(ctx, certs[0].c_str(), nullptr);
+            SSL_CTX_use_certificate_file(ctx, certs[3].c_str(), SSL_FILETYPE_PEM);
+            SSL_CTX_use_PrivateKey_file(ctx, certs[4].c_str(), SSL_FILETYPE_PEM);
+            name = string("tls/") + modeNames[secureServer.getServerMode()];
+            runTest(name.c_str(), atoi(SECURE_PORT), ctx, connections, seconds, bodyBytes, reconnect);
+            SSL_CTX_free(ctx);
+            if (ktls)
+            {
+                KtlsStatistics stats;
+                secureServer.getKtlsStatistics(&stats);
+                printf("%-15s kernel TLS: %llu connections send offloaded, %llu receive "
+                       "offloaded, %llu not offloaded\n", name.c_str(), stats.sendOffloaded,
+                       stats.receiveOffloaded, stats.notOffloaded);
+            }
+
+            secureServer.stop();
+        }
+    }
+
+    return 0;
+}
@@ -40,32 +40,24 @@ string PRIVATE_KEY_FILE = "/home/user/certs/two-way/server_rsa_private.pem";
 string CA_CERTIFICATE = "/home/user/certs/two-way/ca.crt";
 
 /**
- * Sample REST endpoint for the non-secure server.
+ * Sample REST endpoint for the non-secure server. The server owns both the
+ * request and the response, and reuses them for the connection's next
+ * request.
  *
  * @param request Client's REST request
- * @param extra
- *
- * @return
+ * @param response Response to fill in
  */
-static RestResponse* nonSecureHello(RestRequest* request, void* extra)
+static void nonSecureHello(const RestRequest& request, RestResponse& response)
 {
-	// Create the response headers. A copy of these headers will be stored in
-	// the response, so we can just pass in the address of a local variable.
-	map<string, string> headers;
-	headers["Content-Type"] = "application/json";
-	
-	// Build the response. The server instance will delete the response.
-	RestResponse* response = new RestResponse;
-	response->setCode(200);			// Set the response code
-	response->setReason("OK");		// Set the response reason
-	response->setHeaders(headers);	// Set the response headers
-	response->setBody("{\"data\":\"Non-secure Hello!\"}");
-	
-	return response;
+	response.setCode(200);			// Set the response code
+	response.setReason("OK");		// Set the response reason
+	response.addHeader("Content-Type", "application/json");
+	response.setBody("{\"data\":\"Non-secure Hello!\"}");
 }
 
 /**
- * Sample REST endpoint for the secure server.
+ * Sample REST endpoint for the secure server, written as a handler that
+ * creates its own response.
  *
  * @param request Client's REST request
  * @param extra
@@ -108,9 +100,11 @@ int main()
 
     // Define the routes and their handlers
 	//
-	// The fourth argument can be used to pass in a pointer to a class instance, 
-	// such as a database access object, that might be needed to build the response.
-    restServer.addRoute(RestRequest::GET, "/hello", nonSecureHello, (void*)nullptr);
+	// A handler may be any callable, such as a lambda that captures a class
+	// instance (a database access object, for example) that it needs to build
+	// the response. Handlers that create their own response are given the
+	// fourth argument instead.
+    restServer.addRoute(RestRequest::GET, "/hello", nonSecureHello);
     secureServer.addRoute(RestRequest::GET, "/hello", secureHello, (void*)nullptr);
 
     // Start the servers. These will run in their own threads.
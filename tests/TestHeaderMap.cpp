@@ -0,0 +1,215 @@
+#include <HeaderMap.h>
+#include <HttpDate.h>
+#include <RestResponse.h>
+#include <StaticResponse.h>
+
+#include <cppunit/TestCase.h>
+#include <cppunit/TestFixture.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/TestRunner.h>
+#include <cppunit/BriefTestProgressListener.h>
+#include <cppunit/CompilerOutputter.h>
+#include <cppunit/XmlOutputter.h>
+
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <string_view>
+
+using namespace CppUnit;
+using namespace std;
+using namespace kaoisoft;
+
+//-----------------------------------------------------------------------------
+
+class TestHeaderMap : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(TestHeaderMap);
+    CPPUNIT_TEST(testFind);
+    CPPUNIT_TEST(testSet);
+    CPPUNIT_TEST(testOverflow);
+    CPPUNIT_TEST(testResponse);
+    CPPUNIT_TEST(testResponseReset);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp(void);
+    void tearDown(void);
+
+protected:
+    void testFind(void);
+    void testSet(void);
+    void testOverflow(void);
+    void testResponse(void);
+    void testResponseReset(void);
+
+private:
+    HeaderMap<string_view>* headers;
+};
+
+//-----------------------------------------------------------------------------
+
+void
+TestHeaderMap::testFind(void)
+{
+    headers->add("Host", "localhost");
+    headers->add("X-Trace", "1");
+    headers->add("content-length", "5");
+    headers->add("x-trace", "2");
+
+    // Names match without regard to case, and the last duplicate wins
+    CPPUNIT_ASSERT(0 == headers->find("HOST")->compare("localhost"));
+    CPPUNIT_ASSERT(0 == headers->find("X-TRACE")->compare("2"));
+    CPPUNIT_ASSERT(nullptr == headers->find("X-Trac"));
+
+    // Well-known headers are identified when they are added
+    CPPUNIT_ASSERT(HeaderNames::CONTENT_LENGTH == headers->at(2).id);
+    CPPUNIT_ASSERT(HeaderNames::OTHER == headers->at(1).id);
+    CPPUNIT_ASSERT(0 == headers->find(HeaderNames::CONTENT_LENGTH)->compare("5"));
+    CPPUNIT_ASSERT(nullptr == headers->find(HeaderNames::CONNECTION));
+
+    // Every header is kept, in order
+    CPPUNIT_ASSERT(4 == headers->size());
+    CPPUNIT_ASSERT(0 == headers->at(3).name.compare("x-trace"));
+}
+
+void
+TestHeaderMap::testSet(void)
+{
+    headers->add("Connection", "keep-alive");
+    headers->set("connection", "close");
+    headers->set("Accept", "*/*");
+
+    CPPUNIT_ASSERT(2 == headers->size());
+    CPPUNIT_ASSERT(0 == headers->find(HeaderNames::CONNECTION)->compare("close"));
+    CPPUNIT_ASSERT(0 == headers->find("accept")->compare("*/*"));
+}
+
+void
+TestHeaderMap::testOverflow(void)
+{
+    // Headers beyond the inline ones are still found
+    HeaderMap<string> owned;
+    for (int i = 0; i < 2 * HEADER_MAP_INLINE_COUNT; i++)
+    {
+        owned.add("X-Header-" + to_string(i), to_string(i));
+    }
+    owned.set("x-header-20", "twenty");
+
+    CPPUNIT_ASSERT(2 * HEADER_MAP_INLINE_COUNT == owned.size());
+    CPPUNIT_ASSERT(0 == owned.find("X-HEADER-3")->compare("3"));
+    CPPUNIT_ASSERT(0 == owned.find("X-Header-20")->compare("twenty"));
+
+    map<string, string> copy;
+    owned.toMap(&copy);
+    CPPUNIT_ASSERT(2 * HEADER_MAP_INLINE_COUNT == copy.size());
+    CPPUNIT_ASSERT(0 == copy["x-header-20"].compare("twenty"));
+}
+
+void
+TestHeaderMap::testResponse(void)
+{
+    RestResponse response;
+    map<string, string> initial;
+    initial["Content-Type"] = "text/plain";
+    response.setHeaders(initial);
+    response.addHeader("content-type", "application/json");
+    response.addHeader("Content-Length", "99");
+    response.setBody("{}");
+
+    // Differently cased names replace each other, and the length always
+    // comes from the body
+    string block = response.getHeaderBlock();
+    CPPUNIT_ASSERT(string::npos == block.find("text/plain"));
+    CPPUNIT_ASSERT(string::npos != block.find("content-type: application/json\r\n"));
+    CPPUNIT_ASSERT(string::npos == block.find("99"));
+    CPPUNIT_ASSERT(string::npos != block.find("Content-Length: 2\r\n"));
+
+    // The date is added unless the response has its own
+    CPPUNIT_ASSERT(HTTP_DATE_LENGTH == HttpDate::now().length());
+    CPPUNIT_ASSERT(string::npos != block.find("Date: "));
+    response.addHeader("Date", "Sun, 06 Nov 1994 08:49:37 GMT");
+    block = response.getHeaderBlock();
+    CPPUNIT_ASSERT(block.find("Date: ") == block.rfind("Date: "));
+
+    // A static response leaves Connection to the closing block
+    response.addHeader("Connection", "close");
+    StaticResponse staticResponse(response);
+    CPPUNIT_ASSERT(0 == staticResponse.getConnectionView().compare("close"));
+    CPPUNIT_ASSERT(string::npos == staticResponse.getHead().find("Connection"));
+    CPPUNIT_ASSERT(string::npos != staticResponse.getHead().find("Content-Length: 2\r\n"));
+    std::pmr::string closing = staticResponse.getClosingBlock(false, std::pmr::get_default_resource());
+    CPPUNIT_ASSERT(0 == closing.compare("Connection: close\r\n\r\n"));
+}
+
+void
+TestHeaderMap::testResponseReset(void)
+{
+    RestResponse response;
+
+    // A response that is recycled after an ordinary body keeps its memory
+    response.setBody(string(1024, 'x'));
+    size_t kept = response.getBody().capacity();
+    response.reset();
+    CPPUNIT_ASSERT(response.getBody().empty());
+    CPPUNIT_ASSERT(kept == response.getBody().capacity());
+
+    // but not the memory of a large one
+    response.setBody(string(4 * 1024 * 1024, 'x'));
+    response.addHeader("Content-Type", "application/octet-stream");
+    response.reset();
+    CPPUNIT_ASSERT(response.getBody().empty());
+    CPPUNIT_ASSERT(1024 * 1024 > response.getBody().capacity());
+    CPPUNIT_ASSERT(500 == response.getCode());
+    CPPUNIT_ASSERT(string::npos == response.getHeaderBlock().find("Content-Type"));
+}
+
+void TestHeaderMap::setUp(void)
+{
+    headers = new HeaderMap<string_view>();
+}
+
+void TestHeaderMap::tearDown(void)
+{
+    delete headers;
+}
+
+//-----------------------------------------------------------------------------
+
+CPPUNIT_TEST_SUITE_REGISTRATION( TestHeaderMap );
+
+int main(int argc, char* argv[])
+{
+    // informs test-listener about testresults
+    CPPUNIT_NS::TestResult testresult;
+
+    // register listener for collecting the test-results
+    CPPUNIT_NS::TestResultCollector collectedresults;
+    testresult.addListener (&collectedresults);
+
+    // register listener for per-test progress output
+    CPPUNIT_NS::BriefTestProgressListener progress;
+    testresult.addListener (&progress);
+
+    // insert test-suite at test-runner by registry
+    CPPUNIT_NS::TestRunner testrunner;
+    testrunner.addTest (CPPUNIT_NS::TestFactoryRegistry::getRegistry().makeTest ());
+    testrunner.run(testresult);
+
+    // output results in compiler-format
+    CPPUNIT_NS::CompilerOutputter compileroutputter(&collectedresults, std::cerr);
+    compileroutputter.write ();
+
+    // Output XML for Jenkins CPPunit plugin
+    ofstream xmlFileOut("cppTestHeaderMap.xml");
+    XmlOutputter xmlOut(&collectedresults, xmlFileOut);
+    xmlOut.write();
+
+    // return 0 if tests were successful
+    return collectedresults.wasSuccessful() ? 0 : 1;
+}
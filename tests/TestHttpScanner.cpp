@@ -0,0 +1,166 @@
+#include <HttpScanner.h>
+
+#include <cppunit/TestCase.h>
+#include <cppunit/TestFixture.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/TestRunner.h>
+#include <cppunit/BriefTestProgressListener.h>
+#include <cppunit/CompilerOutputter.h>
+#include <cppunit/XmlOutputter.h>
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using namespace CppUnit;
+using namespace std;
+using namespace kaoisoft;
+
+//-----------------------------------------------------------------------------
+
+class TestHttpScanner : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(TestHttpScanner);
+    CPPUNIT_TEST(testLineEnd);
+    CPPUNIT_TEST(testToken);
+    CPPUNIT_TEST(testLevelsAgree);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp(void);
+    void tearDown(void);
+
+protected:
+    void testLineEnd(void);
+    void testToken(void);
+    void testLevelsAgree(void);
+
+private:
+    size_t lineEnd(string str);
+    size_t token(string str);
+
+    HttpScanner::Level level;
+};
+
+//-----------------------------------------------------------------------------
+
+size_t TestHttpScanner::lineEnd(string str)
+{
+    return HttpScanner::findLineEnd(str.c_str(), str.length());
+}
+
+size_t TestHttpScanner::token(string str)
+{
+    return HttpScanner::scanToken(str.c_str(), str.length());
+}
+
+void
+TestHttpScanner::testLineEnd(void)
+{
+    // Line feeds end lines, with or without a carriage return
+    CPPUNIT_ASSERT(5 == lineEnd("Host:\nx"));
+    CPPUNIT_ASSERT(10 == lineEnd("Host: a\tb\r\nx"));
+
+    // No line feed yet
+    CPPUNIT_ASSERT(7 == lineEnd("Host: a"));
+    CPPUNIT_ASSERT(8 == lineEnd("Host: a\r"));
+
+    // Characters that are not allowed
+    CPPUNIT_ASSERT(6 == lineEnd("Host: \ra\r\n"));
+    CPPUNIT_ASSERT(6 == lineEnd(string("Host: \0a\r\n", 10)));
+    CPPUNIT_ASSERT(6 == lineEnd("Host: \x7f\r\n"));
+
+    // Text beyond ASCII is allowed
+    CPPUNIT_ASSERT(8 == lineEnd("Host: \xc3\xa9\n"));
+}
+
+void
+TestHttpScanner::testToken(void)
+{
+    CPPUNIT_ASSERT(14 == token("Content-Length: 5"));
+    CPPUNIT_ASSERT(15 == token("!#$%&'*+-.^_`|~ x"));
+    CPPUNIT_ASSERT(3 == token("GET / HTTP/1.1"));
+    CPPUNIT_ASSERT(0 == token(" Host"));
+    CPPUNIT_ASSERT(4 == token("Host"));
+    CPPUNIT_ASSERT(1 == token("a{b"));
+}
+
+void
+TestHttpScanner::testLevelsAgree(void)
+{
+    // Put every byte value at every offset of a buffer that is long enough
+    // for the vector loops, and check that each level finds the same
+    // positions as the scalar code
+    string buffer(80, 'a');
+    for (int level = HttpScanner::SSE42; level <= HttpScanner::AVX2; level++)
+    {
+        for (int ch = 0; ch < 256; ch++)
+        {
+            for (size_t pos = 0; pos < buffer.length(); pos++)
+            {
+                string str = buffer;
+                str[pos] = (char)ch;
+
+                CPPUNIT_ASSERT(HttpScanner::setLevel(HttpScanner::SCALAR));
+                size_t expectedLineEnd = lineEnd(str);
+                size_t expectedToken = token(str);
+                if (!HttpScanner::setLevel((HttpScanner::Level)level))
+                {
+                    // The CPU does not support this level
+                    return;
+                }
+                CPPUNIT_ASSERT(expectedLineEnd == lineEnd(str));
+                CPPUNIT_ASSERT(expectedToken == token(str));
+            }
+        }
+    }
+}
+
+void TestHttpScanner::setUp(void)
+{
+    level = HttpScanner::getLevel();
+}
+
+void TestHttpScanner::tearDown(void)
+{
+    HttpScanner::setLevel(level);
+}
+
+//-----------------------------------------------------------------------------
+
+CPPUNIT_TEST_SUITE_REGISTRATION( TestHttpScanner );
+
+int main(int argc, char* argv[])
+{
+    // informs test-listener about testresults
+    CPPUNIT_NS::TestResult testresult;
+
+    // register listener for collecting the test-results
+    CPPUNIT_NS::TestResultCollector collectedresults;
+    testresult.addListener (&collectedresults);
+
+    // register listener for per-test progress output
+    CPPUNIT_NS::BriefTestProgressListener progress;
+    testresult.addListener (&progress);
+
+    // insert test-suite at test-runner by registry
+    CPPUNIT_NS::TestRunner testrunner;
+    testrunner.addTest (CPPUNIT_NS::TestFactoryRegistry::getRegistry().makeTest ());
+    testrunner.run(testresult);
+
+    // output results in compiler-format
+    CPPUNIT_NS::CompilerOutputter compileroutputter(&collectedresults, std::cerr);
+    compileroutputter.write ();
+
+    // Output XML for Jenkins CPPunit plugin
+    ofstream xmlFileOut("cppTestHttpScanner.xml");
+    XmlOutputter xmlOut(&collectedresults, xmlFileOut);
+    xmlOut.write();
+
+    // return 0 if tests were successful
+    return collectedresults.wasSuccessful() ? 0 : 1;
+}
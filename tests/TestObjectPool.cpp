@@ -0,0 +1,170 @@
+#include <ObjectPool.h>
+
+#include <cppunit/TestCase.h>
+#include <cppunit/TestFixture.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/TestRunner.h>
+#include <cppunit/BriefTestProgressListener.h>
+#include <cppunit/CompilerOutputter.h>
+#include <cppunit/XmlOutputter.h>
+#include <pthread.h>
+
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+using namespace CppUnit;
+using namespace std;
+using namespace kaoisoft;
+
+//-----------------------------------------------------------------------------
+
+/* Object types, so that each test starts with empty pools */
+struct LocalObject { int value; };
+struct SharedObject { int value; };
+
+/**
+ * Releases objects on a thread of its own.
+ */
+static void* releaseThread(void* args)
+{
+    vector<SharedObject*>* objects = (vector<SharedObject*>*)args;
+    for (size_t i = 0; i < objects->size(); i++)
+    {
+        ObjectPool<SharedObject>::release((*objects)[i]);
+    }
+
+    return nullptr;
+}
+
+class TestObjectPool : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(TestObjectPool);
+    CPPUNIT_TEST(testReuse);
+    CPPUNIT_TEST(testOtherThread);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp(void);
+    void tearDown(void);
+
+protected:
+    void testReuse(void);
+    void testOtherThread(void);
+};
+
+//-----------------------------------------------------------------------------
+
+void
+TestObjectPool::testReuse(void)
+{
+    // An empty pool has nothing to give, so the objects are created
+    CPPUNIT_ASSERT(nullptr == ObjectPool<LocalObject>::take());
+    LocalObject* first = new LocalObject;
+    CPPUNIT_ASSERT(nullptr == ObjectPool<LocalObject>::take());
+    LocalObject* second = new LocalObject;
+
+    // The object that was released last is taken first
+    ObjectPool<LocalObject>::release(first);
+    ObjectPool<LocalObject>::release(second);
+    CPPUNIT_ASSERT(second == ObjectPool<LocalObject>::take());
+    CPPUNIT_ASSERT(first == ObjectPool<LocalObject>::take());
+
+    ObjectPoolStatistics stats;
+    ObjectPool<LocalObject>::getStatistics(&stats);
+    CPPUNIT_ASSERT(2 == stats.hits);
+    CPPUNIT_ASSERT(2 == stats.misses);
+    delete first;
+    delete second;
+
+    // Objects beyond the thread's capacity are passed on or deleted
+    vector<LocalObject*> objects;
+    for (int i = 0; i < OBJECT_POOL_THREAD_CAPACITY + OBJECT_POOL_SHARED_CAPACITY + 1; i++)
+    {
+        ObjectPool<LocalObject>::take();
+        objects.push_back(new LocalObject);
+    }
+    for (size_t i = 0; i < objects.size(); i++)
+    {
+        ObjectPool<LocalObject>::release(objects[i]);
+    }
+    ObjectPool<LocalObject>::getStatistics(&stats);
+    CPPUNIT_ASSERT(0 < stats.discarded);
+}
+
+void
+TestObjectPool::testOtherThread(void)
+{
+    // Objects released by a thread that never takes any are shared
+    vector<SharedObject*> objects;
+    for (int i = 0; i < 3; i++)
+    {
+        objects.push_back(new SharedObject);
+    }
+    pthread_t threadId;
+    CPPUNIT_ASSERT(0 == pthread_create(&threadId, nullptr, releaseThread, &objects));
+    pthread_join(threadId, nullptr);
+
+    for (int i = 0; i < 3; i++)
+    {
+        CPPUNIT_ASSERT(nullptr != ObjectPool<SharedObject>::take());
+    }
+    CPPUNIT_ASSERT(nullptr == ObjectPool<SharedObject>::take());
+
+    ObjectPoolStatistics stats;
+    ObjectPool<SharedObject>::getStatistics(&stats);
+    CPPUNIT_ASSERT(3 == stats.hits);
+    CPPUNIT_ASSERT(0 == stats.discarded);
+
+    for (int i = 0; i < 3; i++)
+    {
+        delete objects[i];
+    }
+}
+
+void TestObjectPool::setUp(void)
+{
+}
+
+void TestObjectPool::tearDown(void)
+{
+}
+
+//-----------------------------------------------------------------------------
+
+CPPUNIT_TEST_SUITE_REGISTRATION( TestObjectPool );
+
+int main(int argc, char* argv[])
+{
+    // informs test-listener about testresults
+    CPPUNIT_NS::TestResult testresult;
+
+    // register listener for collecting the test-results
+    CPPUNIT_NS::TestResultCollector collectedresults;
+    testresult.addListener (&collectedresults);
+
+    // register listener for per-test progress output
+    CPPUNIT_NS::BriefTestProgressListener progress;
+    testresult.addListener (&progress);
+
+    // insert test-suite at test-runner by registry
+    CPPUNIT_NS::TestRunner testrunner;
+    testrunner.addTest (CPPUNIT_NS::TestFactoryRegistry::getRegistry().makeTest ());
+    testrunner.run(testresult);
+
+    // output results in compiler-format
+    CPPUNIT_NS::CompilerOutputter compileroutputter(&collectedresults, std::cerr);
+    compileroutputter.write ();
+
+    // Output XML for Jenkins CPPunit plugin
+    ofstream xmlFileOut("cppTestObjectPool.xml");
+    XmlOutputter xmlOut(&collectedresults, xmlFileOut);
+    xmlOut.write();
+
+    // return 0 if tests were successful
+    return collectedresults.wasSuccessful() ? 0 : 1;
+}
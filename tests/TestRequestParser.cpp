@@ -0,0 +1,312 @@
+#include <RequestParser.h>
+
+#include <cppunit/TestCase.h>
+#include <cppunit/TestFixture.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/TestRunner.h>
+#include <cppunit/BriefTestProgressListener.h>
+#include <cppunit/CompilerOutputter.h>
+#include <cppunit/XmlOutputter.h>
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using namespace CppUnit;
+using namespace std;
+using namespace kaoisoft;
+
+//-----------------------------------------------------------------------------
+
+class TestRequestParser : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(TestRequestParser);
+    CPPUNIT_TEST(testContentLength);
+    CPPUNIT_TEST(testIncomplete);
+    CPPUNIT_TEST(testChunked);
+    CPPUNIT_TEST(testExpectContinue);
+    CPPUNIT_TEST(testInvalid);
+    CPPUNIT_TEST(testPipelined);
+    CPPUNIT_TEST(testViews);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp(void);
+    void tearDown(void);
+
+protected:
+    void testContentLength(void);
+    void testIncomplete(void);
+    void testChunked(void);
+    void testExpectContinue(void);
+    void testInvalid(void);
+    void testPipelined(void);
+    void testViews(void);
+
+private:
+    RequestParser::Status parse(string str, size_t maxBodySize);
+
+    string input;
+    RestRequest* request;
+    size_t consumed;
+    int errorCode;
+};
+
+//-----------------------------------------------------------------------------
+
+RequestParser::Status TestRequestParser::parse(string str, size_t maxBodySize)
+{
+    // The request points into the parsed data, so it is kept
+    input = str;
+    return RequestParser::parse(input.c_str(), input.length(), maxBodySize, request,
+                                &consumed, &errorCode);
+}
+
+void
+TestRequestParser::testContentLength(void)
+{
+    string first = "POST /items HTTP/1.1\r\n"
+                   "Host: localhost:4433\r\n"
+                   "content-length: 5\r\n"
+                   "\r\n"
+                   "hello";
+    string second = "GET / HTTP/1.1\r\n\r\n";
+
+    // Only the first of two back-to-back requests is consumed
+    CPPUNIT_ASSERT(RequestParser::COMPLETE == parse(first + second, 1024));
+    CPPUNIT_ASSERT(first.length() == consumed);
+    CPPUNIT_ASSERT(RestRequest::POST == request->getMethod());
+    CPPUNIT_ASSERT(0 == request->getPath().compare("/items"));
+    CPPUNIT_ASSERT(0 == request->getProtocol().compare("HTTP/1.1"));
+    CPPUNIT_ASSERT(0 == request->getBody().compare("hello"));
+
+    // Header values may contain colons
+    CPPUNIT_ASSERT(0 == request->getHeader("Host").compare("localhost:4433"));
+}
+
+void
+TestRequestParser::testIncomplete(void)
+{
+    string str = "POST /items HTTP/1.1\r\n"
+                 "Content-Length: 10\r\n"
+                 "\r\n"
+                 "hello";
+
+    // Headers that have not ended yet
+    CPPUNIT_ASSERT(RequestParser::INCOMPLETE == parse("GET / HTTP/1.1\r\nHost: x\r\n", 1024));
+
+    // A body that has only partly arrived
+    CPPUNIT_ASSERT(RequestParser::INCOMPLETE == parse(str, 1024));
+    CPPUNIT_ASSERT(RequestParser::COMPLETE == parse(str + "world", 1024));
+    CPPUNIT_ASSERT(0 == request->getBody().compare("helloworld"));
+}
+
+void
+TestRequestParser::testChunked(void)
+{
+    string str = "POST /items HTTP/1.1\r\n"
+                 "Transfer-Encoding: chunked\r\n"
+                 "\r\n"
+                 "5\r\nhello\r\n"
+                 "6;name=value\r\n world\r\n"
+                 "0\r\n"
+                 "Trailer: value\r\n"
+                 "\r\n";
+
+    CPPUNIT_ASSERT(RequestParser::INCOMPLETE == parse(str.substr(0, str.length() - 2), 1024));
+    CPPUNIT_ASSERT(RequestParser::COMPLETE == parse(str, 1024));
+    CPPUNIT_ASSERT(str.length() == consumed);
+    CPPUNIT_ASSERT(0 == request->getBody().compare("hello world"));
+
+    // chunked may follow other codings in a list
+    string listed = str;
+    listed.replace(listed.find("chunked"), 7, "gzip ,\tchunked");
+    CPPUNIT_ASSERT(RequestParser::COMPLETE == parse(listed, 1024));
+
+    // The decoded body is limited too
+    CPPUNIT_ASSERT(RequestParser::INVALID == parse(str, 8));
+    CPPUNIT_ASSERT(413 == errorCode);
+}
+
+void
+TestRequestParser::testExpectContinue(void)
+{
+    string str = "PUT /items HTTP/1.1\r\n"
+                 "Content-Length: 5\r\n"
+                 "Expect: 100-continue\r\n"
+                 "\r\n";
+
+    CPPUNIT_ASSERT(RequestParser::EXPECT_CONTINUE == parse(str, 1024));
+    CPPUNIT_ASSERT(RequestParser::INCOMPLETE == parse(str + "he", 1024));
+    CPPUNIT_ASSERT(RequestParser::COMPLETE == parse(str + "hello", 1024));
+}
+
+void
+TestRequestParser::testInvalid(void)
+{
+    // Malformed request line
+    CPPUNIT_ASSERT(RequestParser::INVALID == parse("GET /\r\n\r\n", 1024));
+    CPPUNIT_ASSERT(400 == errorCode);
+
+    // Method that is not a token
+    CPPUNIT_ASSERT(RequestParser::INVALID == parse("G(T / HTTP/1.1\r\n\r\n", 1024));
+    CPPUNIT_ASSERT(400 == errorCode);
+
+    // Header name that is not a token, or is followed by a space
+    CPPUNIT_ASSERT(RequestParser::INVALID == parse("GET / HTTP/1.1\r\nHo@st: x\r\n\r\n", 1024));
+    CPPUNIT_ASSERT(400 == errorCode);
+    CPPUNIT_ASSERT(RequestParser::INVALID == parse("GET / HTTP/1.1\r\nHost : x\r\n\r\n", 1024));
+    CPPUNIT_ASSERT(400 == errorCode);
+
+    // Control character in a header value
+    CPPUNIT_ASSERT(RequestParser::INVALID == parse("GET / HTTP/1.1\r\nHost: a\x01b\r\n\r\n", 1024));
+    CPPUNIT_ASSERT(400 == errorCode);
+
+    // Body larger than allowed
+    CPPUNIT_ASSERT(RequestParser::INVALID ==
+                   parse("POST / HTTP/1.1\r\nContent-Length: 2048\r\n\r\n", 1024));
+    CPPUNIT_ASSERT(413 == errorCode);
+
+    // Bad Content-Length
+    CPPUNIT_ASSERT(RequestParser::INVALID ==
+                   parse("POST / HTTP/1.1\r\nContent-Length: 12a\r\n\r\n", 1024));
+    CPPUNIT_ASSERT(400 == errorCode);
+
+    // Both Content-Length and Transfer-Encoding
+    CPPUNIT_ASSERT(RequestParser::INVALID ==
+                   parse("POST / HTTP/1.1\r\nContent-Length: 1\r\n"
+                         "Transfer-Encoding: chunked\r\n\r\n", 1024));
+    CPPUNIT_ASSERT(400 == errorCode);
+
+    // Unsupported transfer coding
+    CPPUNIT_ASSERT(RequestParser::INVALID ==
+                   parse("POST / HTTP/1.1\r\nTransfer-Encoding: gzip\r\n\r\n", 1024));
+    CPPUNIT_ASSERT(501 == errorCode);
+
+    // A coding that only ends in "chunked" is not chunked
+    CPPUNIT_ASSERT(RequestParser::INVALID ==
+                   parse("POST / HTTP/1.1\r\nTransfer-Encoding: xchunked\r\n\r\n", 1024));
+    CPPUNIT_ASSERT(501 == errorCode);
+    CPPUNIT_ASSERT(RequestParser::INVALID ==
+                   parse("POST / HTTP/1.1\r\nTransfer-Encoding: gzip, dechunked\r\n\r\n", 1024));
+    CPPUNIT_ASSERT(501 == errorCode);
+
+    // Bad chunk size
+    CPPUNIT_ASSERT(RequestParser::INVALID ==
+                   parse("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n", 1024));
+    CPPUNIT_ASSERT(400 == errorCode);
+}
+
+void
+TestRequestParser::testPipelined(void)
+{
+    input = "POST /a HTTP/1.1\r\n"
+            "Transfer-Encoding: chunked\r\n"
+            "\r\n"
+            "3\r\none\r\n"
+            "0\r\n"
+            "\r\n"
+            "GET /b HTTP/1.1\r\n"
+            "\r\n"
+            "PUT /c HTTP/1.1\r\n"
+            "Content-Length: 3\r\n"
+            "\r\n"
+            "two"
+            "GET /d HTTP/1.1\r\n";
+
+    // Requests that arrived together are parsed one after the other, each
+    // starting where the last one ended, until only part of one is left
+    const char* paths[] = { "/a", "/b", "/c" };
+    const char* bodies[] = { "one", "", "two" };
+    size_t offset = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        request->reset();
+        CPPUNIT_ASSERT(RequestParser::COMPLETE ==
+                       RequestParser::parse(input.c_str() + offset, input.length() - offset,
+                                            1024, request, &consumed, &errorCode));
+        CPPUNIT_ASSERT(0 == request->getPath().compare(paths[i]));
+        CPPUNIT_ASSERT(0 == request->getBody().compare(bodies[i]));
+        offset += consumed;
+    }
+    request->reset();
+    CPPUNIT_ASSERT(RequestParser::INCOMPLETE ==
+                   RequestParser::parse(input.c_str() + offset, input.length() - offset,
+                                        1024, request, &consumed, &errorCode));
+}
+
+void
+TestRequestParser::testViews(void)
+{
+    string str = "POST /items HTTP/1.1\r\n"
+                 "Host: localhost\r\n"
+                 "Content-Length: 5\r\n"
+                 "\r\n"
+                 "hello";
+
+    // Nothing is copied out of the parsed data
+    CPPUNIT_ASSERT(RequestParser::COMPLETE == parse(str, 1024));
+    const char* data = input.c_str();
+    CPPUNIT_ASSERT(data + 5 == request->getPathView().data());
+    CPPUNIT_ASSERT(data + 12 == request->getProtocolView().data());
+    CPPUNIT_ASSERT(data + 28 == request->getHeaderView("host").data());
+    CPPUNIT_ASSERT(data + str.length() - 5 == request->getBodyView().data());
+
+    // A copy of the request owns its data
+    RestRequest copy(*request);
+    input.assign(input.length(), 'x');
+    CPPUNIT_ASSERT(0 == copy.getPath().compare("/items"));
+    CPPUNIT_ASSERT(0 == copy.getHeader("Host").compare("localhost"));
+    CPPUNIT_ASSERT(0 == copy.getBody().compare("hello"));
+}
+
+void TestRequestParser::setUp(void)
+{
+    request = new RestRequest();
+    consumed = 0;
+    errorCode = 0;
+}
+
+void TestRequestParser::tearDown(void)
+{
+    delete request;
+}
+
+//-----------------------------------------------------------------------------
+
+CPPUNIT_TEST_SUITE_REGISTRATION( TestRequestParser );
+
+int main(int argc, char* argv[])
+{
+    // informs test-listener about testresults
+    CPPUNIT_NS::TestResult testresult;
+
+    // register listener for collecting the test-results
+    CPPUNIT_NS::TestResultCollector collectedresults;
+    testresult.addListener (&collectedresults);
+
+    // register listener for per-test progress output
+    CPPUNIT_NS::BriefTestProgressListener progress;
+    testresult.addListener (&progress);
+
+    // insert test-suite at test-runner by registry
+    CPPUNIT_NS::TestRunner testrunner;
+    testrunner.addTest (CPPUNIT_NS::TestFactoryRegistry::getRegistry().makeTest ());
+    testrunner.run(testresult);
+
+    // output results in compiler-format
+    CPPUNIT_NS::CompilerOutputter compileroutputter(&collectedresults, std::cerr);
+    compileroutputter.write ();
+
+    // Output XML for Jenkins CPPunit plugin
+    ofstream xmlFileOut("cppTestRequestParser.xml");
+    XmlOutputter xmlOut(&collectedresults, xmlFileOut);
+    xmlOut.write();
+
+    // return 0 if tests were successful
+    return collectedresults.wasSuccessful() ? 0 : 1;
+}
@@ -1,3 +1,4 @@
+#include <RequestArena.h>
 #include <RestRequest.h>
 
 #include <cppunit/TestCase.h>
@@ -28,6 +29,8 @@ class TestRestRequest : public CppUnit::TestFixture
 {
     CPPUNIT_TEST_SUITE(TestRestRequest);
     CPPUNIT_TEST(testConstructor);
+    CPPUNIT_TEST(testReset);
+    CPPUNIT_TEST(testArena);
 //    CPPUNIT_TEST(testMultiply);
     CPPUNIT_TEST_SUITE_END();
 
@@ -37,6 +40,8 @@ public:
 
 protected:
     void testConstructor(void);
+    void testReset(void);
+    void testArena(void);
 
 private:
 
@@ -104,6 +109,66 @@ TestRestRequest::testConstructor(void)
     }
 }
 
+void
+TestRestRequest::testReset(void)
+{
+    // Parameters are found by name, the last one winning
+    request->setPath("/users/42");
+    request->addParam("id", "7");
+    request->addParamView("id", request->getPathView().substr(7));
+    CPPUNIT_ASSERT(0 == request->getParam("id").compare("42"));
+    CPPUNIT_ASSERT(request->getParam("name").empty());
+    CPPUNIT_ASSERT(0 == request->getParams()["id"].compare("42"));
+
+    // A copy does not point into the original
+    request->addHeader("Host", "localhost");
+    RestRequest copy(*request);
+    request->reset();
+    CPPUNIT_ASSERT(0 == copy.getParam("id").compare("42"));
+    CPPUNIT_ASSERT(0 == copy.getHeaderView("host").compare("localhost"));
+
+    // A reset request is empty
+    CPPUNIT_ASSERT(RestRequest::INVALID == request->getMethod());
+    CPPUNIT_ASSERT(0 == request->getPathView().compare("/"));
+    CPPUNIT_ASSERT(request->getParam("id").empty());
+    CPPUNIT_ASSERT(request->getHeaderView("Host").empty());
+    CPPUNIT_ASSERT(request->getBodyView().empty());
+
+    // Parameters set from a map replace the old ones
+    map<string, string> params;
+    params["a"] = "1";
+    params["b"] = "2";
+    request->setParams(params);
+    CPPUNIT_ASSERT(0 == request->getParam("b").compare("2"));
+    CPPUNIT_ASSERT(2 == request->getParams().size());
+}
+
+void
+TestRestRequest::testArena(void)
+{
+    // Copies made by the request come from the arena
+    RequestArena arena;
+    RestRequest arenaRequest(&arena);
+    arenaRequest.setPath("/users/42");
+    arenaRequest.addHeader("Host", "localhost");
+    CPPUNIT_ASSERT(0 < arena.getUsed());
+    CPPUNIT_ASSERT(0 == arenaRequest.getPathView().compare("/users/42"));
+    CPPUNIT_ASSERT(0 == arenaRequest.getHeaderView("host").compare("localhost"));
+
+    // A value too big for what is left of the arena comes from the heap
+    size_t used = arena.getUsed();
+    arenaRequest.setBody(string(REQUEST_ARENA_SIZE, 'x'));
+    CPPUNIT_ASSERT(used < arena.getUsed());
+    CPPUNIT_ASSERT(REQUEST_ARENA_SIZE == arenaRequest.getBodyView().length());
+
+    // Once the request has been reset, so can the arena
+    arenaRequest.reset();
+    arena.reset();
+    CPPUNIT_ASSERT(0 == arena.getUsed());
+    arenaRequest.setPath("/");
+    CPPUNIT_ASSERT(0 == arenaRequest.getPathView().compare("/"));
+}
+
 void TestRestRequest::setUp(void)
 {
     request = new RestRequest();
@@ -0,0 +1,227 @@
+#include <Router.h>
+
+#include <cppunit/TestCase.h>
+#include <cppunit/TestFixture.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/TestRunner.h>
+#include <cppunit/BriefTestProgressListener.h>
+#include <cppunit/CompilerOutputter.h>
+#include <cppunit/XmlOutputter.h>
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using namespace CppUnit;
+using namespace std;
+using namespace kaoisoft;
+
+//-----------------------------------------------------------------------------
+
+class TestRouter : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(TestRouter);
+    CPPUNIT_TEST(testLiteral);
+    CPPUNIT_TEST(testParams);
+    CPPUNIT_TEST(testWildcard);
+    CPPUNIT_TEST(testPriority);
+    CPPUNIT_TEST(testMalformed);
+    CPPUNIT_TEST(testConflict);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp(void);
+    void tearDown(void);
+
+protected:
+    void testLiteral(void);
+    void testParams(void);
+    void testWildcard(void);
+    void testPriority(void);
+    void testMalformed(void);
+    void testConflict(void);
+
+private:
+    Router* router;
+    HandlerData handlers[4];
+};
+
+//-----------------------------------------------------------------------------
+
+void
+TestRouter::testLiteral(void)
+{
+    CPPUNIT_ASSERT(router->addRoute(RestRequest::GET, "/users", &handlers[0]));
+    CPPUNIT_ASSERT(router->addRoute(RestRequest::GET, "/user", &handlers[1]));
+    CPPUNIT_ASSERT(router->addRoute(RestRequest::POST, "/users", &handlers[2]));
+
+    CPPUNIT_ASSERT(&handlers[0] == router->findRoute(RestRequest::GET, "/users", nullptr));
+    CPPUNIT_ASSERT(&handlers[1] == router->findRoute(RestRequest::GET, "/user", nullptr));
+    CPPUNIT_ASSERT(&handlers[2] == router->findRoute(RestRequest::POST, "/users", nullptr));
+
+    // The query string is ignored
+    CPPUNIT_ASSERT(&handlers[0] == router->findRoute(RestRequest::GET, "/users?a=b", nullptr));
+
+    // Misses
+    CPPUNIT_ASSERT(nullptr == router->findRoute(RestRequest::GET, "/use", nullptr));
+    CPPUNIT_ASSERT(nullptr == router->findRoute(RestRequest::GET, "/users/", nullptr));
+    CPPUNIT_ASSERT(nullptr == router->findRoute(RestRequest::PUT, "/users", nullptr));
+    CPPUNIT_ASSERT(nullptr == router->findRoute(RestRequest::INVALID, "/users", nullptr));
+
+    // A route can be replaced
+    CPPUNIT_ASSERT(router->addRoute(RestRequest::GET, "/users", &handlers[3]));
+    CPPUNIT_ASSERT(&handlers[3] == router->findRoute(RestRequest::GET, "/users", nullptr));
+}
+
+void
+TestRouter::testParams(void)
+{
+    RestRequest request;
+
+    CPPUNIT_ASSERT(router->addRoute(RestRequest::GET, "/users/{id}", &handlers[0]));
+    CPPUNIT_ASSERT(router->addRoute(RestRequest::GET, "/users/{id}/posts/{post}", &handlers[1]));
+
+    CPPUNIT_ASSERT(&handlers[1] == router->findRoute(RestRequest::GET, "/users/42/posts/7", &request));
+    map<string, string> params = request.getParams();
+    CPPUNIT_ASSERT(2 == params.size());
+    CPPUNIT_ASSERT(0 == params["id"].compare("42"));
+    CPPUNIT_ASSERT(0 == params["post"].compare("7"));
+
+    // A parameter must not be empty
+    CPPUNIT_ASSERT(nullptr == router->findRoute(RestRequest::GET, "/users/", nullptr));
+    CPPUNIT_ASSERT(nullptr == router->findRoute(RestRequest::GET, "/users//posts/7", nullptr));
+
+    // Parameters at the same place must have the same name
+    CPPUNIT_ASSERT(!router->addRoute(RestRequest::GET, "/users/{name}", &handlers[2]));
+}
+
+void
+TestRouter::testWildcard(void)
+{
+    RestRequest request;
+
+    CPPUNIT_ASSERT(router->addRoute(RestRequest::GET, "/files/{path*}", &handlers[0]));
+    CPPUNIT_ASSERT(router->addRoute(RestRequest::GET, "/static/*", &handlers[1]));
+
+    CPPUNIT_ASSERT(&handlers[0] == router->findRoute(RestRequest::GET, "/files/a/b.txt", &request));
+    CPPUNIT_ASSERT(0 == request.getParams()["path"].compare("a/b.txt"));
+
+    CPPUNIT_ASSERT(&handlers[1] == router->findRoute(RestRequest::GET, "/static/", &request));
+    CPPUNIT_ASSERT(0 == request.getParams()["*"].compare(""));
+
+    CPPUNIT_ASSERT(nullptr == router->findRoute(RestRequest::GET, "/static", nullptr));
+}
+
+void
+TestRouter::testPriority(void)
+{
+    RestRequest request;
+
+    CPPUNIT_ASSERT(router->addRoute(RestRequest::GET, "/users/me", &handlers[0]));
+    CPPUNIT_ASSERT(router->addRoute(RestRequest::GET, "/users/{id}", &handlers[1]));
+    CPPUNIT_ASSERT(router->addRoute(RestRequest::GET, "/users/*", &handlers[2]));
+    CPPUNIT_ASSERT(router->addRoute(RestRequest::GET, "/users/{id}/profile", &handlers[3]));
+
+    CPPUNIT_ASSERT(&handlers[0] == router->findRoute(RestRequest::GET, "/users/me", nullptr));
+    CPPUNIT_ASSERT(&handlers[1] == router->findRoute(RestRequest::GET, "/users/mel", nullptr));
+    CPPUNIT_ASSERT(&handlers[2] == router->findRoute(RestRequest::GET, "/users/a/b", nullptr));
+
+    // A literal that leads nowhere falls back to the parameter
+    CPPUNIT_ASSERT(&handlers[3] == router->findRoute(RestRequest::GET, "/users/me/profile", &request));
+    CPPUNIT_ASSERT(0 == request.getParams()["id"].compare("me"));
+}
+
+void
+TestRouter::testMalformed(void)
+{
+    CPPUNIT_ASSERT(!router->addRoute(RestRequest::GET, "users", &handlers[0]));
+    CPPUNIT_ASSERT(!router->addRoute(RestRequest::GET, "/users/{id", &handlers[0]));
+    CPPUNIT_ASSERT(!router->addRoute(RestRequest::GET, "/users/{}", &handlers[0]));
+    CPPUNIT_ASSERT(!router->addRoute(RestRequest::GET, "/users/x{id}", &handlers[0]));
+    CPPUNIT_ASSERT(!router->addRoute(RestRequest::GET, "/users/{id}x", &handlers[0]));
+    CPPUNIT_ASSERT(!router->addRoute(RestRequest::GET, "/files/*/more", &handlers[0]));
+    CPPUNIT_ASSERT(!router->addRoute(RestRequest::GET, "/files/{path*}/more", &handlers[0]));
+    CPPUNIT_ASSERT(!router->addRoute(RestRequest::INVALID, "/users", &handlers[0]));
+}
+
+void
+TestRouter::testConflict(void)
+{
+    CPPUNIT_ASSERT(router->addRoute(RestRequest::GET, "/users/{id}", &handlers[0]));
+    CPPUNIT_ASSERT(router->addRoute(RestRequest::GET, "/users/{id}/posts/{post}", &handlers[1]));
+
+    // A parameter must have the same name as the one already at its place
+    const string* conflict = router->findParamConflict(RestRequest::GET, "/users/{userId}/posts");
+    CPPUNIT_ASSERT(nullptr != conflict && 0 == conflict->compare("id"));
+    CPPUNIT_ASSERT(!router->addRoute(RestRequest::GET, "/users/{userId}/posts", &handlers[2]));
+    CPPUNIT_ASSERT(!router->addRoute(RestRequest::GET, "/users/{id}/posts/{p}", &handlers[2]));
+    CPPUNIT_ASSERT(nullptr == router->findRoute(RestRequest::GET, "/users/5/posts", nullptr));
+
+    // Other places, methods and wildcards do not conflict
+    CPPUNIT_ASSERT(nullptr == router->findParamConflict(RestRequest::GET, "/user/{name}"));
+    CPPUNIT_ASSERT(nullptr == router->findParamConflict(RestRequest::POST, "/users/{userId}"));
+    CPPUNIT_ASSERT(nullptr == router->findParamConflict(RestRequest::GET, "/users/{rest*}"));
+    CPPUNIT_ASSERT(router->addRoute(RestRequest::GET, "/users/{id}/posts", &handlers[2]));
+    CPPUNIT_ASSERT(&handlers[2] == router->findRoute(RestRequest::GET, "/users/5/posts", nullptr));
+    CPPUNIT_ASSERT(&handlers[1] == router->findRoute(RestRequest::GET, "/users/5/posts/7", nullptr));
+
+    // A wildcard must have the same name as the one already at its place,
+    // and both spellings of an unnamed wildcard are the same route
+    CPPUNIT_ASSERT(router->addRoute(RestRequest::GET, "/files/{path*}", &handlers[0]));
+    conflict = router->findParamConflict(RestRequest::GET, "/files/{rest*}");
+    CPPUNIT_ASSERT(nullptr != conflict && 0 == conflict->compare("path"));
+    CPPUNIT_ASSERT(!router->addRoute(RestRequest::GET, "/files/*", &handlers[1]));
+    CPPUNIT_ASSERT(router->addRoute(RestRequest::GET, "/static/*", &handlers[1]));
+    CPPUNIT_ASSERT(nullptr == router->findParamConflict(RestRequest::GET, "/static/{*}"));
+    CPPUNIT_ASSERT(router->addRoute(RestRequest::GET, "/static/{*}", &handlers[2]));
+    CPPUNIT_ASSERT(&handlers[2] == router->findRoute(RestRequest::GET, "/static/a/b", nullptr));
+}
+
+void TestRouter::setUp(void)
+{
+    router = new Router();
+}
+
+void TestRouter::tearDown(void)
+{
+    delete router;
+}
+
+//-----------------------------------------------------------------------------
+
+CPPUNIT_TEST_SUITE_REGISTRATION( TestRouter );
+
+int main(int argc, char* argv[])
+{
+    // informs test-listener about testresults
+    CPPUNIT_NS::TestResult testresult;
+
+    // register listener for collecting the test-results
+    CPPUNIT_NS::TestResultCollector collectedresults;
+    testresult.addListener (&collectedresults);
+
+    // register listener for per-test progress output
+    CPPUNIT_NS::BriefTestProgressListener progress;
+    testresult.addListener (&progress);
+
+    // insert test-suite at test-runner by registry
+    CPPUNIT_NS::TestRunner testrunner;
+    testrunner.addTest (CPPUNIT_NS::TestFactoryRegistry::getRegistry().makeTest ());
+    testrunner.run(testresult);
+
+    // output results in compiler-format
+    CPPUNIT_NS::CompilerOutputter compileroutputter(&collectedresults, std::cerr);
+    compileroutputter.write ();
+
+    // Output XML for Jenkins CPPunit plugin
+    ofstream xmlFileOut("cppTestRouter.xml");
+    XmlOutputter xmlOut(&collectedresults, xmlFileOut);
+    xmlOut.write();
+
+    // return 0 if tests were successful
+    return collectedresults.wasSuccessful() ? 0 : 1;
+}
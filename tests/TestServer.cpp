@@ -0,0 +1,1600 @@
+#include <RestServer.h>
+#include <SecureRestServer.h>
+#ifdef CPPRESTLIB_IO_URING
+#include <IoUringLoop.h>
+#endif
+
+#include <cppunit/TestCase.h>
+#include <cppunit/TestFixture.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/TestRunner.h>
+#include <cppunit/BriefTestProgressListener.h>
+#include <cppunit/CompilerOutputter.h>
+#include <cppunit/XmlOutputter.h>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+
+using namespace CppUnit;
+using namespace std;
+using namespace kaoisoft;
+
+/* Seconds that a client waits for the server before a test fails */
+#define CLIENT_TIMEOUT 5
+
+/* Number of server modes that the tests are run in */
+#define SERVER_MODE_COUNT 4
+
+/* Server modes that the tests are run in. IO_URING falls back to EVENT_LOOP
+   where it is not available. */
+static const RestServer::ServerMode serverModes[SERVER_MODE_COUNT] =
+{
+    RestServer::THREAD_PER_CONNECTION,
+    RestServer::EVENT_LOOP,
+    RestServer::THREAD_POOL,
+    RestServer::IO_URING
+};
+
+//-----------------------------------------------------------------------------
+
+/**
+ * Response read by a test client. Header names are lower case.
+ */
+struct TestResponse
+{
+    int code;
+    map<string, string> headers;
+    string body;
+};
+
+/**
+ * Client connection to a server under test, with or without TLS. Reads time
+ * out, so that a server that stops answering fails the test instead of
+ * hanging it.
+ */
+class TestClient
+{
+private:
+    int sock;           // Connection to the server, or -1
+    SSL* ssl;           // TLS connection, or nullptr if the connection is plain
+    string input;       // Bytes that have been received and not yet read
+
+    /**
+     * Receives more of what the server sends.
+     *
+     * @return true if anything was received
+     */
+    bool fill();
+
+public:
+    TestClient() { sock = -1; ssl = nullptr; }
+    ~TestClient() { disconnect(); }
+
+    /**
+     * Connects to a server on the loopback interface.
+     *
+     * @param port Server's port
+     * @param ctx Context with which the connection is secured, or nullptr
+     *            for a plain connection
+     * @param session Session to resume, or nullptr
+     *
+     * @return true if successful
+     */
+    bool connect(int port, SSL_CTX* ctx, SSL_SESSION* session);
+
+    /**
+     * Closes the connection.
+     */
+    void disconnect();
+
+    /**
+     * Gets the TLS connection.
+     *
+     * @return TLS connection, or nullptr if the connection is plain
+     */
+    SSL* getSsl() { return ssl; }
+
+    /**
+     * Checks whether the server has closed the connection, waiting for it to
+     * do so if need be.
+     *
+     * @return true if the connection was closed
+     */
+    bool isClosed();
+
+    /**
+     * Reads a number of bytes.
+     *
+     * @param length Number of bytes
+     * @param data Bytes that are read
+     *
+     * @return true if they were all read
+     */
+    bool read(size_t length, string* data);
+
+    /**
+     * Reads a response whose length is given by its Content-Length header.
+     *
+     * @param response Response that is read
+     *
+     * @return true if a whole response was read
+     */
+    bool readResponse(TestResponse* response);
+
+    /**
+     * Sends bytes to the server.
+     *
+     * @param data Bytes to send
+     *
+     * @return true if they were all sent
+     */
+    bool send(const string& data);
+};
+
+bool TestClient::connect(int port, SSL_CTX* ctx, SSL_SESSION* session)
+{
+    sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (0 > sock)
+    {
+        return false;
+    }
+
+    struct timeval timeout;
+    timeout.tv_sec = CLIENT_TIMEOUT;
+    timeout.tv_usec = 0;
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (0 != ::connect(sock, (struct sockaddr*)&addr, sizeof(addr)))
+    {
+        return false;
+    }
+
+    if (nullptr != ctx)
+    {
+        ssl = SSL_new(ctx);
+        SSL_set_fd(ssl, sock);
+        if (nullptr != session)
+        {
+            SSL_set_session(ssl, session);
+        }
+        if (1 != SSL_connect(ssl))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void TestClient::disconnect()
+{
+    if (nullptr != ssl)
+    {
+        // A session that is not shut down cannot be resumed
+        SSL_shutdown(ssl);
+        SSL_free(ssl);
+        ssl = nullptr;
+    }
+    if (0 <= sock)
+    {
+        close(sock);
+        sock = -1;
+    }
+    input.clear();
+}
+
+bool TestClient::fill()
+{
+    char buffer[16384];
+    int count = (nullptr != ssl) ? SSL_read(ssl, buffer, sizeof(buffer)) :
+                                   (int)recv(sock, buffer, sizeof(buffer), 0);
+    if (0 >= count)
+    {
+        return false;
+    }
+    input.append(buffer, count);
+
+    return true;
+}
+
+bool TestClient::isClosed()
+{
+    char buffer[1];
+    errno = 0;
+    int count = (nullptr != ssl) ? SSL_read(ssl, buffer, sizeof(buffer)) :
+                                   (int)recv(sock, buffer, sizeof(buffer), 0);
+    if (0 < count)
+    {
+        input.append(buffer, count);
+        return false;
+    }
+
+    // A read that timed out means that the connection is still open
+    return EAGAIN != errno && EWOULDBLOCK != errno;
+}
+
+bool TestClient::read(size_t length, string* data)
+{
+    while (input.length() < length)
+    {
+        if (!fill())
+        {
+            return false;
+        }
+    }
+    data->assign(input, 0, length);
+    input.erase(0, length);
+
+    return true;
+}
+
+bool TestClient::readResponse(TestResponse* response)
+{
+    size_t end;
+    while (string::npos == (end = input.find("\r\n\r\n")))
+    {
+        if (!fill())
+        {
+            return false;
+        }
+    }
+
+    // Status line
+    size_t lineEnd = input.find("\r\n");
+    if (0 != input.compare(0, 5, "HTTP/") || string::npos == input.find(' '))
+    {
+        return false;
+    }
+    response->code = atoi(input.c_str() + input.find(' ') + 1);
+
+    // Headers
+    response->headers.clear();
+    while (lineEnd < end)
+    {
+        size_t start = lineEnd + 2;
+        lineEnd = input.find("\r\n", start);
+        size_t colon = input.find(':', start);
+        if (colon >= lineEnd)
+        {
+            continue;
+        }
+        string name = input.substr(start, colon - start);
+        for (size_t i = 0; i < name.length(); i++)
+        {
+            name[i] = tolower(name[i]);
+        }
+        size_t value = input.find_first_not_of(' ', colon + 1);
+        response->headers[name] = input.substr(value, lineEnd - value);
+    }
+
+    // Body
+    size_t length = strtoul(response->headers["content-length"].c_str(), nullptr, 10);
+    while (input.length() < end + 4 + length)
+    {
+        if (!fill())
+        {
+            return false;
+        }
+    }
+    response->body = input.substr(end + 4, length);
+    input.erase(0, end + 4 + length);
+
+    return true;
+}
+
+bool TestClient::send(const string& data)
+{
+    size_t sent = 0;
+    while (sent < data.length())
+    {
+        int count = (nullptr != ssl) ? SSL_write(ssl, data.data() + sent, data.length() - sent) :
+                                       (int)::send(sock, data.data() + sent, data.length() - sent,
+                                                   MSG_NOSIGNAL);
+        if (0 >= count)
+        {
+            return false;
+        }
+        sent += count;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+/**
+ * Makes a certificate for a key.
+ *
+ * @param key Key whose public half is certified
+ * @param name Common name of the subject
+ * @param issuer Certificate of the issuer, or nullptr for a self-signed one
+ * @param issuerKey Key with which the certificate is signed
+ * @param serial Serial number
+ *
+ * @return New certificate, or nullptr on error
+ */
+static X509* makeCertificate(EVP_PKEY* key, const char* name, X509* issuer,
+                             EVP_PKEY* issuerKey, long serial)
+{
+    X509* cert = X509_new();
+    X509_set_version(cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), serial);
+    X509_gmtime_adj(X509_getm_notBefore(cert), -3600);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 24 * 3600);
+    X509_set_pubkey(cert, key);
+    X509_NAME* subject = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(subject, "CN", MBSTRING_ASC, (const unsigned char*)name, -1, -1, 0);
+    X509_set_issuer_name(cert, (nullptr != issuer) ? X509_get_subject_name(issuer) : subject);
+
+    // Only the CA may sign certificates
+    X509V3_CTX ctx;
+    X509V3_set_ctx_nodb(&ctx);
+    X509V3_set_ctx(&ctx, (nullptr != issuer) ? issuer : cert, cert, nullptr, nullptr, 0);
+    X509_EXTENSION* ext = X509V3_EXT_conf_nid(nullptr, &ctx, NID_basic_constraints,
+                                              (nullptr != issuer) ? "CA:FALSE" : "critical,CA:TRUE");
+    X509_add_ext(cert, ext, -1);
+    X509_EXTENSION_free(ext);
+
+    if (0 == X509_sign(cert, issuerKey, EVP_sha256()))
+    {
+        X509_free(cert);
+        return nullptr;
+    }
+
+    return cert;
+}
+
+/**
+ * Writes a certificate and, optionally, its key to PEM files.
+ *
+ * @param cert Certificate
+ * @param certFile Name of the certificate's file
+ * @param key Key, or nullptr
+ * @param keyFile Name of the key's file
+ *
+ * @return true if successful
+ */
+static bool writePem(X509* cert, const string& certFile, EVP_PKEY* key, const string& keyFile)
+{
+    FILE* file = fopen(certFile.c_str(), "w");
+    if (nullptr == file)
+    {
+        return false;
+    }
+    bool written = (1 == PEM_write_X509(file, cert));
+    fclose(file);
+
+    if (written && nullptr != key)
+    {
+        file = fopen(keyFile.c_str(), "w");
+        if (nullptr == file)
+        {
+            return false;
+        }
+        written = (1 == PEM_write_PrivateKey(file, key, nullptr, nullptr, 0, nullptr, nullptr));
+        fclose(file);
+    }
+
+    return written;
+}
+
+/**
+ * Writes a CA certificate, and certificates that it signed for a server and
+ * a client, with their keys, to a directory. They are valid for a day.
+ *
+ * @param dir Directory
+ *
+ * @return true if successful
+ */
+static bool writeCertificates(const string& dir)
+{
+    EVP_PKEY* caKey = EVP_EC_gen("P-256");
+    EVP_PKEY* serverKey = EVP_EC_gen("P-256");
+    EVP_PKEY* clientKey = EVP_EC_gen("P-256");
+    X509* caCert = nullptr;
+    X509* serverCert = nullptr;
+    X509* clientCert = nullptr;
+    bool written = false;
+    if (nullptr != caKey && nullptr != serverKey && nullptr != clientKey)
+    {
+        caCert = makeCertificate(caKey, "Test CA", nullptr, caKey, 1);
+        if (nullptr != caCert)
+        {
+            serverCert = makeCertificate(serverKey, "localhost", caCert, caKey, 2);
+            clientCert = makeCertificate(clientKey, "Test Client", caCert, caKey, 3);
+        }
+    }
+    if (nullptr != serverCert && nullptr != clientCert)
+    {
+        written = writePem(caCert, dir + "/ca.crt", nullptr, "") &&
+                  writePem(serverCert, dir + "/server.crt", serverKey, dir + "/server.key") &&
+                  writePem(clientCert, dir + "/client.crt", clientKey, dir + "/client.key");
+    }
+
+    X509_free(clientCert);
+    X509_free(serverCert);
+    X509_free(caCert);
+    EVP_PKEY_free(clientKey);
+    EVP_PKEY_free(serverKey);
+    EVP_PKEY_free(caKey);
+
+    return written;
+}
+
+/**
+ * Finds a port on which nothing is listening.
+ *
+ * @return Port number, or 0 on error
+ */
+static int findFreePort()
+{
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(addr);
+    int port = 0;
+    if (0 == bind(sock, (struct sockaddr*)&addr, sizeof(addr)) &&
+        0 == getsockname(sock, (struct sockaddr*)&addr, &length))
+    {
+        port = ntohs(addr.sin_port);
+    }
+    close(sock);
+
+    return port;
+}
+
+/**
+ * Makes an HTTP/1.1 GET request.
+ *
+ * @param path Request path
+ * @param headers Header lines besides Host, each ending in CRLF
+ *
+ * @return Request
+ */
+static string getRequest(const string& path, const string& headers)
+{
+    return "GET " + path + " HTTP/1.1\r\nHost: localhost\r\n" + headers + "\r\n";
+}
+
+/**
+ * Handler that answers GET /bytes/{tag}/{count} with a body of count bytes
+ * that starts with the tag and a colon, so that a client can tell the
+ * responses to pipelined requests apart.
+ *
+ * @param request Client's request
+ * @param response Response to fill in
+ */
+static void sendBytes(const RestRequest& request, RestResponse& response)
+{
+    string body(request.getParam("tag"));
+    body.append(":");
+    size_t count = strtoul(string(request.getParam("count")).c_str(), nullptr, 10);
+    if (body.length() < count)
+    {
+        body.append(count - body.length(), 'x');
+    }
+
+    response.setCode(200);
+    response.setReason("OK");
+    response.addHeader("Content-Type", "text/plain");
+    response.setBody(std::move(body));
+}
+
+/**
+ * Handler that answers POST /echo with the request's body.
+ *
+ * @param request Client's request
+ * @param response Response to fill in
+ */
+static void echoBody(const RestRequest& request, RestResponse& response)
+{
+    response.setCode(200);
+    response.setReason("OK");
+    response.addHeader("Content-Type", "application/octet-stream");
+    response.setBody(string(request.getBodyView()));
+}
+
+//-----------------------------------------------------------------------------
+
+class TestServer : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(TestServer);
+    CPPUNIT_TEST(testPipelineOverCaps);
+    CPPUNIT_TEST(testKeepAlive);
+    CPPUNIT_TEST(testEventLoopInterleaved);
+    CPPUNIT_TEST(testThreadPoolFull);
+    CPPUNIT_TEST(testLargeBody);
+    CPPUNIT_TEST(testNotFound);
+    CPPUNIT_TEST(testAcceptBurst);
+    CPPUNIT_TEST(testListenSockets);
+    CPPUNIT_TEST(testScatterWrite);
+    CPPUNIT_TEST(testSlowReader);
+    CPPUNIT_TEST(testIoUringFallback);
+    CPPUNIT_TEST(testSessionResumption);
+    CPPUNIT_TEST(testHandshakes);
+    CPPUNIT_TEST(testKtls);
+    CPPUNIT_TEST(testCryptoPool);
+    CPPUNIT_TEST(testTlsConfig);
+    CPPUNIT_TEST(testAlpn);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp(void);
+    void tearDown(void);
+
+protected:
+    void testPipelineOverCaps(void);
+    void testKeepAlive(void);
+    void testEventLoopInterleaved(void);
+    void testThreadPoolFull(void);
+    void testLargeBody(void);
+    void testNotFound(void);
+    void testAcceptBurst(void);
+    void testListenSockets(void);
+    void testScatterWrite(void);
+    void testSlowReader(void);
+    void testIoUringFallback(void);
+    void testSessionResumption(void);
+    void testHandshakes(void);
+    void testKtls(void);
+    void testCryptoPool(void);
+    void testTlsConfig(void);
+    void testAlpn(void);
+
+private:
+    string certDir;         // Directory of the certificates and keys
+    SSL_CTX* clientCtx;     // Context of the secure test clients
+
+    /**
+     * Makes a context for secure test clients, which present their own
+     * certificate and check the server's.
+     *
+     * @param maxVersion Highest protocol version, or 0 for the highest
+     *                   supported
+     *
+     * @return New context
+     */
+    SSL_CTX* newClientContext(int maxVersion);
+
+    /**
+     * Makes one request over a new secure connection, and keeps the session
+     * that the server gave the client, from a ticket or otherwise.
+     *
+     * @param port Server's port
+     * @param ctx Client's context
+     * @param session Session to resume, or nullptr, which is replaced by the
+     *                connection's session
+     * @param reused Whether the session was resumed
+     *
+     * @return true if the request was served
+     */
+    bool requestOverTls(int port, SSL_CTX* ctx, SSL_SESSION** session, bool* reused);
+
+    /**
+     * Sets up a server on a free port, adds the test routes and starts it.
+     *
+     * @param server Server, which is secured if it is a SecureRestServer
+     * @param port Port on which the server listens
+     *
+     * @return true if successful
+     */
+    bool startServer(RestServer* server, int* port);
+
+    /**
+     * Sets up a secure server with a TLS configuration on a free port, adds
+     * the test routes and starts it.
+     *
+     * @param server Server
+     * @param config TLS configuration, or nullptr for OpenSSL's defaults
+     * @param port Port on which the server listens
+     *
+     * @return true if successful
+     */
+    bool startServer(RestServer* server, const TlsConfig* config, int* port);
+};
+
+//-----------------------------------------------------------------------------
+
+SSL_CTX* TestServer::newClientContext(int maxVersion)
+{
+    SSL_CTX* ctx = SSL_CTX_new(TLS_client_method());
+    SSL_CTX_use_certificate_file(ctx, (certDir + "/client.crt").c_str(), SSL_FILETYPE_PEM);
+    SSL_CTX_use_PrivateKey_file(ctx, (certDir + "/client.key").c_str(), SSL_FILETYPE_PEM);
+    SSL_CTX_load_verify_locations(ctx, (certDir + "/ca.crt").c_str(), nullptr);
+    SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, nullptr);
+    SSL_CTX_set_max_proto_version(ctx, maxVersion);
+
+    return ctx;
+}
+
+bool TestServer::requestOverTls(int port, SSL_CTX* ctx, SSL_SESSION** session, bool* reused)
+{
+    TestClient client;
+    TestResponse response;
+    if (!client.connect(port, ctx, *session) ||
+        !client.send(getRequest("/bytes/a/10", "")) ||
+        !client.readResponse(&response) ||
+        200 != response.code)
+    {
+        return false;
+    }
+
+    // A TLS 1.3 ticket arrives after the handshake, so the session is only
+    // complete once a response has been read
+    *reused = (1 == SSL_session_reused(client.getSsl()));
+    SSL_SESSION_free(*session);
+    *session = SSL_get1_session(client.getSsl());
+
+    return true;
+}
+
+bool TestServer::startServer(RestServer* server, int* port)
+{
+    return startServer(server, nullptr, port);
+}
+
+bool TestServer::startServer(RestServer* server, const TlsConfig* config, int* port)
+{
+    *port = findFreePort();
+    if (0 == *port)
+    {
+        return false;
+    }
+
+    SecureRestServer* secureServer = dynamic_cast<SecureRestServer*>(server);
+    bool ready;
+    if (nullptr == secureServer)
+    {
+        ready = server->setUp(to_string(*port));
+    }
+    else if (nullptr == config)
+    {
+        ready = secureServer->setUp(to_string(*port), certDir + "/ca.crt",
+                                    certDir + "/server.crt", certDir + "/server.key");
+    }
+    else
+    {
+        ready = secureServer->setUp(to_string(*port), certDir + "/ca.crt",
+                                    certDir + "/server.crt", certDir + "/server.key", *config);
+    }
+    if (!ready)
+    {
+        return false;
+    }
+
+    server->addRoute(RestRequest::GET, "/bytes/{tag}/{count}", sendBytes);
+    server->addRoute(RestRequest::POST, "/echo", echoBody);
+
+    RestResponse staticResponse;
+    staticResponse.setCode(200);
+    staticResponse.setReason("OK");
+    staticResponse.addHeader("Content-Type", "text/plain");
+    staticResponse.setBody("static");
+    server->addStaticRoute(RestRequest::GET, "/static", staticResponse);
+    server->start();
+
+    return true;
+}
+
+void
+TestServer::testPipelineOverCaps(void)
+{
+    // More requests than may be queued, all sent at once, whose responses
+    // are larger than the output buffer and than the socket buffers, so that
+    // the server has to wait for the client to read them
+    const int requestCount = 24;
+    const size_t responseSize = 512 * 1024;
+    string requests;
+    for (int i = 0; i < requestCount; i++)
+    {
+        requests.append("GET /bytes/" + to_string(i) + "/" + to_string(responseSize) +
+                        " HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    }
+
+    for (int secure = 0; secure < 2; secure++)
+    {
+        for (int mode = 0; mode < SERVER_MODE_COUNT; mode++)
+        {
+            RestServer* server = secure ? new SecureRestServer() : new RestServer();
+            server->setServerMode(serverModes[mode]);
+            server->setMaxPipelinedRequests(4);
+            server->setMaxOutputBuffer(64 * 1024);
+            int port;
+            CPPUNIT_ASSERT(startServer(server, &port));
+
+            // Every response arrives, in the order of the requests
+            TestClient client;
+            CPPUNIT_ASSERT(client.connect(port, secure ? clientCtx : nullptr, nullptr));
+            CPPUNIT_ASSERT(client.send(requests));
+            for (int i = 0; i < requestCount; i++)
+            {
+                TestResponse response;
+                bool read = client.readResponse(&response);
+                CPPUNIT_ASSERT(read);
+                if (!read)
+                {
+                    break;
+                }
+                string tag = to_string(i) + ":";
+                CPPUNIT_ASSERT(200 == response.code);
+                CPPUNIT_ASSERT(responseSize == response.body.length());
+                CPPUNIT_ASSERT(0 == response.body.compare(0, tag.length(), tag));
+            }
+
+            client.disconnect();
+            server->stop();
+            delete server;
+        }
+    }
+}
+
+void
+TestServer::testKeepAlive(void)
+{
+    for (int mode = 0; mode < SERVER_MODE_COUNT; mode++)
+    {
+        RestServer* server = new RestServer();
+        server->setServerMode(serverModes[mode]);
+        server->setMaxRequestsPerConnection(3);
+        server->setKeepAliveTimeout(200);
+        int port;
+        CPPUNIT_ASSERT(startServer(server, &port));
+
+        // HTTP/1.1 connections are kept open up to the request limit
+        TestClient client;
+        TestResponse response;
+        CPPUNIT_ASSERT(client.connect(port, nullptr, nullptr));
+        for (int i = 0; i < 3; i++)
+        {
+            CPPUNIT_ASSERT(client.send(getRequest("/bytes/" + to_string(i) + "/10", "")));
+            CPPUNIT_ASSERT(client.readResponse(&response));
+            CPPUNIT_ASSERT(200 == response.code);
+            CPPUNIT_ASSERT(0 == response.body.compare(0, 2, to_string(i) + ":"));
+            CPPUNIT_ASSERT((2 == i) == (0 == response.headers["connection"].compare("close")));
+        }
+        CPPUNIT_ASSERT(client.isClosed());
+        client.disconnect();
+
+        // A client that asks for the connection to be closed has it closed
+        CPPUNIT_ASSERT(client.connect(port, nullptr, nullptr));
+        CPPUNIT_ASSERT(client.send(getRequest("/bytes/a/10", "Connection: close\r\n")));
+        CPPUNIT_ASSERT(client.readResponse(&response));
+        CPPUNIT_ASSERT(0 == response.headers["connection"].compare("close"));
+        CPPUNIT_ASSERT(client.isClosed());
+        client.disconnect();
+
+        // and so does an HTTP/1.0 client that does not ask for keep-alive
+        CPPUNIT_ASSERT(client.connect(port, nullptr, nullptr));
+        CPPUNIT_ASSERT(client.send("GET /bytes/a/10 HTTP/1.0\r\n\r\n"));
+        CPPUNIT_ASSERT(client.readResponse(&response));
+        CPPUNIT_ASSERT(200 == response.code);
+        CPPUNIT_ASSERT(client.isClosed());
+        client.disconnect();
+
+        // An idle connection is closed after the keep-alive timeout
+        CPPUNIT_ASSERT(client.connect(port, nullptr, nullptr));
+        CPPUNIT_ASSERT(client.send(getRequest("/bytes/a/10", "")));
+        CPPUNIT_ASSERT(client.readResponse(&response));
+        CPPUNIT_ASSERT(0 != response.headers["connection"].compare("close"));
+        CPPUNIT_ASSERT(client.isClosed());
+        client.disconnect();
+
+        server->stop();
+        delete server;
+    }
+}
+
+void
+TestServer::testEventLoopInterleaved(void)
+{
+    const int clientCount = 20;
+    const RestServer::ServerMode loopModes[] = { RestServer::EVENT_LOOP, RestServer::IO_URING };
+    for (size_t mode = 0; mode < sizeof(loopModes) / sizeof(loopModes[0]); mode++)
+    {
+        // One loop serves every connection
+        RestServer* server = new RestServer();
+        server->setServerMode(loopModes[mode]);
+        server->setEventLoopCount(1);
+        int port;
+        CPPUNIT_ASSERT(startServer(server, &port));
+
+        // Each client sends the first part of its request, and then the rest
+        // in the opposite order, so that the loop has to keep the state of
+        // every connection while it waits for the others
+        TestClient clients[clientCount];
+        for (int i = 0; i < clientCount; i++)
+        {
+            CPPUNIT_ASSERT(clients[i].connect(port, nullptr, nullptr));
+            CPPUNIT_ASSERT(clients[i].send("GET /bytes/" + to_string(i) + "/100 HTTP/1.1\r\nHo"));
+        }
+        for (int i = clientCount - 1; i >= 0; i--)
+        {
+            CPPUNIT_ASSERT(clients[i].send("st: localhost\r\n\r\n"));
+        }
+        for (int i = 0; i < clientCount; i++)
+        {
+            TestResponse response;
+            CPPUNIT_ASSERT(clients[i].readResponse(&response));
+            CPPUNIT_ASSERT(200 == response.code);
+            CPPUNIT_ASSERT(100 == response.body.length());
+            CPPUNIT_ASSERT(0 == response.body.compare(0, to_string(i).length() + 1, to_string(i) + ":"));
+            clients[i].disconnect();
+        }
+
+        server->stop();
+        delete server;
+    }
+}
+
+void
+TestServer::testThreadPoolFull(void)
+{
+    RestServer* server = new RestServer();
+    server->setServerMode(RestServer::THREAD_POOL);
+    server->setThreadPoolSize(2);
+    server->setThreadPoolQueueDepth(1);
+    server->setThreadPoolFullPolicy(ThreadPool::REJECT);
+    server->setListenSocketCount(1);
+    int port;
+    CPPUNIT_ASSERT(startServer(server, &port));
+
+    // Each worker serves a persistent connection until it is closed
+    TestClient clients[4];
+    TestResponse response;
+    for (int i = 0; i < 2; i++)
+    {
+        CPPUNIT_ASSERT(clients[i].connect(port, nullptr, nullptr));
+        CPPUNIT_ASSERT(clients[i].send(getRequest("/bytes/a/10", "")));
+        CPPUNIT_ASSERT(clients[i].readResponse(&response));
+        CPPUNIT_ASSERT(200 == response.code);
+    }
+
+    // so the next client waits in the queue, and the one after that is
+    // turned away
+    CPPUNIT_ASSERT(clients[2].connect(port, nullptr, nullptr));
+    CPPUNIT_ASSERT(clients[2].send(getRequest("/bytes/c/10", "")));
+    CPPUNIT_ASSERT(clients[3].connect(port, nullptr, nullptr));
+    CPPUNIT_ASSERT(clients[3].readResponse(&response));
+    CPPUNIT_ASSERT(503 == response.code);
+    CPPUNIT_ASSERT(clients[3].isClosed());
+
+    // Once a worker is free, the waiting client is served
+    CPPUNIT_ASSERT(clients[0].send(getRequest("/bytes/a/10", "Connection: close\r\n")));
+    CPPUNIT_ASSERT(clients[0].readResponse(&response));
+    CPPUNIT_ASSERT(clients[2].readResponse(&response));
+    CPPUNIT_ASSERT(200 == response.code);
+    CPPUNIT_ASSERT(0 == response.body.compare(0, 2, "c:"));
+
+    ThreadPoolStatistics stats;
+    CPPUNIT_ASSERT(server->getThreadPoolStatistics(&stats));
+    CPPUNIT_ASSERT(2 == stats.size);
+    CPPUNIT_ASSERT(3 == stats.submitted);
+    CPPUNIT_ASSERT(1 == stats.rejected);
+
+    for (int i = 0; i < 4; i++)
+    {
+        clients[i].disconnect();
+    }
+    server->stop();
+    delete server;
+}
+
+void
+TestServer::testLargeBody(void)
+{
+    // A body that takes many reads, with another request right behind it
+    string body(2 * 1024 * 1024, ' ');
+    for (size_t i = 0; i < body.length(); i++)
+    {
+        body[i] = 'a' + (i % 23);
+    }
+    string requests = "POST /echo HTTP/1.1\r\nHost: localhost\r\nContent-Length: " +
+                      to_string(body.length()) + "\r\n\r\n" + body +
+                      getRequest("/bytes/next/10", "");
+
+    for (int secure = 0; secure < 2; secure++)
+    {
+        for (int mode = 0; mode < SERVER_MODE_COUNT; mode++)
+        {
+            RestServer* server = secure ? new SecureRestServer() : new RestServer();
+            server->setServerMode(serverModes[mode]);
+            server->setMaxBodySize(4 * 1024 * 1024);
+            int port;
+            CPPUNIT_ASSERT(startServer(server, &port));
+
+            TestClient client;
+            TestResponse response;
+            CPPUNIT_ASSERT(client.connect(port, secure ? clientCtx : nullptr, nullptr));
+            CPPUNIT_ASSERT(client.send(requests));
+            CPPUNIT_ASSERT(client.readResponse(&response));
+            CPPUNIT_ASSERT(200 == response.code);
+            CPPUNIT_ASSERT(0 == response.body.compare(body));
+            CPPUNIT_ASSERT(client.readResponse(&response));
+            CPPUNIT_ASSERT(0 == response.body.compare(0, 5, "next:"));
+
+            // A body larger than the server accepts is refused before it is
+            // read
+            CPPUNIT_ASSERT(client.send("POST /echo HTTP/1.1\r\nHost: localhost\r\n"
+                                       "Content-Length: 4194305\r\n\r\n"));
+            CPPUNIT_ASSERT(client.readResponse(&response));
+            CPPUNIT_ASSERT(413 == response.code);
+            CPPUNIT_ASSERT(client.isClosed());
+
+            client.disconnect();
+            server->stop();
+            delete server;
+        }
+    }
+}
+
+void
+TestServer::testNotFound(void)
+{
+    for (int mode = 0; mode < SERVER_MODE_COUNT; mode++)
+    {
+        RestServer* server = new RestServer();
+        server->setServerMode(serverModes[mode]);
+        int port;
+        CPPUNIT_ASSERT(startServer(server, &port));
+
+        // Paths and methods without a route are not found, and the
+        // connection stays open
+        TestClient client;
+        TestResponse response;
+        CPPUNIT_ASSERT(client.connect(port, nullptr, nullptr));
+        CPPUNIT_ASSERT(client.send(getRequest("/nothing", "")));
+        CPPUNIT_ASSERT(client.readResponse(&response));
+        CPPUNIT_ASSERT(404 == response.code);
+        CPPUNIT_ASSERT(!response.body.empty());
+        CPPUNIT_ASSERT(client.send(getRequest("/bytes/a", "")));
+        CPPUNIT_ASSERT(client.readResponse(&response));
+        CPPUNIT_ASSERT(404 == response.code);
+        CPPUNIT_ASSERT(client.send("DELETE /bytes/a/10 HTTP/1.1\r\nHost: localhost\r\n\r\n"));
+        CPPUNIT_ASSERT(client.readResponse(&response));
+        CPPUNIT_ASSERT(404 == response.code);
+
+        // while the parameters of a route are captured without its query
+        CPPUNIT_ASSERT(client.send(getRequest("/bytes/q/10?count=99", "")));
+        CPPUNIT_ASSERT(client.readResponse(&response));
+        CPPUNIT_ASSERT(200 == response.code);
+        CPPUNIT_ASSERT(0 == response.body.compare("q:xxxxxxxx"));
+
+        client.disconnect();
+        server->stop();
+        delete server;
+    }
+}
+
+void
+TestServer::testAcceptBurst(void)
+{
+    const int clientCount = 100;
+    for (int mode = 0; mode < SERVER_MODE_COUNT; mode++)
+    {
+        // Many more connections arrive at once than are accepted at a time
+        RestServer* server = new RestServer();
+        server->setServerMode(serverModes[mode]);
+        server->setAcceptBatchSize(4);
+        int port;
+        CPPUNIT_ASSERT(startServer(server, &port));
+
+        TestClient* clients = new TestClient[clientCount];
+        for (int i = 0; i < clientCount; i++)
+        {
+            CPPUNIT_ASSERT(clients[i].connect(port, nullptr, nullptr));
+        }
+
+        // Every one of them is served. Each connection is closed after its
+        // request, so that none of them keeps a worker of the pool.
+        for (int i = 0; i < clientCount; i++)
+        {
+            CPPUNIT_ASSERT(clients[i].send(getRequest("/bytes/" + to_string(i) + "/10",
+                                                      "Connection: close\r\n")));
+        }
+        for (int i = 0; i < clientCount; i++)
+        {
+            TestResponse response;
+            CPPUNIT_ASSERT(clients[i].readResponse(&response));
+            CPPUNIT_ASSERT(200 == response.code);
+            CPPUNIT_ASSERT(0 == response.body.compare(0, to_string(i).length() + 1, to_string(i) + ":"));
+        }
+
+        delete [] clients;
+        server->stop();
+        delete server;
+    }
+}
+
+void
+TestServer::testListenSockets(void)
+{
+    const int clientCount = 40;
+    for (int mode = 0; mode < SERVER_MODE_COUNT; mode++)
+    {
+        // The kernel spreads the connections over four listen sockets, which
+        // three loops share unevenly in the loop modes
+        RestServer* server = new RestServer();
+        server->setServerMode(serverModes[mode]);
+        server->setListenSocketCount(4);
+        server->setEventLoopCount(3);
+        int port;
+        CPPUNIT_ASSERT(startServer(server, &port));
+
+        // Connections on every socket are served
+        TestClient* clients = new TestClient[clientCount];
+        for (int i = 0; i < clientCount; i++)
+        {
+            CPPUNIT_ASSERT(clients[i].connect(port, nullptr, nullptr));
+            CPPUNIT_ASSERT(clients[i].send(getRequest("/bytes/" + to_string(i) + "/10",
+                                                      "Connection: close\r\n")));
+        }
+        for (int i = 0; i < clientCount; i++)
+        {
+            TestResponse response;
+            CPPUNIT_ASSERT(clients[i].readResponse(&response));
+            CPPUNIT_ASSERT(200 == response.code);
+            CPPUNIT_ASSERT(0 == response.body.compare(0, to_string(i).length() + 1, to_string(i) + ":"));
+        }
+
+        delete [] clients;
+        server->stop();
+        delete server;
+    }
+}
+
+void
+TestServer::testScatterWrite(void)
+{
+    // Static, small and large responses, many more than are written with
+    // one call
+    const int requestCount = 60;
+    string requests;
+    for (int i = 0; i < requestCount; i++)
+    {
+        if (0 == i % 3)
+        {
+            requests.append(getRequest("/static", ""));
+        }
+        else
+        {
+            requests.append(getRequest("/bytes/" + to_string(i) + "/" +
+                                       ((1 == i % 3) ? "10" : "100000"), ""));
+        }
+    }
+
+    for (int secure = 0; secure < 2; secure++)
+    {
+        for (int mode = 0; mode < SERVER_MODE_COUNT; mode++)
+        {
+            RestServer* server = secure ? new SecureRestServer() : new RestServer();
+            server->setServerMode(serverModes[mode]);
+            int port;
+            CPPUNIT_ASSERT(startServer(server, &port));
+
+            // Each response's head and body arrive whole and in order
+            TestClient client;
+            CPPUNIT_ASSERT(client.connect(port, secure ? clientCtx : nullptr, nullptr));
+            CPPUNIT_ASSERT(client.send(requests));
+            for (int i = 0; i < requestCount; i++)
+            {
+                TestResponse response;
+                bool read = client.readResponse(&response);
+                CPPUNIT_ASSERT(read);
+                if (!read)
+                {
+                    break;
+                }
+                CPPUNIT_ASSERT(200 == response.code);
+                CPPUNIT_ASSERT(0 == response.headers["content-type"].compare("text/plain"));
+                CPPUNIT_ASSERT(!response.headers["date"].empty());
+                if (0 == i % 3)
+                {
+                    CPPUNIT_ASSERT(0 == response.body.compare("static"));
+                }
+                else
+                {
+                    string tag = to_string(i) + ":";
+                    CPPUNIT_ASSERT(((1 == i % 3) ? 10 : 100000) == response.body.length());
+                    CPPUNIT_ASSERT(0 == response.body.compare(0, tag.length(), tag));
+                }
+            }
+
+            client.disconnect();
+            server->stop();
+            delete server;
+        }
+    }
+}
+
+void
+TestServer::testSlowReader(void)
+{
+    // Responses larger than the socket buffers can hold
+    const size_t responseSize = 16 * 1024 * 1024;
+    string request = getRequest("/bytes/big/" + to_string(responseSize), "");
+    for (int mode = 0; mode < SERVER_MODE_COUNT; mode++)
+    {
+        RestServer* server = new RestServer();
+        server->setServerMode(serverModes[mode]);
+        server->setEventLoopCount(1);
+        server->setWriteTimeout(500);
+        int port;
+        CPPUNIT_ASSERT(startServer(server, &port));
+
+        // While one client does not read its response, another is served
+        TestClient slow;
+        TestClient other;
+        TestResponse response;
+        CPPUNIT_ASSERT(slow.connect(port, nullptr, nullptr));
+        CPPUNIT_ASSERT(slow.send(request));
+        usleep(100000);
+        CPPUNIT_ASSERT(other.connect(port, nullptr, nullptr));
+        CPPUNIT_ASSERT(other.send(getRequest("/bytes/other/10", "")));
+        CPPUNIT_ASSERT(other.readResponse(&response));
+        CPPUNIT_ASSERT(0 == response.body.compare("other:xxxx"));
+
+        // and the slow client still gets all of it once it reads
+        CPPUNIT_ASSERT(slow.readResponse(&response));
+        CPPUNIT_ASSERT(responseSize == response.body.length());
+
+        // A client that stops reading for longer than the write timeout is
+        // disconnected
+        CPPUNIT_ASSERT(slow.send(request));
+        usleep(1500000);
+        CPPUNIT_ASSERT(!slow.readResponse(&response));
+        CPPUNIT_ASSERT(slow.isClosed());
+
+        slow.disconnect();
+        other.disconnect();
+        server->stop();
+        delete server;
+    }
+}
+
+void
+TestServer::testIoUringFallback(void)
+{
+#ifdef CPPRESTLIB_IO_URING
+    bool supported = IoUringLoop::isSupported();
+#else
+    bool supported = false;
+#endif
+
+    for (int secure = 0; secure < 2; secure++)
+    {
+        // io_uring is used for plain connections where the kernel has it,
+        // and event loops otherwise
+        RestServer* server = secure ? new SecureRestServer() : new RestServer();
+        server->setServerMode(RestServer::IO_URING);
+        int port;
+        CPPUNIT_ASSERT(startServer(server, &port));
+        CPPUNIT_ASSERT(((supported && !secure) ? RestServer::IO_URING : RestServer::EVENT_LOOP) ==
+                       server->getServerMode());
+
+        // Either way, clients are served
+        TestClient client;
+        TestResponse response;
+        CPPUNIT_ASSERT(client.connect(port, secure ? clientCtx : nullptr, nullptr));
+        CPPUNIT_ASSERT(client.send(getRequest("/bytes/a/10", "") + getRequest("/static", "")));
+        CPPUNIT_ASSERT(client.readResponse(&response));
+        CPPUNIT_ASSERT(0 == response.body.compare("a:xxxxxxxx"));
+        CPPUNIT_ASSERT(client.readResponse(&response));
+        CPPUNIT_ASSERT(0 == response.body.compare("static"));
+
+        client.disconnect();
+        server->stop();
+        delete server;
+    }
+}
+
+void
+TestServer::testSessionResumption(void)
+{
+    // Sessions are resumed from the cache or from tickets, with TLS 1.2
+    // and TLS 1.3, unless both are disabled
+    const int versions[] = { TLS1_2_VERSION, TLS1_3_VERSION };
+    for (size_t version = 0; version < sizeof(versions) / sizeof(versions[0]); version++)
+    {
+        SSL_CTX* ctx = newClientContext(versions[version]);
+        for (int cache = 0; cache < 2; cache++)
+        {
+            for (int tickets = 0; tickets < 2; tickets++)
+            {
+                SecureRestServer* server = new SecureRestServer();
+                server->setSessionCacheSize(cache ? 100 : 0);
+                server->setSessionTicketsEnabled(1 == tickets);
+                int port;
+                CPPUNIT_ASSERT(startServer(server, &port));
+
+                SSL_SESSION* session = nullptr;
+                bool reused;
+                CPPUNIT_ASSERT(requestOverTls(port, ctx, &session, &reused));
+                CPPUNIT_ASSERT(!reused);
+                CPPUNIT_ASSERT(requestOverTls(port, ctx, &session, &reused));
+                CPPUNIT_ASSERT((cache || tickets) == reused);
+
+                TlsSessionStatistics stats;
+                server->getTlsSessionStatistics(&stats);
+                CPPUNIT_ASSERT((reused ? 1 : 0) == stats.resumed);
+                CPPUNIT_ASSERT((reused ? 1 : 2) == stats.full);
+
+                SSL_SESSION_free(session);
+                server->stop();
+                delete server;
+            }
+        }
+        SSL_CTX_free(ctx);
+    }
+
+    // A ticket outlives one change of the ticket key, but not two
+    SecureRestServer* server = new SecureRestServer();
+    server->setSessionCacheSize(0);
+    int port;
+    CPPUNIT_ASSERT(startServer(server, &port));
+    SSL_SESSION* session = nullptr;
+    bool reused;
+    CPPUNIT_ASSERT(requestOverTls(port, clientCtx, &session, &reused));
+    SSL_SESSION* oldSession = session;
+    SSL_SESSION_up_ref(oldSession);
+    server->rotateSessionTicketKey();
+    CPPUNIT_ASSERT(requestOverTls(port, clientCtx, &session, &reused));
+    CPPUNIT_ASSERT(reused);
+    server->rotateSessionTicketKey();
+    CPPUNIT_ASSERT(requestOverTls(port, clientCtx, &session, &reused));
+    CPPUNIT_ASSERT(reused);
+    CPPUNIT_ASSERT(requestOverTls(port, clientCtx, &oldSession, &reused));
+    CPPUNIT_ASSERT(!reused);
+
+    SSL_SESSION_free(oldSession);
+    SSL_SESSION_free(session);
+    server->stop();
+    delete server;
+}
+
+void
+TestServer::testHandshakes(void)
+{
+    for (int mode = 0; mode < SERVER_MODE_COUNT; mode++)
+    {
+        SecureRestServer* server = new SecureRestServer();
+        server->setServerMode(serverModes[mode]);
+        server->setEventLoopCount(1);
+        server->setHandshakeTimeout(2000);
+        int port;
+        CPPUNIT_ASSERT(startServer(server, &port));
+
+        // A client that never finishes its handshake holds up no one else,
+        // so the others are served long before it times out
+        TestClient stalled;
+        CPPUNIT_ASSERT(stalled.connect(port, nullptr, nullptr));
+        CPPUNIT_ASSERT(stalled.send(string("\x16\x03\x01\x00", 4)));
+        struct timeval start;
+        gettimeofday(&start, nullptr);
+
+        // Sessions are resumed in every mode
+        SSL_SESSION* session = nullptr;
+        bool reused;
+        CPPUNIT_ASSERT(requestOverTls(port, clientCtx, &session, &reused));
+        CPPUNIT_ASSERT(!reused);
+        CPPUNIT_ASSERT(requestOverTls(port, clientCtx, &session, &reused));
+        CPPUNIT_ASSERT(reused);
+        SSL_SESSION_free(session);
+
+        struct timeval end;
+        gettimeofday(&end, nullptr);
+        long elapsed = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_usec - start.tv_usec) / 1000;
+        CPPUNIT_ASSERT(1000 > elapsed);
+
+        // The stalled client is disconnected once its time is up
+        CPPUNIT_ASSERT(stalled.isClosed());
+
+        stalled.disconnect();
+        server->stop();
+        delete server;
+    }
+}
+
+void
+TestServer::testKtls(void)
+{
+    string body(1024 * 1024, 'k');
+    string requests = "POST /echo HTTP/1.1\r\nHost: localhost\r\nContent-Length: " +
+                      to_string(body.length()) + "\r\n\r\n" + body +
+                      getRequest("/bytes/big/1048576", "");
+    for (int mode = 0; mode < SERVER_MODE_COUNT; mode++)
+    {
+        SecureRestServer* server = new SecureRestServer();
+        server->setServerMode(serverModes[mode]);
+        server->setKtlsEnabled(true);
+        server->setMaxBodySize(2 * 1024 * 1024);
+        int port;
+        CPPUNIT_ASSERT(startServer(server, &port));
+
+        // Large requests and responses arrive intact, whether the kernel or
+        // OpenSSL encrypts them
+        for (int i = 0; i < 2; i++)
+        {
+            TestClient client;
+            TestResponse response;
+            CPPUNIT_ASSERT(client.connect(port, clientCtx, nullptr));
+            CPPUNIT_ASSERT(client.send(requests));
+            CPPUNIT_ASSERT(client.readResponse(&response));
+            CPPUNIT_ASSERT(0 == response.body.compare(body));
+            CPPUNIT_ASSERT(client.readResponse(&response));
+            CPPUNIT_ASSERT(1024 * 1024 == response.body.length());
+            CPPUNIT_ASSERT(0 == response.body.compare(0, 4, "big:"));
+        }
+
+        // Every connection is counted as offloaded in some direction or not
+        // at all
+        KtlsStatistics stats;
+        server->getKtlsStatistics(&stats);
+        CPPUNIT_ASSERT(stats.enabled);
+        CPPUNIT_ASSERT(2 <= stats.sendOffloaded + stats.receiveOffloaded + stats.notOffloaded);
+        CPPUNIT_ASSERT(2 >= stats.sendOffloaded && 2 >= stats.receiveOffloaded &&
+                       2 >= stats.notOffloaded);
+
+        server->stop();
+        delete server;
+    }
+}
+
+void
+TestServer::testCryptoPool(void)
+{
+    for (int mode = 0; mode < SERVER_MODE_COUNT; mode++)
+    {
+        SecureRestServer* server = new SecureRestServer();
+        server->setServerMode(serverModes[mode]);
+        server->setCryptoThreadCount(2);
+        int port;
+        CPPUNIT_ASSERT(startServer(server, &port));
+
+        // Each full handshake signs once, and a resumed one not at all
+        SSL_SESSION* session = nullptr;
+        bool reused;
+        for (int i = 0; i < 4; i++)
+        {
+            SSL_SESSION_free(session);
+            session = nullptr;
+            CPPUNIT_ASSERT(requestOverTls(port, clientCtx, &session, &reused));
+            CPPUNIT_ASSERT(!reused);
+        }
+        CPPUNIT_ASSERT(requestOverTls(port, clientCtx, &session, &reused));
+        CPPUNIT_ASSERT(reused);
+        SSL_SESSION_free(session);
+
+        CryptoPoolStatistics stats;
+        ThreadPoolStatistics threadStats;
+        CPPUNIT_ASSERT(server->getCryptoPoolStatistics(&stats, &threadStats));
+        CPPUNIT_ASSERT(2 == threadStats.size);
+        CPPUNIT_ASSERT(4 == stats.offloaded + stats.inlined);
+        CPPUNIT_ASSERT(0 == stats.cancelled);
+
+        server->stop();
+        delete server;
+    }
+
+    // Without threads there is no pool
+    SecureRestServer server;
+    int port;
+    CPPUNIT_ASSERT(startServer(&server, &port));
+    CryptoPoolStatistics stats;
+    ThreadPoolStatistics threadStats;
+    CPPUNIT_ASSERT(!server.getCryptoPoolStatistics(&stats, &threadStats));
+    server.stop();
+}
+
+void
+TestServer::testTlsConfig(void)
+{
+    SSL_CTX* tls12Ctx = newClientContext(TLS1_2_VERSION);
+
+    // TLS 1.3 only, with the server's choice of group and cipher suite
+    TlsConfig config;
+    config.setMinProtocolVersion(TLS1_3_VERSION);
+    config.setGroups("P-256");
+    config.setCipherSuites("TLS_CHACHA20_POLY1305_SHA256");
+    SecureRestServer* server = new SecureRestServer();
+    server->setServerMode(RestServer::EVENT_LOOP);
+    int port;
+    CPPUNIT_ASSERT(startServer(server, &config, &port));
+
+    TestClient client;
+    TestResponse response;
+    CPPUNIT_ASSERT(!client.connect(port, tls12Ctx, nullptr));
+    client.disconnect();
+    CPPUNIT_ASSERT(client.connect(port, clientCtx, nullptr));
+    CPPUNIT_ASSERT(TLS1_3_VERSION == SSL_version(client.getSsl()));
+    CPPUNIT_ASSERT(NID_X9_62_prime256v1 == SSL_get_negotiated_group(client.getSsl()));
+    CPPUNIT_ASSERT(0 == strcmp("TLS_CHACHA20_POLY1305_SHA256",
+                               SSL_get_cipher_name(client.getSsl())));
+    CPPUNIT_ASSERT(client.send(getRequest("/bytes/a/10", "")));
+    CPPUNIT_ASSERT(client.readResponse(&response));
+    CPPUNIT_ASSERT(200 == response.code);
+    client.disconnect();
+    server->stop();
+    delete server;
+
+    // TLS 1.2 only, with the server's choice of cipher
+    TlsConfig legacy;
+    legacy.setMaxProtocolVersion(TLS1_2_VERSION);
+    legacy.setCipherList("ECDHE-ECDSA-AES128-GCM-SHA256");
+    legacy.setPreferServerCiphers(true);
+    server = new SecureRestServer();
+    CPPUNIT_ASSERT(startServer(server, &legacy, &port));
+    CPPUNIT_ASSERT(client.connect(port, clientCtx, nullptr));
+    CPPUNIT_ASSERT(TLS1_2_VERSION == SSL_version(client.getSsl()));
+    CPPUNIT_ASSERT(0 == strcmp("ECDHE-ECDSA-AES128-GCM-SHA256",
+                               SSL_get_cipher_name(client.getSsl())));
+    CPPUNIT_ASSERT(client.send(getRequest("/bytes/a/10", "")));
+    CPPUNIT_ASSERT(client.readResponse(&response));
+    CPPUNIT_ASSERT(200 == response.code);
+    client.disconnect();
+    server->stop();
+    delete server;
+
+    // A configuration that OpenSSL does not accept fails the set up
+    TlsConfig wrong;
+    wrong.setGroups("no-such-group");
+    server = new SecureRestServer();
+    CPPUNIT_ASSERT(!startServer(server, &wrong, &port));
+    delete server;
+
+    SSL_CTX_free(tls12Ctx);
+}
+
+void
+TestServer::testAlpn(void)
+{
+    SSL_CTX* h2Ctx = newClientContext(0);
+    SSL_CTX_set_alpn_protos(h2Ctx, (const unsigned char*)"\x02h2\x08http/1.1", 12);
+    SSL_CTX* http1Ctx = newClientContext(0);
+    SSL_CTX_set_alpn_protos(http1Ctx, (const unsigned char*)"\x08http/1.1", 9);
+
+    for (int mode = 0; mode < SERVER_MODE_COUNT; mode++)
+    {
+        for (int enabled = 0; enabled < 2; enabled++)
+        {
+            SecureRestServer* server = new SecureRestServer();
+            server->setServerMode(serverModes[mode]);
+            server->setHttp2Enabled(1 == enabled);
+            int port;
+            CPPUNIT_ASSERT(startServer(server, &port));
+
+#ifdef CPPRESTLIB_HTTP2
+            bool http2 = (1 == enabled);
+#else
+            bool http2 = false;
+#endif
+            // HTTP/2 is chosen when the server offers it and the client
+            // wants it, and the server then answers the client's preface
+            // with its settings
+            TestClient client;
+            const unsigned char* protocol;
+            unsigned int length;
+            CPPUNIT_ASSERT(client.connect(port, h2Ctx, nullptr));
+            SSL_get0_alpn_selected(client.getSsl(), &protocol, &length);
+            if (http2)
+            {
+                CPPUNIT_ASSERT(2 == length && 0 == memcmp("h2", protocol, 2));
+                string frame;
+                CPPUNIT_ASSERT(client.send(string("PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"
+                                                  "\x00\x00\x00\x04\x00\x00\x00\x00\x00", 33)));
+                CPPUNIT_ASSERT(client.read(9, &frame));
+                CPPUNIT_ASSERT(0x04 == frame[3]);
+            }
+            else
+            {
+                CPPUNIT_ASSERT(0 == length);
+            }
+            client.disconnect();
+
+            // A client that only wants HTTP/1.1 is served with it
+            TestResponse response;
+            CPPUNIT_ASSERT(client.connect(port, http1Ctx, nullptr));
+            SSL_get0_alpn_selected(client.getSsl(), &protocol, &length);
+            CPPUNIT_ASSERT(http2 ? (8 == length && 0 == memcmp("http/1.1", protocol, 8)) :
+                                   (0 == length));
+            CPPUNIT_ASSERT(client.send(getRequest("/bytes/a/10", "")));
+            CPPUNIT_ASSERT(client.readResponse(&response));
+            CPPUNIT_ASSERT(200 == response.code);
+            client.disconnect();
+
+            server->stop();
+            delete server;
+        }
+    }
+
+    SSL_CTX_free(http1Ctx);
+    SSL_CTX_free(h2Ctx);
+}
+
+void TestServer::setUp(void)
+{
+    char dir[] = "/tmp/TestServerXXXXXX";
+    certDir = (nullptr != mkdtemp(dir)) ? dir : "/tmp";
+    CPPUNIT_ASSERT(writeCertificates(certDir));
+
+    clientCtx = newClientContext(0);
+}
+
+void TestServer::tearDown(void)
+{
+    SSL_CTX_free(clientCtx);
+
+    const char* files[] = { "ca.crt", "server.crt", "server.key", "client.crt", "client.key" };
+    for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++)
+    {
+        unlink((certDir + "/" + files[i]).c_str());
+    }
+    rmdir(certDir.c_str());
+}
+
+//-----------------------------------------------------------------------------
+
+CPPUNIT_TEST_SUITE_REGISTRATION( TestServer );
+
+int main(int argc, char* argv[])
+{
+    // Writes to connections that the server closed must not end the test
+    signal(SIGPIPE, SIG_IGN);
+
+    // informs test-listener about testresults
+    CPPUNIT_NS::TestResult testresult;
+
+    // register listener for collecting the test-results
+    CPPUNIT_NS::TestResultCollector collectedresults;
+    testresult.addListener (&collectedresults);
+
+    // register listener for per-test progress output
+    CPPUNIT_NS::BriefTestProgressListener progress;
+    testresult.addListener (&progress);
+
+    // insert test-suite at test-runner by registry
+    CPPUNIT_NS::TestRunner testrunner;
+    testrunner.addTest (CPPUNIT_NS::TestFactoryRegistry::getRegistry().makeTest ());
+    testrunner.run(testresult);
+
+    // output results in compiler-format
+    CPPUNIT_NS::CompilerOutputter compileroutputter(&collectedresults, std::cerr);
+    compileroutputter.write ();
+
+    // Output XML for Jenkins CPPunit plugin
+    ofstream xmlFileOut("cppTestServer.xml");
+    XmlOutputter xmlOut(&collectedresults, xmlFileOut);
+    xmlOut.write();
+
+    // return 0 if tests were successful
+    return collectedresults.wasSuccessful() ? 0 : 1;
+}